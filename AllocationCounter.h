@@ -0,0 +1,51 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counts heap allocations on every thread by replacing the global operator new, so a
+// program can check that its steady-state frame allocates nothing (main --check-allocations).
+// The replacements are definitions: include this header in exactly one translation unit
+// of a program
+struct AllocationCounter
+{
+    static std::atomic<uint64_t>& total()
+    {
+        static std::atomic<uint64_t> count(0);
+        return count;
+    }
+
+    static uint64_t count() { return total().load(std::memory_order_relaxed); }
+};
+
+inline void* countedAllocate(std::size_t size, std::size_t alignment)
+{
+    AllocationCounter::total().fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+        size = 1;
+    void* p = alignment > alignof(std::max_align_t)
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size) { return countedAllocate(size, 0); }
+void* operator new[](std::size_t size) { return countedAllocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return countedAllocate(size, std::size_t(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return countedAllocate(size, std::size_t(alignment)); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif
@@ -0,0 +1,372 @@
+#ifndef ASSETSTREAMER_H
+#define ASSETSTREAMER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "MeshFile.h"
+
+// A mesh on its way from disk to the GPU. Usable as soon as it is requested: until its
+// data is resident it draws as a box around its bounds (once those are known)
+class StreamedMesh
+{
+public:
+    enum State { Loading, Uploading, Resident, Failed };
+
+    std::string path;
+    State state = Loading;
+
+    // Local-space bounds, known from Uploading on
+    AABB bounds;
+
+    // The real geometry, shared through MeshCache once Resident
+    MeshHandle mesh;
+
+    // Progress of the upload
+    size_t totalBytes = 0;
+    size_t uploadedBytes = 0;
+
+    bool resident() const { return state == Resident; }
+
+    // What to draw this frame: the mesh once resident, else the placeholder box (null
+    // while the bounds are unknown or the load failed)
+    const Mesh* drawMesh() const
+    {
+        if (state == Resident)
+            return mesh.get();
+        return state == Uploading ? placeholder.get() : nullptr;
+    }
+
+    // Model-space transform for drawMesh(): the placeholder's unit box stretched to the
+    // bounds, then the mesh's own position dequantization
+    glm::mat4 drawTransform() const
+    {
+        if (state == Resident)
+            return mesh->positionTransform;
+        if (state != Uploading)
+            return glm::mat4(1.0f);
+        glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(1e-4f));
+        return glm::scale(glm::translate(glm::mat4(1.0f), bounds.min), size);
+    }
+
+private:
+    friend class AssetStreamer;
+
+    MeshHandle placeholder;
+    std::unique_ptr<Mesh> uploading; // Buffers being filled, handed to MeshCache once complete
+    MeshFile file; // Source of the upload, released once resident
+    bool loaded = false;
+    size_t vertexBytes = 0;
+    bool vertexStorage = false, indexStorage = false;
+};
+
+using StreamHandle = std::shared_ptr<StreamedMesh>;
+
+// Streams meshes from disk without stalling the frame. Files are mapped and parsed (or
+// their binary cache built) on the job system; the GL thread then creates the buffers and
+// copies into them through a staging ring buffer, at most bytesPerFrame a frame. Ring
+// space is recycled with fences, so the CPU never waits for the GPU: when the ring is
+// full the upload just resumes next frame. Finished meshes go into MeshCache, and a
+// mesh the cache already holds (loaded either way) is shared instead of uploaded again
+class AssetStreamer
+{
+public:
+    // Upload budget per frame and staging ring size
+    size_t bytesPerFrame = 4 << 20;
+    size_t ringBytes = 16 << 20;
+
+    // Counters
+    size_t uploadedThisFrame = 0;
+    size_t uploadedTotal = 0;
+    size_t ringStalls = 0; // Frames that stopped early for lack of ring space
+
+    AssetStreamer() : ring(0), ringCapacity(0), ringHead(0), ringUsed(0) {}
+
+    AssetStreamer(const AssetStreamer&) = delete;
+    AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+    // The process-wide streamer
+    static AssetStreamer& instance()
+    {
+        static AssetStreamer streamer;
+        return streamer;
+    }
+
+    // Starts loading an OBJ file (through MeshFile::loadCached) and returns its handle
+    // right away. Requests for a path already streaming share one handle, and a path
+    // MeshCache holds up to date is resident at once
+    StreamHandle load(const std::string& path, JobSystem& jobs = JobSystem::instance())
+    {
+        auto it = streams.find(path);
+        if (it != streams.end()) {
+            if (StreamHandle stream = it->second.lock())
+                return stream;
+        }
+
+        StreamHandle stream(new StreamedMesh());
+        stream->path = path;
+        if (MeshHandle cached = MeshCache::instance().findOBJ(path.c_str())) {
+            stream->mesh = cached;
+            stream->bounds = cached->bounds;
+            stream->state = StreamedMesh::Resident;
+            return stream;
+        }
+
+        if (ring == 0)
+            initRing();
+        streams[path] = stream;
+        loading++;
+        jobs.run([this, stream] {
+            stream->loaded = stream->file.loadCached(stream->path.c_str());
+            std::lock_guard<std::mutex> lock(readyMutex);
+            ready.push_back(stream);
+        });
+        return stream;
+    }
+
+    // Requests still being read or parsed, and bytes waiting to be uploaded
+    size_t pendingLoads() const { return loading; }
+    size_t pendingBytes() const
+    {
+        size_t bytes = 0;
+        for (const StreamHandle& stream : uploads)
+            bytes += stream->totalBytes - stream->uploadedBytes;
+        return bytes;
+    }
+
+    // Call once per frame on the GL thread: picks up finished loads, then uploads within
+    // the budget
+    void update()
+    {
+        uploadedThisFrame = 0;
+        retireFences();
+
+        std::vector<StreamHandle> finished;
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            finished.swap(ready);
+        }
+        for (StreamHandle& stream : finished) {
+            loading--;
+            begin(stream);
+        }
+
+        size_t budget = bytesPerFrame;
+        size_t frameBytes = 0; // Ring bytes used this frame, including skipped tails
+        while (!uploads.empty() && budget > 0) {
+            StreamedMesh& stream = *uploads.front();
+            bool vertices = stream.uploadedBytes < stream.vertexBytes;
+            size_t blobBytes = vertices ? stream.vertexBytes : stream.totalBytes - stream.vertexBytes;
+            size_t blobOffset = vertices ? stream.uploadedBytes : stream.uploadedBytes - stream.vertexBytes;
+
+            // Buffer storage costs about as much as filling it on some drivers (llvmpipe
+            // zeroes it), so creating it is charged to the budget. A buffer larger than the
+            // budget gets a frame to itself
+            bool& storage = vertices ? stream.vertexStorage : stream.indexStorage;
+            if (!storage) {
+                if (blobBytes > budget && budget < bytesPerFrame)
+                    break;
+                glBindBuffer(GL_COPY_WRITE_BUFFER, vertices ? stream.uploading->VBO : stream.uploading->EBO);
+                glBufferData(GL_COPY_WRITE_BUFFER, blobBytes, nullptr, GL_STATIC_DRAW);
+                storage = true;
+                budget -= std::min(budget, blobBytes);
+                continue;
+            }
+
+            // Take what fits in the ring, unless that is only a sliver
+            size_t remaining = blobBytes - blobOffset;
+            size_t chunk = std::min(std::min(remaining, budget), largestFree(frameBytes));
+            size_t offset;
+            if ((chunk < remaining && chunk < MIN_CHUNK) || !allocateRing(chunk, offset, frameBytes)) {
+                ringStalls++;
+                break;
+            }
+            const char* source = static_cast<const char*>(vertices ? stream.file.vertexData() : stream.file.indexData());
+            // A chunk that could not be staged is retried next frame. Its ring range is
+            // fenced with the rest of the frame and comes back when that retires
+            if (!copyChunk(source + blobOffset, chunk, offset, vertices ? stream.uploading->VBO : stream.uploading->EBO, blobOffset))
+                break;
+            stream.uploadedBytes += chunk;
+            budget -= chunk;
+            uploadedThisFrame += chunk;
+
+            if (stream.uploadedBytes == stream.totalBytes) {
+                stream.mesh = MeshCache::instance().addFile(stream.path.c_str(), stream.file, std::move(stream.uploading));
+                stream.state = StreamedMesh::Resident;
+                stream.placeholder.reset();
+                stream.file.close(); // Unmap the source
+                uploads.pop_front();
+            }
+        }
+
+        if (frameBytes > 0) {
+            fences.push_back(Fence{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frameBytes });
+            ringUsed += frameBytes;
+        }
+        uploadedTotal += uploadedThisFrame;
+        Profiler::instance().counters.uploadBytes += uploadedThisFrame;
+    }
+
+    ~AssetStreamer()
+    {
+        for (Fence& fence : fences)
+            glDeleteSync(fence.sync);
+        if (ring != 0)
+            glDeleteBuffers(1, &ring);
+    }
+
+private:
+    // Smallest partial chunk worth squeezing into a nearly full ring
+    static const size_t MIN_CHUNK = 64 * 1024;
+
+    struct Fence
+    {
+        GLsync sync;
+        size_t bytes; // Ring bytes written in the frame it guards
+    };
+
+    std::unordered_map<std::string, std::weak_ptr<StreamedMesh>> streams;
+    std::deque<StreamHandle> uploads;
+    size_t loading = 0;
+
+    std::mutex readyMutex;
+    std::vector<StreamHandle> ready;
+
+    // Staging ring: writes go at ringHead; the ringUsed bytes before it (wrapping) are
+    // still being read by copies that the fences guard, oldest first
+    unsigned int ring;
+    size_t ringCapacity, ringHead, ringUsed;
+    std::deque<Fence> fences;
+
+    // A finished load: allocate the GPU buffers and queue the upload
+    void begin(const StreamHandle& stream)
+    {
+        if (!stream->loaded) {
+            std::cerr << "Failed to stream OBJ file: " << stream->path << std::endl;
+            stream->state = StreamedMesh::Failed;
+            return;
+        }
+
+        const MeshFileHeader& header = stream->file.header();
+        stream->bounds = stream->file.bounds();
+
+        // Loaded meanwhile by another request or MeshCache::loadOBJ
+        if (MeshHandle cached = MeshCache::instance().findFile(stream->path.c_str(), stream->file)) {
+            stream->mesh = cached;
+            stream->state = StreamedMesh::Resident;
+            stream->file.close();
+            return;
+        }
+
+        stream->vertexBytes = stream->file.vertexBytes();
+        stream->totalBytes = stream->vertexBytes + stream->file.indexBytes();
+
+        stream->uploading.reset(new Mesh());
+        stream->uploading->allocate(stream->vertexBytes, header.format, header.indexCount,
+                                    header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, stream->bounds);
+        stream->uploading->setLODs(stream->file.lods());
+        stream->placeholder = placeholderBox();
+        stream->state = StreamedMesh::Uploading;
+        uploads.push_back(stream);
+    }
+
+    // Unit box from (0,0,0) to (1,1,1), stretched to each mesh's bounds
+    static MeshHandle placeholderBox()
+    {
+        static const std::vector<float> vertices = {
+            0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 1.0f,
+            0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f
+        };
+        static const std::vector<unsigned int> indices = {
+            0, 1, 2, 2, 3, 0,  4, 5, 6, 6, 7, 4,  0, 3, 7, 7, 4, 0,
+            1, 2, 6, 6, 5, 1,  3, 2, 6, 6, 7, 3,  0, 1, 5, 5, 4, 0
+        };
+        return MeshCache::instance().procedural("unit-box", vertices, indices);
+    }
+
+    void initRing()
+    {
+        ringCapacity = ringBytes;
+        glGenBuffers(1, &ring);
+        glBindBuffer(GL_COPY_READ_BUFFER, ring);
+        glBufferData(GL_COPY_READ_BUFFER, ringCapacity, nullptr, GL_STREAM_COPY);
+    }
+
+    // Frees the ring space of every frame whose copies the GPU has finished
+    void retireFences()
+    {
+        while (!fences.empty()) {
+            GLenum status = glClientWaitSync(fences.front().sync, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(fences.front().sync);
+            ringUsed -= fences.front().bytes;
+            fences.pop_front();
+        }
+    }
+
+    // Largest block allocateRing() can hand out. In-flight data occupies the ringUsed
+    // bytes before ringHead (wrapping); free space is the rest
+    size_t largestFree(size_t frameBytes) const
+    {
+        size_t used = ringUsed + frameBytes;
+        if (used == 0)
+            return ringCapacity;
+        size_t tail = (ringHead + ringCapacity - used) % ringCapacity;
+        if (tail >= ringHead)
+            return tail - ringHead; // Free space is the gap between head and tail
+        return std::max(ringCapacity - ringHead, tail);
+    }
+
+    // Reserves size contiguous bytes, wrapping to the start (and skipping the end of the
+    // ring, which then counts as used until this frame's fence) when the end is too short
+    bool allocateRing(size_t size, size_t& offset, size_t& frameBytes)
+    {
+        if (size == 0 || size > largestFree(frameBytes))
+            return false;
+        if (ringUsed + frameBytes == 0) {
+            ringHead = 0;
+        } else if (size > ringCapacity - ringHead) {
+            // Only fits at the start
+            frameBytes += ringCapacity - ringHead;
+            ringHead = 0;
+        }
+        offset = ringHead;
+        ringHead = (ringHead + size) % ringCapacity;
+        frameBytes += size;
+        return true;
+    }
+
+    // Writes size bytes into the ring at offset and copies them to targetOffset in buffer.
+    // The mapping is unsynchronized: the fences guarantee the GPU is done with that range.
+    // Returns false, having copied nothing, if the ring could not be mapped
+    bool copyChunk(const void* data, size_t size, size_t offset, unsigned int buffer, size_t targetOffset)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, ring);
+        void* staging = glMapBufferRange(GL_COPY_READ_BUFFER, offset, size,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (staging == nullptr) {
+            std::cerr << "Failed to map the staging ring" << std::endl;
+            return false;
+        }
+        memcpy(staging, data, size);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, targetOffset, size);
+        return true;
+    }
+};
+
+#endif
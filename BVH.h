@@ -0,0 +1,249 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <vector>
+#include "Bounds.h"
+#include "Frustum.h"
+
+// Bounding volume hierarchy over object AABBs. Built top-down with a binned SAH, refit
+// incrementally when objects move, and queried against a view frustum. Objects are
+// identified by their index in the bounds array passed to build()
+class BVH
+{
+public:
+    struct Node {
+        AABB bounds;
+        int first;  // Leaf: first entry in items. Interior: index of the left child (right = first + 1)
+        int count;  // Leaf: number of items. Interior: 0
+        int parent;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> items;
+
+    // Builds the hierarchy from scratch
+    void build(const std::vector<AABB>& bounds)
+    {
+        objectBounds = bounds;
+        nodes.clear();
+        items.resize(bounds.size());
+        leafOf.assign(bounds.size(), -1);
+        dirtyLeaves.clear();
+        if (bounds.empty())
+            return;
+
+        centroids.resize(bounds.size());
+        for (size_t i = 0; i < bounds.size(); i++) {
+            items[i] = static_cast<int>(i);
+            centroids[i] = bounds[i].center();
+        }
+
+        nodes.reserve(bounds.size() * 2 / LEAF_SIZE + 1);
+        nodes.push_back(Node{ AABB(), 0, static_cast<int>(bounds.size()), -1 });
+
+        std::vector<int> stack{ 0 };
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            if (split(index)) {
+                stack.push_back(nodes[index].first);
+                stack.push_back(nodes[index].first + 1);
+            }
+        }
+
+        for (size_t n = 0; n < nodes.size(); n++) {
+            if (nodes[n].count > 0) {
+                for (int i = nodes[n].first; i < nodes[n].first + nodes[n].count; i++)
+                    leafOf[items[i]] = static_cast<int>(n);
+            }
+        }
+        centroids.clear();
+        centroids.shrink_to_fit();
+    }
+
+    // Records a moved object; the tree is updated by the next refit()
+    void setBounds(int object, const AABB& bounds)
+    {
+        objectBounds[object] = bounds;
+        dirtyLeaves.push_back(leafOf[object]);
+    }
+
+    // Refits the leaves of moved objects and their ancestors. Walking up stops early once a
+    // node's bounds are unchanged, so sparse updates stay cheap; when many objects moved the
+    // whole tree is refit bottom-up instead (children always follow their parent in nodes)
+    void refit()
+    {
+        if (dirtyLeaves.size() * 8 > nodes.size()) {
+            for (int n = static_cast<int>(nodes.size()) - 1; n >= 0; n--)
+                refitNode(nodes[n]);
+            dirtyLeaves.clear();
+            return;
+        }
+
+        for (int leaf : dirtyLeaves) {
+            int n = leaf;
+            while (n >= 0) {
+                Node& node = nodes[n];
+                if (!refitNode(node))
+                    break;
+                n = node.parent;
+            }
+        }
+        dirtyLeaves.clear();
+    }
+
+    // Appends every object whose bounds intersect the frustum. Subtrees fully inside a
+    // plane stop testing it; subtrees fully inside the frustum are accepted without tests.
+    // visible is any list of ints (std::vector, or std::pmr::vector on a frame arena)
+    template <typename List>
+    void query(const Frustum& frustum, List& visible) const
+    {
+        if (nodes.empty())
+            return;
+
+        queryStack.clear();
+        queryStack.push_back({ 0, 0x3Fu });
+        while (!queryStack.empty()) {
+            StackEntry e = queryStack.back();
+            queryStack.pop_back();
+            const Node& node = nodes[e.node];
+            Frustum::Side side = (e.mask == 0) ? Frustum::Inside : frustum.classify(node.bounds, e.mask);
+            if (side == Frustum::Outside)
+                continue;
+
+            if (node.count > 0) {
+                for (int i = node.first; i < node.first + node.count; i++) {
+                    unsigned int mask = e.mask;
+                    if (mask == 0 || frustum.classify(objectBounds[items[i]], mask) != Frustum::Outside)
+                        visible.push_back(items[i]);
+                }
+            } else {
+                queryStack.push_back({ node.first + 1, e.mask });
+                queryStack.push_back({ node.first, e.mask });
+            }
+        }
+    }
+
+    const AABB& bounds(int object) const { return objectBounds[object]; }
+
+private:
+    static const int LEAF_SIZE = 4;
+    static const int BINS = 12;
+
+    std::vector<AABB> objectBounds;
+    std::vector<glm::vec3> centroids;
+    std::vector<int> leafOf;
+    std::vector<int> dirtyLeaves;
+
+    // Traversal stack reused between queries (so query() is not reentrant)
+    struct StackEntry { int node; unsigned int mask; };
+    mutable std::vector<StackEntry> queryStack;
+
+    // Recomputes a node's bounds from its items or children; returns whether they changed
+    bool refitNode(Node& node)
+    {
+        AABB box;
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++)
+                box.expand(objectBounds[items[i]]);
+        } else {
+            box = nodes[node.first].bounds;
+            box.expand(nodes[node.first + 1].bounds);
+        }
+        if (box == node.bounds)
+            return false;
+        node.bounds = box;
+        return true;
+    }
+
+    // Splits a node along the best binned SAH plane; returns false if it stays a leaf
+    bool split(int index)
+    {
+        Node& node = nodes[index];
+        AABB centroidBounds;
+        node.bounds = AABB();
+        for (int i = node.first; i < node.first + node.count; i++) {
+            node.bounds.expand(objectBounds[items[i]]);
+            centroidBounds.expand(centroids[items[i]]);
+        }
+        if (node.count <= LEAF_SIZE)
+            return false;
+
+        // Evaluate BINS - 1 candidate planes on every axis
+        float bestCost = FLT_MAX;
+        int bestAxis = -1, bestBin = -1;
+        for (int axis = 0; axis < 3; axis++) {
+            float lo = centroidBounds.min[axis], hi = centroidBounds.max[axis];
+            if (hi - lo <= 1e-6f)
+                continue;
+
+            AABB binBounds[BINS];
+            int binCount[BINS] = {};
+            float scale = BINS / (hi - lo);
+            for (int i = node.first; i < node.first + node.count; i++) {
+                int b = std::min(BINS - 1, static_cast<int>((centroids[items[i]][axis] - lo) * scale));
+                binBounds[b].expand(objectBounds[items[i]]);
+                binCount[b]++;
+            }
+
+            // Sweep from the right to get the cost of every right-hand side, then from the left
+            float rightArea[BINS];
+            int rightCount[BINS];
+            AABB acc;
+            int count = 0;
+            for (int b = BINS - 1; b > 0; b--) {
+                acc.expand(binBounds[b]);
+                count += binCount[b];
+                rightArea[b] = acc.surfaceArea();
+                rightCount[b] = count;
+            }
+            acc = AABB();
+            count = 0;
+            for (int b = 0; b < BINS - 1; b++) {
+                acc.expand(binBounds[b]);
+                count += binCount[b];
+                float cost = acc.surfaceArea() * count + rightArea[b + 1] * rightCount[b + 1];
+                if (count > 0 && rightCount[b + 1] > 0 && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        // Splitting must beat intersecting every item of this node
+        float leafCost = node.bounds.surfaceArea() * node.count;
+        int first = node.first, count = node.count;
+        int* begin = items.data() + first;
+        int* end = begin + count;
+        int* mid;
+        if (bestAxis >= 0 && bestCost < leafCost) {
+            float lo = centroidBounds.min[bestAxis];
+            float scale = BINS / (centroidBounds.max[bestAxis] - lo);
+            mid = std::partition(begin, end, [&](int item) {
+                return std::min(BINS - 1, static_cast<int>((centroids[item][bestAxis] - lo) * scale)) <= bestBin;
+            });
+        } else if (count > LEAF_SIZE * 4) {
+            // Degenerate (e.g. coincident centroids): split by median to bound leaf size
+            mid = begin + count / 2;
+            int axis = 0;
+            glm::vec3 size = node.bounds.max - node.bounds.min;
+            if (size.y > size[axis]) axis = 1;
+            if (size.z > size[axis]) axis = 2;
+            std::nth_element(begin, mid, end, [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        } else {
+            return false;
+        }
+
+        int leftCount = static_cast<int>(mid - begin);
+        int child = static_cast<int>(nodes.size());
+        nodes.push_back(Node{ AABB(), first, leftCount, index });
+        nodes.push_back(Node{ AABB(), first + leftCount, count - leftCount, index });
+        nodes[index].first = child;
+        nodes[index].count = 0;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// Axis-aligned bounding box. Default constructed boxes are empty (min > max)
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+    AABB(glm::vec3 min, glm::vec3 max) : min(min), max(max) {}
+
+    // Bounds of count positions (3 floats at the start of every stride-byte vertex)
+    static AABB fromPositions(const void* data, size_t count, size_t stride)
+    {
+        AABB box;
+        const char* p = static_cast<const char*>(data);
+        for (size_t i = 0; i < count; i++, p += stride) {
+            glm::vec3 v;
+            memcpy(&v.x, p, 3 * sizeof(float));
+            box.expand(v);
+        }
+        return box;
+    }
+
+    bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+    void expand(glm::vec3 p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void expand(const AABB& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    float surfaceArea() const
+    {
+        if (empty())
+            return 0.0f;
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool overlaps(const AABB& other) const
+    {
+        return min.x <= other.max.x && max.x >= other.min.x
+            && min.y <= other.max.y && max.y >= other.min.y
+            && min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    bool operator==(const AABB& other) const { return min == other.min && max == other.max; }
+    bool operator!=(const AABB& other) const { return !(*this == other); }
+
+    // Bounds of this box after an affine transform (Arvo: center plus |M| * extent)
+    AABB transformed(const glm::mat4& m) const
+    {
+        if (empty())
+            return AABB();
+        glm::vec3 c = center(), e = extent();
+        glm::vec3 newCenter(m[3]), newExtent(0.0f);
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                newCenter[row] += m[col][row] * c[col];
+                newExtent[row] += std::fabs(m[col][row]) * e[col];
+            }
+        }
+        return AABB(newCenter - newExtent, newCenter + newExtent);
+    }
+};
+
+#endif
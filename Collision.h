@@ -0,0 +1,448 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "Bounds.h"
+#include "SpatialHash.h"
+
+// A capsule: the points within radius of the segment a-b
+struct Capsule
+{
+    glm::vec3 a, b;
+    float radius;
+
+    AABB bounds() const
+    {
+        glm::vec3 r(radius);
+        return AABB(glm::min(a, b) - r, glm::max(a, b) + r);
+    }
+
+    Capsule translated(glm::vec3 offset) const { return Capsule{ a + offset, b + offset, radius }; }
+};
+
+// The earliest contact of a sweep
+struct CollisionHit
+{
+    float t;          // Fraction of the displacement travelled before contact
+    glm::vec3 normal; // Unit contact normal, pointing from the surface toward the capsule
+    int collider;     // -1 for the grid
+};
+
+// CPU-side triangle geometry for collision (GPU meshes keep no CPU copy)
+struct CollisionMesh
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+
+    // From tightly packed xyz floats, e.g. Cube::meshVertices()
+    static std::shared_ptr<const CollisionMesh> fromArrays(const std::vector<float>& positions, const std::vector<unsigned int>& indices)
+    {
+        auto mesh = std::make_shared<CollisionMesh>();
+        for (size_t i = 0; i + 2 < positions.size(); i += 3)
+            mesh->vertices.emplace_back(positions[i], positions[i + 1], positions[i + 2]);
+        mesh->indices = indices;
+        return mesh;
+    }
+};
+
+// Closest-point queries (Ericson, Real-Time Collision Detection, 5.1)
+namespace collision
+{
+    // Closest point on triangle abc to p
+    inline glm::vec3 closestPointTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+    {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + ab * (d1 / (d1 - d3));
+
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + ac * (d2 / (d2 - d6));
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        float denom = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    // Closest points c1 on p1-q1 and c2 on p2-q2
+    inline void closestPointsSegments(glm::vec3 p1, glm::vec3 q1, glm::vec3 p2, glm::vec3 q2, glm::vec3& c1, glm::vec3& c2)
+    {
+        const float epsilon = 1e-12f;
+        glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+        float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+        float s, t;
+        if (a <= epsilon && e <= epsilon) {
+            s = t = 0.0f;
+        } else if (a <= epsilon) {
+            s = 0.0f;
+            t = glm::clamp(f / e, 0.0f, 1.0f);
+        } else {
+            float c = glm::dot(d1, r);
+            if (e <= epsilon) {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            } else {
+                float b = glm::dot(d1, d2);
+                float denom = a * e - b * b;
+                s = denom != 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+                t = (b * s + f) / e;
+                if (t < 0.0f) {
+                    t = 0.0f;
+                    s = glm::clamp(-c / a, 0.0f, 1.0f);
+                } else if (t > 1.0f) {
+                    t = 1.0f;
+                    s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+                }
+            }
+        }
+        c1 = p1 + d1 * s;
+        c2 = p2 + d2 * t;
+    }
+
+    // Closest points between segment p-q and triangle abc; returns the squared distance
+    inline float closestPointsSegmentTriangle(glm::vec3 p, glm::vec3 q, glm::vec3 a, glm::vec3 b, glm::vec3 c,
+                                              glm::vec3& onSegment, glm::vec3& onTriangle)
+    {
+        // Segment crossing the triangle
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float dp = glm::dot(p - a, n), dq = glm::dot(q - a, n);
+        if ((dp < 0.0f) != (dq < 0.0f) && dp != dq) {
+            glm::vec3 x = p + (q - p) * (dp / (dp - dq));
+            if (glm::dot(glm::cross(b - a, x - a), n) >= 0.0f && glm::dot(glm::cross(c - b, x - b), n) >= 0.0f
+                && glm::dot(glm::cross(a - c, x - c), n) >= 0.0f) {
+                onSegment = onTriangle = x;
+                return 0.0f;
+            }
+        }
+
+        // Otherwise the minimum is at a segment endpoint or between the segment and an edge
+        float best = FLT_MAX;
+        auto consider = [&](glm::vec3 s, glm::vec3 t) {
+            glm::vec3 d = s - t;
+            float dist = glm::dot(d, d);
+            if (dist < best) {
+                best = dist;
+                onSegment = s;
+                onTriangle = t;
+            }
+        };
+        consider(p, closestPointTriangle(p, a, b, c));
+        consider(q, closestPointTriangle(q, a, b, c));
+        const glm::vec3 edges[3][2] = { { a, b }, { b, c }, { c, a } };
+        for (const auto& edge : edges) {
+            glm::vec3 s, t;
+            closestPointsSegments(p, q, edge[0], edge[1], s, t);
+            consider(s, t);
+        }
+        return best;
+    }
+
+    // Sweeps the capsule by displacement against triangle abc by conservative advancement:
+    // the separation can shrink by at most |displacement| per unit t, so stepping t by
+    // (distance - radius) / |displacement| never skips past the contact. Contacts closer
+    // than skin count as touching, which keeps resting bodies a hair above surfaces.
+    // Triangles the capsule is moving away from or along are ignored
+    inline bool sweepCapsuleTriangle(const Capsule& capsule, glm::vec3 displacement, glm::vec3 a, glm::vec3 b, glm::vec3 c,
+                                     float skin, float& hitT, glm::vec3& hitNormal)
+    {
+        const int MAX_ITERATIONS = 64;
+        float length = glm::length(displacement);
+        float contact = capsule.radius + skin;
+        float t = 0.0f;
+        for (int i = 0; i < MAX_ITERATIONS && t <= 1.0f; i++) {
+            glm::vec3 offset = displacement * t, onSegment, onTriangle;
+            float distance = std::sqrt(closestPointsSegmentTriangle(capsule.a + offset, capsule.b + offset, a, b, c, onSegment, onTriangle));
+            if (distance <= contact) {
+                glm::vec3 normal;
+                if (distance > 1e-6f) {
+                    normal = (onSegment - onTriangle) / distance;
+                } else {
+                    // Segment touches the triangle: use the face normal on the side we came from
+                    normal = glm::normalize(glm::cross(b - a, c - a));
+                    if (glm::dot(normal, displacement) > 0.0f)
+                        normal = -normal;
+                }
+                // Tangential motion (within float noise of the contact normal) is not a hit
+                if (glm::dot(normal, displacement) >= -1e-3f * length)
+                    return false;
+                hitT = t;
+                hitNormal = normal;
+                return true;
+            }
+            if (length < 1e-9f)
+                return false;
+            // Aim slightly inside the skin so direct approaches finish in one step
+            t += (distance - capsule.radius - skin * 0.5f) / length;
+        }
+        return false;
+    }
+}
+
+// Solid unit cells on an integer grid (e.g. a voxel world); cell (x, y, z) spans
+// [x, x + 1] x [y, y + 1] x [z, z + 1]
+class CollisionGrid
+{
+public:
+    virtual ~CollisionGrid() {}
+    virtual bool solid(int x, int y, int z) const = 0;
+};
+
+// Static and moving colliders with a spatial hash broadphase and swept capsule queries
+// against their triangles. Box colliders are solid AABBs; mesh colliders are triangle
+// meshes under a transform (their world-space vertices are cached). An optional grid adds
+// the faces of its solid cells that border empty ones
+class CollisionWorld
+{
+public:
+    float skin = 0.01f;
+
+    explicit CollisionWorld(float cellSize = 4.0f) : broadphase(cellSize), dirty(false), grid(nullptr) {}
+
+    // Collides with grid's solid cells too (null for none); grid must outlive its use here
+    void setGrid(const CollisionGrid* grid) { this->grid = grid; }
+
+    // Adds a solid axis-aligned box and returns its collider id
+    int addBox(const AABB& box)
+    {
+        colliders.push_back(Collider{ box, nullptr, box, glm::mat4(1.0f), {} });
+        dirty = true;
+        return static_cast<int>(colliders.size() - 1);
+    }
+
+    // Adds a triangle mesh placed by transform (e.g. Object::getModelMatrix())
+    int addMesh(std::shared_ptr<const CollisionMesh> mesh, const glm::mat4& transform)
+    {
+        colliders.push_back(Collider{ AABB(), mesh, AABB(), transform, {} });
+        place(colliders.back());
+        dirty = true;
+        return static_cast<int>(colliders.size() - 1);
+    }
+
+    // Moves a collider. A box stays axis aligned: it becomes the bounds of the added box
+    // under transform. The broadphase entry is updated in place; it is only rebuilt once
+    // many colliders have left their cells
+    void setTransform(int id, const glm::mat4& transform)
+    {
+        colliders[id].transform = transform;
+        place(colliders[id]);
+        if (!dirty)
+            broadphase.update(id, colliders[id].bounds);
+    }
+
+    size_t size() const { return colliders.size(); }
+    const AABB& bounds(int id) const { return colliders[id].bounds; }
+
+    // Appends the colliders whose bounds overlap box
+    void query(const AABB& box, std::vector<int>& out)
+    {
+        if (dirty || broadphase.stale())
+            rebuild();
+        broadphase.query(box, out);
+    }
+
+    // Earliest contact of capsule moving by displacement
+    bool sweep(const Capsule& capsule, glm::vec3 displacement, CollisionHit& hit)
+    {
+        AABB swept = capsule.bounds();
+        swept.expand(capsule.translated(displacement).bounds());
+        swept.min -= glm::vec3(skin);
+        swept.max += glm::vec3(skin);
+
+        candidates.clear();
+        query(swept, candidates);
+
+        bool found = false;
+        hit.t = FLT_MAX;
+        for (int id : candidates) {
+            forEachTriangle(colliders[id], [&](glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+                AABB tri(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)));
+                if (!tri.overlaps(swept))
+                    return;
+                float t;
+                glm::vec3 normal;
+                if (collision::sweepCapsuleTriangle(capsule, displacement, a, b, c, skin, t, normal) && t < hit.t) {
+                    hit.t = t;
+                    hit.normal = normal;
+                    hit.collider = id;
+                    found = true;
+                }
+            });
+        }
+        if (grid != nullptr)
+            found = sweepGrid(capsule, displacement, swept, hit) || found;
+        return found;
+    }
+
+    // Moves the capsule by displacement, stopping at contacts and sliding along them
+    // (collide-and-slide). The first contact constrains the motion to its plane, a second
+    // one to the crease between the two planes, and a third stops it. Returns the
+    // displacement actually applied; every contact is appended to contacts if given
+    glm::vec3 slide(const Capsule& capsule, glm::vec3 displacement, std::vector<CollisionHit>* contacts = nullptr)
+    {
+        glm::vec3 moved(0.0f), remaining = displacement, firstNormal(0.0f);
+        for (int i = 0; i < 3 && glm::dot(remaining, remaining) > 1e-12f; i++) {
+            CollisionHit hit;
+            if (!sweep(capsule.translated(moved), remaining, hit)) {
+                moved += remaining;
+                return moved;
+            }
+            moved += remaining * hit.t;
+            if (contacts != nullptr)
+                contacts->push_back(hit);
+            remaining *= 1.0f - hit.t;
+
+            glm::vec3 crease = glm::cross(firstNormal, hit.normal);
+            if (i == 0 || glm::dot(crease, crease) < 1e-6f) {
+                // Drop the part of the rest of the motion that goes into the surface
+                remaining -= hit.normal * glm::dot(remaining, hit.normal);
+                if (i == 0)
+                    firstNormal = hit.normal;
+            } else if (i == 1) {
+                crease = glm::normalize(crease);
+                remaining = crease * glm::dot(remaining, crease);
+            } else {
+                break;
+            }
+        }
+        return moved;
+    }
+
+private:
+    struct Collider
+    {
+        AABB bounds;
+        std::shared_ptr<const CollisionMesh> mesh; // Null for boxes
+        AABB box;                                  // Boxes: the box as added, before transform
+        glm::mat4 transform;
+        std::vector<glm::vec3> worldVertices;
+    };
+
+    std::vector<Collider> colliders;
+    SpatialHash broadphase;
+    bool dirty;
+    std::vector<int> candidates;
+    std::vector<AABB> colliderBounds;
+    const CollisionGrid* grid;
+
+    // Two triangles per face, in face order -x, +x, -y, +y, -z, +z, over corners numbered
+    // by bits x = 4, y = 2, z = 1
+    static const unsigned int* boxIndices()
+    {
+        static const unsigned int indices[36] = {
+            0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, // -x, +x
+            0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6, // -y, +y
+            0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3  // -z, +z
+        };
+        return indices;
+    }
+
+    // Sweeps against the exposed faces of the grid's solid cells within swept
+    bool sweepGrid(const Capsule& capsule, glm::vec3 displacement, const AABB& swept, CollisionHit& hit) const
+    {
+        static const int offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+        const unsigned int* indices = boxIndices();
+        glm::vec3 low = glm::floor(swept.min), high = glm::floor(swept.max);
+        bool found = false;
+        for (int y = int(low.y); y <= int(high.y); y++) {
+            for (int z = int(low.z); z <= int(high.z); z++) {
+                for (int x = int(low.x); x <= int(high.x); x++) {
+                    if (!grid->solid(x, y, z))
+                        continue;
+                    glm::vec3 corners[8];
+                    for (int i = 0; i < 8; i++)
+                        corners[i] = glm::vec3(float(x + (i >> 2 & 1)), float(y + (i >> 1 & 1)), float(z + (i & 1)));
+                    for (int face = 0; face < 6; face++) {
+                        if (grid->solid(x + offsets[face][0], y + offsets[face][1], z + offsets[face][2]))
+                            continue;
+                        for (int i = face * 6; i < face * 6 + 6; i += 3) {
+                            float t;
+                            glm::vec3 normal;
+                            if (collision::sweepCapsuleTriangle(capsule, displacement, corners[indices[i]], corners[indices[i + 1]],
+                                                                corners[indices[i + 2]], skin, t, normal)
+                                && t < hit.t) {
+                                hit.t = t;
+                                hit.normal = normal;
+                                hit.collider = -1;
+                                found = true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return found;
+    }
+
+    void place(Collider& collider)
+    {
+        collider.worldVertices.clear();
+        collider.bounds = AABB();
+        if (collider.mesh == nullptr) {
+            for (int i = 0; i < 8; i++) {
+                glm::vec3 corner(i & 4 ? collider.box.max.x : collider.box.min.x,
+                                 i & 2 ? collider.box.max.y : collider.box.min.y,
+                                 i & 1 ? collider.box.max.z : collider.box.min.z);
+                collider.bounds.expand(glm::vec3(collider.transform * glm::vec4(corner, 1.0f)));
+            }
+            return;
+        }
+        for (const glm::vec3& v : collider.mesh->vertices) {
+            glm::vec3 w = glm::vec3(collider.transform * glm::vec4(v, 1.0f));
+            collider.worldVertices.push_back(w);
+            collider.bounds.expand(w);
+        }
+    }
+
+    void rebuild()
+    {
+        colliderBounds.clear();
+        for (const Collider& collider : colliders)
+            colliderBounds.push_back(collider.bounds);
+        broadphase.build(colliderBounds);
+        dirty = false;
+    }
+
+    template <typename F>
+    static void forEachTriangle(const Collider& collider, F&& f)
+    {
+        if (collider.mesh == nullptr) {
+            const unsigned int* indices = boxIndices();
+            glm::vec3 corners[8];
+            for (int i = 0; i < 8; i++)
+                corners[i] = glm::vec3(i & 4 ? collider.bounds.max.x : collider.bounds.min.x,
+                                       i & 2 ? collider.bounds.max.y : collider.bounds.min.y,
+                                       i & 1 ? collider.bounds.max.z : collider.bounds.min.z);
+            for (int i = 0; i < 36; i += 3)
+                f(corners[indices[i]], corners[indices[i + 1]], corners[indices[i + 2]]);
+            return;
+        }
+        const std::vector<unsigned int>& indices = collider.mesh->indices;
+        const std::vector<glm::vec3>& v = collider.worldVertices;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            f(v[indices[i]], v[indices[i + 1]], v[indices[i + 2]]);
+    }
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef COMMANDBUFFER_H
+#define COMMANDBUFFER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "JobSystem.h"
+
+enum class CommandType : uint8_t { BindProgram, BindMesh, SetVec4, SetMat4, Draw };
+
+// One recorded command, 8 bytes. object is the program or mesh for binds and the index of
+// the value's first float (in its buffer) for uniforms
+struct RenderCommand
+{
+    CommandType type;
+    uint8_t lod;
+    int16_t location;
+    uint32_t object;
+};
+
+// Where recorded commands go: a graphics API, called on the thread that owns its context.
+// Programs and meshes are ids the recording code was handed; the backend maps them to
+// its own objects
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() = default;
+
+    virtual void bindProgram(uint32_t program) = 0;
+    virtual void bindMesh(uint32_t mesh) = 0;
+    virtual void setVec4(int location, const float* value) = 0;
+    virtual void setMat4(int location, const float* value) = 0;
+    virtual void draw(int lod) = 0; // Level of detail of the bound mesh
+};
+
+// Bind, uniform and draw commands recorded without touching any graphics API, so any
+// thread can fill one (one thread per buffer at a time). clear() keeps the memory, so a
+// buffer refilled every frame stops allocating
+class CommandBuffer
+{
+public:
+    void bindProgram(uint32_t program) { commands.push_back(RenderCommand{ CommandType::BindProgram, 0, 0, program }); }
+    void bindMesh(uint32_t mesh) { commands.push_back(RenderCommand{ CommandType::BindMesh, 0, 0, mesh }); }
+    void setVec4(int location, const glm::vec4& value) { push(CommandType::SetVec4, location, &value[0], 4); }
+    void setMat4(int location, const glm::mat4& value) { push(CommandType::SetMat4, location, &value[0][0], 16); }
+    void draw(int lod = 0) { commands.push_back(RenderCommand{ CommandType::Draw, uint8_t(lod), 0, 0 }); }
+
+    void clear()
+    {
+        commands.clear();
+        values.clear();
+    }
+
+    size_t size() const { return commands.size(); }
+    const RenderCommand* begin() const { return commands.data(); }
+    const RenderCommand* end() const { return commands.data() + commands.size(); }
+    const float* value(const RenderCommand& command) const { return &values[command.object]; }
+
+private:
+    std::vector<RenderCommand> commands;
+    std::vector<float> values; // Uniform values, 4 or 16 floats each
+
+    void push(CommandType type, int location, const float* value, int floats)
+    {
+        commands.push_back(RenderCommand{ type, 0, int16_t(location), static_cast<uint32_t>(values.size()) });
+        values.insert(values.end(), value, value + floats);
+    }
+};
+
+// Plays command buffers into a backend, dropping binds of what is already bound and
+// uniform sets that wouldn't change the value. It follows the backend's state, so keep one
+// replayer per backend and reset() it whenever other code may have touched that state
+// (e.g. once per frame). Uniforms are only remembered for the bound program
+class CommandReplayer
+{
+public:
+    uint64_t replayed, filtered; // Commands since reset(), and how many of them were dropped
+
+    CommandReplayer() : replayed(0), filtered(0), program(NONE), mesh(NONE) {}
+
+    void reset()
+    {
+        replayed = filtered = 0;
+        forgetState();
+    }
+
+    // Assumes nothing is bound, keeping the counts (for backends that unbind after a replay)
+    void forgetState()
+    {
+        program = mesh = NONE;
+        forgetUniforms();
+    }
+
+    void replay(const CommandBuffer& buffer, RenderBackend& backend)
+    {
+        for (const RenderCommand& command : buffer) {
+            replayed++;
+            switch (command.type) {
+            case CommandType::BindProgram:
+                if (command.object == program) {
+                    filtered++;
+                    break;
+                }
+                program = command.object;
+                forgetUniforms();
+                backend.bindProgram(program);
+                break;
+            case CommandType::BindMesh:
+                if (command.object == mesh) {
+                    filtered++;
+                    break;
+                }
+                mesh = command.object;
+                backend.bindMesh(mesh);
+                break;
+            case CommandType::SetVec4:
+            case CommandType::SetMat4: {
+                int floats = command.type == CommandType::SetVec4 ? 4 : 16;
+                const float* value = buffer.value(command);
+                if (!changeUniform(command.location, value, floats)) {
+                    filtered++;
+                    break;
+                }
+                if (floats == 4)
+                    backend.setVec4(command.location, value);
+                else
+                    backend.setMat4(command.location, value);
+                break;
+            }
+            case CommandType::Draw:
+                backend.draw(command.lod);
+                break;
+            }
+        }
+    }
+
+private:
+    static const uint32_t NONE = ~0u;
+
+    uint32_t program, mesh;
+    // Last value set at each location of the bound program: 16 floats per location and the
+    // number of them in use (0 for unknown)
+    std::vector<float> uniformValues;
+    std::vector<uint8_t> uniformFloats;
+
+    void forgetUniforms() { std::fill(uniformFloats.begin(), uniformFloats.end(), 0); }
+
+    // Records value at location; false if it is already there
+    bool changeUniform(int location, const float* value, int floats)
+    {
+        if (location < 0)
+            return false; // Inactive: GL ignores it
+        if (size_t(location) >= uniformFloats.size()) {
+            uniformFloats.resize(location + 1, 0);
+            uniformValues.resize(uniformFloats.size() * 16);
+        }
+        float* known = &uniformValues[size_t(location) * 16];
+        if (uniformFloats[location] == floats && memcmp(known, value, floats * sizeof(float)) == 0)
+            return false;
+        memcpy(known, value, floats * sizeof(float));
+        uniformFloats[location] = uint8_t(floats);
+        return true;
+    }
+};
+
+// Records items in parallel: record() splits [0, count) into chunks of grain, and the
+// jobs call body(buffer, begin, end) to record each chunk into its own CommandBuffer.
+// replay() plays the buffers back in chunk order, so the commands don't depend on which
+// thread recorded what. Buffers are kept between frames
+class ParallelRecorder
+{
+public:
+    ParallelRecorder() : used(0) {}
+
+    template <typename F>
+    void record(JobSystem& jobs, size_t count, size_t grain, const F& body)
+    {
+        grain = std::max<size_t>(grain, 1);
+        used = (count + grain - 1) / grain;
+        if (buffers.size() < used)
+            buffers.resize(used);
+        jobs.parallelFor(0, count, grain, [&](size_t begin, size_t end) {
+            // Ranges run inline may span several chunks
+            for (size_t chunk = begin; chunk < end; chunk += grain) {
+                CommandBuffer& buffer = buffers[chunk / grain];
+                buffer.clear();
+                body(buffer, chunk, std::min(end, chunk + grain));
+            }
+        });
+    }
+
+    // Replays every buffer of the last record() (replayer is not reset)
+    void replay(CommandReplayer& replayer, RenderBackend& backend) const
+    {
+        for (size_t b = 0; b < used; b++)
+            replayer.replay(buffers[b], backend);
+    }
+
+    size_t bufferCount() const { return used; }
+    const CommandBuffer& buffer(size_t index) const { return buffers[index]; }
+
+    size_t commandCount() const
+    {
+        size_t commands = 0;
+        for (size_t b = 0; b < used; b++)
+            commands += buffers[b].size();
+        return commands;
+    }
+
+private:
+    std::vector<CommandBuffer> buffers;
+    size_t used;
+};
+
+#endif
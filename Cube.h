@@ -9,13 +9,24 @@ class Cube : public Object
 {
 public:
 	// Constructor
-	Cube(Vec3 position = Vec3(0.0f, 0.0f, 0.0f), 
-	  Vec3 rotation = Vec3(0.0f, 0.0f, 0.0f), 
+	Cube(Vec3 position = Vec3(0.0f, 0.0f, 0.0f),
+	  Vec3 rotation = Vec3(0.0f, 0.0f, 0.0f),
 	  Vec3 scale = Vec3(1.0f, 1.0f, 1.0f))
 	: Object(position, rotation, scale)
 	{
-		// Define the vertices and indices for a cube
-		vertices = {
+		mesh = sharedMesh();
+	}
+
+	// The cube mesh every cube shares (uploaded on first use)
+	static MeshHandle sharedMesh()
+	{
+		return MeshCache::instance().procedural("cube", meshVertices(), meshIndices());
+	}
+
+	// The vertices for a unit cube
+	static const std::vector<float>& meshVertices()
+	{
+		static const std::vector<float> cubeVertices = {
 			-0.5f, -0.5f,  0.5f,
 			0.5f, -0.5f,  0.5f,
 			0.5f,  0.5f,  0.5f,
@@ -25,8 +36,13 @@ public:
 			0.5f,  0.5f, -0.5f,
 			-0.5f,  0.5f, -0.5f
 		};
+		return cubeVertices;
+	}
 
-		indices = {
+	// The indices for a unit cube
+	static const std::vector<unsigned int>& meshIndices()
+	{
+		static const std::vector<unsigned int> cubeIndices = {
 			0, 1, 2, 2, 3, 0, // Front
 			4, 5, 6, 6, 7, 4, // Back
 			0, 3, 7, 7, 4, 0, // Left
@@ -34,9 +50,7 @@ public:
 			3, 2, 6, 6, 7, 3, // Top
 			0, 1, 5, 5, 4, 0  // Bottom
 		};
-
-		// Initialize the cube (setup VAO, VBO, EBO)
-		init();
+		return cubeIndices;
 	}
 };
 
@@ -0,0 +1,45 @@
+#ifndef FIXEDTIMESTEP_H
+#define FIXEDTIMESTEP_H
+
+#include <cstdint>
+
+// Accumulator for a fixed-rate simulation driven by a variable render rate. Each frame
+// advance() turns the elapsed time into a whole number of steps; the remainder carries
+// over and alpha() says how far the render time is between the last two sim states.
+// Steps are capped per frame so a long hitch can't snowball into ever longer frames
+class FixedTimestep
+{
+public:
+    double step;        // Seconds per simulation step
+    int maxSteps;       // Catch-up cap per frame
+    double accumulator; // Unsimulated time, below one step after advance()
+
+    // Totals since construction
+    uint64_t steps;
+    double droppedTime; // Time discarded by the catch-up cap
+
+    explicit FixedTimestep(double hz = 60.0, int maxSteps = 8)
+        : step(1.0 / hz), maxSteps(maxSteps), accumulator(0.0), steps(0), droppedTime(0.0) {}
+
+    // Adds a frame's elapsed time and returns the number of steps to simulate
+    int advance(double frameTime)
+    {
+        accumulator += frameTime;
+        int count = static_cast<int>(accumulator / step);
+        if (count > maxSteps) {
+            droppedTime += (count - maxSteps) * step;
+            accumulator -= (count - maxSteps) * step;
+            count = maxSteps;
+        }
+        accumulator -= count * step;
+        steps += count;
+        return count;
+    }
+
+    float dt() const { return static_cast<float>(step); }
+
+    // Blend factor between the previous (0) and current (1) simulation state
+    float alpha() const { return static_cast<float>(accumulator / step); }
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+// Bump allocator for short-lived data, usable anywhere a std::pmr::memory_resource is
+// (std::pmr::vector<int> list(&arena)). Allocation is an aligned pointer bump;
+// deallocation does nothing, and everything is released at once by reset() or back to a
+// mark by rewind(). When the block runs out, allocations spill into extra blocks from the
+// heap; the next reset() replaces the block with one big enough for the high-water mark
+// (up to retainLimit), so a workload that repeats (a frame) stops allocating after its
+// first run
+class LinearArena : public std::pmr::memory_resource
+{
+public:
+    // Position to rewind to: the block offset plus the newest spill block at the time
+    struct Mark
+    {
+        size_t offset;
+        void* overflow;
+    };
+
+    // Largest block reset() grows to; bigger peaks keep spilling instead of holding memory
+    size_t retainLimit;
+
+    explicit LinearArena(size_t capacity = 64 * 1024, size_t retainLimit = SIZE_MAX)
+        : retainLimit(retainLimit), block(nullptr), capacity(0), offset(0), overflow(nullptr), overflowBytes(0),
+          highWater(0)
+    {
+        grow(capacity);
+    }
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    ~LinearArena()
+    {
+        freeOverflow(nullptr);
+        ::operator delete(block, std::align_val_t(BLOCK_ALIGNMENT));
+    }
+
+    // Bytes handed out since the last reset, including spills
+    size_t used() const { return offset + overflowBytes; }
+    size_t blockCapacity() const { return capacity; }
+    // Largest used() seen; the block is resized to this on the next reset after a spill
+    size_t peak() const { return highWater; }
+
+    Mark mark() const { return Mark{ offset, overflow }; }
+
+    // Frees everything allocated after m was taken
+    void rewind(const Mark& m)
+    {
+        freeOverflow(m.overflow);
+        offset = m.offset;
+        if (offset == 0 && highWater > capacity && capacity < retainLimit)
+            grow(std::min(highWater, retainLimit));
+    }
+
+    // Frees everything, growing the block first if the last use spilled
+    void reset() { rewind(Mark{ 0, nullptr }); }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start + bytes <= capacity && alignment <= BLOCK_ALIGNMENT) {
+            offset = start + bytes;
+            highWater = std::max(highWater, used());
+            return static_cast<char*>(block) + start;
+        }
+
+        // Spill: a heap block holding a link to the previous spill, then the data
+        alignment = std::max(alignment, alignof(Spill));
+        size_t header = spillHeader(alignment);
+        Spill* spill = static_cast<Spill*>(::operator new(header + bytes, std::align_val_t(alignment)));
+        spill->previous = overflow;
+        spill->size = header + bytes;
+        spill->alignment = alignment;
+        overflow = spill;
+        overflowBytes += bytes;
+        highWater = std::max(highWater, used());
+        return reinterpret_cast<char*>(spill) + header;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+    static const size_t BLOCK_ALIGNMENT = 64;
+
+    struct Spill
+    {
+        void* previous;
+        size_t size;
+        size_t alignment;
+    };
+
+    void* block;
+    size_t capacity;
+    size_t offset;
+    void* overflow; // Newest spill block
+    size_t overflowBytes;
+    size_t highWater;
+
+    // Bytes before a spill's data: the header rounded up so the data keeps the alignment
+    static size_t spillHeader(size_t alignment) { return (sizeof(Spill) + alignment - 1) & ~(alignment - 1); }
+
+    void grow(size_t bytes)
+    {
+        ::operator delete(block, std::align_val_t(BLOCK_ALIGNMENT));
+        capacity = (bytes + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+        block = ::operator new(capacity, std::align_val_t(BLOCK_ALIGNMENT));
+    }
+
+    // Frees spill blocks newer than keep
+    void freeOverflow(void* keep)
+    {
+        while (overflow != nullptr && overflow != keep) {
+            Spill* spill = static_cast<Spill*>(overflow);
+            overflow = spill->previous;
+            overflowBytes -= spill->size - spillHeader(spill->alignment);
+            ::operator delete(spill, std::align_val_t(spill->alignment));
+        }
+    }
+};
+
+// Transient per-frame data (visibility lists, render commands, debug lines) comes from
+// FRAMES arenas used in turn: beginFrame() moves to the next one and resets it, so data
+// allocated in a frame stays valid while the next FRAMES - 1 frames are built (e.g. for
+// jobs or uploads that still read it). Main thread only
+class FrameAllocator
+{
+public:
+    static const int FRAMES = 3;
+
+    static FrameAllocator& instance()
+    {
+        static FrameAllocator allocator;
+        return allocator;
+    }
+
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    void beginFrame()
+    {
+        index = (index + 1) % FRAMES;
+        arenas[index].reset();
+    }
+
+    // The current frame's arena
+    LinearArena& arena() { return arenas[index]; }
+    std::pmr::memory_resource* resource() { return &arenas[index]; }
+
+private:
+    LinearArena arenas[FRAMES];
+    int index = 0;
+
+    FrameAllocator() {}
+};
+
+// Per-thread scratch memory for work that builds large temporaries and throws them away
+// (importers, mesh baking). Put a ScratchScope around the work; everything allocated
+// through its resource() is freed when the scope ends. Scopes nest
+inline LinearArena& scratchArena()
+{
+    thread_local LinearArena arena(1 << 20, 16 << 20);
+    return arena;
+}
+
+class ScratchScope
+{
+public:
+    ScratchScope() : arena(scratchArena()), start(arena.mark()) {}
+    ~ScratchScope() { arena.rewind(start); }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+    std::pmr::memory_resource* resource() { return &arena; }
+
+private:
+    LinearArena& arena;
+    LinearArena::Mark start;
+};
+
+#endif
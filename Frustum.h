@@ -0,0 +1,63 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+// View frustum as six inward-facing planes (xyz = normal, w = distance)
+struct Frustum
+{
+    enum Side { Outside, Intersecting, Inside };
+
+    glm::vec4 planes[6];
+
+    // Extracts the planes from projection * view (Gribb/Hartmann), normalized
+    static Frustum fromMatrix(const glm::mat4& viewProjection)
+    {
+        const glm::mat4& m = viewProjection;
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+        Frustum f;
+        f.planes[0] = row[3] + row[0]; // Left
+        f.planes[1] = row[3] - row[0]; // Right
+        f.planes[2] = row[3] + row[1]; // Bottom
+        f.planes[3] = row[3] - row[1]; // Top
+        f.planes[4] = row[3] + row[2]; // Near
+        f.planes[5] = row[3] - row[2]; // Far
+        for (glm::vec4& p : f.planes)
+            p = p / glm::length(glm::vec3(p));
+        return f;
+    }
+
+    // Classifies a box against the planes whose bit is set in mask. Planes the box is fully
+    // inside are cleared from mask, so children of a BVH node can skip them
+    Side classify(const AABB& box, unsigned int& mask) const
+    {
+        glm::vec3 c = box.center(), e = box.extent();
+        Side side = Inside;
+        for (int i = 0; i < 6; i++) {
+            if (!(mask & (1u << i)))
+                continue;
+            glm::vec3 n(planes[i]);
+            float distance = glm::dot(n, c) + planes[i].w;
+            float radius = glm::dot(glm::abs(n), e);
+            if (distance < -radius)
+                return Outside;
+            if (distance < radius)
+                side = Intersecting;
+            else
+                mask &= ~(1u << i);
+        }
+        return side;
+    }
+
+    bool intersects(const AABB& box) const
+    {
+        unsigned int mask = 0x3F;
+        return classify(box, mask) != Outside;
+    }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef GLRENDERBACKEND_H
+#define GLRENDERBACKEND_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include "CommandBuffer.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "ShaderProgram.h"
+
+// Replays commands with OpenGL. Program and mesh ids are the order they were added in.
+// Draws go straight to glDrawElements on the bound mesh's VAO, which stays bound until
+// unbind(); call that after replaying, before other drawing code. Binds count as state
+// changes, programs through ShaderProgram::use()
+class GLRenderBackend : public RenderBackend
+{
+public:
+    GLRenderBackend() : mesh(nullptr) {}
+
+    uint32_t addProgram(const ShaderProgram& program)
+    {
+        programs.push_back(&program);
+        return static_cast<uint32_t>(programs.size() - 1);
+    }
+
+    uint32_t addMesh(const Mesh& added)
+    {
+        meshes.push_back(&added);
+        return static_cast<uint32_t>(meshes.size() - 1);
+    }
+
+    void bindProgram(uint32_t program) override { programs[program]->use(); }
+
+    void bindMesh(uint32_t id) override
+    {
+        mesh = meshes[id];
+        glBindVertexArray(mesh->VAO);
+        Profiler::instance().counters.stateChanges++;
+    }
+
+    void setVec4(int location, const float* value) override { glUniform4fv(location, 1, value); }
+    void setMat4(int location, const float* value) override { glUniformMatrix4fv(location, 1, GL_FALSE, value); }
+
+    void draw(int lod) override
+    {
+        assert(mesh != nullptr && "draw without a bound mesh: was the replayer told about unbind()?");
+        const MeshLOD& level = mesh->lods[std::min<size_t>(std::max(lod, 0), mesh->lods.size() - 1)];
+        size_t indexSize = (mesh->indexType == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int);
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(level.count), mesh->indexType, (void*)(level.first * indexSize));
+
+        FrameCounters& counters = Profiler::instance().counters;
+        counters.drawCalls++;
+        counters.triangles += level.count / 3;
+        counters.trianglesFullDetail += mesh->indexCount / 3;
+    }
+
+    // Unbinds the VAO and tells replayer, so its next replay binds the mesh again
+    void unbind(CommandReplayer& replayer)
+    {
+        glBindVertexArray(0);
+        mesh = nullptr;
+        replayer.forgetState();
+    }
+
+private:
+    std::vector<const ShaderProgram*> programs;
+    std::vector<const Mesh*> meshes;
+    const Mesh* mesh; // Bound
+};
+
+#endif
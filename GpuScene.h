@@ -0,0 +1,306 @@
+#ifndef GPUSCENE_H
+#define GPUSCENE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "Frustum.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "ShaderProgram.h"
+
+// An object as the cull shader reads it (std430: the struct rounds up to 16 bytes)
+struct GpuObject
+{
+    glm::mat4 model;
+    uint32_t mesh;
+    uint32_t padding[3];
+};
+
+// A registered mesh: its local bounds and the range of draw commands for its levels
+struct GpuMeshInfo
+{
+    glm::mat4 positionTransform;
+    glm::vec4 center;
+    glm::vec4 extent;
+    uint32_t firstCommand;
+    uint32_t lodCount;
+    uint32_t padding[2];
+};
+
+static_assert(sizeof(GpuObject) == 80, "GpuObject must match the std430 layout in shaders/cull.comp");
+static_assert(sizeof(GpuMeshInfo) == 112, "GpuMeshInfo must match the std430 layout in shaders/cull.comp");
+
+// GPU-driven drawing: object transforms and bounds live in shader storage buffers, a
+// compute shader (shaders/cull.comp) frustum culls every object, picks its level of detail
+// and appends its matrix to that level's draw command, and one
+// glMultiDrawElementsIndirectCount per mesh draws whatever survived. The CPU only uploads
+// the transforms that changed, so its cost per frame doesn't grow with the object count.
+//
+// Each (mesh, level) has a command whose instances start at a fixed offset with room for
+// every object using the mesh; the instance counts are reset from a template with a GPU
+// copy, and shaders/compact_draws.comp packs the non-empty commands to the front of each
+// mesh's range and writes their count. Matrices are read from ATTRIBUTE_INSTANCE_MODEL
+// like RenderQueue's, so programs are shared. Needs GL 4.3 compute shaders and storage
+// buffers plus GL_ARB_base_instance and GL_ARB_indirect_parameters (core in 4.6); check
+// supported() and keep the CPU path (BVH + RenderQueue) otherwise. Visible counts stay on
+// the GPU; readStatistics() reads them back, stalling, for tests
+class GpuScene
+{
+public:
+    // Same meaning as selectLOD's
+    float thresholdPixels;
+
+    GpuScene() : thresholdPixels(1.0f), layoutDirty(true), dirtyBegin(0), dirtyEnd(0), commandCount(0)
+    {
+        for (unsigned int& buffer : buffers)
+            buffer = 0;
+    }
+
+    GpuScene(const GpuScene&) = delete;
+    GpuScene& operator=(const GpuScene&) = delete;
+
+    static bool supported()
+    {
+        return GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_multi_draw_indirect
+            && GLEW_ARB_base_instance && GLEW_ARB_indirect_parameters;
+    }
+
+    // Compiles the compute shaders and creates the buffers; false if the context can't run them
+    bool init()
+    {
+        if (!supported()) {
+            std::cout << "GPU culling needs compute shaders, storage buffers and GL_ARB_indirect_parameters" << std::endl;
+            return false;
+        }
+        if (!cullShader.load(GL_COMPUTE_SHADER, "shaders/cull.comp")
+            || !compactShader.load(GL_COMPUTE_SHADER, "shaders/compact_draws.comp")
+            || !cullProgram.link({ &cullShader }) || !compactProgram.link({ &compactShader }))
+            return false;
+        planesLocation = cullProgram.uniform("planes");
+        eyeLocation = cullProgram.uniform("eye");
+        pixelsPerUnitLocation = cullProgram.uniform("pixelsPerUnit");
+        thresholdLocation = cullProgram.uniform("thresholdPixels");
+        objectCountLocation = cullProgram.uniform("objectCount");
+        meshCountLocation = compactProgram.uniform("meshCount");
+        glGenBuffers(BUFFER_COUNT, buffers);
+        return true;
+    }
+
+    // Registers a mesh (its levels and bounds are read now; it must outlive the scene)
+    int addMesh(const Mesh& mesh)
+    {
+        meshes.push_back(&mesh);
+        layoutDirty = true;
+        return static_cast<int>(meshes.size()) - 1;
+    }
+
+    // Adds an object drawing a registered mesh; returns its index
+    int add(int mesh, const glm::mat4& model)
+    {
+        GpuObject object = {};
+        object.model = model;
+        object.mesh = static_cast<uint32_t>(mesh);
+        objects.push_back(object);
+        layoutDirty = true;
+        return static_cast<int>(objects.size()) - 1;
+    }
+
+    // Moves an object; the changed range is uploaded by the next draw()
+    void setTransform(int object, const glm::mat4& model)
+    {
+        objects[object].model = model;
+        if (dirtyBegin == dirtyEnd) {
+            dirtyBegin = object;
+            dirtyEnd = object + 1;
+        } else {
+            dirtyBegin = std::min<size_t>(dirtyBegin, object);
+            dirtyEnd = std::max<size_t>(dirtyEnd, object + 1);
+        }
+    }
+
+    size_t size() const { return objects.size(); }
+
+    // Culls and draws every object with program, which reads the Frame uniform block.
+    // fovDegrees and viewportHeight set the level of detail, as for selectLOD
+    void draw(const ShaderProgram& program, const glm::mat4& viewProjection, const glm::vec3& eye, float fovDegrees,
+              float viewportHeight)
+    {
+        if (objects.empty())
+            return;
+        if (cullProgram.id == 0) {
+            std::cerr << "Error: GpuScene is not initialized. Cannot draw." << std::endl;
+            return;
+        }
+        FrameCounters& counters = Profiler::instance().counters;
+        if (layoutDirty) {
+            rebuild();
+        } else if (dirtyBegin < dirtyEnd) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[OBJECTS]);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyBegin * sizeof(GpuObject),
+                            (dirtyEnd - dirtyBegin) * sizeof(GpuObject), &objects[dirtyBegin]);
+            counters.uploadBytes += (dirtyEnd - dirtyBegin) * sizeof(GpuObject);
+        }
+        dirtyBegin = dirtyEnd = 0;
+
+        // Zero the instance counts with a copy from the template, on the GPU
+        size_t commandBytes = commandCount * sizeof(DrawElementsIndirectCommand);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffers[COMMAND_TEMPLATE]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[COMMANDS]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandBytes);
+        for (unsigned int binding = 0; binding < STORAGE_BINDINGS; binding++)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffers[binding]);
+
+        Frustum frustum = Frustum::fromMatrix(viewProjection);
+        cullProgram.use();
+        cullProgram.setVec4(planesLocation, frustum.planes, 6);
+        cullProgram.setVec3(eyeLocation, eye);
+        cullProgram.setFloat(pixelsPerUnitLocation, viewportHeight / (2.0f * std::tan(glm::radians(fovDegrees) * 0.5f)));
+        cullProgram.setFloat(thresholdLocation, thresholdPixels);
+        cullProgram.setUint(objectCountLocation, static_cast<unsigned int>(objects.size()));
+        glDispatchCompute(static_cast<GLuint>((objects.size() + GROUP_SIZE - 1) / GROUP_SIZE), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        compactProgram.use();
+        compactProgram.setUint(meshCountLocation, static_cast<unsigned int>(meshes.size()));
+        glDispatchCompute(static_cast<GLuint>((meshes.size() + GROUP_SIZE - 1) / GROUP_SIZE), 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+        program.use();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers[DRAWS]);
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, buffers[DRAW_COUNTS]);
+        for (size_t m = 0; m < meshes.size(); m++) {
+            const Mesh& mesh = *meshes[m];
+            if (mesh.VAO == 0)
+                continue;
+            mesh.bindInstanced(buffers[INSTANCES]);
+            glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, mesh.indexType,
+                                                (void*)(meshInfos[m].firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                                static_cast<GLintptr>(m * sizeof(uint32_t)),
+                                                static_cast<GLsizei>(meshInfos[m].lodCount), 0);
+            counters.stateChanges++;
+            counters.drawCalls++;
+        }
+        glBindVertexArray(0);
+    }
+
+    // What the last draw() drew, read back from the GPU (waits for it)
+    struct Statistics
+    {
+        uint64_t instances = 0;
+        uint64_t triangles = 0;
+        uint64_t trianglesFullDetail = 0;
+        uint64_t commands = 0; // Non-empty draw commands
+    };
+
+    Statistics readStatistics() const
+    {
+        Statistics statistics;
+        if (commandCount == 0)
+            return statistics;
+        std::vector<DrawElementsIndirectCommand> commands(commandCount);
+        std::vector<uint32_t> counts(meshes.size());
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[COMMANDS]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(commands[0]), commands.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[DRAW_COUNTS]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, counts.size() * sizeof(counts[0]), counts.data());
+        for (size_t m = 0; m < meshes.size(); m++) {
+            const GpuMeshInfo& info = meshInfos[m];
+            for (uint32_t c = info.firstCommand; c < info.firstCommand + info.lodCount; c++) {
+                statistics.instances += commands[c].instanceCount;
+                statistics.triangles += static_cast<uint64_t>(commands[c].count / 3) * commands[c].instanceCount;
+                statistics.trianglesFullDetail += static_cast<uint64_t>(meshes[m]->indexCount / 3) * commands[c].instanceCount;
+            }
+            statistics.commands += counts[m];
+        }
+        return statistics;
+    }
+
+    ~GpuScene()
+    {
+        if (buffers[0] != 0) glDeleteBuffers(BUFFER_COUNT, buffers);
+    }
+
+private:
+    // Layout fixed by GL for glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand
+    {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        uint32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    // Buffers, the first STORAGE_BINDINGS at the storage binding of the same number
+    enum Buffer { OBJECTS, MESHES, LOD_ERRORS, COMMANDS, LODS, INSTANCES, DRAWS, DRAW_COUNTS, COMMAND_TEMPLATE, BUFFER_COUNT };
+    static const unsigned int STORAGE_BINDINGS = COMMAND_TEMPLATE;
+    static const size_t GROUP_SIZE = 64; // local_size_x of both shaders
+
+    Shader cullShader, compactShader;
+    ShaderProgram cullProgram, compactProgram;
+    int planesLocation, eyeLocation, pixelsPerUnitLocation, thresholdLocation, objectCountLocation, meshCountLocation;
+    unsigned int buffers[BUFFER_COUNT];
+
+    std::vector<const Mesh*> meshes;
+    std::vector<GpuMeshInfo> meshInfos;
+    std::vector<GpuObject> objects;
+    bool layoutDirty;
+    size_t dirtyBegin, dirtyEnd; // Objects changed since the last upload
+    size_t commandCount;
+
+    // Lays out the commands and instance ranges for the current meshes and objects and
+    // uploads everything. Levels of detail restart at the finest
+    void rebuild()
+    {
+        std::vector<uint32_t> objectsPerMesh(meshes.size(), 0);
+        for (const GpuObject& object : objects)
+            objectsPerMesh[object.mesh]++;
+
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<float> lodErrors;
+        meshInfos.clear();
+        uint32_t baseInstance = 0;
+        for (size_t m = 0; m < meshes.size(); m++) {
+            const Mesh& mesh = *meshes[m];
+            GpuMeshInfo info = {};
+            info.positionTransform = mesh.positionTransform;
+            info.center = glm::vec4(mesh.bounds.center(), 0.0f);
+            info.extent = glm::vec4(mesh.bounds.extent(), 0.0f);
+            info.firstCommand = static_cast<uint32_t>(commands.size());
+            info.lodCount = static_cast<uint32_t>(mesh.lods.size());
+            meshInfos.push_back(info);
+            for (const MeshLOD& level : mesh.lods) {
+                commands.push_back(DrawElementsIndirectCommand{ level.count, 0, level.first, 0, baseInstance });
+                lodErrors.push_back(level.error);
+                baseInstance += objectsPerMesh[m];
+            }
+        }
+        commandCount = commands.size();
+
+        auto upload = [&](Buffer buffer, size_t bytes, const void* data, unsigned int usage) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer]);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(bytes, 4), data, usage);
+            Profiler::instance().counters.uploadBytes += data != nullptr ? bytes : 0;
+        };
+        std::vector<uint32_t> lods(objects.size(), 0);
+        upload(OBJECTS, objects.size() * sizeof(GpuObject), objects.data(), GL_DYNAMIC_DRAW);
+        upload(MESHES, meshInfos.size() * sizeof(GpuMeshInfo), meshInfos.data(), GL_STATIC_DRAW);
+        upload(LOD_ERRORS, lodErrors.size() * sizeof(float), lodErrors.data(), GL_STATIC_DRAW);
+        upload(COMMAND_TEMPLATE, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+        upload(COMMANDS, commands.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+        upload(DRAWS, commands.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+        upload(DRAW_COUNTS, meshes.size() * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+        upload(LODS, lods.size() * sizeof(uint32_t), lods.data(), GL_DYNAMIC_COPY);
+        upload(INSTANCES, baseInstance * sizeof(glm::mat4), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        layoutDirty = false;
+    }
+};
+
+#endif
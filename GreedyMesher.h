@@ -0,0 +1,168 @@
+#ifndef GREEDYMESHER_H
+#define GREEDYMESHER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "VoxelChunk.h"
+
+// One corner of a voxel quad: chunk-local position in blocks (0..SIZE), the face it
+// belongs to (0..5: -x, +x, -y, +y, -z, +z) and its block type. 8 bytes
+struct VoxelVertex
+{
+    uint8_t x, y, z;
+    uint8_t face;
+    BlockId block;
+    uint16_t padding;
+};
+static_assert(sizeof(VoxelVertex) == 8, "VoxelVertex is read by shaders/voxel.vert");
+
+// Quads of one chunk, four vertices each (drawn with a shared quad index buffer)
+struct VoxelMesh
+{
+    std::vector<VoxelVertex> vertices;
+
+    size_t quadCount() const { return vertices.size() / 4; }
+    void clear() { vertices.clear(); }
+};
+
+// Turns the faces between solid blocks and air into quads, merging coplanar faces of the
+// same type into rectangles (greedy meshing). Works on a dense copy of the chunk with a
+// one-block border from its neighbors, so faces on chunk boundaries are only emitted when
+// the neighboring block is air
+template <int N>
+class GreedyMesher
+{
+public:
+    static const int SIZE = N;
+    static const int PADDED = N + 2;
+
+    // Dense blocks with the border, cell (x, y, z) at ((y + 1) * PADDED + z + 1) * PADDED + x + 1
+    std::vector<BlockId> blocks;
+
+    GreedyMesher() : blocks(size_t(PADDED) * PADDED * PADDED, AIR), mask(size_t(N) * N), decoded(PaletteChunk<N>::VOLUME) {}
+
+    static size_t padded(int x, int y, int z) { return (size_t(y + 1) * PADDED + z + 1) * PADDED + x + 1; }
+
+    // Fills blocks from chunk; neighbors in face order (-x, +x, -y, +y, -z, +z), null for air
+    void load(const PaletteChunk<N>& chunk, const PaletteChunk<N>* const neighbors[6])
+    {
+        std::fill(blocks.begin(), blocks.end(), AIR);
+        chunk.decode(decoded.data());
+        for (int y = 0; y < N; y++)
+            for (int z = 0; z < N; z++)
+                std::copy_n(&decoded[PaletteChunk<N>::cell(0, y, z)], N, &blocks[padded(0, y, z)]);
+
+        for (int face = 0; face < 6; face++) {
+            const PaletteChunk<N>* neighbor = neighbors[face];
+            if (neighbor == nullptr)
+                continue;
+            int axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+            int from = face % 2 == 0 ? N - 1 : 0, to = face % 2 == 0 ? -1 : N;
+            for (int j = 0; j < N; j++) {
+                for (int i = 0; i < N; i++) {
+                    int source[3], target[3];
+                    source[axis] = from;
+                    target[axis] = to;
+                    source[u] = target[u] = i;
+                    source[v] = target[v] = j;
+                    blocks[padded(target[0], target[1], target[2])] = neighbor->get(source[0], source[1], source[2]);
+                }
+            }
+        }
+    }
+
+    // Meshes the loaded blocks into mesh (cleared first)
+    void build(VoxelMesh& mesh)
+    {
+        mesh.clear();
+        for (int face = 0; face < 6; face++) {
+            int axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+            int step[3] = { 0, 0, 0 };
+            step[axis] = face % 2 == 0 ? -1 : 1;
+            for (int slice = 0; slice < N; slice++) {
+                // Exposed faces of this slice
+                bool any = false;
+                for (int j = 0; j < N; j++) {
+                    for (int i = 0; i < N; i++) {
+                        int p[3];
+                        p[axis] = slice;
+                        p[u] = i;
+                        p[v] = j;
+                        BlockId block = blocks[padded(p[0], p[1], p[2])];
+                        bool exposed = block != AIR && blocks[padded(p[0] + step[0], p[1] + step[1], p[2] + step[2])] == AIR;
+                        mask[size_t(j) * N + i] = exposed ? block : AIR;
+                        any = any || exposed;
+                    }
+                }
+                if (any)
+                    mergeSlice(mesh, face, slice);
+            }
+        }
+    }
+
+    // Exposed faces without merging, for comparison: one quad each
+    size_t countFaces() const
+    {
+        size_t faces = 0;
+        for (int y = 0; y < N; y++)
+            for (int z = 0; z < N; z++)
+                for (int x = 0; x < N; x++) {
+                    if (blocks[padded(x, y, z)] == AIR)
+                        continue;
+                    faces += (blocks[padded(x - 1, y, z)] == AIR) + (blocks[padded(x + 1, y, z)] == AIR)
+                           + (blocks[padded(x, y - 1, z)] == AIR) + (blocks[padded(x, y + 1, z)] == AIR)
+                           + (blocks[padded(x, y, z - 1)] == AIR) + (blocks[padded(x, y, z + 1)] == AIR);
+                }
+        return faces;
+    }
+
+private:
+    std::vector<BlockId> mask; // Exposed face types of one slice, (v, u) order
+    std::vector<BlockId> decoded;
+
+    // Grows rectangles along u, then v, over faces of the same type
+    void mergeSlice(VoxelMesh& mesh, int face, int slice)
+    {
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < N;) {
+                BlockId block = mask[size_t(j) * N + i];
+                if (block == AIR) {
+                    i++;
+                    continue;
+                }
+                int width = 1;
+                while (i + width < N && mask[size_t(j) * N + i + width] == block)
+                    width++;
+                int height = 1;
+                for (; j + height < N; height++) {
+                    const BlockId* row = &mask[size_t(j + height) * N + i];
+                    if (!std::all_of(row, row + width, [block](BlockId b) { return b == block; }))
+                        break;
+                }
+                for (int h = 0; h < height; h++)
+                    std::fill_n(&mask[size_t(j + h) * N + i], width, AIR);
+                emitQuad(mesh, face, slice, i, j, width, height, block);
+                i += width;
+            }
+        }
+    }
+
+    // Corners counter-clockwise seen from outside the block
+    static void emitQuad(VoxelMesh& mesh, int face, int slice, int i, int j, int width, int height, BlockId block)
+    {
+        int axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+        int corners[4][2] = { { i, j }, { i + width, j }, { i + width, j + height }, { i, j + height } };
+        for (int k = 0; k < 4; k++) {
+            // u x v points along +axis, so the corners wind the other way on negative faces
+            const int* corner = corners[face % 2 == 1 ? k : 3 - k];
+            int p[3];
+            p[axis] = slice + face % 2;
+            p[u] = corner[0];
+            p[v] = corner[1];
+            mesh.vertices.push_back(VoxelVertex{ uint8_t(p[0]), uint8_t(p[1]), uint8_t(p[2]), uint8_t(face), block, 0 });
+        }
+    }
+};
+
+#endif
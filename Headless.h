@@ -0,0 +1,202 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// An OpenGL 3.3 core context without a window or display server, created through EGL.
+// Prefers Mesa's surfaceless platform (works with llvmpipe on machines with no GPU) and
+// falls back to the default display with a 1x1 pbuffer
+class HeadlessContext
+{
+public:
+    HeadlessContext() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), surface(EGL_NO_SURFACE) {}
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    bool init()
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+        if (getPlatformDisplay != nullptr)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+#endif
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            std::cout << "Failed to initialize EGL" << std::endl;
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+            // Surfaceless displays may expose no pbuffer configs; rendering goes to an FBO anyway
+            const EGLint anyAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+            if (!eglChooseConfig(display, anyAttribs, &config, 1, &configCount) || configCount == 0) {
+                std::cout << "Failed to find an EGL config" << std::endl;
+                return false;
+            }
+        }
+
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cout << "EGL has no desktop OpenGL support" << std::endl;
+            return false;
+        }
+
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "Failed to create an OpenGL 3.3 EGL context" << std::endl;
+            return false;
+        }
+
+        // Surfaceless if supported, otherwise a tiny pbuffer
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+            if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context)) {
+                std::cout << "Failed to make the EGL context current" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ~HeadlessContext()
+    {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+
+private:
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+};
+
+// Loads the GL entry points for the current context. A GLX build of GLEW reports
+// GLEW_ERROR_NO_GLX_DISPLAY under EGL with no display server, but its entry points still
+// resolve, so that counts as success. Clears the GL_INVALID_ENUM glewInit can leave behind
+// on core contexts
+inline bool initGlew()
+{
+    glewExperimental = GL_TRUE;
+    GLenum status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (status == GLEW_ERROR_NO_GLX_DISPLAY)
+        status = GLEW_OK;
+#endif
+    if (status != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        return false;
+    }
+    glGetError();
+    return true;
+}
+
+// An offscreen render target: RGBA8 color and 24-bit depth renderbuffers
+class Framebuffer
+{
+public:
+    unsigned int FBO, colorRBO, depthRBO;
+    int width, height;
+
+    Framebuffer() : FBO(0), colorRBO(0), depthRBO(0), width(0), height(0) {}
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    bool init(int w, int h)
+    {
+        width = w;
+        height = h;
+
+        glGenFramebuffers(1, &FBO);
+        glGenRenderbuffers(1, &colorRBO);
+        glGenRenderbuffers(1, &depthRBO);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        if (!complete)
+            std::cout << "ERROR: Offscreen framebuffer is incomplete" << std::endl;
+        return complete;
+    }
+
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, width, height);
+    }
+
+    // Reads the color buffer as tightly packed RGB rows, top row first
+    void readPixels(std::vector<unsigned char>& rgb) const
+    {
+        std::vector<unsigned char> flipped(size_t(width) * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, flipped.data());
+
+        // GL rows start at the bottom
+        rgb.resize(flipped.size());
+        size_t row = size_t(width) * 3;
+        for (int y = 0; y < height; y++)
+            std::copy(flipped.begin() + (height - 1 - y) * row, flipped.begin() + (height - y) * row, rgb.begin() + y * row);
+    }
+
+    // Writes the color buffer as a binary PPM (P6)
+    bool writePPM(const char* path) const
+    {
+        std::vector<unsigned char> rgb;
+        readPixels(rgb);
+
+        FILE* file = fopen(path, "wb");
+        if (file == nullptr) {
+            std::cout << "Failed to write " << path << std::endl;
+            return false;
+        }
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        fclose(file);
+        return ok;
+    }
+
+    ~Framebuffer()
+    {
+        if (FBO != 0) glDeleteFramebuffers(1, &FBO);
+        if (colorRBO != 0) glDeleteRenderbuffers(1, &colorRBO);
+        if (depthRBO != 0) glDeleteRenderbuffers(1, &depthRBO);
+    }
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef INSTANCEDMESH_H
+#define INSTANCEDMESH_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "MeshCache.h"
+
+// A mesh drawn many times with one glDrawElementsInstanced call. The geometry buffers are
+// shared with the cached Mesh; this class adds its own VAO and an instance VBO streaming
+// per-instance model matrices into attribute locations 3-6 (one vec4 column each, divisor 1).
+// The matrices apply to stored positions: for a quantized mesh, multiply in its positionTransform
+class InstancedMesh
+{
+public:
+    // First of the four model matrix attribute locations
+    static const unsigned int INSTANCE_ATTRIBUTE = ATTRIBUTE_INSTANCE_MODEL;
+
+    // Per-instance model matrices, uploaded by update()
+    std::vector<glm::mat4> transforms;
+
+    // Shared geometry
+    MeshHandle mesh;
+
+    // OpenGL attributes
+    unsigned int VAO, instanceVBO;
+
+    InstancedMesh() : VAO(0), instanceVBO(0), instanceCapacity(0), uploadedCount(0) {}
+
+    InstancedMesh(const InstancedMesh&) = delete;
+    InstancedMesh& operator=(const InstancedMesh&) = delete;
+
+    // Binds the shared geometry and sets up the instance attributes
+    void init(MeshHandle sharedMesh)
+    {
+        if (!sharedMesh || sharedMesh->VAO == 0) {
+            std::cerr << "Error: Mesh is not uploaded. InstancedMesh initialization failed." << std::endl;
+            return;
+        }
+        mesh = sharedMesh;
+
+        // Generate the VAO and the instance buffer
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &instanceVBO);
+
+        glBindVertexArray(VAO);
+
+        // Geometry
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->VBO);
+        mesh->format.setAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->EBO);
+
+        // Instance transforms: a mat4 takes four consecutive vec4 attributes
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        setInstanceAttributes(0);
+
+        glBindVertexArray(0);
+    }
+
+    // Streams transforms into the instance VBO. The buffer grows geometrically and is
+    // orphaned every frame so the driver never stalls on the previous frame's draw
+    void update()
+    {
+        update(transforms.data(), transforms.size());
+    }
+
+    // Streams count matrices from an external array (e.g. TransformStore::matrices)
+    void update(const glm::mat4* data, size_t count)
+    {
+        if (instanceVBO == 0)
+            return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (count > instanceCapacity)
+            instanceCapacity = std::max(count, instanceCapacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        uploadedCount = count;
+        Profiler::instance().counters.uploadBytes += count * sizeof(glm::mat4);
+    }
+
+    // Draws every instance uploaded by the last update()
+    void draw() const
+    {
+        if (VAO == 0) {
+            std::cerr << "Error: VAO is not initialized. Cannot draw instanced mesh." << std::endl;
+            return;
+        }
+        if (uploadedCount == 0)
+            return;
+
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount, mesh->indexType, 0, static_cast<GLsizei>(uploadedCount));
+        glBindVertexArray(0);
+
+        FrameCounters& counters = Profiler::instance().counters;
+        counters.stateChanges++;
+        counters.drawCalls++;
+        counters.triangles += static_cast<uint64_t>(mesh->indexCount / 3) * uploadedCount;
+        counters.trianglesFullDetail += static_cast<uint64_t>(mesh->indexCount / 3) * uploadedCount;
+    }
+
+    ~InstancedMesh()
+    {
+        if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+        if (instanceVBO != 0) glDeleteBuffers(1, &instanceVBO);
+    }
+
+private:
+    size_t instanceCapacity;
+    size_t uploadedCount;
+};
+
+#endif
@@ -0,0 +1,412 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+struct Job;
+
+// Counts the unfinished jobs of a group. wait() on it, or chain jobs to run once it
+// reaches zero with JobSystem::runAfter()
+class JobCounter
+{
+public:
+    JobCounter() : value(0) {}
+    // Waits out a finishing job still holding the lock (counters often live on the stack)
+    ~JobCounter() { std::lock_guard<std::mutex> lock(mutex); }
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const { return value.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> value;
+    std::mutex mutex;
+    std::vector<Job*> continuations;
+};
+
+struct Job
+{
+    std::function<void()> function;
+    JobCounter* counter;
+    int owner;  // Worker whose free list it returns to, -1 for the shared one
+    Job* next;  // In a free list
+};
+
+// Chase-Lev work-stealing deque of fixed capacity (Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models"). The owning thread pushes and pops at the bottom;
+// any thread may steal from the top. Sequentially consistent operations stand in for the
+// paper's fences so ThreadSanitizer can follow them
+class JobDeque
+{
+public:
+    static const int64_t CAPACITY = 4096;
+
+    JobDeque() : top(0), bottom(0)
+    {
+        for (auto& slot : slots)
+            slot.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // Owner only. Fails when full
+    bool push(Job* job)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= CAPACITY)
+            return false;
+        slots[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only. Newest job first
+    Job* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last job: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Any thread. Oldest job first; null if empty or another thread won the race
+    Job* steal()
+    {
+        int64_t t = top.load(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_seq_cst);
+        if (t >= b)
+            return nullptr;
+        Job* job = slots[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<Job*> slots[CAPACITY];
+};
+
+// Work-stealing job scheduler. The constructing thread is worker 0 and runs jobs while it
+// waits; the other workers are background threads. Each worker pushes to and pops from
+// its own deque and steals from the others when it runs dry; threads outside the system
+// submit through a locked injection queue. Idle workers sleep on a condition variable
+class JobSystem
+{
+public:
+    // workers: total threads including the calling one (0 = one per hardware thread)
+    explicit JobSystem(unsigned workers = 0) : pending(0), sleeping(0), stopping(false)
+    {
+        if (workers == 0)
+            workers = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < workers; i++) {
+            deques.emplace_back(new JobDeque());
+            freeLists.emplace_back(new FreeList());
+        }
+
+        current() = ThreadState{ this, 0 };
+        for (unsigned i = 1; i < workers; i++)
+            threads.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // The process-wide scheduler, created on first use (call that from the main thread).
+    // Always has a background worker so fire-and-forget loads progress on one core too
+    static JobSystem& instance()
+    {
+        static JobSystem jobs(std::max(2u, std::thread::hardware_concurrency()));
+        return jobs;
+    }
+
+    unsigned threadCount() const { return static_cast<unsigned>(deques.size()); }
+
+    // Queues function; counter (if given) is incremented now and decremented when it finishes
+    void run(std::function<void()> function, JobCounter* counter = nullptr)
+    {
+        if (counter != nullptr)
+            counter->value.fetch_add(1, std::memory_order_relaxed);
+        submit(newJob(std::move(function), counter));
+    }
+
+    // Queues function to run once dependency reaches zero
+    void runAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr)
+    {
+        if (counter != nullptr)
+            counter->value.fetch_add(1, std::memory_order_relaxed);
+        Job* job = newJob(std::move(function), counter);
+        {
+            std::lock_guard<std::mutex> lock(dependency.mutex);
+            if (dependency.value.load(std::memory_order_acquire) != 0) {
+                dependency.continuations.push_back(job);
+                return;
+            }
+        }
+        submit(job);
+    }
+
+    // Runs other jobs until counter reaches zero
+    void wait(JobCounter& counter)
+    {
+        int self = workerIndex();
+        while (!counter.done()) {
+            if (Job* job = findJob(self))
+                execute(job);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // Calls body(chunkBegin, chunkEnd) over [begin, end) in chunks of grain and returns
+    // when all are done. The caller runs the first chunk itself; small ranges run inline
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, const F& body)
+    {
+        if (end <= begin)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        if (end - begin <= grain || deques.size() == 1) {
+            body(begin, end);
+            return;
+        }
+
+        // The jobs capture two words so std::function stores them without allocating
+        struct Range
+        {
+            const F& body;
+            size_t end, grain;
+        } range{ body, end, grain };
+        JobCounter counter;
+        for (size_t chunk = begin + grain; chunk < end; chunk += grain)
+            run([&range, chunk] { range.body(chunk, std::min(range.end, chunk + range.grain)); }, &counter);
+        body(begin, begin + grain);
+        wait(counter);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping.store(true);
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+
+        // Drop anything never started
+        for (auto& deque : deques)
+            while (Job* job = deque->steal())
+                delete job;
+        for (Job* job : injected)
+            delete job;
+        for (auto& list : freeLists) {
+            for (Job* job : { list->local, list->returned.load() }) {
+                while (job != nullptr) {
+                    Job* next = job->next;
+                    delete job;
+                    job = next;
+                }
+            }
+        }
+        for (Job* job : sharedFreeJobs)
+            delete job;
+        if (current().system == this)
+            current() = ThreadState{ nullptr, -1 };
+    }
+
+private:
+    struct ThreadState
+    {
+        const JobSystem* system;
+        int index;
+    };
+
+    std::vector<std::unique_ptr<JobDeque>> deques;
+    std::vector<std::thread> threads;
+
+    std::mutex injectedMutex;
+    std::deque<Job*> injected;
+
+    // Finished jobs kept for reuse, so steady-state frames don't allocate them. A job goes
+    // back to the worker that created it: whoever runs it pushes it on that worker's
+    // returned stack, and the owner takes the whole stack when its local list runs out.
+    // Each worker so keeps as many jobs as it ever had queued at once. Jobs made by
+    // outside threads share a locked list
+    struct alignas(64) FreeList
+    {
+        std::atomic<Job*> returned{ nullptr };
+        Job* local = nullptr; // Owner only
+    };
+    std::vector<std::unique_ptr<FreeList>> freeLists;
+    std::mutex sharedFreeMutex;
+    std::vector<Job*> sharedFreeJobs;
+
+    // Queued but not yet started jobs, for sleeping
+    std::atomic<int> pending;
+    std::atomic<int> sleeping;
+    std::atomic<bool> stopping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    static ThreadState& current()
+    {
+        thread_local ThreadState state{ nullptr, -1 };
+        return state;
+    }
+
+    // This thread's worker index in this system, or -1
+    int workerIndex() const
+    {
+        const ThreadState& state = current();
+        return state.system == this ? state.index : -1;
+    }
+
+    Job* newJob(std::function<void()>&& function, JobCounter* counter)
+    {
+        Job* job = nullptr;
+        int self = workerIndex();
+        if (self >= 0) {
+            FreeList& list = *freeLists[self];
+            if (list.local == nullptr)
+                list.local = list.returned.exchange(nullptr, std::memory_order_acquire);
+            job = list.local;
+            if (job != nullptr)
+                list.local = job->next;
+        } else {
+            std::lock_guard<std::mutex> lock(sharedFreeMutex);
+            if (!sharedFreeJobs.empty()) {
+                job = sharedFreeJobs.back();
+                sharedFreeJobs.pop_back();
+            }
+        }
+        if (job == nullptr)
+            return new Job{ std::move(function), counter, self, nullptr };
+        job->function = std::move(function);
+        job->counter = counter;
+        return job;
+    }
+
+    void releaseJob(Job* job)
+    {
+        if (job->owner < 0) {
+            std::lock_guard<std::mutex> lock(sharedFreeMutex);
+            sharedFreeJobs.push_back(job);
+            return;
+        }
+        // Only the owner takes from the stack, and it takes all of it, so there is no ABA
+        std::atomic<Job*>& returned = freeLists[job->owner]->returned;
+        job->next = returned.load(std::memory_order_relaxed);
+        while (!returned.compare_exchange_weak(job->next, job, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    void submit(Job* job)
+    {
+        int self = workerIndex();
+        if (self < 0 || !deques[self]->push(job)) {
+            if (self >= 0) {
+                // Own deque is full: run it now rather than grow
+                execute(job);
+                return;
+            }
+            std::lock_guard<std::mutex> lock(injectedMutex);
+            injected.push_back(job);
+        }
+        pending.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst) > 0) {
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            wake.notify_one();
+        }
+    }
+
+    Job* findJob(int self)
+    {
+        Job* job = nullptr;
+        if (self >= 0)
+            job = deques[self]->pop();
+
+        // Steal, starting after ourselves so thieves spread over the victims
+        size_t count = deques.size();
+        size_t start = self >= 0 ? static_cast<size_t>(self) : 0;
+        for (size_t i = 1; job == nullptr && i <= count; i++)
+            job = deques[(start + i) % count]->steal();
+
+        if (job == nullptr) {
+            std::lock_guard<std::mutex> lock(injectedMutex);
+            if (!injected.empty()) {
+                job = injected.front();
+                injected.pop_front();
+            }
+        }
+        if (job != nullptr)
+            pending.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    void execute(Job* job)
+    {
+        job->function();
+        JobCounter* counter = job->counter;
+        job->function = nullptr;
+        releaseJob(job);
+        if (counter == nullptr)
+            return;
+
+        // Decrement under the lock so runAfter() can't miss the transition to zero
+        std::vector<Job*> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.swap(counter->continuations);
+        }
+        for (Job* next : ready)
+            submit(next);
+    }
+
+    void workerLoop(int index)
+    {
+        current() = ThreadState{ this, index };
+        while (!stopping.load(std::memory_order_acquire)) {
+            if (Job* job = findJob(index)) {
+                execute(job);
+                continue;
+            }
+            if (pending.load(std::memory_order_seq_cst) > 0) {
+                std::this_thread::yield(); // Lost a steal race; work is still out there
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            wake.wait(lock, [this] { return pending.load(std::memory_order_seq_cst) > 0 || stopping.load(); });
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+};
+
+#endif
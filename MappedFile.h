@@ -0,0 +1,96 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A read-only memory mapping of a whole file, unmapped on destruction
+class MappedFile
+{
+public:
+    MappedFile() : data(nullptr), size(0), mtime(0) {}
+
+    explicit MappedFile(const char* path) : MappedFile() { open(path); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : data(other.data), size(other.size), mtime(other.mtime)
+    {
+        other.data = nullptr;
+        other.size = 0;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            data = other.data;
+            size = other.size;
+            mtime = other.mtime;
+            other.data = nullptr;
+            other.size = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile() { close(); }
+
+    // Maps the file at path, returns false if it can't be opened or mapped
+    bool open(const char* path)
+    {
+        close();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        mtime = static_cast<long long>(st.st_mtime);
+
+        // mmap rejects zero-length mappings, so an empty file is valid but unmapped
+        if (st.st_size == 0) {
+            ::close(fd);
+            return true;
+        }
+
+        void* ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED)
+            return false;
+
+        // The parsers walk the file front to back
+        madvise(ptr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+        data = static_cast<const char*>(ptr);
+        size = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    void close()
+    {
+        if (data != nullptr)
+            munmap(const_cast<char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+
+    bool isOpen() const { return data != nullptr; }
+
+    // Mapped contents (not null terminated)
+    const char* data;
+    size_t size;
+
+    // Modification time of the file when it was mapped
+    long long mtime;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <GL/glew.h>
+#include <iostream>
+#include <vector>
+#include "Bounds.h"
+#include "MeshLOD.h"
+#include "Profiler.h"
+#include "VertexFormat.h"
+
+// GPU-resident geometry (VAO, VBO and EBO). Meshes are shared between objects through
+// MeshCache, so an Object only needs a handle and its transform
+class Mesh
+{
+public:
+    // OpenGL attributes
+    unsigned int VAO, VBO, EBO;
+    unsigned int indexType;
+    int indexCount; // Full detail (lods[0])
+    unsigned int vertexStride;
+
+    // Layout of the VBO, and the transform from its stored positions to model space
+    // (identity unless positions are quantized)
+    VertexFormat format;
+    glm::mat4 positionTransform;
+
+    // Levels of detail as ranges of the EBO, finest first; a single full level by default
+    std::vector<MeshLOD> lods;
+
+    // Bytes held by the VBO and EBO
+    size_t gpuBytes;
+
+    // A second VAO over the same buffers plus per-instance matrices from an external
+    // buffer (see RenderQueue); created by bindInstanced()
+    mutable unsigned int instanceVAO, instanceBuffer;
+
+    // Local-space bounds, computed once at upload
+    AABB bounds;
+
+    Mesh()
+        : VAO(0), VBO(0), EBO(0), indexType(GL_UNSIGNED_INT), indexCount(0), vertexStride(0),
+          format(VertexFormat::positionsOnly()), positionTransform(1.0f), gpuBytes(0),
+          instanceVAO(0), instanceBuffer(0) {}
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // Uploads positions (3 floats per vertex) and indices, narrowing to 16-bit indices when every vertex fits
+    bool upload(const std::vector<float>& vertices, const std::vector<unsigned int>& indices)
+    {
+        if (vertices.empty() || indices.empty()) {
+            std::cerr << "Error: Vertices or indices are empty. Mesh upload failed." << std::endl;
+            return false;
+        }
+
+        VertexFormat floats = VertexFormat::positionsOnly();
+        AABB meshBounds = AABB::fromPositions(vertices.data(), vertices.size() / 3, floats.stride());
+        if (vertices.size() / 3 <= 65536) {
+            std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+            upload(vertices.data(), vertices.size() * sizeof(float), floats, meshBounds,
+                   shortIndices.data(), shortIndices.size(), GL_UNSIGNED_SHORT);
+        } else {
+            upload(vertices.data(), vertices.size() * sizeof(float), floats, meshBounds,
+                   indices.data(), indices.size(), GL_UNSIGNED_INT);
+        }
+        return true;
+    }
+
+    // Creates the VAO, VBO and EBO from raw buffers of vertices in vertexFormat. The data
+    // is only read during the call (it may point into a mapped file). Quantized positions
+    // are relative to meshBounds
+    void upload(const void* vertexData, size_t vertexBytes, const VertexFormat& vertexFormat, const AABB& meshBounds,
+                const void* indexData, size_t count, unsigned int type)
+    {
+        createBuffers(vertexData, vertexBytes, vertexFormat, indexData, count, type, true);
+        setBounds(meshBounds);
+        Profiler::instance().counters.uploadBytes += gpuBytes;
+    }
+
+    // Creates the VAO and buffer names without storage, for filling in pieces later (see
+    // AssetStreamer). The caller creates the VBO and EBO storage with glBufferData and must
+    // write every byte before the mesh is drawn
+    void allocate(size_t vertexBytes, const VertexFormat& vertexFormat, size_t count, unsigned int type,
+                  const AABB& meshBounds)
+    {
+        createBuffers(nullptr, vertexBytes, vertexFormat, nullptr, count, type, false);
+        setBounds(meshBounds);
+    }
+
+    // Replaces the single full level with levels stored in the EBO (see MeshFile)
+    void setLODs(const std::vector<MeshLOD>& levels)
+    {
+        if (levels.empty())
+            return;
+        lods = levels;
+        indexCount = static_cast<int>(lods[0].count);
+    }
+
+    // Draw the mesh at a level of detail (clamped to the available levels)
+    void draw(int lod = 0) const
+    {
+        if (VAO != 0) {
+            const MeshLOD& level = lods[std::min<size_t>(std::max(lod, 0), lods.size() - 1)];
+            size_t indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int);
+            glBindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(level.count), indexType, (void*)(level.first * indexSize));
+            glBindVertexArray(0);
+
+            FrameCounters& counters = Profiler::instance().counters;
+            counters.stateChanges++;
+            counters.drawCalls++;
+            counters.triangles += level.count / 3;
+            counters.trianglesFullDetail += indexCount / 3;
+        } else {
+            std::cerr << "Error: VAO is not initialized. Cannot draw mesh." << std::endl;
+        }
+    }
+
+    // Binds the instanced VAO, reading model matrices (attributes 3-6) from buffer. The VAO
+    // is rebuilt if it was set up for another buffer
+    void bindInstanced(unsigned int buffer) const
+    {
+        if (instanceVAO == 0 || instanceBuffer != buffer) {
+            if (instanceVAO == 0)
+                glGenVertexArrays(1, &instanceVAO);
+            instanceBuffer = buffer;
+            glBindVertexArray(instanceVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            format.setAttributes();
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            setInstanceAttributes(0);
+            return;
+        }
+        glBindVertexArray(instanceVAO);
+    }
+
+    // Destructor to clean up OpenGL resources
+    ~Mesh()
+    {
+        if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+        if (instanceVAO != 0) glDeleteVertexArrays(1, &instanceVAO);
+        if (VBO != 0) glDeleteBuffers(1, &VBO);
+        if (EBO != 0) glDeleteBuffers(1, &EBO);
+    }
+
+private:
+    void setBounds(const AABB& meshBounds)
+    {
+        bounds = meshBounds;
+        positionTransform = format.positionTransform(bounds);
+    }
+
+    void createBuffers(const void* vertexData, size_t vertexBytes, const VertexFormat& vertexFormat,
+                       const void* indexData, size_t count, unsigned int type, bool storage)
+    {
+        // Generate VAO, VBO, and EBO
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        // Bind VAO
+        glBindVertexArray(VAO);
+
+        // Bind VBO and buffer data
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (storage)
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+
+        // Bind EBO and buffer data
+        size_t indexSize = (type == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (storage)
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * indexSize, indexData, GL_STATIC_DRAW);
+
+        indexCount = static_cast<int>(count);
+        lods.assign(1, MeshLOD{ 0, static_cast<uint32_t>(count), 0.0f });
+        indexType = type;
+        format = vertexFormat;
+        vertexStride = format.stride();
+        gpuBytes = vertexBytes + count * indexSize;
+
+        // Set vertex attribute pointers
+        format.setAttributes();
+
+        // Unbind VAO
+        glBindVertexArray(0);
+    }
+};
+
+#endif
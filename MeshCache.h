@@ -0,0 +1,167 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include "Mesh.h"
+#include "MeshFile.h"
+
+using MeshHandle = std::shared_ptr<Mesh>;
+
+// Reference-counted cache of GPU meshes keyed by identity ("proc:<kind>" for procedural
+// meshes, "file:<path>#<source hash>" for files). Identical meshes are uploaded once and
+// freed when the last handle goes away
+class MeshCache
+{
+public:
+    // Counters
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t residentBytes = 0;
+    size_t residentMeshes = 0;
+
+    // The process-wide cache
+    static MeshCache& instance()
+    {
+        static MeshCache cache;
+        return cache;
+    }
+
+    // Returns the cached mesh for key, or builds one with build (returns false on failure)
+    MeshHandle get(const std::string& key, const std::function<bool(Mesh&)>& build)
+    {
+        if (MeshHandle mesh = find(key)) {
+            hits++;
+            return mesh;
+        }
+
+        misses++;
+        std::unique_ptr<Mesh> mesh(new Mesh());
+        if (!build(*mesh))
+            return nullptr;
+        return insert(key, std::move(mesh));
+    }
+
+    // Procedural mesh from position/index arrays, cached under "proc:<kind>"
+    MeshHandle procedural(const std::string& kind, const std::vector<float>& vertices, const std::vector<unsigned int>& indices)
+    {
+        return get("proc:" + kind, [&](Mesh& mesh) { return mesh.upload(vertices, indices); });
+    }
+
+    // OBJ file through its binary mesh cache (see MeshFile::loadCached). A mesh already
+    // resident for path is returned without opening the cache when the source's size and
+    // mtime still match the ones it was built from. To load without stalling the frame,
+    // use AssetStreamer, which hands its meshes to this cache
+    MeshHandle loadOBJ(const char* path)
+    {
+        if (MeshHandle mesh = findOBJ(path))
+            return mesh;
+        MeshFile file;
+        if (!file.loadCached(path)) {
+            std::cerr << "Failed to load OBJ file: " << path << std::endl;
+            return nullptr;
+        }
+        return uploadFile(path, file);
+    }
+
+    // The resident mesh of an OBJ file whose source is unchanged since its upload, or null
+    MeshHandle findOBJ(const char* path)
+    {
+        auto source = sources.find(path);
+        struct stat st;
+        if (source == sources.end() || stat(path, &st) != 0)
+            return nullptr;
+        if (uint64_t(st.st_size) != source->second.size || int64_t(st.st_mtime) != source->second.mtime)
+            return nullptr;
+        MeshHandle mesh = find(fileKey(path, source->second.hash));
+        hits += mesh != nullptr;
+        return mesh;
+    }
+
+    // The resident mesh built from the same source as file (loaded from path), or null
+    MeshHandle findFile(const char* path, const MeshFile& file)
+    {
+        MeshHandle mesh = find(fileKey(path, file.header().sourceHash));
+        hits += mesh != nullptr;
+        return mesh;
+    }
+
+    // Registers a mesh uploaded from file by other code (see AssetStreamer). If the same
+    // source became resident in the meantime, that mesh is returned and this one freed
+    MeshHandle addFile(const char* path, const MeshFile& file, std::unique_ptr<Mesh> mesh)
+    {
+        if (MeshHandle resident = findFile(path, file))
+            return resident;
+        misses++;
+        stampSource(path, file);
+        return insert(fileKey(path, file.header().sourceHash), std::move(mesh));
+    }
+
+private:
+    // Source of the last upload of each OBJ path
+    struct SourceStamp
+    {
+        uint64_t size;
+        int64_t mtime;
+        uint64_t hash;
+    };
+
+    std::unordered_map<std::string, std::weak_ptr<Mesh>> meshes;
+    std::unordered_map<std::string, SourceStamp> sources;
+
+    static std::string fileKey(const char* path, uint64_t sourceHash)
+    {
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)sourceHash);
+        return std::string("file:") + path + "#" + hash;
+    }
+
+    MeshHandle find(const std::string& key) const
+    {
+        auto it = meshes.find(key);
+        return it != meshes.end() ? it->second.lock() : nullptr;
+    }
+
+    MeshHandle insert(const std::string& key, std::unique_ptr<Mesh> mesh)
+    {
+        size_t bytes = mesh->gpuBytes;
+        residentBytes += bytes;
+        residentMeshes++;
+
+        // The deleter drops the entry (unless it was already replaced) and the byte count
+        MeshHandle handle(mesh.release(), [this, key, bytes](Mesh* m) {
+            residentBytes -= bytes;
+            residentMeshes--;
+            auto entry = meshes.find(key);
+            if (entry != meshes.end() && entry->second.expired())
+                meshes.erase(entry);
+            delete m;
+        });
+        meshes[key] = handle;
+        return handle;
+    }
+
+    void stampSource(const char* path, const MeshFile& file)
+    {
+        const MeshFileHeader& source = file.header();
+        sources[path] = SourceStamp{ source.sourceSize, source.sourceMtime, source.sourceHash };
+    }
+
+    MeshHandle uploadFile(const char* path, const MeshFile& file)
+    {
+        stampSource(path, file);
+        return get(fileKey(path, file.header().sourceHash), [&](Mesh& mesh) {
+            const MeshFileHeader& header = file.header();
+            mesh.upload(file.vertexData(), file.vertexBytes(), header.format, file.bounds(),
+                        file.indexData(), header.indexCount, header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+            mesh.setLODs(file.lods());
+            return true;
+        });
+    }
+};
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MappedFile.h"
+#include "MeshLOD.h"
+#include "MeshOptimizer.h"
+#include "OBJImporter.h"
+#include "VertexFormat.h"
+
+// Header of a binary mesh file. Blobs follow at the given offsets:
+// interleaved vertices (in format, quantized against the bounds) then indices (indexSize
+// bytes each). The index blob holds every level of detail back to back; lods[0] is the
+// full mesh
+struct MeshFileHeader {
+    static constexpr uint32_t MAX_LODS = 5;
+
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t vertexStride;
+    uint32_t indexSize;
+    VertexFormat format;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+
+    // Source file the mesh was built from, used to detect stale caches
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+
+    uint32_t lodCount;
+    MeshLOD lods[MAX_LODS];
+};
+
+// What MeshFile::build did to a mesh, for tools to report
+struct MeshBuildStats {
+    size_t corners = 0;       // Face corners before welding
+    size_t vertices = 0;      // After welding
+    size_t indexBits = 0;
+    long long savedBytes = 0; // Indexed against unindexed buffers
+    uint32_t lodCount = 0;
+    uint32_t lodTriangles[MeshFileHeader::MAX_LODS] = {};
+    float maxError = 0.0f;    // Of the coarsest level
+    VertexCacheStats before = {}, after = {}; // Full detail, before and after optimizing
+};
+
+// A compact binary mesh (welded OBJ data), either memory-mapped or built in memory.
+// Mapped files are read in place so the blobs can go straight to glBufferData
+class MeshFile
+{
+public:
+    static constexpr uint32_t VERSION = 3;
+
+    // Cache location for a source file
+    static std::string cachePath(const char* sourcePath) { return std::string(sourcePath) + ".mesh"; }
+
+    // 64-bit FNV-1a
+    static uint64_t hashBytes(const void* data, size_t size)
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (size_t i = 0; i < size; i++) {
+            h ^= p[i];
+            h *= 0x100000001B3ull;
+        }
+        return h;
+    }
+
+    // Maps an existing mesh file and validates its header and blob ranges
+    bool open(const char* path)
+    {
+        owned.clear();
+        if (!file.open(path))
+            return false;
+        data = file.data;
+        size = file.size;
+        if (!validate()) {
+            close();
+            return false;
+        }
+        mappedPath = path;
+        return true;
+    }
+
+    // Parses and welds an OBJ file into an in-memory mesh file, with its levels of detail
+    // and vertices encoded in format. Fills stats if given
+    bool build(const char* objPath, const VertexFormat& format = VertexFormat::compact(), MeshBuildStats* stats = nullptr)
+    {
+        close();
+
+        MappedFile source;
+        if (!source.open(objPath)) {
+            std::cerr << "Failed to open OBJ file: " << objPath << std::endl;
+            return false;
+        }
+        ScratchScope scratch;
+        OBJData parsed(scratch.resource());
+        if (!OBJImporter::parseOBJ(source.data, source.size, parsed)) {
+            std::cerr << "File can't be read by this parser: " << objPath << std::endl;
+            return false;
+        }
+        OBJMesh mesh;
+        OBJImporter::weld(parsed, mesh);
+        if (mesh.positions.empty()) {
+            std::cerr << "OBJ file has no faces: " << objPath << std::endl;
+            return false;
+        }
+        MeshBuildStats built;
+        built.corners = mesh.cornerCount;
+        built.vertices = mesh.positions.size();
+        built.indexBits = mesh.indexSize() * 8;
+        built.savedBytes = (long long)mesh.unindexedBytes(format.stride()) - (long long)mesh.indexedBytes(format.stride());
+
+        std::vector<uint32_t> indices;
+        std::vector<MeshLOD> lods = MeshSimplifier::build(mesh.positions.data(), mesh.normals.data(), mesh.uvs.data(),
+                                                          mesh.positions.size(), mesh.indices, indices,
+                                                          MeshFileHeader::MAX_LODS);
+        built.lodCount = static_cast<uint32_t>(lods.size());
+        for (size_t i = 0; i < lods.size(); i++)
+            built.lodTriangles[i] = lods[i].count / 3;
+        built.maxError = lods.back().error;
+
+        // Index order for the post-transform cache and overdraw per level, then the
+        // vertices in order of first use
+        size_t vertexCount = mesh.positions.size();
+        built.before = MeshOptimizer::analyzeVertexCache(indices.data(), lods[0].count, vertexCount);
+        for (const MeshLOD& lod : lods) {
+            MeshOptimizer::optimizeVertexCache(&indices[lod.first], lod.count, vertexCount);
+            MeshOptimizer::optimizeOverdraw(&indices[lod.first], lod.count, mesh.positions.data(), vertexCount);
+        }
+        std::vector<uint32_t> remap = MeshOptimizer::optimizeVertexFetch(indices.data(), indices.size(), vertexCount);
+        MeshOptimizer::remapVertices(mesh.positions, remap);
+        MeshOptimizer::remapVertices(mesh.normals, remap);
+        MeshOptimizer::remapVertices(mesh.uvs, remap);
+        built.after = MeshOptimizer::analyzeVertexCache(indices.data(), lods[0].count, vertexCount);
+        if (stats != nullptr)
+            *stats = built;
+
+        MeshFileHeader header = {};
+        memcpy(header.magic, "OGLM", 4);
+        header.version = VERSION;
+        header.vertexCount = static_cast<uint32_t>(mesh.positions.size());
+        header.indexCount = static_cast<uint32_t>(indices.size());
+        header.vertexStride = format.stride();
+        header.format = format;
+        header.indexSize = static_cast<uint32_t>(mesh.indexSize());
+        header.vertexOffset = sizeof(MeshFileHeader);
+        header.indexOffset = header.vertexOffset + uint64_t(header.vertexCount) * header.vertexStride;
+        header.sourceSize = source.size;
+        header.sourceMtime = source.mtime;
+        header.sourceHash = hashBytes(source.data, source.size);
+        header.lodCount = static_cast<uint32_t>(lods.size());
+        std::copy(lods.begin(), lods.end(), header.lods);
+
+        AABB bounds;
+        for (const glm::vec3& p : mesh.positions)
+            bounds.expand(p);
+        for (int i = 0; i < 3; i++) {
+            header.boundsMin[i] = bounds.min[i];
+            header.boundsMax[i] = bounds.max[i];
+        }
+
+        owned.resize(header.indexOffset + uint64_t(header.indexCount) * header.indexSize);
+        memcpy(owned.data(), &header, sizeof(header));
+
+        format.encode(mesh.positions.data(), mesh.normals.data(), mesh.uvs.data(), mesh.positions.size(), bounds,
+                      owned.data() + header.vertexOffset);
+
+        char* indexBlob = owned.data() + header.indexOffset;
+        if (header.indexSize == sizeof(uint16_t)) {
+            for (size_t i = 0; i < indices.size(); i++) {
+                uint16_t index = static_cast<uint16_t>(indices[i]);
+                memcpy(indexBlob + i * sizeof(uint16_t), &index, sizeof(index));
+            }
+        } else {
+            memcpy(indexBlob, indices.data(), indices.size() * sizeof(uint32_t));
+        }
+
+        data = owned.data();
+        size = owned.size();
+        return true;
+    }
+
+    // Writes the current contents to path (through a temporary file, so readers never see a
+    // partial mesh). Temporary names are unique per save, so concurrent writers of one path
+    // (threads or processes) each rename a whole file
+    bool save(const char* path) const
+    {
+        if (data == nullptr)
+            return false;
+
+        static std::atomic<unsigned> saves{ 0 };
+        std::string tmpPath = std::string(path) + "." + std::to_string(getpid()) + "." + std::to_string(saves++) + ".tmp";
+        FILE* out = fopen(tmpPath.c_str(), "wb");
+        if (out == nullptr)
+            return false;
+        bool ok = fwrite(data, 1, size, out) == size;
+        ok = (fclose(out) == 0) && ok;
+        if (!ok || rename(tmpPath.c_str(), path) != 0) {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Builds a mesh file from an OBJ file and writes it to meshPath
+    static bool bake(const char* objPath, const char* meshPath, MeshBuildStats* stats = nullptr)
+    {
+        MeshFile mesh;
+        return mesh.build(objPath, VertexFormat::compact(), stats) && mesh.save(meshPath);
+    }
+
+    // Whether this mesh still matches its source. An unchanged size and mtime is trusted;
+    // otherwise the source is hashed, so a touched but identical file stays valid. A mapped
+    // file then gets the new mtime written into it, so later loads don't hash again
+    bool isCurrent(const char* sourcePath) const
+    {
+        MappedFile source;
+        if (data == nullptr || !source.open(sourcePath))
+            return false;
+        const MeshFileHeader& h = header();
+        if (h.sourceSize != source.size)
+            return false;
+        if (h.sourceMtime == source.mtime)
+            return true;
+        if (h.sourceHash != hashBytes(source.data, source.size))
+            return false;
+        if (file.isOpen())
+            stampSourceMtime(mappedPath.c_str(), source.mtime);
+        return true;
+    }
+
+    // Loads the cache for sourcePath, rebuilding (and rewriting) it when missing, stale or
+    // in another vertex format. If the cache can't be written the freshly built mesh is
+    // used from memory
+    bool loadCached(const char* sourcePath, const VertexFormat& format = VertexFormat::compact())
+    {
+        std::string path = cachePath(sourcePath);
+        if (open(path.c_str()) && isCurrent(sourcePath) && header().format == format)
+            return true;
+
+        if (!build(sourcePath, format))
+            return false;
+        if (!save(path.c_str())) {
+            std::cerr << "Warning: could not write mesh cache " << path << std::endl;
+            return true;
+        }
+
+        // Re-map the written file so the built copy can be released
+        MeshFile mapped;
+        if (mapped.open(path.c_str()))
+            *this = std::move(mapped);
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        mappedPath.clear();
+        owned.clear();
+        owned.shrink_to_fit();
+        data = nullptr;
+        size = 0;
+    }
+
+    bool isOpen() const { return data != nullptr; }
+    const MeshFileHeader& header() const { return *reinterpret_cast<const MeshFileHeader*>(data); }
+    const void* vertexData() const { return data + header().vertexOffset; }
+    const void* indexData() const { return data + header().indexOffset; }
+    size_t vertexBytes() const { return size_t(header().vertexCount) * header().vertexStride; }
+    size_t indexBytes() const { return size_t(header().indexCount) * header().indexSize; }
+    AABB bounds() const
+    {
+        const MeshFileHeader& h = header();
+        return AABB(glm::vec3(h.boundsMin[0], h.boundsMin[1], h.boundsMin[2]), glm::vec3(h.boundsMax[0], h.boundsMax[1], h.boundsMax[2]));
+    }
+    std::vector<MeshLOD> lods() const { return std::vector<MeshLOD>(header().lods, header().lods + header().lodCount); }
+
+private:
+    // Rewrites the sourceMtime field of the mesh file at path in place. Best effort: a
+    // cache that can't be written is only hashed again next time
+    static void stampSourceMtime(const char* path, int64_t mtime)
+    {
+        int fd = ::open(path, O_WRONLY);
+        if (fd < 0)
+            return;
+        if (pwrite(fd, &mtime, sizeof(mtime), offsetof(MeshFileHeader, sourceMtime)) != sizeof(mtime))
+            std::cerr << "Warning: could not update mesh cache " << path << std::endl;
+        ::close(fd);
+    }
+
+    bool validate() const
+    {
+        if (size < sizeof(MeshFileHeader))
+            return false;
+        const MeshFileHeader& h = header();
+        if (memcmp(h.magic, "OGLM", 4) != 0 || h.version != VERSION)
+            return false;
+        if (!h.format.valid() || h.vertexStride != h.format.stride() || (h.indexSize != 2 && h.indexSize != 4))
+            return false;
+        if (h.vertexOffset < sizeof(MeshFileHeader) || h.vertexOffset % 4 != 0 || h.indexOffset % 2 != 0)
+            return false;
+        if (h.lodCount == 0 || h.lodCount > MeshFileHeader::MAX_LODS)
+            return false;
+        for (uint32_t i = 0; i < h.lodCount; i++)
+            if (uint64_t(h.lods[i].first) + h.lods[i].count > h.indexCount || h.lods[i].count % 3 != 0)
+                return false;
+        return h.vertexOffset + uint64_t(h.vertexCount) * h.vertexStride <= size
+            && h.indexOffset + uint64_t(h.indexCount) * h.indexSize <= size;
+    }
+
+    MappedFile file;
+    std::string mappedPath; // Path of file, while mapped
+    std::vector<char> owned;
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+#endif
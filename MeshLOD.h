@@ -0,0 +1,508 @@
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// One level of detail: a range of a mesh's shared index buffer and how far it may stray
+// from the full mesh
+struct MeshLOD
+{
+    uint32_t first; // First index
+    uint32_t count; // Index count
+    float error;    // Geometric error bound, in model units
+};
+
+// Symmetric 4x4 error quadric (Garland & Heckbert): the sum of squared distances to a set
+// of planes, stored as its 10 distinct coefficients
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    // Plane n . p + d = 0 with unit normal n
+    static Quadric plane(glm::dvec3 n, double d, double weight = 1.0)
+    {
+        Quadric q;
+        q.a2 = n.x * n.x * weight; q.ab = n.x * n.y * weight; q.ac = n.x * n.z * weight; q.ad = n.x * d * weight;
+        q.b2 = n.y * n.y * weight; q.bc = n.y * n.z * weight; q.bd = n.y * d * weight;
+        q.c2 = n.z * n.z * weight; q.cd = n.z * d * weight;
+        q.d2 = d * d * weight;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& o)
+    {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2;
+        bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+        return *this;
+    }
+
+    double evaluate(glm::dvec3 p) const
+    {
+        double e = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+                 + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+                 + c2 * p.z * p.z + 2 * cd * p.z + d2;
+        return std::max(e, 0.0);
+    }
+};
+
+// Quadric error metric simplification by half-edge collapse: a vertex is merged into a
+// neighbour, which keeps its position. No vertex is moved or created, so every level
+// indexes the original vertex buffer and all levels can share one index buffer.
+// Topology is tracked per position, so vertices split on uv or normal seams collapse
+// together: each is redirected to the vertex of the target that shares its triangles on
+// the edge, or else to the one with the closest attributes, and that mismatch is added to
+// the collapse cost so seams go late. Open borders are held in place by perpendicular
+// constraint planes. Collapses that would flip a triangle or pinch the surface (link
+// condition) are rejected
+class MeshSimplifier
+{
+public:
+    // normals and uvs may be null
+    MeshSimplifier(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* uvs, size_t vertexCount,
+                   const std::vector<uint32_t>& indices)
+        : triangles(indices), removed(indices.size() / 3, 0), aliveTriangles(indices.size() / 3), maxError(0.0f),
+          normals(normals), uvs(uvs)
+    {
+        // Positions shared by several vertices are one topological vertex
+        positionOf.resize(vertexCount);
+        std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+        for (size_t v = 0; v < vertexCount; v++) {
+            uint32_t bits[3];
+            memcpy(bits, &positions[v].x, sizeof(bits));
+            uint64_t key = (uint64_t(bits[0]) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(bits[1]) * 0xC2B2AE3D27D4EB4Full) ^ bits[2];
+            std::vector<uint32_t>& bucket = buckets[key];
+            uint32_t id = UINT32_MAX;
+            for (uint32_t candidate : bucket)
+                if (points[candidate] == glm::dvec3(positions[v]))
+                    id = candidate;
+            if (id == UINT32_MAX) {
+                id = static_cast<uint32_t>(points.size());
+                points.push_back(glm::dvec3(positions[v]));
+                vertices.emplace_back();
+                bucket.push_back(id);
+            }
+            positionOf[v] = id;
+            vertices[id].push_back(static_cast<uint32_t>(v));
+        }
+
+        // Attribute mismatches are charged as if they were this far off the surface
+        glm::dvec3 lo = points.empty() ? glm::dvec3(0.0) : points[0], hi = lo;
+        for (const glm::dvec3& p : points) {
+            lo = glm::dvec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = glm::dvec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
+        double extent = glm::length(hi - lo) * ATTRIBUTE_WEIGHT;
+        attributeScale = extent * extent;
+
+        // Face planes, and a count of each position edge's faces to find open borders
+        quadrics.resize(points.size());
+        around.resize(points.size());
+        version.assign(points.size(), 0);
+        dead.assign(points.size(), 0);
+        std::unordered_map<uint64_t, int> edgeFaces;
+        for (size_t t = 0; t < removed.size(); t++) {
+            uint32_t p[3];
+            corners(t, p);
+            if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0]) {
+                removed[t] = 1; // Degenerate in the input
+                aliveTriangles--;
+                continue;
+            }
+            glm::dvec3 n = glm::cross(points[p[1]] - points[p[0]], points[p[2]] - points[p[0]]);
+            double length = glm::length(n);
+            if (length > 0.0) {
+                n /= length;
+                Quadric q = Quadric::plane(n, -glm::dot(n, points[p[0]]));
+                for (int i = 0; i < 3; i++)
+                    quadrics[p[i]] += q;
+            }
+            for (int i = 0; i < 3; i++) {
+                around[p[i]].push_back(static_cast<uint32_t>(t));
+                edgeFaces[edgeKey(p[i], p[(i + 1) % 3])]++;
+            }
+        }
+
+        // Borders: a plane through the edge, perpendicular to its face, heavily weighted
+        for (size_t t = 0; t < removed.size(); t++) {
+            if (removed[t])
+                continue;
+            uint32_t p[3];
+            corners(t, p);
+            glm::dvec3 faceNormal = glm::cross(points[p[1]] - points[p[0]], points[p[2]] - points[p[0]]);
+            for (int i = 0; i < 3; i++) {
+                uint32_t a = p[i], b = p[(i + 1) % 3];
+                if (edgeFaces[edgeKey(a, b)] != 1)
+                    continue;
+                glm::dvec3 n = glm::cross(points[b] - points[a], faceNormal);
+                double length = glm::length(n);
+                if (length == 0.0)
+                    continue;
+                n /= length;
+                Quadric q = Quadric::plane(n, -glm::dot(n, points[a]), BORDER_WEIGHT);
+                quadrics[a] += q;
+                quadrics[b] += q;
+            }
+        }
+
+        for (uint32_t p = 0; p < points.size(); p++)
+            pushBest(p);
+    }
+
+    // Collapses edges until at most targetTriangles remain, no collapse is possible, or
+    // the next one would exceed errorLimit. May be called again with a lower target
+    void simplify(size_t targetTriangles, float errorLimit = INFINITY)
+    {
+        while (aliveTriangles > targetTriangles && !queue.empty()) {
+            Candidate c = queue.top();
+            queue.pop();
+            if (dead[c.from] || c.version != version[c.from])
+                continue;
+            if (std::sqrt(c.error) > errorLimit)
+                break;
+
+            double error, penalty;
+            if (!canCollapse(c.from, c.to, remap, error, penalty)) {
+                version[c.from]++;
+                pushBest(c.from);
+                continue;
+            }
+            collapse(c.from, c.to);
+            maxError = std::max(maxError, static_cast<float>(std::sqrt(error)));
+        }
+    }
+
+    size_t triangleCount() const { return aliveTriangles; }
+
+    // Largest collapse error so far
+    float error() const { return maxError; }
+
+    // The remaining triangles
+    void appendIndices(std::vector<uint32_t>& out) const
+    {
+        for (size_t t = 0; t < removed.size(); t++)
+            if (!removed[t])
+                out.insert(out.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+    }
+
+    // Builds up to maxLevels levels into one index buffer: level 0 is the input, each
+    // further level has about ratio times the triangles of the one before. Stops early
+    // once simplification stalls
+    static std::vector<MeshLOD> build(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* uvs,
+                                      size_t vertexCount, const std::vector<uint32_t>& indices,
+                                      std::vector<uint32_t>& outIndices, int maxLevels = 4, float ratio = 0.5f)
+    {
+        outIndices = indices;
+        std::vector<MeshLOD> lods;
+        lods.push_back(MeshLOD{ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+
+        MeshSimplifier simplifier(positions, normals, uvs, vertexCount, indices);
+        size_t previous = indices.size() / 3;
+        for (int level = 1; level < maxLevels; level++) {
+            size_t target = static_cast<size_t>(previous * ratio);
+            if (target < MIN_TRIANGLES)
+                break;
+            simplifier.simplify(target);
+            size_t count = simplifier.triangleCount();
+            if (count > previous * (1.0f + ratio) * 0.5f) // Less than half the asked reduction
+                break;
+            uint32_t first = static_cast<uint32_t>(outIndices.size());
+            simplifier.appendIndices(outIndices);
+            lods.push_back(MeshLOD{ first, static_cast<uint32_t>(count * 3), simplifier.error() });
+            previous = count;
+        }
+        return lods;
+    }
+
+private:
+    static constexpr double BORDER_WEIGHT = 10.0;
+    static constexpr double ATTRIBUTE_WEIGHT = 0.05; // Of the bounding box diagonal, per unit of attribute distance
+    static const size_t MIN_TRIANGLES = 16;
+
+    struct Candidate
+    {
+        double cost;  // Geometric error plus attribute penalty, for ordering
+        double error; // Squared geometric error
+        uint32_t from, to;
+        uint32_t version;
+
+        bool operator<(const Candidate& other) const { return cost > other.cost; } // Min-heap
+    };
+
+    std::vector<uint32_t> triangles;     // Vertex indices, rewritten as vertices collapse
+    std::vector<uint8_t> removed;
+    size_t aliveTriangles;
+    float maxError;
+
+    std::vector<uint32_t> positionOf;   // Vertex -> position
+    std::vector<glm::dvec3> points;     // Per position
+    std::vector<std::vector<uint32_t>> vertices; // Per position (several on seams)
+    const glm::vec3* normals;
+    const glm::vec2* uvs;
+    double attributeScale;
+    std::vector<Quadric> quadrics;
+    std::vector<std::vector<uint32_t>> around; // Triangles touching each position (may hold removed ones)
+    std::vector<uint32_t> version;
+    std::vector<uint8_t> dead;
+    std::priority_queue<Candidate> queue;
+    std::vector<std::pair<uint32_t, uint32_t>> remap; // Vertex of from -> vertex of to, for the collapse at hand
+    std::vector<std::pair<uint32_t, uint32_t>> scratch;
+    std::vector<uint32_t> scratchNeighbours;
+    mutable std::vector<uint32_t> linkFrom, linkTo;
+
+    static uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    void corners(size_t t, uint32_t p[3]) const
+    {
+        for (int i = 0; i < 3; i++)
+            p[i] = positionOf[triangles[t * 3 + i]];
+    }
+
+    double attributeDistance(uint32_t a, uint32_t b) const
+    {
+        double d = 0.0;
+        if (normals != nullptr) {
+            glm::vec3 n = normals[a] - normals[b];
+            d += glm::dot(n, n);
+        }
+        if (uvs != nullptr) {
+            glm::vec2 uv = uvs[a] - uvs[b];
+            d += glm::dot(uv, uv);
+        }
+        return d;
+    }
+
+    // Vertex of to that v is redirected to
+    uint32_t& redirect(std::vector<std::pair<uint32_t, uint32_t>>& map, uint32_t v) const
+    {
+        for (auto& entry : map)
+            if (entry.first == v)
+                return entry.second;
+        map.emplace_back(v, UINT32_MAX);
+        return map.back().second;
+    }
+
+    // Whether from can merge into to. Fills map with where each of from's vertices goes,
+    // error with the squared geometric error and penalty with the attribute mismatch
+    bool canCollapse(uint32_t from, uint32_t to, std::vector<std::pair<uint32_t, uint32_t>>& map, double& error,
+                     double& penalty) const
+    {
+        if (dead[from] || dead[to])
+            return false;
+
+        // Vertices on the edge's triangles follow those triangles; a vertex whose edge
+        // triangles disagree on the target would tear the seam
+        map.clear();
+        int shared = 0;
+        for (uint32_t t : around[from]) {
+            if (removed[t])
+                continue;
+            uint32_t v = UINT32_MAX, w = UINT32_MAX;
+            for (int i = 0; i < 3; i++) {
+                uint32_t vertex = triangles[t * 3 + i];
+                if (positionOf[vertex] == from)
+                    v = vertex;
+                else if (positionOf[vertex] == to)
+                    w = vertex;
+            }
+            if (w == UINT32_MAX)
+                continue;
+            uint32_t& mapped = redirect(map, v);
+            if (mapped != UINT32_MAX && mapped != w)
+                return false;
+            mapped = w;
+            shared++;
+        }
+        if (shared == 0)
+            return false;
+
+        // The rest take to's closest vertex
+        penalty = 0.0;
+        for (uint32_t t : around[from]) {
+            if (removed[t])
+                continue;
+            for (int i = 0; i < 3; i++) {
+                uint32_t v = triangles[t * 3 + i];
+                if (positionOf[v] != from)
+                    continue;
+                uint32_t& mapped = redirect(map, v);
+                if (mapped != UINT32_MAX)
+                    continue;
+                double best = INFINITY;
+                for (uint32_t w : vertices[to]) {
+                    double d = attributeDistance(v, w);
+                    if (d < best) {
+                        best = d;
+                        mapped = w;
+                    }
+                }
+                penalty += best * attributeScale;
+            }
+        }
+
+        // Link condition: the two may only have the edge's opposite corners as common
+        // neighbours, or the collapse would pinch the surface
+        neighbourSet(from, linkFrom);
+        neighbourSet(to, linkTo);
+        int common = 0;
+        for (size_t i = 0, j = 0; i < linkFrom.size() && j < linkTo.size();) {
+            if (linkFrom[i] < linkTo[j])
+                i++;
+            else if (linkTo[j] < linkFrom[i])
+                j++;
+            else {
+                common++;
+                i++;
+                j++;
+            }
+        }
+        if (common > shared)
+            return false;
+
+        Quadric q = quadrics[from];
+        q += quadrics[to];
+        error = q.evaluate(points[to]);
+
+        // No triangle that survives may flip or collapse to a sliver
+        for (uint32_t t : around[from]) {
+            if (removed[t])
+                continue;
+            uint32_t p[3];
+            corners(t, p);
+            if (p[0] == to || p[1] == to || p[2] == to)
+                continue;
+            glm::dvec3 before = glm::cross(points[p[1]] - points[p[0]], points[p[2]] - points[p[0]]);
+            for (int i = 0; i < 3; i++)
+                if (p[i] == from)
+                    p[i] = to;
+            glm::dvec3 after = glm::cross(points[p[1]] - points[p[0]], points[p[2]] - points[p[0]]);
+            double lengths = glm::length(before) * glm::length(after);
+            if (lengths == 0.0 || glm::dot(before, after) < 0.2 * lengths)
+                return false;
+        }
+        return true;
+    }
+
+    // Sorted positions sharing a live triangle with p
+    void neighbourSet(uint32_t p, std::vector<uint32_t>& out) const
+    {
+        out.clear();
+        for (uint32_t t : around[p]) {
+            if (removed[t])
+                continue;
+            uint32_t c[3];
+            corners(t, c);
+            for (int i = 0; i < 3; i++)
+                if (c[i] != p)
+                    out.push_back(c[i]);
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    // Applies the collapse canCollapse() just mapped out
+    void collapse(uint32_t from, uint32_t to)
+    {
+        for (uint32_t t : around[from]) {
+            if (removed[t])
+                continue;
+            uint32_t p[3];
+            corners(t, p);
+            if (p[0] == to || p[1] == to || p[2] == to) {
+                removed[t] = 1;
+                aliveTriangles--;
+                continue;
+            }
+            for (int i = 0; i < 3; i++)
+                if (p[i] == from)
+                    triangles[t * 3 + i] = redirect(remap, triangles[t * 3 + i]);
+            around[to].push_back(t);
+        }
+        around[from].clear();
+        quadrics[to] += quadrics[from];
+        dead[from] = 1;
+
+        // Drop removed triangles from to's list, then refresh to and its neighbours, whose
+        // best collapse may have involved from or depends on to's quadric
+        std::vector<uint32_t>& list = around[to];
+        list.erase(std::remove_if(list.begin(), list.end(), [this](uint32_t t) { return removed[t] != 0; }), list.end());
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+
+        std::vector<uint32_t> touched(1, to);
+        for (uint32_t t : list) {
+            uint32_t p[3];
+            corners(t, p);
+            touched.insert(touched.end(), p, p + 3);
+        }
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        for (uint32_t p : touched) {
+            version[p]++;
+            pushBest(p);
+        }
+    }
+
+    // Queues the cheapest valid collapse of p into one of its neighbours
+    void pushBest(uint32_t p)
+    {
+        if (dead[p])
+            return;
+        Candidate best{ INFINITY, INFINITY, p, 0, version[p] };
+
+        // The quadric error alone is a lower bound on the cost, so the full check only
+        // runs on neighbours that could still win, cheapest first
+        std::vector<std::pair<double, uint32_t>> options;
+        neighbourSet(p, scratchNeighbours);
+        for (uint32_t n : scratchNeighbours) {
+            Quadric q = quadrics[p];
+            q += quadrics[n];
+            options.emplace_back(q.evaluate(points[n]), n);
+        }
+        std::sort(options.begin(), options.end());
+        for (const auto& option : options) {
+            if (option.first >= best.cost)
+                break;
+            double error, penalty;
+            if (canCollapse(p, option.second, scratch, error, penalty) && error + penalty < best.cost) {
+                best.cost = error + penalty;
+                best.error = error;
+                best.to = option.second;
+            }
+        }
+        if (best.cost < INFINITY)
+            queue.push(best);
+    }
+};
+
+// Picks the level of detail for an object from the on-screen size of each level's error:
+// error * scale / distance, against the screen height the vertical fov covers. Keeps the
+// current level unless its error exceeds thresholdPixels * (1 + hysteresis), and only
+// moves to a coarser level once that one is under thresholdPixels * (1 - hysteresis), so
+// an object near a boundary doesn't pop back and forth
+inline int selectLOD(const std::vector<MeshLOD>& lods, int current, float distance, float scale, float fovDegrees,
+                     float viewportHeight, float thresholdPixels = 1.0f, float hysteresis = 0.25f)
+{
+    if (lods.size() <= 1)
+        return 0;
+    float pixelsPerUnit = viewportHeight / (2.0f * std::tan(glm::radians(fovDegrees) * 0.5f) * std::max(distance, 1e-4f));
+    auto pixels = [&](int level) { return lods[level].error * scale * pixelsPerUnit; };
+
+    int level = std::min(std::max(current, 0), static_cast<int>(lods.size()) - 1);
+    while (level > 0 && pixels(level) > thresholdPixels * (1.0f + hysteresis))
+        level--;
+    while (level + 1 < static_cast<int>(lods.size()) && pixels(level + 1) <= thresholdPixels * (1.0f - hysteresis))
+        level++;
+    return level;
+}
+
+#endif
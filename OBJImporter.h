@@ -3,103 +3,515 @@
 
 #include <vector>
 #include <string>
+#include <thread>
+#include <algorithm>
 #include <glm/glm.hpp>
-#include <cstdio>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <memory_resource>
+#include "FrameArena.h"
+#include "MappedFile.h"
+
+// One face corner of an OBJ mesh, as 0-based indices (-1 when the attribute is absent)
+struct OBJIndex {
+    int v, vt, vn;
+};
+
+// Raw OBJ contents: attribute pools plus triangulated face corners (3 per triangle).
+// Usually thrown away after welding, so the arrays can live in a scratch arena
+struct OBJData {
+    std::pmr::vector<glm::vec3> positions;
+    std::pmr::vector<glm::vec2> uvs;
+    std::pmr::vector<glm::vec3> normals;
+    std::pmr::vector<OBJIndex> corners;
+
+    explicit OBJData(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : positions(memory), uvs(memory), normals(memory), corners(memory) {}
+
+    void clear()
+    {
+        positions.clear();
+        uvs.clear();
+        normals.clear();
+        corners.clear();
+    }
+};
+
+// Welded OBJ mesh: one vertex per unique (position, uv, normal) corner plus an index list
+struct OBJMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+
+    // Face corners before welding
+    size_t cornerCount = 0;
+
+    // 16-bit indices are enough to address every vertex
+    bool fitsShortIndices() const { return positions.size() <= 65536; }
+    size_t indexSize() const { return fitsShortIndices() ? sizeof(unsigned short) : sizeof(unsigned int); }
+
+    // Corners per welded vertex (how many times each vertex used to be duplicated)
+    double dedupRatio() const { return positions.empty() ? 0.0 : double(cornerCount) / positions.size(); }
+
+    // Buffer sizes for a given vertex stride, unindexed (trivial 32-bit index list) vs welded
+    size_t unindexedBytes(size_t vertexStride) const { return cornerCount * (vertexStride + sizeof(unsigned int)); }
+    size_t indexedBytes(size_t vertexStride) const { return positions.size() * vertexStride + indices.size() * indexSize(); }
+};
 
 class OBJImporter {
 public:
-    // Loads an OBJ file
+    // Loads an OBJ file and expands it into unindexed triangles. The three outputs are
+    // parallel, one entry per face corner; missing uvs or normals are zero-filled
     static bool loadOBJ(
         const char* path,
         std::vector<glm::vec3>& outVertices,
         std::vector<glm::vec2>& outUVs,
         std::vector<glm::vec3>& outNormals
     ) {
-        // Temporary storage for vertices, uvs, and normals
-        std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-        std::vector<glm::vec3> tempVertices;
-        std::vector<glm::vec2> tempUVs;
-        std::vector<glm::vec3> tempNormals;
-
-        // Open the file
-        FILE* file = fopen(path, "r");
-        if (file == nullptr) {
-            std::cerr << "Failed to open OBJ file: " << path << std::endl;
+        ScratchScope scratch;
+        OBJData data(scratch.resource());
+        if (!parseOBJ(path, data))
             return false;
+
+        outVertices.reserve(outVertices.size() + data.corners.size());
+        outUVs.reserve(outUVs.size() + data.corners.size());
+        outNormals.reserve(outNormals.size() + data.corners.size());
+        for (const OBJIndex& c : data.corners) {
+            outVertices.push_back(data.positions[c.v]);
+            outUVs.push_back(c.vt >= 0 ? data.uvs[c.vt] : glm::vec2(0.0f));
+            outNormals.push_back(c.vn >= 0 ? data.normals[c.vn] : glm::vec3(0.0f));
         }
+        return true;
+    }
 
-        // Read the file line by line
-        while (true) {
-            char lineHeader[128];
-            int res = fscanf(file, "%s", lineHeader);
-            if (res == EOF)
-                break; // End of file
+    // Loads an OBJ file and welds identical face corners into a shared, indexed vertex table
+    static bool loadIndexedOBJ(const char* path, OBJMesh& out)
+    {
+        ScratchScope scratch;
+        OBJData data(scratch.resource());
+        if (!parseOBJ(path, data))
+            return false;
+        weld(data, out);
+        return true;
+    }
 
-            // Process vertex positions (v)
-            if (strcmp(lineHeader, "v") == 0) {
-                glm::vec3 vertex;
-                fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-                tempVertices.push_back(vertex);
-            }
-            // Process texture coordinates (vt)
-            else if (strcmp(lineHeader, "vt") == 0) {
-                glm::vec2 uv;
-                fscanf(file, "%f %f\n", &uv.x, &uv.y);
-                tempUVs.push_back(uv);
+    // Hashes each (v, vt, vn) corner into a compact vertex table and emits real indices
+    static void weld(const OBJData& data, OBJMesh& out)
+    {
+        const size_t cornerCount = data.corners.size();
+        out.positions.clear();
+        out.uvs.clear();
+        out.normals.clear();
+        out.indices.clear();
+        out.cornerCount = cornerCount;
+        out.indices.reserve(cornerCount);
+
+        // Open-addressing table of vertex ids, kept at most half full, in scratch memory
+        ScratchScope scratch;
+        size_t capacity = 16;
+        while (capacity < cornerCount * 2)
+            capacity <<= 1;
+        const unsigned int empty = ~0u;
+        std::pmr::vector<unsigned int> slots(capacity, empty, scratch.resource());
+        std::pmr::vector<OBJIndex> keys(scratch.resource());
+        keys.reserve(cornerCount / 4 + 16);
+
+        for (const OBJIndex& c : data.corners) {
+            uint64_t h = static_cast<uint32_t>(c.v) * 0x9E3779B97F4A7C15ull;
+            h ^= (static_cast<uint32_t>(c.vt) + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2)) * 0xC2B2AE3D27D4EB4Full;
+            h ^= (static_cast<uint32_t>(c.vn) + 0x85EBCA77C2B2AE63ull + (h << 6) + (h >> 2)) * 0x165667B19E3779F9ull;
+            size_t slot = static_cast<size_t>(h ^ (h >> 29)) & (capacity - 1);
+
+            while (true) {
+                unsigned int id = slots[slot];
+                if (id == empty) {
+                    id = static_cast<unsigned int>(keys.size());
+                    slots[slot] = id;
+                    keys.push_back(c);
+                    out.indices.push_back(id);
+                    break;
+                }
+                const OBJIndex& k = keys[id];
+                if (k.v == c.v && k.vt == c.vt && k.vn == c.vn) {
+                    out.indices.push_back(id);
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
             }
-            // Process vertex normals (vn)
-            else if (strcmp(lineHeader, "vn") == 0) {
-                glm::vec3 normal;
-                fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-                tempNormals.push_back(normal);
+        }
+
+        // Gather the welded attributes (zero-filled where the corner had none)
+        out.positions.resize(keys.size());
+        out.uvs.resize(keys.size());
+        out.normals.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++) {
+            const OBJIndex& k = keys[i];
+            out.positions[i] = data.positions[k.v];
+            out.uvs[i] = k.vt >= 0 ? data.uvs[k.vt] : glm::vec2(0.0f);
+            out.normals[i] = k.vn >= 0 ? data.normals[k.vn] : glm::vec3(0.0f);
+        }
+    }
+
+    // Memory-maps an OBJ file and parses it (see the in-memory overload)
+    static bool parseOBJ(const char* path, OBJData& out, unsigned int threads = 0)
+    {
+        MappedFile file;
+        if (!file.open(path)) {
+            std::cerr << "Failed to open OBJ file: " << path << std::endl;
+            return false;
+        }
+        if (!parseOBJ(file.data, file.size, out, threads)) {
+            std::cerr << "File can't be read by this parser: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Parses OBJ text. The buffer is split at line boundaries into one chunk per thread
+    // (0 = hardware concurrency), the chunks are parsed in parallel, then merged in order.
+    // Supports v, v/vt, v//vn and v/vt/vn corners, negative indices and polygons (fanned).
+    // Malformed numbers, short faces and indices out of range fail the parse, with the
+    // line reported on std::cerr
+    static bool parseOBJ(const char* text, size_t size, OBJData& out, unsigned int threads = 0)
+    {
+        out.clear();
+
+        // Small files aren't worth the thread start-up cost
+        const size_t minChunkBytes = 1 << 20;
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned int>(std::min<size_t>(threads, size / minChunkBytes + 1));
+
+        // Split at line boundaries
+        std::vector<size_t> bounds(threads + 1, size);
+        bounds[0] = 0;
+        for (unsigned int i = 1; i < threads; i++) {
+            size_t pos = std::max(bounds[i - 1], size * i / threads);
+            while (pos < size && pos > 0 && text[pos - 1] != '\n')
+                pos++;
+            bounds[i] = pos;
+        }
+
+        // Parse each chunk
+        std::vector<Chunk> chunks(threads);
+        if (threads == 1) {
+            parseChunk(text, text + size, chunks[0]);
+        } else {
+            std::vector<std::thread> workers;
+            for (unsigned int i = 0; i < threads; i++)
+                workers.emplace_back(parseChunk, text + bounds[i], text + bounds[i + 1], std::ref(chunks[i]));
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        // Prefix sums give each chunk's offset into the merged arrays
+        for (const Chunk& c : chunks) {
+            if (c.error != nullptr) {
+                std::cerr << "OBJ line " << std::count(text, c.errorLine, '\n') + 1 << ": " << c.error << std::endl;
+                return false;
             }
-            // Process faces (f)
-            else if (strcmp(lineHeader, "f") == 0) {
-                unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-                int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n",
-                    &vertexIndex[0], &uvIndex[0], &normalIndex[0],
-                    &vertexIndex[1], &uvIndex[1], &normalIndex[1],
-                    &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
-
-                if (matches != 9) {
-                    std::cerr << "File can't be read by this parser: " << path << std::endl;
-                    fclose(file);
+        }
+        std::vector<size_t> vBase(threads + 1, 0), vtBase(threads + 1, 0), vnBase(threads + 1, 0), fBase(threads + 1, 0);
+        for (unsigned int i = 0; i < threads; i++) {
+            vBase[i + 1] = vBase[i] + chunks[i].positions.size();
+            vtBase[i + 1] = vtBase[i] + chunks[i].uvs.size();
+            vnBase[i + 1] = vnBase[i] + chunks[i].normals.size();
+            fBase[i + 1] = fBase[i] + chunks[i].corners.size();
+        }
+
+        out.positions.resize(vBase[threads]);
+        out.uvs.resize(vtBase[threads]);
+        out.normals.resize(vnBase[threads]);
+        out.corners.resize(fBase[threads]);
+
+        // Merge in order, resolving chunk-relative (negative) indices against the global pools
+        for (unsigned int i = 0; i < threads; i++) {
+            const Chunk& c = chunks[i];
+            std::copy(c.positions.begin(), c.positions.end(), out.positions.begin() + vBase[i]);
+            std::copy(c.uvs.begin(), c.uvs.end(), out.uvs.begin() + vtBase[i]);
+            std::copy(c.normals.begin(), c.normals.end(), out.normals.begin() + vnBase[i]);
+
+            const int vCount = static_cast<int>(out.positions.size());
+            const int vtCount = static_cast<int>(out.uvs.size());
+            const int vnCount = static_cast<int>(out.normals.size());
+            for (size_t j = 0; j < c.corners.size(); j++) {
+                const RawIndex& r = c.corners[j];
+                OBJIndex& idx = out.corners[fBase[i] + j];
+                idx.v = resolve(r.v, r.relative & 1, static_cast<int>(vBase[i]));
+                idx.vt = resolve(r.vt, r.relative & 2, static_cast<int>(vtBase[i]));
+                idx.vn = resolve(r.vn, r.relative & 4, static_cast<int>(vnBase[i]));
+                if (idx.v < 0 || idx.v >= vCount || idx.vt < -1 || idx.vt >= vtCount || idx.vn < -1 || idx.vn >= vnCount) {
+                    std::cerr << "OBJ face " << (fBase[i] + j) / 3 + 1 << ": index out of range" << std::endl;
                     return false;
                 }
+            }
+        }
+        return true;
+    }
+
+private:
+    // Face corner as parsed inside a chunk. Negative OBJ indices can only be resolved once
+    // the chunk's global offset is known, so they're stored chunk-relative and flagged
+    struct RawIndex {
+        int v, vt, vn;
+        unsigned char relative;
+    };
+
+    struct Chunk {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> uvs;
+        std::vector<glm::vec3> normals;
+        std::vector<RawIndex> corners;
+        const char* error = nullptr; // Why parsing stopped, and at which line
+        const char* errorLine = nullptr;
+    };
+
+    static int resolve(int index, bool relative, int base)
+    {
+        if (index == INT32_MIN)
+            return -1;
+        if (!relative)
+            return index;
+        // A negative index reaching before the start of the file is invalid
+        return index + base < 0 ? -2 : index + base;
+    }
+
+    static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    static const char* skipBlanks(const char* p, const char* end)
+    {
+        while (p < end && isBlank(*p))
+            p++;
+        return p;
+    }
+
+    static const char* skipLine(const char* p, const char* end)
+    {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        return nl ? nl + 1 : end;
+    }
 
-                // Store indices
-                vertexIndices.push_back(vertexIndex[0]);
-                uvIndices.push_back(uvIndex[0]);
-                normalIndices.push_back(normalIndex[0]);
-                vertexIndices.push_back(vertexIndex[1]);
-                uvIndices.push_back(uvIndex[1]);
-                normalIndices.push_back(normalIndex[1]);
-                vertexIndices.push_back(vertexIndex[2]);
-                uvIndices.push_back(uvIndex[2]);
-                normalIndices.push_back(normalIndex[2]);
+    // Locale-independent float scanner: [+-]digits[.digits][(e|E)[+-]digits], ending at a
+    // blank, a comment or the end of the line. Returns null if there is no such number
+    static const char* parseFloat(const char* p, const char* end, float& out)
+    {
+        static const double powers[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        p = skipBlanks(p, end);
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = (*p++ == '-');
+
+        uint64_t mantissa = 0;
+        int exponent = 0, digits = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (mantissa < 1000000000000000000ull)
+                mantissa = mantissa * 10 + (*p - '0');
+            else
+                exponent++;
+            p++;
+            digits++;
+        }
+        if (p < end && *p == '.') {
+            p++;
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (mantissa < 1000000000000000000ull) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    exponent--;
+                }
+                p++;
+                digits++;
             }
         }
+        if (digits == 0)
+            return nullptr;
 
-        // Process indexed data into unindexed form
-        for (unsigned int i = 0; i < vertexIndices.size(); i++) {
-            unsigned int vertexIndex = vertexIndices[i];
-            glm::vec3 vertex = tempVertices[vertexIndex - 1];
-            outVertices.push_back(vertex);
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            const char* q = p + 1;
+            bool expNegative = false;
+            if (q < end && (*q == '-' || *q == '+'))
+                expNegative = (*q++ == '-');
+            if (q < end && *q >= '0' && *q <= '9') {
+                int e = 0;
+                while (q < end && *q >= '0' && *q <= '9') {
+                    if (e < 10000)
+                        e = e * 10 + (*q - '0');
+                    q++;
+                }
+                exponent += expNegative ? -e : e;
+                p = q;
+            }
+        }
+        if (p < end && !isBlank(*p) && *p != '\n' && *p != '#')
+            return nullptr;
+
+        double value = static_cast<double>(mantissa);
+        while (exponent > 22) {
+            value *= 1e22;
+            exponent -= 22;
+        }
+        while (exponent < -22) {
+            value /= 1e22;
+            exponent += 22;
+        }
+        value = exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
 
-            unsigned int uvIndex = uvIndices[i];
-            glm::vec2 uv = tempUVs[uvIndex - 1];
-            outUVs.push_back(uv);
+        out = static_cast<float>(negative ? -value : value);
+        return p;
+    }
 
-            unsigned int normalIndex = normalIndices[i];
-            glm::vec3 normal = tempNormals[normalIndex - 1];
-            outNormals.push_back(normal);
+    // Parses count floats into out; null if any is malformed or missing
+    static const char* parseFloats(const char* p, const char* end, float* out, int count)
+    {
+        for (int i = 0; i < count && p != nullptr; i++)
+            p = parseFloat(p, end, out[i]);
+        return p;
+    }
+
+    static const char* parseInt(const char* p, const char* end, int& out)
+    {
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = (*p++ == '-');
+
+        const char* digitsStart = p;
+        long long value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (value < INT32_MAX)
+                value = value * 10 + (*p - '0');
+            p++;
         }
+        if (p == digitsStart)
+            return start;
+
+        value = std::min<long long>(value, INT32_MAX);
+        out = static_cast<int>(negative ? -value : value);
+        return p;
+    }
 
-        fclose(file);
+    // Converts an OBJ index (1-based, or negative from the end) to 0-based. Negative
+    // indices become chunk-relative and set the given bit in relative
+    static bool convertIndex(int index, int localCount, unsigned char bit, int& out, unsigned char& relative)
+    {
+        if (index > 0) {
+            out = index - 1;
+        } else if (index < 0) {
+            out = localCount + index;
+            relative |= bit;
+        } else {
+            return false;
+        }
         return true;
     }
+
+    // Parses one face corner token: v, v/vt, v//vn or v/vt/vn
+    static const char* parseCorner(const char* p, const char* end, const Chunk& chunk, RawIndex& out)
+    {
+        out.vt = out.vn = INT32_MIN;
+        out.relative = 0;
+
+        int v;
+        const char* q = parseInt(p, end, v);
+        if (q == p || !convertIndex(v, static_cast<int>(chunk.positions.size()), 1, out.v, out.relative))
+            return nullptr;
+        p = q;
+
+        if (p < end && *p == '/') {
+            p++;
+            int vt;
+            q = parseInt(p, end, vt);
+            if (q != p) {
+                if (!convertIndex(vt, static_cast<int>(chunk.uvs.size()), 2, out.vt, out.relative))
+                    return nullptr;
+                p = q;
+            }
+            if (p < end && *p == '/') {
+                p++;
+                int vn;
+                q = parseInt(p, end, vn);
+                if (q == p || !convertIndex(vn, static_cast<int>(chunk.normals.size()), 4, out.vn, out.relative))
+                    return nullptr;
+                p = q;
+            }
+        }
+
+        // A corner must end at whitespace or the end of the line
+        if (p < end && !isBlank(*p) && *p != '\n')
+            return nullptr;
+        return p;
+    }
+
+    static void parseChunk(const char* p, const char* end, Chunk& chunk)
+    {
+        // Rough pre-sizing: cow.obj style files average ~35 bytes per line
+        size_t estimate = static_cast<size_t>(end - p) / 35;
+        chunk.positions.reserve(estimate / 2);
+        chunk.corners.reserve(estimate * 3 / 2);
+
+        std::vector<RawIndex> polygon;
+        while (p < end) {
+            p = skipBlanks(p, end);
+            if (p >= end)
+                break;
+
+            const char* line = p;
+            auto fail = [&](const char* error) {
+                chunk.error = error;
+                chunk.errorLine = line;
+            };
+            if (p[0] == 'v' && p + 1 < end && isBlank(p[1])) {
+                glm::vec3 v;
+                p = parseFloats(p + 1, end, &v.x, 3);
+                if (p == nullptr)
+                    return fail("malformed vertex position");
+                chunk.positions.push_back(v);
+            } else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && isBlank(p[2])) {
+                glm::vec2 uv;
+                p = parseFloats(p + 2, end, &uv.x, 2);
+                if (p == nullptr)
+                    return fail("malformed texture coordinate");
+                chunk.uvs.push_back(uv);
+            } else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && isBlank(p[2])) {
+                glm::vec3 n;
+                p = parseFloats(p + 2, end, &n.x, 3);
+                if (p == nullptr)
+                    return fail("malformed normal");
+                chunk.normals.push_back(n);
+            } else if (p[0] == 'f' && p + 1 < end && isBlank(p[1])) {
+                polygon.clear();
+                p++;
+                while (true) {
+                    p = skipBlanks(p, end);
+                    if (p >= end || *p == '\n' || *p == '#')
+                        break;
+                    RawIndex corner;
+                    p = parseCorner(p, end, chunk, corner);
+                    if (p == nullptr)
+                        return fail("malformed face corner");
+                    polygon.push_back(corner);
+                }
+                if (polygon.size() < 3)
+                    return fail("face with fewer than 3 corners");
+
+                // Triangulate as a fan around the first corner
+                for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i]);
+                    chunk.corners.push_back(polygon[i + 1]);
+                }
+            }
+
+            // Comments, groups, materials and any trailing values (vt w, v w) are ignored
+            p = skipLine(p, end);
+        }
+    }
 };
 
 #endif // OBJIMPORTER_H
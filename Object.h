@@ -4,13 +4,17 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include "OBJImporter.h"
+#include "AssetStreamer.h"
+#include "Camera.h"
+#include "MeshCache.h"
+#include "RenderQueue.h"
 #include <iostream>
 #include <vector>
 
 using Vec3 = glm::vec3;
 
-// A generic Object class for 3D objects
+// A generic Object class for 3D objects. Geometry is shared through a MeshCache handle,
+// so an instance only carries its transform
 class Object
 {
 public:
@@ -18,52 +22,23 @@ public:
     Vec3 position;
     Vec3 rotation;
     Vec3 scale;
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<unsigned int> uvs;
-    std::vector<unsigned int> normals;
 
-    // OpenGL attributes
-    unsigned int VAO, VBO, EBO;
+    // Shared GPU geometry (null for transform-only objects)
+    MeshHandle mesh;
 
-    // Constructor with default values
-    Object(Vec3 position = Vec3(0.0f, 0.0f, 0.0f), 
-           Vec3 rotation = Vec3(0.0f, 0.0f, 0.0f), 
-           Vec3 scale = Vec3(1.0f, 1.0f, 1.0f))
-        : position(position), rotation(rotation), scale(scale), VAO(0), VBO(0), EBO(0) {}
-
-    // Initializes the object by setting up VAO, VBO, and EBO
-    virtual void init()
-    {
-        // Ensure vertices and indices are populated
-        if (vertices.empty() || indices.empty()) {
-            std::cerr << "Error: Vertices or indices are empty. Object initialization failed." << std::endl;
-            return;
-        }
+    // Geometry still streaming in (see loadFromOBJAsync); replaced by mesh once resident
+    StreamHandle stream;
 
-        // Generate VAO, VBO, and EBO
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+    // Level of detail drawn, kept between frames for selectLOD's hysteresis
+    int lod = 0;
 
-        // Bind VAO
-        glBindVertexArray(VAO);
-
-        // Bind VBO and buffer data
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-        // Bind EBO and buffer data
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-        // Set vertex attribute pointers (assuming 3D positions)
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+    // Constructor with default values
+    Object(Vec3 position = Vec3(0.0f, 0.0f, 0.0f),
+           Vec3 rotation = Vec3(0.0f, 0.0f, 0.0f),
+           Vec3 scale = Vec3(1.0f, 1.0f, 1.0f))
+        : position(position), rotation(rotation), scale(scale) {}
 
-        // Unbind VAO
-        glBindVertexArray(0);
-    }
+    virtual ~Object() {}
 
     // Returns the model matrix based on position, rotation, and scale
     glm::mat4 getModelMatrix() const
@@ -77,62 +52,83 @@ public:
         return model;
     }
 
-    // Draw the object
-    virtual void draw() const
+    // Model matrix to draw with: getModelMatrix() times the mesh's position dequantization,
+    // or stretched to the bounds while a streamed mesh is still drawn as its placeholder box
+    glm::mat4 getDrawMatrix() const
     {
-        if (VAO != 0) {
-            glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-            glBindVertexArray(0);
-        } else {
-            std::cerr << "Error: VAO is not initialized. Cannot draw object." << std::endl;
-        }
+        if (mesh)
+            return getModelMatrix() * mesh->positionTransform;
+        return stream ? getModelMatrix() * stream->drawTransform() : getModelMatrix();
     }
 
-    // Destructor to clean up OpenGL resources
-    virtual ~Object()
+    // World-space bounds of the mesh under the current transform (empty without a mesh,
+    // or while a streamed mesh's bounds are unknown)
+    AABB getWorldBounds() const
     {
-        if (VAO != 0) glDeleteVertexArrays(1, &VAO);
-        if (VBO != 0) glDeleteBuffers(1, &VBO);
-        if (EBO != 0) glDeleteBuffers(1, &EBO);
+        if (mesh)
+            return mesh->bounds.transformed(getModelMatrix());
+        return stream ? stream->bounds.transformed(getModelMatrix()) : AABB();
     }
 
-	// Load OBJ file
-    bool loadFromOBJ(const char* path) {
-        std::vector<glm::vec3> outVertices;
-        std::vector<glm::vec2> outUVs;
-        std::vector<glm::vec3> outNormals;
-
-        if (!OBJImporter::loadOBJ(path, outVertices, outUVs, outNormals)) {
-            std::cerr << "Failed to load OBJ file: " << path << std::endl;
-            return false;
+    // Picks the level of detail from the projected size of each level's error; call once
+    // per frame before draw(). Returns the level
+    int selectLOD(const Camera& camera, float viewportHeight, float thresholdPixels = 1.0f)
+    {
+        if (!mesh) {
+            lod = 0;
+            return lod;
         }
+        float distance = glm::length(getWorldBounds().center() - camera.position);
+        float largestScale = std::max(std::abs(scale.x), std::max(std::abs(scale.y), std::abs(scale.z)));
+        lod = ::selectLOD(mesh->lods, lod, distance, largestScale, camera.fov, viewportHeight, thresholdPixels);
+        return lod;
+    }
 
-        // Convert vertices to a flat array for OpenGL
-        for (const auto& vertex : outVertices) {
-            vertices.push_back(vertex.x);
-            vertices.push_back(vertex.y);
-            vertices.push_back(vertex.z);
+    // Draw the object
+    virtual void draw() const
+    {
+        if (mesh) {
+            mesh->draw(lod);
+        } else if (stream) {
+            if (const Mesh* current = stream->drawMesh())
+                current->draw();
+        } else {
+            std::cerr << "Error: Object has no mesh. Cannot draw object." << std::endl;
         }
+    }
 
-        // Generate simple indices (for unindexed OBJ models)
-        indices.resize(outVertices.size());
-        for (size_t i = 0; i < indices.size(); ++i) {
-            indices[i] = static_cast<unsigned int>(i);
-        }
+    // Queues the object instead of drawing it now. program must read the model matrix
+    // from the instance attributes (see RenderQueue); eye orders draws front to back
+    void submit(RenderQueue& queue, const ShaderProgram& program, uint32_t material, const Vec3& eye) const
+    {
+        const Mesh* drawn = mesh ? mesh.get() : stream ? stream->drawMesh() : nullptr;
+        if (drawn != nullptr)
+            queue.submit(program, *drawn, material, mesh ? lod : 0, getDrawMatrix(), glm::length(position - eye));
+    }
 
-        // Convert UVs and normals if needed (currently not used for rendering)
-        for (const auto& uv : outUVs) {
-            uvs.push_back(uv.x);
-            uvs.push_back(uv.y);
-        }
-        for (const auto& normal : outNormals) {
-            normals.push_back(normal.x);
-            normals.push_back(normal.y);
-            normals.push_back(normal.z);
+    // Adopts a streamed mesh once it is resident. Returns true when the object has its mesh
+    bool updateStream()
+    {
+        if (stream && stream->resident()) {
+            mesh = stream->mesh;
+            stream.reset();
         }
+        return mesh != nullptr;
+    }
+
+	// Load OBJ file through the mesh cache. The binary mesh (path + ".mesh") is written on
+	// first load, rebuilt when stale and mapped on later loads; objects loading the same
+	// file share one upload
+    bool loadFromOBJ(const char* path) {
+        mesh = MeshCache::instance().loadOBJ(path);
+        return mesh != nullptr;
+    }
 
-        return true;
+	// Load OBJ file in the background through the AssetStreamer. The object draws a box
+	// around the mesh bounds until the upload completes, without stalling any frame
+    void loadFromOBJAsync(const char* path) {
+        mesh.reset();
+        stream = AssetStreamer::instance().load(path);
     }
 };
 
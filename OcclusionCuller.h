@@ -0,0 +1,305 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "Bounds.h"
+#include "SoftwareRasterizer.h"
+
+// Masked software occlusion culling (after Hasselgren, Andersson and Akenine-Möller,
+// "Masked Software Occlusion Culling"). Each frame a few large occluders are rasterized
+// into a small depth buffer of 8x4-pixel tiles, and objects are then tested by the
+// screen rectangle and nearest depth of their bounds. No GL needed.
+//
+// A tile holds a reference depth zMax0 (every pixel of the tile is covered by something
+// at most that far) and a working layer: a 32-bit coverage mask with its farthest depth
+// zMax1. Triangles add to the working layer; once its mask is full it becomes the new
+// reference. When a much nearer triangle arrives the working layer is dropped instead of
+// merged, which only forgets coverage. Every step errs towards "visible", and bounds
+// reaching the near plane always pass.
+// Depth is window depth in [0, 1], smaller is nearer, as in the GL path
+class OcclusionCuller
+{
+public:
+    static const int TILE_WIDTH = 8, TILE_HEIGHT = 4;
+
+    // Compute coverage masks with AVX2; set from the CPU on construction
+    bool useAvx2;
+
+    // Counts since the last beginFrame()
+    struct Statistics
+    {
+        uint64_t occluderTriangles = 0; // Rasterized into the depth buffer
+        uint64_t tested = 0;            // visible() calls
+        uint64_t culled = 0;            // ... that returned false
+    };
+    Statistics statistics;
+
+    explicit OcclusionCuller(int width = 256, int height = 128) : useAvx2(cpuHasAvx2()), viewProjection(1.0f)
+    {
+        resize(width, height);
+    }
+
+    // The buffer is rounded up to whole tiles; keep the screen's aspect ratio
+    void resize(int newWidth, int newHeight)
+    {
+        tilesX = (std::max(newWidth, 1) + TILE_WIDTH - 1) / TILE_WIDTH;
+        tilesY = (std::max(newHeight, 1) + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        width = tilesX * TILE_WIDTH;
+        height = tilesY * TILE_HEIGHT;
+        zMax0.assign(size_t(tilesX) * tilesY, 1.0f);
+        zMax1.assign(zMax0.size(), 0.0f);
+        masks.assign(zMax0.size(), 0u);
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Clears the buffer for a new view
+    void beginFrame(const glm::mat4& matrix)
+    {
+        viewProjection = matrix;
+        std::fill(zMax0.begin(), zMax0.end(), 1.0f);
+        std::fill(zMax1.begin(), zMax1.end(), 0.0f);
+        std::fill(masks.begin(), masks.end(), 0u);
+        statistics = Statistics();
+    }
+
+    // Rasterizes an occluder: simplified, closed geometry no larger than what it stands for
+    void addOccluder(const RasterMesh& mesh, const glm::mat4& model)
+    {
+        glm::mat4 toClip = viewProjection * model;
+        clip.resize(mesh.positions.size());
+        for (size_t v = 0; v < mesh.positions.size(); v++)
+            clip[v] = toClip * glm::vec4(mesh.positions[v], 1.0f);
+
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const glm::vec4* v[3] = { &clip[mesh.indices[i]], &clip[mesh.indices[i + 1]], &clip[mesh.indices[i + 2]] };
+            unsigned int outside = ~0u, nearMask = 0;
+            for (int k = 0; k < 3; k++) {
+                const glm::vec4& p = *v[k];
+                unsigned int code = (p.x < -p.w) | (p.x > p.w) << 1 | (p.y < -p.w) << 2 | (p.y > p.w) << 3
+                                  | (p.z < -p.w) << 4 | (p.z > p.w) << 5;
+                outside &= code;
+                nearMask |= code & 16;
+            }
+            if (outside != 0)
+                continue;
+            if (nearMask == 0) {
+                rasterizeTriangle(*v[0], *v[1], *v[2]);
+                continue;
+            }
+
+            // Nearby occluders matter most: clip against z = -w as SoftwareRasterizer does
+            glm::vec4 polygon[4];
+            int count = 0;
+            for (int k = 0; k < 3; k++) {
+                const glm::vec4& p = *v[k];
+                const glm::vec4& q = *v[(k + 1) % 3];
+                float dp = p.z + p.w, dq = q.z + q.w;
+                if (dp >= 0.0f)
+                    polygon[count++] = p;
+                if ((dp >= 0.0f) != (dq >= 0.0f))
+                    polygon[count++] = p + (q - p) * (dp / (dp - dq));
+            }
+            for (int k = 1; k + 1 < count; k++)
+                rasterizeTriangle(polygon[0], polygon[k], polygon[k + 1]);
+        }
+    }
+
+    // False only if every pixel the bounds cover is behind the occluders
+    bool visible(const AABB& bounds)
+    {
+        statistics.tested++;
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec4 p = viewProjection * glm::vec4(corner & 1 ? bounds.max.x : bounds.min.x,
+                                                      corner & 2 ? bounds.max.y : bounds.min.y,
+                                                      corner & 4 ? bounds.max.z : bounds.min.z, 1.0f);
+            if (p.z < -p.w || p.w <= 0.0f)
+                return true; // Reaches the near plane
+            float x = (p.x / p.w * 0.5f + 0.5f) * width, y = (0.5f - p.y / p.w * 0.5f) * height;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearest = std::min(nearest, p.z / p.w * 0.5f + 0.5f);
+        }
+
+        // Tiles holding a pixel center the rectangle may cover
+        int x0 = std::max(0, static_cast<int>(std::floor(minX)) / TILE_WIDTH);
+        int y0 = std::max(0, static_cast<int>(std::floor(minY)) / TILE_HEIGHT);
+        int x1 = std::min(tilesX - 1, static_cast<int>(std::floor(maxX)) / TILE_WIDTH);
+        int y1 = std::min(tilesY - 1, static_cast<int>(std::floor(maxY)) / TILE_HEIGHT);
+        if (minX >= width || minY >= height || maxX < 0.0f || maxY < 0.0f)
+            return true; // Off screen: left to the frustum test
+        for (int ty = y0; ty <= y1; ty++) {
+            const float* row = &zMax0[size_t(ty) * tilesX];
+            for (int tx = x0; tx <= x1; tx++)
+                if (nearest < row[tx])
+                    return true;
+        }
+        statistics.culled++;
+        return false;
+    }
+
+    // Reference depth of a tile (1 where nothing covers all of it)
+    float tileDepth(int tileX, int tileY) const { return zMax0[size_t(tileY) * tilesX + tileX]; }
+
+    double culledPercent() const { return statistics.tested > 0 ? 100.0 * statistics.culled / statistics.tested : 0.0; }
+
+private:
+    int width, height, tilesX, tilesY;
+    glm::mat4 viewProjection;
+    std::vector<float> zMax0;     // Reference layer, per tile
+    std::vector<float> zMax1;     // Working layer's farthest depth
+    std::vector<uint32_t> masks;  // Working layer's coverage, bit row * 8 + column
+    std::vector<glm::vec4> clip;
+
+    // Edge i is e(x, y) = a*x + b*y + c at pixel centers, >= 0 inside
+    struct Edges
+    {
+        float a[3], b[3], c[3];
+    };
+
+    static bool cpuHasAvx2()
+    {
+#ifdef SOFTWARE_RASTERIZER_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    void rasterizeTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2)
+    {
+        glm::vec3 s[3];
+        const glm::vec4* clipped[3] = { &c0, &c1, &c2 };
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4& p = *clipped[i];
+            s[i] = glm::vec3((p.x / p.w * 0.5f + 0.5f) * width, (0.5f - p.y / p.w * 0.5f) * height, p.z / p.w * 0.5f + 0.5f);
+        }
+        float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+        if (area == 0.0f)
+            return;
+        statistics.occluderTriangles++;
+
+        Edges t;
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec3& p = s[(i + 1) % 3];
+            const glm::vec3& q = s[(i + 2) % 3];
+            t.a[i] = sign * (p.y - q.y);
+            t.b[i] = sign * (q.x - p.x);
+            t.c[i] = sign * (p.x * q.y - p.y * q.x);
+        }
+        // Depth plane, and the farthest vertex: the plane can run past it outside the triangle
+        float za = ((s[1].z - s[0].z) * (s[2].y - s[0].y) - (s[2].z - s[0].z) * (s[1].y - s[0].y)) / area;
+        float zb = ((s[2].z - s[0].z) * (s[1].x - s[0].x) - (s[1].z - s[0].z) * (s[2].x - s[0].x)) / area;
+        float zc = s[0].z - za * s[0].x - zb * s[0].y;
+        float zFarthest = std::max(s[0].z, std::max(s[1].z, s[2].z));
+
+        int x0 = std::max(0, static_cast<int>(std::floor(std::min(s[0].x, std::min(s[1].x, s[2].x)))) / TILE_WIDTH);
+        int y0 = std::max(0, static_cast<int>(std::floor(std::min(s[0].y, std::min(s[1].y, s[2].y)))) / TILE_HEIGHT);
+        int x1 = std::min(tilesX - 1, static_cast<int>(std::floor(std::max(s[0].x, std::max(s[1].x, s[2].x)))) / TILE_WIDTH);
+        int y1 = std::min(tilesY - 1, static_cast<int>(std::floor(std::max(s[0].y, std::max(s[1].y, s[2].y)))) / TILE_HEIGHT);
+
+        for (int ty = y0; ty <= y1; ty++) {
+            for (int tx = x0; tx <= x1; tx++) {
+                int px = tx * TILE_WIDTH, py = ty * TILE_HEIGHT;
+
+                // Skip the tile if an edge is negative at the pixel center nearest its inside
+                bool outside = false;
+                for (int i = 0; i < 3 && !outside; i++) {
+                    float x = px + (t.a[i] > 0.0f ? TILE_WIDTH - 0.5f : 0.5f);
+                    float y = py + (t.b[i] > 0.0f ? TILE_HEIGHT - 0.5f : 0.5f);
+                    outside = t.a[i] * x + t.b[i] * y + t.c[i] < 0.0f;
+                }
+                if (outside)
+                    continue;
+
+                // Farthest the triangle gets over the tile's pixel centers
+                float zx = za * (za > 0.0f ? px + TILE_WIDTH - 0.5f : px + 0.5f);
+                float zy = zb * (zb > 0.0f ? py + TILE_HEIGHT - 0.5f : py + 0.5f);
+                float zTile = std::min(zx + zy + zc, zFarthest);
+
+                size_t tile = size_t(ty) * tilesX + tx;
+                if (zTile >= zMax0[tile])
+                    continue; // Behind what the tile already guarantees
+                uint32_t coverage;
+#ifdef SOFTWARE_RASTERIZER_AVX2
+                if (useAvx2)
+                    coverage = coverageAvx2(t, px, py);
+                else
+#endif
+                    coverage = coverageScalar(t, px, py);
+                if (coverage != 0)
+                    merge(tile, coverage, zTile);
+            }
+        }
+    }
+
+    void merge(size_t tile, uint32_t coverage, float zTile)
+    {
+        // Drop the working layer when the new triangle is nearer to the reference than it
+        // is to the working layer: keeping the union would push the working depth too far
+        if (masks[tile] != 0 && zMax1[tile] - zTile > zMax0[tile] - zMax1[tile]) {
+            masks[tile] = 0;
+            zMax1[tile] = 0.0f;
+        }
+        masks[tile] |= coverage;
+        zMax1[tile] = std::max(zMax1[tile], zTile);
+        if (masks[tile] == ~0u) {
+            zMax0[tile] = zMax1[tile];
+            masks[tile] = 0;
+            zMax1[tile] = 0.0f;
+        }
+    }
+
+    // Bit row * 8 + column is set where the pixel center is inside all three edges; the
+    // reference for the AVX2 version, which does the same float operations in the same order
+    static uint32_t coverageScalar(const Edges& t, int px, int py)
+    {
+        uint32_t coverage = 0;
+        for (int row = 0; row < TILE_HEIGHT; row++) {
+            float y = py + row + 0.5f;
+            float rowE[3];
+            for (int i = 0; i < 3; i++)
+                rowE[i] = t.b[i] * y + t.c[i];
+            for (int column = 0; column < TILE_WIDTH; column++) {
+                float x = px + column + 0.5f;
+                bool inside = t.a[0] * x + rowE[0] >= 0.0f && t.a[1] * x + rowE[1] >= 0.0f && t.a[2] * x + rowE[2] >= 0.0f;
+                coverage |= uint32_t(inside) << (row * TILE_WIDTH + column);
+            }
+        }
+        return coverage;
+    }
+
+#ifdef SOFTWARE_RASTERIZER_AVX2
+    // A tile row is eight pixels: one register per edge
+    __attribute__((target("avx2"))) static uint32_t coverageAvx2(const Edges& t, int px, int py)
+    {
+        __m256 x = _mm256_add_ps(_mm256_set1_ps(float(px)), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+        __m256 ax[3];
+        for (int i = 0; i < 3; i++)
+            ax[i] = _mm256_mul_ps(_mm256_set1_ps(t.a[i]), x);
+
+        uint32_t coverage = 0;
+        const __m256 zero = _mm256_setzero_ps();
+        for (int row = 0; row < TILE_HEIGHT; row++) {
+            float y = py + row + 0.5f;
+            __m256 inside = _mm256_cmp_ps(_mm256_add_ps(ax[0], _mm256_set1_ps(t.b[0] * y + t.c[0])), zero, _CMP_GE_OQ);
+            for (int i = 1; i < 3; i++)
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(ax[i], _mm256_set1_ps(t.b[i] * y + t.c[i])), zero,
+                                                             _CMP_GE_OQ));
+            coverage |= uint32_t(_mm256_movemask_ps(inside)) << (row * TILE_WIDTH);
+        }
+        return coverage;
+    }
+#endif
+};
+
+#endif
@@ -5,15 +5,26 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "Camera.h"
+#include "Collision.h"
+#include <cmath>
+#include <vector>
 
 using Vec2 = glm::vec2;
 using Vec3 = glm::vec3;
 
+// Input sampled once per frame and applied to every simulation step of that frame
+struct PlayerInput
+{
+	Vec2 direction = Vec2(0.0f, 0.0f); // x: right, y: forward
+	bool jump = false;
+};
+
 class Player
 {
 public:
     // Attributes
     Vec3 position;
+    Vec3 previousPosition; // Position before the last step(), for interpolation
     Vec3 rotation;
     Camera* camera;
 
@@ -21,45 +32,96 @@ public:
 	bool grounded;
 
 	const float maxSpeed = 1000.0f;
-	const float moveSpeed = 2.0f;
+	const float acceleration = 120.0f; // Units/s^2 along the input direction
 	const float jumpSpeed = 10.0f;
 	const float gravity = -25.0f;
 
 	const float dragForce = 12.0f;
 	const float frictionForce = 15.0f;
 
+	// Collision shape: a capsule standing under the eye (position)
+	CollisionWorld* world; // Without a world the only ground is the plane y = 0
+	const float radius = 0.3f;
+	const float height = 1.8f;
+	const float eyeHeight = 1.6f;
+	const float minGroundNormal = 0.7f; // Surfaces steeper than ~45 degrees are walls
+
     // Constructor
     Player(Vec3 position = Vec3(0.0f, 0.0f, 0.0f), 
-           Camera* camera = nullptr)
+           Camera* camera = nullptr,
+           CollisionWorld* world = nullptr)
     {
         this->position = position;
+        this->previousPosition = position;
         this->rotation = Vec3(0.0f, 0.0f, 0.0f);
         this->camera = camera;
+        this->world = world;
 
 		this->velocity = Vec3(0.0f, 0.0f, 0.0f);
 		this->grounded = true;
     }
 
-	// Player movement
+	// Advances the player by one fixed simulation step
+	void step(const PlayerInput& input, float deltaTime) {
+		previousPosition = position;
+		if (input.jump) {
+			jump();
+		}
+		move(input.direction, deltaTime);
+		updateVertical(deltaTime);
+	}
+
+	// The collision capsule at the current position
+	Capsule capsule() const {
+		Vec3 feet = position - Vec3(0.0f, eyeHeight, 0.0f);
+		return Capsule{ feet + Vec3(0.0f, radius, 0.0f), feet + Vec3(0.0f, height - radius, 0.0f), radius };
+	}
+
+	// Position between the previous (alpha 0) and current (alpha 1) step
+	Vec3 interpolatedPosition(float alpha) const {
+		return glm::mix(previousPosition, position, alpha);
+	}
+
+	// Moves the camera to the interpolated position for rendering
+	void updateCamera(float alpha) {
+		if (camera) {
+			camera->position = interpolatedPosition(alpha);
+		}
+	}
+
+	// Player movement (horizontal; updateVertical() integrates y)
 	void move(const Vec2& direction, float deltaTime) {
 		if (camera) {
 			// Calculate the forward and right vectors
 			Vec3 forward = glm::normalize(Vec3(camera->front.x, 0.0f, camera->front.z));
 			Vec3 right = glm::normalize(glm::cross(forward, camera->worldUp));
 
-			// Calculate target velocity
-			velocity += (forward * direction.y + right * direction.x) * moveSpeed;
-
-			// Apply friction or drag to reduce velocity
-			float damping = grounded ? frictionForce : dragForce;
-			velocity.x *= 1.0f - (damping * deltaTime);
-			velocity.z *= 1.0f - (damping * deltaTime);
-
-			// Update the player's position
-			position += velocity * deltaTime;
-
-			// Update the camera's position
-			camera->position = position;
+			// Accelerate along the input direction
+			velocity += (forward * direction.y + right * direction.x) * (acceleration * deltaTime);
+
+			// Apply friction or drag as exponential decay, which is exact for any step
+			// length and can't overshoot and reverse the velocity like 1 - damping * dt
+			float decay = std::exp(-(grounded ? frictionForce : dragForce) * deltaTime);
+			velocity.x *= decay;
+			velocity.z *= decay;
+
+			// Update the player's position, sliding along walls
+			Vec3 displacement(velocity.x * deltaTime, 0.0f, velocity.z * deltaTime);
+			if (world) {
+				contacts.clear();
+				position += world->slide(capsule(), displacement, &contacts);
+
+				// Lose the horizontal velocity going into what we hit
+				for (const CollisionHit& hit : contacts) {
+					float into = glm::dot(velocity, hit.normal);
+					if (into < 0.0f) {
+						velocity.x -= hit.normal.x * into;
+						velocity.z -= hit.normal.z * into;
+					}
+				}
+			} else {
+				position += displacement;
+			}
 		}
 	}
 
@@ -73,6 +135,30 @@ public:
 
 	// Update the player's vertical position (gravity and jumping)
 	void updateVertical(float deltaTime) {
+        if (world) {
+            // Always fall and let the collision decide whether something holds us up
+            velocity.y += gravity * deltaTime;
+            contacts.clear();
+            Vec3 moved = world->slide(capsule(), Vec3(0.0f, velocity.y * deltaTime, 0.0f), &contacts);
+            position += moved;
+
+            // Standing on a walkable surface, or wedged between steep ones so the fall stopped
+            bool blocked = !contacts.empty() && velocity.y < 0.0f && moved.y > 0.01f * velocity.y * deltaTime;
+            grounded = blocked;
+            if (blocked) {
+                velocity.y = 0.0f;
+            }
+            for (const CollisionHit& hit : contacts) {
+                if (hit.normal.y >= minGroundNormal && velocity.y <= 0.0f) {
+                    grounded = true;
+                    velocity.y = 0.0f;
+                } else if (hit.normal.y <= -minGroundNormal && velocity.y > 0.0f) {
+                    velocity.y = 0.0f; // Head hit a ceiling
+                }
+            }
+            return;
+        }
+
         if (!grounded) {
             // Apply gravity to the vertical velocity
             velocity.y += gravity * deltaTime;
@@ -88,6 +174,9 @@ public:
             }
         }
     }
+
+private:
+	std::vector<CollisionHit> contacts;
 };
 
 #endif
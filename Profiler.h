@@ -0,0 +1,388 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A timed CPU scope. Times are nanoseconds since the profiler started
+struct ProfileEvent
+{
+    const char* name; // Must outlive the profiler (string literals)
+    uint64_t start;
+    uint64_t end;
+    uint32_t thread;
+    uint32_t depth;
+};
+
+// Single-producer/single-consumer ring of events owned by one thread. The owning thread
+// pushes without locks; the main thread drains it once per frame. Events are dropped
+// (and counted) if the ring fills up between drains
+class ProfileRing
+{
+public:
+    static const uint32_t CAPACITY = 1 << 14;
+
+    uint32_t thread;
+    std::atomic<uint32_t> dropped;
+
+    explicit ProfileRing(uint32_t thread) : thread(thread), dropped(0), head(0), tail(0) {}
+
+    void push(const ProfileEvent& event)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[h & (CAPACITY - 1)] = event;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    template <typename F>
+    void drain(F&& consume)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        for (; t != h; t++)
+            consume(events[t & (CAPACITY - 1)]);
+        tail.store(t, std::memory_order_release);
+    }
+
+private:
+    ProfileEvent events[CAPACITY];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+};
+
+// Per-frame work counters. Only touched from the GL thread
+struct FrameCounters
+{
+    uint64_t drawCalls = 0;
+    uint64_t stateChanges = 0; // Program, VAO and material binds
+    uint64_t triangles = 0;
+    uint64_t trianglesFullDetail = 0; // What triangles would be with every mesh at LOD 0
+    uint64_t uploadBytes = 0; // Bytes handed to glBufferData/glBufferSubData/mapped writes
+    uint64_t occlusionTested = 0; // Objects tested against the occlusion buffer
+    uint64_t occlusionCulled = 0; // ... and found hidden
+    uint64_t fenceWaitMicroseconds = 0; // CPU time blocked on StreamBuffer fences
+};
+
+// A GPU pass timed with GL_TIME_ELAPSED
+struct GpuPassTime
+{
+    const char* name;
+    double ms;
+};
+
+// Everything recorded for one frame
+struct FrameStats
+{
+    uint64_t index = 0;
+    uint64_t start = 0;
+    double cpuMs = 0.0;               // Wall time from beginFrame to the next beginFrame
+    FrameCounters counters;
+    std::vector<ProfileEvent> events; // CPU scopes from every thread
+    std::vector<GpuPassTime> gpu;     // Resolved GPU passes (lag the CPU by up to GPU_LATENCY frames)
+};
+
+// Frame profiler: CPU scopes (ProfileScope), GPU passes (GpuScope) and frame counters,
+// collected into a short history for the overlay and optionally captured for export as a
+// Chrome trace (chrome://tracing, Perfetto)
+class Profiler
+{
+public:
+    static const size_t HISTORY = 240;
+    static const int GPU_LATENCY = 4;       // Frames before a timer query is read back
+    static const size_t MAX_CAPTURE = 1 << 20;
+
+    FrameCounters counters; // Current frame
+
+    static Profiler& instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    uint64_t now() const
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    // The calling thread's event ring, created on first use
+    ProfileRing& threadRing()
+    {
+        thread_local ProfileRing* ring = nullptr;
+        if (ring == nullptr) {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.emplace_back(new ProfileRing(static_cast<uint32_t>(rings.size())));
+            ring = rings.back().get();
+        }
+        return *ring;
+    }
+
+    static uint32_t& threadDepth()
+    {
+        thread_local uint32_t depth = 0;
+        return depth;
+    }
+
+    // Starts a frame. Closes the previous one: drains every thread's events, resolves old
+    // GPU queries and appends it to the history. The calling thread is listed as thread 0
+    void beginFrame()
+    {
+        uint64_t t = now();
+        if (frameOpen)
+            finishFrame(t);
+        else if (frameIndex == 0)
+            threadRing();
+        frameOpen = true;
+
+        // Reuse the arrays of the frame that left the history, so once it is full a frame
+        // doesn't allocate
+        current = FrameStats();
+        current.events.swap(spare.events);
+        current.gpu.swap(spare.gpu);
+        current.events.clear();
+        current.gpu.clear();
+        current.index = frameIndex++;
+        current.start = t;
+        counters = FrameCounters();
+
+        if (gpuEnabled) {
+            gpuSlot = static_cast<int>(current.index % GPU_LATENCY);
+            resolveGpu(gpuSlot);
+        }
+    }
+
+    // Closes the current frame without starting another (e.g. before exporting at exit)
+    void endFrame()
+    {
+        if (frameOpen)
+            finishFrame(now());
+        frameOpen = false;
+    }
+
+    // GPU timing needs a current GL context with timer queries (core since 3.3)
+    void enableGpuTimers(bool enabled) { gpuEnabled = enabled; }
+
+    void beginGpuPass(const char* name)
+    {
+        if (!gpuEnabled)
+            return;
+        GpuSlot& slot = gpuSlots[gpuSlot];
+        if (slot.used == slot.queries.size()) {
+            unsigned int query;
+            glGenQueries(1, &query);
+            slot.queries.push_back(query);
+            slot.names.push_back(nullptr);
+        }
+        slot.names[slot.used] = name;
+        glBeginQuery(GL_TIME_ELAPSED, slot.queries[slot.used]);
+    }
+
+    void endGpuPass()
+    {
+        if (!gpuEnabled)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuSlots[gpuSlot].used++;
+    }
+
+    // Completed frames, oldest first
+    const std::vector<FrameStats>& history() const { return frames; }
+
+    // Frame time percentile (0..1) over the history
+    double percentile(double p) const
+    {
+        if (frames.empty())
+            return 0.0;
+        std::vector<double> times;
+        times.reserve(frames.size());
+        for (const FrameStats& frame : frames)
+            times.push_back(frame.cpuMs);
+        size_t k = std::min(times.size() - 1, static_cast<size_t>(p * times.size()));
+        std::nth_element(times.begin(), times.begin() + k, times.end());
+        return times[k];
+    }
+
+    uint64_t droppedEvents() const
+    {
+        uint64_t total = 0;
+        for (const auto& ring : rings)
+            total += ring->dropped.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Trace capture: while capturing, every finished frame's events are kept for export
+    bool capturing() const { return capture; }
+
+    void startCapture()
+    {
+        captured.clear();
+        capturedGpu.clear();
+        capture = true;
+    }
+
+    void stopCapture() { capture = false; }
+
+    // Writes the captured frames as Chrome trace JSON. GPU passes go on their own track,
+    // laid end to end from the start of the frame that resolved them (GL_TIME_ELAPSED
+    // gives durations, not timestamps)
+    bool writeChromeTrace(const char* path) const
+    {
+        FILE* file = fopen(path, "w");
+        if (file == nullptr)
+            return false;
+
+        fprintf(file, "{\"traceEvents\":[\n");
+        bool first = true;
+        for (const ProfileEvent& e : captured) {
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", e.name, e.thread, e.start / 1000.0, (e.end - e.start) / 1000.0);
+            first = false;
+        }
+        for (const CapturedGpu& g : capturedGpu) {
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":\"GPU\",\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", g.name, g.start / 1000.0, g.ms * 1000.0);
+            first = false;
+        }
+        fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        return fclose(file) == 0;
+    }
+
+private:
+    struct GpuSlot
+    {
+        std::vector<unsigned int> queries;
+        std::vector<const char*> names;
+        size_t used = 0;
+    };
+
+    struct CapturedGpu
+    {
+        const char* name;
+        uint64_t start;
+        double ms;
+    };
+
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<ProfileRing>> rings;
+
+    std::vector<FrameStats> frames;
+    FrameStats current;
+    FrameStats spare; // Oldest frame, recycled by beginFrame
+    uint64_t frameIndex;
+    bool frameOpen;
+
+    bool gpuEnabled;
+    int gpuSlot;
+    GpuSlot gpuSlots[GPU_LATENCY];
+
+    bool capture;
+    std::vector<ProfileEvent> captured;
+    std::vector<CapturedGpu> capturedGpu;
+
+    Profiler() : epoch(std::chrono::steady_clock::now()), frameIndex(0), frameOpen(false), gpuEnabled(false), gpuSlot(0), capture(false)
+    {
+        frames.reserve(HISTORY);
+    }
+
+    void finishFrame(uint64_t end)
+    {
+        current.cpuMs = (end - current.start) / 1e6;
+        current.counters = counters;
+
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const auto& ring : rings)
+            ring->drain([this](const ProfileEvent& e) { current.events.push_back(e); });
+
+        if (capture) {
+            if (captured.size() + current.events.size() > MAX_CAPTURE) {
+                capture = false;
+            } else {
+                captured.insert(captured.end(), current.events.begin(), current.events.end());
+                uint64_t t = current.start;
+                for (const GpuPassTime& pass : current.gpu) {
+                    capturedGpu.push_back({ pass.name, t, pass.ms });
+                    t += static_cast<uint64_t>(pass.ms * 1e6);
+                }
+            }
+        }
+
+        if (frames.size() == HISTORY) {
+            spare = std::move(frames.front());
+            frames.erase(frames.begin());
+        }
+        frames.push_back(std::move(current));
+    }
+
+    // Reads back the queries issued GPU_LATENCY frames ago into the current frame
+    void resolveGpu(int index)
+    {
+        GpuSlot& slot = gpuSlots[index];
+        for (size_t i = 0; i < slot.used; i++) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &ns);
+            current.gpu.push_back({ slot.names[i], ns / 1e6 });
+        }
+        slot.used = 0;
+    }
+};
+
+// Times the enclosing scope on the calling thread
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name) : name(name)
+    {
+        start = Profiler::instance().now();
+        depth = Profiler::threadDepth()++;
+    }
+
+    ~ProfileScope()
+    {
+        Profiler& profiler = Profiler::instance();
+        Profiler::threadDepth()--;
+        ProfileRing& ring = profiler.threadRing();
+        ring.push({ name, start, profiler.now(), ring.thread, depth });
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+    uint32_t depth;
+};
+
+// Times the enclosing GL commands with a GL_TIME_ELAPSED query. Passes can't nest
+class GpuScope
+{
+public:
+    explicit GpuScope(const char* name) { Profiler::instance().beginGpuPass(name); }
+    ~GpuScope() { Profiler::instance().endGpuPass(); }
+
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_GPU(name) GpuScope PROFILE_CONCAT(gpuScope_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef PROFILEROVERLAY_H
+#define PROFILEROVERLAY_H
+
+#include <imgui.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "Profiler.h"
+
+// Dear ImGui window showing the profiler: frame time graph and percentiles, the last
+// frame's counters, CPU scopes (summed per name, indented by nesting) and GPU passes.
+// Call between ImGui::NewFrame() and ImGui::Render()
+inline void drawProfilerOverlay(const Profiler& profiler)
+{
+    const std::vector<FrameStats>& frames = profiler.history();
+    if (frames.empty())
+        return;
+    const FrameStats& last = frames.back();
+
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.8f);
+    ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing);
+
+    // Frame times
+    float times[Profiler::HISTORY];
+    float maxTime = 0.0f;
+    for (size_t i = 0; i < frames.size(); i++) {
+        times[i] = static_cast<float>(frames[i].cpuMs);
+        maxTime = std::max(maxTime, times[i]);
+    }
+    ImGui::Text("Frame %.2f ms (%.0f FPS)", last.cpuMs, last.cpuMs > 0.0 ? 1000.0 / last.cpuMs : 0.0);
+    ImGui::PlotLines("##frames", times, static_cast<int>(frames.size()), 0, nullptr, 0.0f, maxTime * 1.1f, ImVec2(300.0f, 60.0f));
+    ImGui::Text("p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms",
+                profiler.percentile(0.50), profiler.percentile(0.95), profiler.percentile(0.99), maxTime);
+
+    // Counters
+    ImGui::Separator();
+    ImGui::Text("Draw calls %llu, state changes %llu", static_cast<unsigned long long>(last.counters.drawCalls),
+                static_cast<unsigned long long>(last.counters.stateChanges));
+    ImGui::Text("Triangles  %llu (%llu at full detail)", static_cast<unsigned long long>(last.counters.triangles),
+                static_cast<unsigned long long>(last.counters.trianglesFullDetail));
+    ImGui::Text("Uploaded   %.1f KB", last.counters.uploadBytes / 1024.0);
+    ImGui::Text("Occluded   %llu of %llu tested", static_cast<unsigned long long>(last.counters.occlusionCulled),
+                static_cast<unsigned long long>(last.counters.occlusionTested));
+    ImGui::Text("Fence wait %.3f ms", last.counters.fenceWaitMicroseconds / 1000.0);
+
+    // CPU scopes, merged by name and nesting depth in first-seen order
+    struct Row { const char* name; uint32_t depth; uint32_t thread; double ms; int calls; };
+    std::vector<Row> rows;
+    for (const ProfileEvent& e : last.events) {
+        auto it = std::find_if(rows.begin(), rows.end(), [&](const Row& r) {
+            return r.depth == e.depth && r.thread == e.thread && strcmp(r.name, e.name) == 0;
+        });
+        double ms = (e.end - e.start) / 1e6;
+        if (it == rows.end())
+            rows.push_back({ e.name, e.depth, e.thread, ms, 1 });
+        else {
+            it->ms += ms;
+            it->calls++;
+        }
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.thread < b.thread; });
+
+    ImGui::Separator();
+    ImGui::Text("CPU");
+    for (const Row& r : rows) {
+        ImGui::Text("%*s%s%s %.3f ms", static_cast<int>(r.depth * 2), "", r.thread != 0 ? "[worker] " : "", r.name, r.ms);
+        if (r.calls > 1) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("x%d", r.calls);
+        }
+    }
+
+    ImGui::Separator();
+    ImGui::Text("GPU");
+    for (const GpuPassTime& pass : last.gpu)
+        ImGui::Text("%s %.3f ms", pass.name, pass.ms);
+
+    if (profiler.droppedEvents() > 0)
+        ImGui::TextDisabled("%llu events dropped", static_cast<unsigned long long>(profiler.droppedEvents()));
+    if (profiler.capturing())
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Capturing trace (F4 to save)");
+
+    ImGui::End();
+}
+
+#endif
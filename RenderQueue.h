@@ -0,0 +1,325 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "Mesh.h"
+#include "Profiler.h"
+#include "ShaderProgram.h"
+#include "StreamBuffer.h"
+
+// One queued draw: the state it needs and its instance's model matrix
+struct DrawItem
+{
+    const ShaderProgram* program;
+    const Mesh* mesh;
+    uint32_t material;
+    uint32_t lod;
+    glm::mat4 model; // Applied to stored positions, so it includes the mesh's positionTransform
+};
+
+// A sort key and the index of the item it belongs to
+struct SortEntry
+{
+    uint64_t key;
+    uint32_t index;
+};
+
+// Stable LSD radix sort by key, one byte per pass. All eight byte histograms are counted
+// in one read of the keys, and passes where every key has the same byte are skipped (the
+// high program and material bits are usually all zero). scratch must hold count entries
+inline void radixSort(SortEntry* entries, SortEntry* scratch, size_t count)
+{
+    if (count < 2)
+        return;
+    size_t histograms[8][256] = {};
+    for (size_t i = 0; i < count; i++)
+        for (int pass = 0; pass < 8; pass++)
+            histograms[pass][(entries[i].key >> (pass * 8)) & 0xFF]++;
+
+    SortEntry* from = entries;
+    SortEntry* to = scratch;
+    for (int pass = 0; pass < 8; pass++) {
+        size_t* offsets = histograms[pass];
+        int shift = pass * 8;
+        if (offsets[(from[0].key >> shift) & 0xFF] == count)
+            continue;
+        size_t sum = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t n = offsets[digit];
+            offsets[digit] = sum;
+            sum += n;
+        }
+        for (size_t i = 0; i < count; i++)
+            to[offsets[(from[i].key >> shift) & 0xFF]++] = from[i];
+        std::swap(from, to);
+    }
+    if (from != entries)
+        memcpy(entries, from, count * sizeof(SortEntry));
+}
+
+// Collects a frame's draws, sorts them by state and issues them with as few binds and
+// draw calls as possible. Each item gets a 64-bit key, most significant first:
+//   program (8 bits) | material (12) | mesh (16) | level of detail (4) | depth (24)
+// so items sharing a program stay together, then a material, then geometry; within the
+// same state they go front to back for early depth rejection. Programs and meshes get
+// small ids on first sight; the ids only order the keys, binds compare the pointers.
+//
+// A run of items with the same program, material and mesh becomes one batch: a single
+// glMultiDrawElementsIndirect with one command per level of detail when the context has
+// it (GL 4.3 / ARB_multi_draw_indirect, with ARB_base_instance for the commands' first
+// instance), otherwise one glDrawElementsInstanced per level.
+// Model matrices go to one instance buffer in sorted order, so programs must read them
+// from ATTRIBUTE_INSTANCE_MODEL (see shaders/instanced.vert). Every array is kept between
+// frames, so a steady-state frame allocates nothing. With setStream() the matrices and
+// commands are written into a StreamBuffer instead of buffers orphaned every frame
+class RenderQueue
+{
+public:
+    static const int PROGRAM_BITS = 8, MATERIAL_BITS = 12, MESH_BITS = 16, LOD_BITS = 4, DEPTH_BITS = 24;
+
+    // Issue batches with glMultiDrawElementsIndirect; set by init() from the context
+    bool multiDrawIndirect;
+
+    // Colors by material index, set to a program's "color" uniform when it has one
+    std::vector<glm::vec4> materials;
+
+    RenderQueue()
+        : multiDrawIndirect(false), stream(nullptr), instanceVBO(0), indirectBuffer(0), instanceCapacity(0),
+          commandCapacity(0), instanceBuffer(0), instanceBase(0), commandBase(0), instanceOffsetsMoved(false) {}
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    void init()
+    {
+        glGenBuffers(1, &instanceVBO);
+        glGenBuffers(1, &indirectBuffer);
+        multiDrawIndirect = GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+    }
+
+    // Streams per-frame data through buffer (null: back to orphaned buffers). A frame whose
+    // data doesn't fit in the buffer's region falls back to the orphaned buffers
+    void setStream(StreamBuffer* buffer) { stream = buffer; }
+
+    // Queues mesh's level lod with a model matrix; depth is the distance from the eye
+    void submit(const ShaderProgram& program, const Mesh& mesh, uint32_t material, int lod, const glm::mat4& model,
+                float depth)
+    {
+        uint32_t level = static_cast<uint32_t>(std::min<size_t>(std::max(lod, 0), mesh.lods.size() - 1));
+        entries.push_back(SortEntry{ makeKey(id(programIds, &program), material, id(meshIds, &mesh), level, depth),
+                                     static_cast<uint32_t>(items.size()) });
+        items.push_back(DrawItem{ &program, &mesh, material, level, model });
+    }
+
+    size_t size() const { return items.size(); }
+
+    static uint64_t makeKey(uint32_t program, uint32_t material, uint32_t mesh, uint32_t lod, float depth)
+    {
+        // Positive floats order the same as their bits; the top 24 of the 31 keep the order
+        float clamped = std::max(depth, 0.0f);
+        uint32_t bits;
+        memcpy(&bits, &clamped, sizeof(bits));
+        uint64_t key = program & ((1u << PROGRAM_BITS) - 1);
+        key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+        key = (key << MESH_BITS) | (mesh & ((1u << MESH_BITS) - 1));
+        key = (key << LOD_BITS) | (lod & ((1u << LOD_BITS) - 1));
+        return (key << DEPTH_BITS) | (bits >> (31 - DEPTH_BITS));
+    }
+
+    // Sorts, uploads the instance matrices and draws everything queued, then empties the
+    // queue. Leaves the last program bound and no VAO
+    void flush()
+    {
+        if (items.empty())
+            return;
+        if (instanceVBO == 0) {
+            std::cerr << "Error: RenderQueue is not initialized. Cannot draw." << std::endl;
+            items.clear();
+            entries.clear();
+            return;
+        }
+
+        scratch.resize(entries.size());
+        radixSort(entries.data(), scratch.data(), entries.size());
+        buildBatches();
+        upload();
+
+        FrameCounters& counters = Profiler::instance().counters;
+        const ShaderProgram* program = nullptr;
+        const Mesh* boundMesh = nullptr;
+        uint32_t material = 0;
+        int colorLocation = -1;
+        for (const Batch& batch : batches) {
+            const DrawItem& first = items[entries[commands[batch.firstCommand].baseInstance].index];
+            if (first.program != program) {
+                program = first.program;
+                program->use();
+                colorLocation = program->uniform("color");
+                material = ~0u;
+            }
+            if (first.material != material && colorLocation >= 0 && first.material < materials.size()) {
+                program->setVec4(colorLocation, materials[first.material]);
+                counters.stateChanges++;
+            }
+            material = first.material;
+
+            const Mesh& mesh = *first.mesh;
+            if (&mesh != boundMesh) {
+                mesh.bindInstanced(instanceBuffer);
+                boundMesh = &mesh;
+                counters.stateChanges++;
+            }
+            size_t indexSize = (mesh.indexType == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int);
+            if (multiDrawIndirect) {
+                if (instanceOffsetsMoved || instanceBuffer != instanceVBO) {
+                    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+                    setInstanceAttributes(instanceBase);
+                }
+                glMultiDrawElementsIndirect(GL_TRIANGLES, mesh.indexType,
+                                            (void*)(commandBase + batch.firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                            static_cast<GLsizei>(batch.commandCount), 0);
+                counters.drawCalls++;
+            } else {
+                // No base instance before GL 4.2: point the matrices at each command's first
+                glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+                for (uint32_t c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; c++) {
+                    const DrawElementsIndirectCommand& command = commands[c];
+                    setInstanceAttributes(instanceBase + command.baseInstance * sizeof(glm::mat4));
+                    glDrawElementsInstanced(GL_TRIANGLES, command.count, mesh.indexType,
+                                            (void*)(command.firstIndex * indexSize), command.instanceCount);
+                    counters.drawCalls++;
+                }
+            }
+            for (uint32_t c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; c++) {
+                counters.triangles += static_cast<uint64_t>(commands[c].count / 3) * commands[c].instanceCount;
+                counters.trianglesFullDetail += static_cast<uint64_t>(mesh.indexCount / 3) * commands[c].instanceCount;
+            }
+        }
+        glBindVertexArray(0);
+        instanceOffsetsMoved = !multiDrawIndirect || instanceBuffer != instanceVBO;
+
+        items.clear();
+        entries.clear();
+    }
+
+    ~RenderQueue()
+    {
+        if (instanceVBO != 0) glDeleteBuffers(1, &instanceVBO);
+        if (indirectBuffer != 0) glDeleteBuffers(1, &indirectBuffer);
+    }
+
+private:
+    // Layout fixed by GL for glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand
+    {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        uint32_t baseVertex;
+        uint32_t baseInstance; // Also the item's position in sorted order
+    };
+
+    // Commands sharing a program, material and mesh
+    struct Batch
+    {
+        uint32_t firstCommand;
+        uint32_t commandCount;
+    };
+
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> entries, scratch;
+    std::vector<glm::mat4> instances;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<Batch> batches;
+    std::unordered_map<const void*, uint32_t> programIds, meshIds;
+
+    StreamBuffer* stream;
+    unsigned int instanceVBO, indirectBuffer;
+    size_t instanceCapacity, commandCapacity;
+    unsigned int instanceBuffer;     // This frame's matrices: instanceVBO or the stream's buffer
+    size_t instanceBase, commandBase; // ... and their offsets, and the commands'
+    bool instanceOffsetsMoved; // The last flush left instance attributes off offset 0
+
+    static uint32_t id(std::unordered_map<const void*, uint32_t>& ids, const void* object)
+    {
+        auto it = ids.find(object);
+        if (it != ids.end())
+            return it->second;
+        uint32_t next = static_cast<uint32_t>(ids.size());
+        ids.emplace(object, next);
+        return next;
+    }
+
+    // Walks the sorted items: a new batch when the program, material or mesh changes, a
+    // new command when the level does. Instances are numbered in sorted order
+    void buildBatches()
+    {
+        commands.clear();
+        batches.clear();
+        instances.resize(entries.size());
+        const DrawItem* previous = nullptr;
+        for (size_t i = 0; i < entries.size(); i++) {
+            const DrawItem& item = items[entries[i].index];
+            instances[i] = item.model;
+            bool sameState = previous != nullptr && item.program == previous->program
+                          && item.material == previous->material && item.mesh == previous->mesh;
+            if (!sameState)
+                batches.push_back(Batch{ static_cast<uint32_t>(commands.size()), 0 });
+            if (!sameState || item.lod != previous->lod) {
+                const MeshLOD& level = item.mesh->lods[item.lod];
+                commands.push_back(DrawElementsIndirectCommand{ level.count, 0, level.first, 0, static_cast<uint32_t>(i) });
+                batches.back().commandCount++;
+            }
+            commands.back().instanceCount++;
+            previous = &item;
+        }
+    }
+
+    // Writes the matrices (and commands) to the stream, or else streams them into buffers
+    // orphaned every frame, as InstancedMesh does
+    void upload()
+    {
+        instanceBuffer = instanceVBO;
+        instanceBase = commandBase = 0;
+        if (stream != nullptr) {
+            StreamSlice matrices = stream->write(instances.data(), instances.size() * sizeof(glm::mat4));
+            StreamSlice indirect = multiDrawIndirect
+                ? stream->write(commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand))
+                : StreamSlice{ nullptr, 0, 0 };
+            if (matrices && (indirect || !multiDrawIndirect)) {
+                instanceBuffer = stream->buffer();
+                instanceBase = matrices.offset;
+                commandBase = indirect.offset;
+                if (multiDrawIndirect)
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream->buffer());
+                return;
+            }
+        }
+
+        FrameCounters& counters = Profiler::instance().counters;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (instances.size() > instanceCapacity)
+            instanceCapacity = std::max(instances.size(), instanceCapacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(glm::mat4), instances.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        counters.uploadBytes += instances.size() * sizeof(glm::mat4);
+
+        if (!multiDrawIndirect)
+            return;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        if (commands.size() > commandCapacity)
+            commandCapacity = std::max(commands.size(), commandCapacity * 2);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commandCapacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        counters.uploadBytes += commands.size() * sizeof(DrawElementsIndirectCommand);
+    }
+};
+
+#endif
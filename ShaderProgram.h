@@ -0,0 +1,200 @@
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include "Profiler.h"
+
+// A compiled shader stage loaded from a file. A stage can be attached to any number of
+// programs, so shared stages (e.g. one fragment shader) are compiled once
+class Shader
+{
+public:
+    unsigned int id;
+
+    Shader() : id(0) {}
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    // Compiles the file at path as a stage of the given type (GL_VERTEX_SHADER, ...).
+    // defines (e.g. VertexFormat::shaderDefines()) go right after the #version line
+    bool load(unsigned int type, const char* path, const char* defines = "")
+    {
+        std::ifstream file(path);
+        if (!file) {
+            std::cout << "ERROR: Failed to open shader file " << path << std::endl;
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string source = buffer.str();
+        size_t versionEnd = source.compare(0, 8, "#version") == 0 ? source.find('\n') : std::string::npos;
+        source.insert(versionEnd == std::string::npos ? 0 : versionEnd + 1, defines);
+        return compile(type, source.c_str(), path);
+    }
+
+    // Compiles source as a stage of the given type; name is only used in error messages
+    bool compile(unsigned int type, const char* source, const char* name = "shader")
+    {
+        if (id != 0)
+            glDeleteShader(id);
+        id = glCreateShader(type);
+        glShaderSource(id, 1, &source, NULL);
+        glCompileShader(id);
+
+        int success;
+        glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetShaderInfoLog(id, 512, NULL, infoLog);
+            std::cout << "ERROR: Shader compilation failed (" << name << ")\n" << infoLog << std::endl;
+            glDeleteShader(id);
+            id = 0;
+            return false;
+        }
+        return true;
+    }
+
+    ~Shader()
+    {
+        if (id != 0) glDeleteShader(id);
+    }
+};
+
+// A linked shader program. Every active uniform's location is queried once at link time,
+// so the render loop never calls glGetUniformLocation
+class ShaderProgram
+{
+public:
+    unsigned int id;
+
+    ShaderProgram() : id(0) {}
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Links the given stages and caches the uniform locations
+    bool link(std::initializer_list<const Shader*> shaders)
+    {
+        if (id != 0)
+            glDeleteProgram(id);
+        uniforms.clear();
+
+        id = glCreateProgram();
+        for (const Shader* shader : shaders)
+            glAttachShader(id, shader->id);
+        glLinkProgram(id);
+        for (const Shader* shader : shaders)
+            glDetachShader(id, shader->id);
+
+        int success;
+        glGetProgramiv(id, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(id, 512, NULL, infoLog);
+            std::cout << "ERROR: Shader program linking failed\n" << infoLog << std::endl;
+            glDeleteProgram(id);
+            id = 0;
+            return false;
+        }
+
+        // Cache the locations of all active default-block uniforms
+        int count = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+        for (int i = 0; i < count; i++) {
+            char name[256];
+            int length = 0, size = 0;
+            unsigned int type = 0;
+            glGetActiveUniform(id, i, sizeof(name), &length, &size, &type, name);
+            int location = glGetUniformLocation(id, name);
+            if (location < 0)
+                continue; // Lives in a uniform block
+
+            // Arrays are reported as "name[0]"; make them reachable as "name" too
+            std::string key(name, length);
+            uniforms[key] = location;
+            size_t bracket = key.find('[');
+            if (bracket != std::string::npos)
+                uniforms[key.substr(0, bracket)] = location;
+        }
+        return true;
+    }
+
+    // Loads, compiles and links a vertex/fragment pair from files
+    bool load(const char* vertexPath, const char* fragmentPath)
+    {
+        Shader vertex, fragment;
+        return vertex.load(GL_VERTEX_SHADER, vertexPath)
+            && fragment.load(GL_FRAGMENT_SHADER, fragmentPath)
+            && link({ &vertex, &fragment });
+    }
+
+    // Cached location of a uniform (-1 if it isn't active). Look it up once outside hot loops
+    int uniform(const std::string& name) const
+    {
+        auto it = uniforms.find(name);
+        return it != uniforms.end() ? it->second : -1;
+    }
+
+    // Binds a uniform block of this program to a binding point
+    bool bindBlock(const char* name, unsigned int binding) const
+    {
+        unsigned int index = glGetUniformBlockIndex(id, name);
+        if (index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(id, index, binding);
+        return true;
+    }
+
+    void use() const
+    {
+        glUseProgram(id);
+        Profiler::instance().counters.stateChanges++;
+    }
+
+    void setMat4(int location, const glm::mat4& value) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+
+    void setVec4(int location, const glm::vec4& value) const
+    {
+        glUniform4fv(location, 1, glm::value_ptr(value));
+    }
+
+    void setVec4(int location, const glm::vec4* values, int count) const
+    {
+        glUniform4fv(location, count, glm::value_ptr(values[0]));
+    }
+
+    void setVec3(int location, const glm::vec3& value) const
+    {
+        glUniform3fv(location, 1, glm::value_ptr(value));
+    }
+
+    void setFloat(int location, float value) const
+    {
+        glUniform1f(location, value);
+    }
+
+    void setUint(int location, unsigned int value) const
+    {
+        glUniform1ui(location, value);
+    }
+
+    ~ShaderProgram()
+    {
+        if (id != 0) glDeleteProgram(id);
+    }
+
+private:
+    std::unordered_map<std::string, int> uniforms;
+};
+
+#endif
@@ -0,0 +1,570 @@
+#ifndef SOFTWARERASTERIZER_H
+#define SOFTWARERASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "JobSystem.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SOFTWARE_RASTERIZER_AVX2 1
+#endif
+
+// Triangle geometry kept on the CPU for SoftwareRasterizer (a Mesh only has GL buffers)
+struct RasterMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+
+    // From tightly packed xyz floats, e.g. Cube::meshVertices()
+    static RasterMesh fromArrays(const std::vector<float>& positions, const std::vector<unsigned int>& indices)
+    {
+        RasterMesh mesh;
+        for (size_t i = 0; i + 2 < positions.size(); i += 3)
+            mesh.positions.emplace_back(positions[i], positions[i + 1], positions[i + 2]);
+        mesh.indices = indices;
+        return mesh;
+    }
+
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Wireframe matches glPolygonMode(GL_LINE); Solid fills with the color, like
+// shaders/color.frag; Shaded lights each face from a fixed direction
+enum class RasterFill { Wireframe, Solid, Shaded };
+
+// Renders triangles on the CPU with the conventions of the GL path (clip space from
+// view-projection * model, depth test GL_LESS on [0, 1] window depth, no face culling), for
+// machines without a GPU. Draws are recorded with draw() and rasterized by render() in two
+// parallel passes on a JobSystem:
+//   1. Geometry: the draw list is split into chunks; each chunk transforms its vertices,
+//      culls and near-clips its triangles, sets up their edge functions and bins them into
+//      the 64x64 screen tiles they touch.
+//   2. Raster: each worker claims one tile at a time, so a tile's pixels are only touched
+//      by one thread. It walks the chunks' bins in submission order and rasterizes 8x8
+//      blocks: blocks are rejected by the edge functions at their corners, and by a
+//      hierarchical depth buffer holding each block's farthest depth, then 8 pixels of a
+//      row are tested at once with AVX2 (when the CPU has it; scalar otherwise, same
+//      results).
+// Images don't depend on the thread count. Every array is kept between frames
+class SoftwareRasterizer
+{
+public:
+    static const int TILE_SIZE = 64, BLOCK_SIZE = 8;
+
+    // Rasterize with AVX2; set from the CPU on construction
+    bool useAvx2;
+
+    // Counts from the last render()
+    struct Statistics
+    {
+        uint64_t triangles = 0;     // Submitted
+        uint64_t clipped = 0;       // Crossing the near plane
+        uint64_t binned = 0;        // After culling and near clipping
+        uint64_t blocks = 0;        // 8x8 blocks rasterized
+        uint64_t blocksHidden = 0;  // Skipped by the hierarchical depth test
+    };
+    Statistics statistics;
+
+    explicit SoftwareRasterizer(int width = 1, int height = 1)
+        : useAvx2(cpuHasAvx2()), viewProjection(1.0f), clearColor(0xFF000000u)
+    {
+        resize(width, height);
+    }
+
+    SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+    SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+
+    void resize(int newWidth, int newHeight)
+    {
+        width = std::max(newWidth, 1);
+        height = std::max(newHeight, 1);
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        stride = tilesX * TILE_SIZE;
+        color.assign(size_t(stride) * tilesY * TILE_SIZE, clearColor);
+        depth.assign(color.size(), 1.0f);
+        blockDepth.assign(color.size() / (BLOCK_SIZE * BLOCK_SIZE), 1.0f);
+        tileStatistics.resize(size_t(tilesX) * tilesY);
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    void setViewProjection(const glm::mat4& matrix) { viewProjection = matrix; }
+
+    // Color every pixel starts from in the next render()
+    void setClearColor(const glm::vec4& value) { clearColor = packColor(value); }
+
+    // Queues mesh with a model matrix (e.g. Object::getModelMatrix()); the mesh must stay
+    // alive until render()
+    void draw(const RasterMesh& mesh, const glm::mat4& model, const glm::vec4& value, RasterFill fill)
+    {
+        draws.push_back(DrawCommand{ &mesh, model, packColor(value), value, fill });
+    }
+
+    // Clears the target, rasterizes everything queued and empties the queue
+    void render(JobSystem& jobs)
+    {
+        statistics = Statistics();
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(draws.size(), jobs.threadCount() * 4));
+        if (chunks.size() < chunkCount)
+            chunks.resize(chunkCount);
+        for (size_t c = 0; c < chunkCount; c++)
+            chunks[c].binStart.resize(size_t(tilesX) * tilesY + 1);
+
+        // One job per worker, each claiming the next chunk (then tile) until none are left
+        std::atomic<size_t> nextChunk(0), nextTile(0);
+        const size_t tileCount = size_t(tilesX) * tilesY;
+        jobs.parallelFor(0, jobs.threadCount(), 1, [&](size_t, size_t) {
+            for (size_t c; (c = nextChunk.fetch_add(1)) < chunkCount;)
+                setupChunk(chunks[c], draws.size() * c / chunkCount, draws.size() * (c + 1) / chunkCount);
+        });
+        // Which draws land in a chunk changes with the view, so the chunks share their
+        // largest bin capacity rather than each growing to its own peak
+        size_t binCapacity = 0;
+        for (size_t c = 0; c < chunkCount; c++)
+            binCapacity = std::max(binCapacity, chunks[c].binned.capacity());
+        for (size_t c = 0; c < chunkCount; c++)
+            chunks[c].binned.reserve(binCapacity);
+
+        jobs.parallelFor(0, jobs.threadCount(), 1, [&](size_t, size_t) {
+            for (size_t tile; (tile = nextTile.fetch_add(1)) < tileCount;)
+                rasterizeTile(static_cast<int>(tile), chunkCount);
+        });
+
+        for (size_t c = 0; c < chunkCount; c++) {
+            statistics.triangles += chunks[c].submitted;
+            statistics.clipped += chunks[c].clipped;
+            statistics.binned += chunks[c].triangles.size();
+        }
+        for (const TileStatistics& tile : tileStatistics) {
+            statistics.blocks += tile.blocks;
+            statistics.blocksHidden += tile.blocksHidden;
+        }
+        draws.clear();
+    }
+
+    // Pixel (x, y) of the last render, RGBA in memory order, top row first
+    uint32_t pixel(int x, int y) const { return color[size_t(y) * stride + x]; }
+    float depthAt(int x, int y) const { return depth[size_t(y) * stride + x]; }
+
+    // Rows of RGBA pixels, top row first, rowStride() pixels apart
+    const uint32_t* pixels() const { return color.data(); }
+    int rowStride() const { return stride; }
+
+    // Tightly packed RGB rows, top row first (as Framebuffer::readPixels)
+    void readPixels(std::vector<unsigned char>& rgb) const
+    {
+        rgb.resize(size_t(width) * height * 3);
+        unsigned char* out = rgb.data();
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint32_t value = pixel(x, y);
+                *out++ = value & 0xFF;
+                *out++ = (value >> 8) & 0xFF;
+                *out++ = (value >> 16) & 0xFF;
+            }
+        }
+    }
+
+    // Writes the last render as a binary PPM (P6)
+    bool writePPM(const char* path) const
+    {
+        std::vector<unsigned char> rgb;
+        readPixels(rgb);
+
+        FILE* file = fopen(path, "wb");
+        if (file == nullptr) {
+            std::cout << "Failed to write " << path << std::endl;
+            return false;
+        }
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        fclose(file);
+        return ok;
+    }
+
+    static uint32_t packColor(const glm::vec4& value)
+    {
+        auto channel = [](float c) { return static_cast<uint32_t>(std::floor(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f)); };
+        return channel(value.x) | channel(value.y) << 8 | channel(value.z) << 16 | channel(value.w) << 24;
+    }
+
+private:
+    struct DrawCommand
+    {
+        const RasterMesh* mesh;
+        glm::mat4 model;
+        uint32_t color;
+        glm::vec4 value;
+        RasterFill fill;
+    };
+
+    // A set-up screen-space triangle. Edge i is e(x, y) = a*x + b*y + c at pixel centers,
+    // positive inside; depth is the plane z(x, y) = za*x + zb*y + zc
+    struct Triangle
+    {
+        float a[3], b[3], c[3];
+        float threshold[3];     // Solid: lowest inside value, 0 on top-left edges (ties go to one triangle)
+        float inverseLength[3]; // Wireframe: e * inverseLength is the distance to the edge in pixels
+        float za, zb, zc;
+        float zMin;
+        int minX, minY, maxX, maxY; // Pixel bounds, inclusive
+        uint32_t color;
+        bool wireframe;
+    };
+
+    // One pass-1 work item: its draws' triangles and their bins. Tile i's triangle indices
+    // are binned[binStart[i]] up to binned[binStart[i + 1]], one flat array so the bins stop
+    // growing once the busiest frame has been seen
+    struct Chunk
+    {
+        std::vector<glm::vec4> clip;
+        std::vector<Triangle> triangles;
+        std::vector<uint32_t> binStart;
+        std::vector<uint32_t> binned;
+        uint64_t submitted = 0, clipped = 0;
+    };
+
+    struct TileStatistics
+    {
+        uint64_t blocks = 0, blocksHidden = 0;
+    };
+
+    int width, height, tilesX, tilesY, stride;
+    glm::mat4 viewProjection;
+    uint32_t clearColor;
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+    std::vector<float> blockDepth; // Farthest depth of each 8x8 block
+    std::vector<DrawCommand> draws;
+    std::vector<Chunk> chunks;
+    std::vector<TileStatistics> tileStatistics;
+
+    static bool cpuHasAvx2()
+    {
+#ifdef SOFTWARE_RASTERIZER_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    void setupChunk(Chunk& chunk, size_t firstDraw, size_t endDraw)
+    {
+        chunk.triangles.clear();
+        chunk.submitted = chunk.clipped = 0;
+
+        // Room for every triangle (near clipping rarely adds any), plus headroom as the view changes
+        size_t triangleCount = 0;
+        for (size_t d = firstDraw; d < endDraw; d++)
+            triangleCount += draws[d].mesh->triangleCount();
+        if (chunk.triangles.capacity() < triangleCount)
+            chunk.triangles.reserve(triangleCount * 3 / 2);
+
+        const glm::vec3 light = glm::normalize(glm::vec3(0.3f, 0.8f, 0.5f));
+        for (size_t d = firstDraw; d < endDraw; d++) {
+            const DrawCommand& draw = draws[d];
+            const RasterMesh& mesh = *draw.mesh;
+            glm::mat4 toClip = viewProjection * draw.model;
+            chunk.clip.resize(mesh.positions.size());
+            for (size_t v = 0; v < mesh.positions.size(); v++)
+                chunk.clip[v] = toClip * glm::vec4(mesh.positions[v], 1.0f);
+            // Cofactors of the model's 3x3: the inverse transpose up to scale, enough for directions
+            glm::mat3 basis(draw.model);
+            glm::vec3 normalColumns[3] = { glm::cross(basis[1], basis[2]), glm::cross(basis[2], basis[0]),
+                                           glm::cross(basis[0], basis[1]) };
+
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                const glm::vec4* v[3] = { &chunk.clip[mesh.indices[i]], &chunk.clip[mesh.indices[i + 1]],
+                                          &chunk.clip[mesh.indices[i + 2]] };
+                uint32_t faceColor = draw.color;
+                if (draw.fill == RasterFill::Shaded) {
+                    const glm::vec3& p0 = mesh.positions[mesh.indices[i]];
+                    glm::vec3 n = glm::cross(mesh.positions[mesh.indices[i + 1]] - p0, mesh.positions[mesh.indices[i + 2]] - p0);
+                    glm::vec3 normal = normalColumns[0] * n.x + normalColumns[1] * n.y + normalColumns[2] * n.z;
+                    float lambert = std::abs(glm::dot(glm::normalize(normal), light));
+                    faceColor = packColor(glm::vec4(glm::vec3(draw.value) * (0.25f + 0.75f * lambert), draw.value.w));
+                }
+                chunk.submitted++;
+                clipTriangle(chunk, v, faceColor, draw.fill == RasterFill::Wireframe);
+            }
+        }
+        binTriangles(chunk);
+    }
+
+    // Counting sort of the chunk's triangles into the tiles their bounds touch, in order
+    void binTriangles(Chunk& chunk)
+    {
+        std::fill(chunk.binStart.begin(), chunk.binStart.end(), 0u);
+        for (const Triangle& t : chunk.triangles)
+            for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ty++)
+                for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; tx++)
+                    chunk.binStart[size_t(ty) * tilesX + tx + 1]++;
+        for (size_t i = 1; i < chunk.binStart.size(); i++)
+            chunk.binStart[i] += chunk.binStart[i - 1];
+        chunk.binned.resize(chunk.binStart.back());
+
+        // Fill each bin from its start, then shift the starts back
+        for (uint32_t index = 0; index < chunk.triangles.size(); index++) {
+            const Triangle& t = chunk.triangles[index];
+            for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ty++)
+                for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; tx++)
+                    chunk.binned[chunk.binStart[size_t(ty) * tilesX + tx]++] = index;
+        }
+        for (size_t i = chunk.binStart.size() - 1; i > 0; i--)
+            chunk.binStart[i] = chunk.binStart[i - 1];
+        chunk.binStart[0] = 0;
+    }
+
+    // Rejects a triangle outside one frustum plane and clips it against the near plane
+    // (the only plane that can't be left to the screen bounds and the depth test)
+    void clipTriangle(Chunk& chunk, const glm::vec4* const v[3], uint32_t faceColor, bool wireframe)
+    {
+        unsigned int outside = ~0u, nearMask = 0;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4& p = *v[i];
+            unsigned int code = (p.x < -p.w) | (p.x > p.w) << 1 | (p.y < -p.w) << 2 | (p.y > p.w) << 3
+                              | (p.z < -p.w) << 4 | (p.z > p.w) << 5;
+            outside &= code;
+            nearMask |= code & 16;
+        }
+        if (outside != 0)
+            return;
+        if (nearMask == 0) {
+            addTriangle(chunk, *v[0], *v[1], *v[2], faceColor, wireframe);
+            return;
+        }
+
+        // Sutherland-Hodgman against z = -w leaves 3 or 4 vertices; fan them
+        chunk.clipped++;
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4& p = *v[i];
+            const glm::vec4& q = *v[(i + 1) % 3];
+            float dp = p.z + p.w, dq = q.z + q.w;
+            if (dp >= 0.0f)
+                polygon[count++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f))
+                polygon[count++] = p + (q - p) * (dp / (dp - dq));
+        }
+        for (int i = 1; i + 1 < count; i++)
+            addTriangle(chunk, polygon[0], polygon[i], polygon[i + 1], faceColor, wireframe);
+    }
+
+    void addTriangle(Chunk& chunk, const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, uint32_t faceColor,
+                     bool wireframe)
+    {
+        // Window coordinates with the top row first, snapped to 1/256 pixel
+        glm::vec3 s[3];
+        const glm::vec4* clip[3] = { &c0, &c1, &c2 };
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4& p = *clip[i];
+            float x = (p.x / p.w * 0.5f + 0.5f) * width;
+            float y = (0.5f - p.y / p.w * 0.5f) * height;
+            s[i] = glm::vec3(std::round(x * 256.0f) / 256.0f, std::round(y * 256.0f) / 256.0f, p.z / p.w * 0.5f + 0.5f);
+        }
+
+        double area = (double(s[1].x) - s[0].x) * (double(s[2].y) - s[0].y) - (double(s[2].x) - s[0].x) * (double(s[1].y) - s[0].y);
+        if (area == 0.0)
+            return;
+
+        Triangle t;
+        float sign = area > 0.0 ? 1.0f : -1.0f;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec3& p = s[(i + 1) % 3];
+            const glm::vec3& q = s[(i + 2) % 3];
+            // Edge from p to q, opposite vertex i
+            t.a[i] = sign * (p.y - q.y);
+            t.b[i] = sign * (q.x - p.x);
+            t.c[i] = sign * static_cast<float>(double(p.x) * q.y - double(p.y) * q.x);
+            bool topLeft = t.a[i] > 0.0f || (t.a[i] == 0.0f && t.b[i] > 0.0f);
+            t.threshold[i] = topLeft ? 0.0f : std::numeric_limits<float>::denorm_min();
+            t.inverseLength[i] = 1.0f / std::sqrt(t.a[i] * t.a[i] + t.b[i] * t.b[i]);
+        }
+
+        // Depth plane through the three vertices
+        double dx1 = s[1].x - s[0].x, dy1 = s[1].y - s[0].y, dx2 = s[2].x - s[0].x, dy2 = s[2].y - s[0].y;
+        double dz1 = s[1].z - s[0].z, dz2 = s[2].z - s[0].z;
+        double za = (dz1 * dy2 - dz2 * dy1) / area, zb = (dz2 * dx1 - dz1 * dx2) / area;
+        t.za = static_cast<float>(za);
+        t.zb = static_cast<float>(zb);
+        t.zc = static_cast<float>(s[0].z - za * s[0].x - zb * s[0].y);
+        t.zMin = std::min(s[0].z, std::min(s[1].z, s[2].z));
+
+        // Pixels whose centers may be covered; lines reach half a pixel past the edges
+        float pad = wireframe ? 1.0f : 0.0f;
+        float minX = std::min(s[0].x, std::min(s[1].x, s[2].x)) - pad, maxX = std::max(s[0].x, std::max(s[1].x, s[2].x)) + pad;
+        float minY = std::min(s[0].y, std::min(s[1].y, s[2].y)) - pad, maxY = std::max(s[0].y, std::max(s[1].y, s[2].y)) + pad;
+        t.minX = std::max(0, static_cast<int>(std::ceil(minX - 0.5f)));
+        t.minY = std::max(0, static_cast<int>(std::ceil(minY - 0.5f)));
+        t.maxX = std::min(width - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+        t.maxY = std::min(height - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+        t.color = faceColor;
+        t.wireframe = wireframe;
+
+        chunk.triangles.push_back(t);
+    }
+
+    void rasterizeTile(int tile, size_t chunkCount)
+    {
+        int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+        TileStatistics& counts = tileStatistics[tile];
+        counts = TileStatistics();
+
+        for (int y = tileY; y < tileY + TILE_SIZE; y++) {
+            std::fill_n(&color[size_t(y) * stride + tileX], TILE_SIZE, clearColor);
+            std::fill_n(&depth[size_t(y) * stride + tileX], TILE_SIZE, 1.0f);
+        }
+        for (int by = tileY / BLOCK_SIZE; by < (tileY + TILE_SIZE) / BLOCK_SIZE; by++)
+            std::fill_n(&blockDepth[size_t(by) * (stride / BLOCK_SIZE) + tileX / BLOCK_SIZE], TILE_SIZE / BLOCK_SIZE, 1.0f);
+
+        for (size_t c = 0; c < chunkCount; c++) {
+            const Chunk& chunk = chunks[c];
+            for (uint32_t i = chunk.binStart[tile]; i < chunk.binStart[tile + 1]; i++) {
+                const Triangle& t = chunk.triangles[chunk.binned[i]];
+                int x0 = std::max(t.minX, tileX), x1 = std::min(t.maxX, tileX + TILE_SIZE - 1);
+                int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, tileY + TILE_SIZE - 1);
+                for (int by = y0 & ~(BLOCK_SIZE - 1); by <= y1; by += BLOCK_SIZE)
+                    for (int bx = x0 & ~(BLOCK_SIZE - 1); bx <= x1; bx += BLOCK_SIZE)
+                        rasterizeBlock(t, bx, by, x0, x1, y0, y1, counts);
+            }
+        }
+    }
+
+    void rasterizeBlock(const Triangle& t, int bx, int by, int x0, int x1, int y0, int y1, TileStatistics& counts)
+    {
+        // Outside if an edge is negative at the block's pixel center nearest its inside
+        for (int i = 0; i < 3; i++) {
+            float x = bx + (t.a[i] > 0.0f ? BLOCK_SIZE - 0.5f : 0.5f);
+            float y = by + (t.b[i] > 0.0f ? BLOCK_SIZE - 0.5f : 0.5f);
+            float e = t.a[i] * x + t.b[i] * y + t.c[i];
+            if (t.wireframe ? e * t.inverseLength[i] < -0.5f : e < t.threshold[i])
+                return;
+        }
+        float& farthest = blockDepth[size_t(by / BLOCK_SIZE) * (stride / BLOCK_SIZE) + bx / BLOCK_SIZE];
+        if (t.zMin >= farthest) {
+            counts.blocksHidden++;
+            return;
+        }
+        counts.blocks++;
+
+        int rowBegin = std::max(y0 - by, 0), rowEnd = std::min(y1 - by, BLOCK_SIZE - 1);
+        int laneBegin = std::max(x0 - bx, 0), laneEnd = std::min(x1 - bx, BLOCK_SIZE - 1);
+        bool written;
+#ifdef SOFTWARE_RASTERIZER_AVX2
+        if (useAvx2)
+            written = rasterizeRowsAvx2(t, bx, by, rowBegin, rowEnd, laneBegin, laneEnd);
+        else
+#endif
+            written = rasterizeRows(t, bx, by, rowBegin, rowEnd, laneBegin, laneEnd);
+
+        if (written) {
+            float newFarthest = 0.0f;
+            for (int row = 0; row < BLOCK_SIZE; row++) {
+                const float* line = &depth[size_t(by + row) * stride + bx];
+                for (int lane = 0; lane < BLOCK_SIZE; lane++)
+                    newFarthest = std::max(newFarthest, line[lane]);
+            }
+            farthest = newFarthest;
+        }
+    }
+
+    // One block's rows; the reference for the AVX2 version, which does the same float
+    // operations in the same order
+    bool rasterizeRows(const Triangle& t, int bx, int by, int rowBegin, int rowEnd, int laneBegin, int laneEnd)
+    {
+        bool written = false;
+        for (int row = rowBegin; row <= rowEnd; row++) {
+            float y = by + row + 0.5f;
+            float rowE[3];
+            for (int i = 0; i < 3; i++)
+                rowE[i] = t.b[i] * y + t.c[i];
+            float rowZ = t.zb * y + t.zc;
+            uint32_t* colorRow = &color[size_t(by + row) * stride + bx];
+            float* depthRow = &depth[size_t(by + row) * stride + bx];
+            for (int lane = laneBegin; lane <= laneEnd; lane++) {
+                float x = bx + lane + 0.5f;
+                float e[3];
+                for (int i = 0; i < 3; i++)
+                    e[i] = t.a[i] * x + rowE[i];
+                bool inside;
+                if (t.wireframe) {
+                    float d = std::min(e[0] * t.inverseLength[0], std::min(e[1] * t.inverseLength[1], e[2] * t.inverseLength[2]));
+                    inside = d >= -0.5f && d < 0.5f;
+                } else {
+                    inside = e[0] >= t.threshold[0] && e[1] >= t.threshold[1] && e[2] >= t.threshold[2];
+                }
+                float z = t.za * x + rowZ;
+                if (inside && z < depthRow[lane]) {
+                    depthRow[lane] = z;
+                    colorRow[lane] = t.color;
+                    written = true;
+                }
+            }
+        }
+        return written;
+    }
+
+#ifdef SOFTWARE_RASTERIZER_AVX2
+    __attribute__((target("avx2"))) bool rasterizeRowsAvx2(const Triangle& t, int bx, int by, int rowBegin, int rowEnd,
+                                                           int laneBegin, int laneEnd)
+    {
+        const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i lanes = _mm256_and_si256(_mm256_cmpgt_epi32(laneIndex, _mm256_set1_epi32(laneBegin - 1)),
+                                         _mm256_cmpgt_epi32(_mm256_set1_epi32(laneEnd + 1), laneIndex));
+        __m256 laneMask = _mm256_castsi256_ps(lanes);
+        __m256 x = _mm256_add_ps(_mm256_set1_ps(float(bx)), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+        __m256 ax[3];
+        for (int i = 0; i < 3; i++)
+            ax[i] = _mm256_mul_ps(_mm256_set1_ps(t.a[i]), x);
+        __m256 zx = _mm256_mul_ps(_mm256_set1_ps(t.za), x);
+
+        __m256 any = _mm256_setzero_ps();
+        for (int row = rowBegin; row <= rowEnd; row++) {
+            float y = by + row + 0.5f;
+            __m256 e[3];
+            for (int i = 0; i < 3; i++)
+                e[i] = _mm256_add_ps(ax[i], _mm256_set1_ps(t.b[i] * y + t.c[i]));
+            __m256 inside;
+            if (t.wireframe) {
+                __m256 d = _mm256_min_ps(_mm256_mul_ps(e[0], _mm256_set1_ps(t.inverseLength[0])),
+                                         _mm256_min_ps(_mm256_mul_ps(e[1], _mm256_set1_ps(t.inverseLength[1])),
+                                                       _mm256_mul_ps(e[2], _mm256_set1_ps(t.inverseLength[2]))));
+                inside = _mm256_and_ps(_mm256_cmp_ps(d, _mm256_set1_ps(-0.5f), _CMP_GE_OQ),
+                                       _mm256_cmp_ps(d, _mm256_set1_ps(0.5f), _CMP_LT_OQ));
+            } else {
+                inside = _mm256_and_ps(_mm256_cmp_ps(e[0], _mm256_set1_ps(t.threshold[0]), _CMP_GE_OQ),
+                                       _mm256_and_ps(_mm256_cmp_ps(e[1], _mm256_set1_ps(t.threshold[1]), _CMP_GE_OQ),
+                                                     _mm256_cmp_ps(e[2], _mm256_set1_ps(t.threshold[2]), _CMP_GE_OQ)));
+            }
+            float* depthRow = &depth[size_t(by + row) * stride + bx];
+            uint32_t* colorRow = &color[size_t(by + row) * stride + bx];
+            __m256 z = _mm256_add_ps(zx, _mm256_set1_ps(t.zb * y + t.zc));
+            __m256 stored = _mm256_loadu_ps(depthRow);
+            __m256 mask = _mm256_and_ps(_mm256_and_ps(inside, laneMask), _mm256_cmp_ps(z, stored, _CMP_LT_OQ));
+            if (_mm256_movemask_ps(mask) == 0)
+                continue;
+            _mm256_storeu_ps(depthRow, _mm256_blendv_ps(stored, z, mask));
+            __m256 pixels = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(colorRow)));
+            __m256 fill = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(t.color)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(colorRow), _mm256_castps_si256(_mm256_blendv_ps(pixels, fill, mask)));
+            any = _mm256_or_ps(any, mask);
+        }
+        return _mm256_movemask_ps(any) != 0;
+    }
+#endif
+};
+
+#endif
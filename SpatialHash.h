@@ -0,0 +1,202 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "Bounds.h"
+
+// Broadphase over AABBs on a uniform grid of cubic cells, hashed so the world needs no
+// fixed extent. Built in one pass: (cell, item) pairs are sorted by cell and packed into
+// one array, and an open-addressing table maps each occupied cell to its range. Items
+// covering more than MAX_CELLS cells (floors, terrain) skip the grid and are tested on
+// every query. Items are identified by their index in the bounds array passed to build().
+// update() moves one item without a rebuild: an item that stays in the cells it was built
+// into only changes its bounds, and one that leaves them is tested on every query until
+// the next build(); stale() says when there are enough of those to rebuild
+class SpatialHash
+{
+public:
+    static const int MAX_CELLS = 64;
+
+    float cellSize;
+
+    explicit SpatialHash(float cellSize = 4.0f) : cellSize(cellSize), queryStamp(0) {}
+
+    void build(const std::vector<AABB>& bounds)
+    {
+        itemBounds = bounds;
+        stamps.assign(bounds.size(), 0);
+        queryStamp = 0;
+        large.clear();
+        moved.clear();
+        where.assign(bounds.size(), NOWHERE);
+
+        entries.clear();
+        entries.reserve(bounds.size() * 2);
+        for (size_t i = 0; i < bounds.size(); i++) {
+            if (bounds[i].empty())
+                continue;
+            int lo[3], hi[3];
+            cellRange(bounds[i], lo, hi);
+            int64_t cells = int64_t(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+            if (cells > MAX_CELLS) {
+                large.push_back(static_cast<int>(i));
+                where[i] = LISTED;
+                continue;
+            }
+            where[i] = IN_GRID;
+            for (int x = lo[0]; x <= hi[0]; x++)
+                for (int y = lo[1]; y <= hi[1]; y++)
+                    for (int z = lo[2]; z <= hi[2]; z++)
+                        entries.emplace_back(cellKey(x, y, z), static_cast<int>(i));
+        }
+        std::sort(entries.begin(), entries.end());
+
+        items.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); i++)
+            items[i] = entries[i].second;
+
+        // One table slot per occupied cell at <= 50% load
+        size_t cellCount = 0;
+        for (size_t i = 0; i < entries.size(); i++)
+            cellCount += (i == 0 || entries[i].first != entries[i - 1].first);
+        size_t capacity = 16;
+        while (capacity < cellCount * 2)
+            capacity *= 2;
+        table.assign(capacity, Cell{ EMPTY, 0, 0 });
+        mask = capacity - 1;
+
+        for (size_t begin = 0; begin < entries.size();) {
+            size_t end = begin;
+            while (end < entries.size() && entries[end].first == entries[begin].first)
+                end++;
+            size_t slot = hashKey(entries[begin].first) & mask;
+            while (table[slot].key != EMPTY)
+                slot = (slot + 1) & mask;
+            table[slot] = Cell{ entries[begin].first, static_cast<uint32_t>(begin), static_cast<uint32_t>(end) };
+            begin = end;
+        }
+    }
+
+    // Gives item new bounds. Large items and items already moved out of their cells are
+    // tested on every query anyway, so only a change of cells needs recording
+    void update(int item, const AABB& box)
+    {
+        if (where[item] == NOWHERE && !box.empty()) {
+            where[item] = LISTED;
+            moved.push_back(item);
+        } else if (where[item] == IN_GRID) {
+            int lo[3], hi[3], newLo[3], newHi[3];
+            cellRange(itemBounds[item], lo, hi);
+            cellRange(box, newLo, newHi);
+            if (box.empty() || !std::equal(lo, lo + 3, newLo) || !std::equal(hi, hi + 3, newHi)) {
+                where[item] = LISTED;
+                moved.push_back(item);
+            }
+        }
+        itemBounds[item] = box;
+    }
+
+    // True once so many items left their cells that a build() is cheaper than testing them
+    bool stale() const { return moved.size() > std::max<size_t>(MAX_CELLS, itemBounds.size() / 16); }
+
+    // Appends the items whose bounds overlap box (each at most once). Not reentrant
+    void query(const AABB& box, std::vector<int>& out) const
+    {
+        if (table.empty() && large.empty() && moved.empty())
+            return;
+        if (++queryStamp == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            queryStamp = 1;
+        }
+
+        if (!table.empty()) {
+            int lo[3], hi[3];
+            cellRange(box, lo, hi);
+            for (int x = lo[0]; x <= hi[0]; x++) {
+                for (int y = lo[1]; y <= hi[1]; y++) {
+                    for (int z = lo[2]; z <= hi[2]; z++) {
+                        const Cell* cell = find(cellKey(x, y, z));
+                        if (cell == nullptr)
+                            continue;
+                        for (uint32_t i = cell->begin; i < cell->end; i++)
+                            test(items[i], box, out);
+                    }
+                }
+            }
+        }
+        for (int item : large)
+            test(item, box, out);
+        for (int item : moved)
+            test(item, box, out);
+    }
+
+    const AABB& bounds(int item) const { return itemBounds[item]; }
+    size_t size() const { return itemBounds.size(); }
+
+private:
+    struct Cell
+    {
+        uint64_t key;
+        uint32_t begin, end;
+    };
+
+    static const uint64_t EMPTY = ~uint64_t(0);
+    enum : uint8_t { IN_GRID, LISTED, NOWHERE }; // LISTED: in large or moved, tested on every query
+
+    std::vector<AABB> itemBounds;
+    std::vector<int> items; // Grouped by cell
+    std::vector<Cell> table;
+    std::vector<int> large;
+    std::vector<int> moved;     // Left their cells since build(); their grid entries are stale
+    std::vector<uint8_t> where; // Per item: how queries find it
+    std::vector<std::pair<uint64_t, int>> entries; // (cell, item) pairs, kept so rebuilds don't allocate
+    size_t mask = 0;
+
+    mutable std::vector<uint32_t> stamps;
+    mutable uint32_t queryStamp;
+
+    void cellRange(const AABB& box, int lo[3], int hi[3]) const
+    {
+        for (int a = 0; a < 3; a++) {
+            lo[a] = static_cast<int>(std::floor(box.min[a] / cellSize));
+            hi[a] = static_cast<int>(std::floor(box.max[a] / cellSize));
+        }
+    }
+
+    // 21 bits per axis, two's complement
+    static uint64_t cellKey(int x, int y, int z)
+    {
+        return (uint64_t(uint32_t(x) & 0x1FFFFF) << 42) | (uint64_t(uint32_t(y) & 0x1FFFFF) << 21) | uint64_t(uint32_t(z) & 0x1FFFFF);
+    }
+
+    static size_t hashKey(uint64_t key)
+    {
+        key ^= key >> 31;
+        key *= 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(key ^ (key >> 29));
+    }
+
+    const Cell* find(uint64_t key) const
+    {
+        for (size_t slot = hashKey(key) & mask;; slot = (slot + 1) & mask) {
+            if (table[slot].key == key)
+                return &table[slot];
+            if (table[slot].key == EMPTY)
+                return nullptr;
+        }
+    }
+
+    void test(int item, const AABB& box, std::vector<int>& out) const
+    {
+        if (stamps[item] == queryStamp)
+            return;
+        stamps[item] = queryStamp;
+        if (itemBounds[item].overlaps(box))
+            out.push_back(item);
+    }
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "Profiler.h"
+
+// Part of a StreamBuffer's current region: write size bytes at data, then commit() it.
+// GL reads it at offset in the buffer
+struct StreamSlice
+{
+    void* data; // Null when the region is full
+    size_t offset;
+    size_t size;
+
+    explicit operator bool() const { return data != nullptr; }
+};
+
+// Per-frame data (uniforms, instance matrices, indirect commands, dynamic vertices)
+// streamed through one buffer split into FRAMES regions used in turn. A frame allocates
+// slices of its region; endFrame() fences the region after the frame's draws, and
+// beginFrame() waits on that fence only when the GPU is still FRAMES - 1 frames behind.
+//
+// With GL 4.4 / ARB_buffer_storage the buffer is mapped once, persistent and coherent,
+// so slices are written straight into memory the GPU reads: no driver copy and no
+// implicit sync. On GL 3.3 slices are staged in memory, and commit() copies each one in
+// with an unsynchronized glMapBufferRange (the fences make that safe, as in
+// AssetStreamer's ring). A frame that outgrows its region gets null slices, which callers
+// upload their own way, and the buffer grows at the next beginFrame().
+//
+// Dynamic meshes: allocate the vertices aligned to the vertex size, point the attributes
+// at buffer() and draw from first vertex (or base vertex) offset / stride
+class StreamBuffer
+{
+public:
+    static const int FRAMES = 3;
+
+    // Frames whose beginFrame() had to wait, and the total time waited
+    uint64_t blockedFrames;
+    double fenceWaitMs;
+
+    StreamBuffer()
+        : blockedFrames(0), fenceWaitMs(0.0), id(0), mapped(nullptr), regionBytes(0), wantedBytes(0), region(0),
+          head(0), persistentMap(false), uniformAlignment(256)
+    {
+        for (GLsync& fence : fences)
+            fence = nullptr;
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    static bool persistentSupported() { return GLEW_ARB_buffer_storage; }
+
+    // Creates FRAMES regions of bytes each; mapped persistently unless the context lacks
+    // buffer storage or persistent is false
+    bool init(size_t bytes, bool persistent = true)
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = std::max<size_t>(alignment, 16);
+        persistentMap = persistent && persistentSupported();
+        return create(bytes);
+    }
+
+    unsigned int buffer() const { return id; }
+    bool persistent() const { return persistentMap; }
+    size_t capacity() const { return regionBytes; }
+    size_t used() const { return head; } // Bytes allocated this frame
+
+    // Moves to the next region, first waiting for the GPU to finish the frame that used it
+    void beginFrame()
+    {
+        if (wantedBytes > regionBytes) {
+            // Outgrown: wait for every frame in flight and recreate the buffer
+            for (int r = 0; r < FRAMES; r++)
+                waitFence(r);
+            destroy();
+            create(std::max(wantedBytes, regionBytes * 2));
+        }
+        region = (region + 1) % FRAMES;
+        head = 0;
+        waitFence(region);
+    }
+
+    // A slice of bytes at a buffer offset that is a multiple of alignment (a power of two,
+    // or the vertex size for dynamic meshes). Regions can have any size after growing, so
+    // the offset is aligned in the whole buffer, not within the region
+    StreamSlice allocate(size_t bytes, size_t alignment = 16)
+    {
+        size_t start = region * regionBytes;
+        size_t at = (start + head + alignment - 1) / alignment * alignment;
+        size_t end = at - start + bytes;
+        if (id == 0 || end > regionBytes) {
+            // Room for the worst-case padding too, wherever the region ends up
+            wantedBytes = std::max(wantedBytes, head + alignment - 1 + bytes);
+            return StreamSlice{ nullptr, 0, 0 };
+        }
+        head = end;
+        char* base = persistentMap ? static_cast<char*>(mapped) : staging.data();
+        return StreamSlice{ base + at, at, bytes };
+    }
+
+    // Makes a written slice visible to GL
+    void commit(const StreamSlice& slice)
+    {
+        if (persistentMap || !slice)
+            return; // Coherent: writes are already visible
+        glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+        void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, slice.offset, slice.size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (target != nullptr) {
+            memcpy(target, slice.data, slice.size);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        } else {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, slice.offset, slice.size, slice.data);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // Copies bytes into a new committed slice (null if the region is full)
+    StreamSlice write(const void* data, size_t bytes, size_t alignment = 16)
+    {
+        StreamSlice slice = allocate(bytes, alignment);
+        if (slice) {
+            memcpy(slice.data, data, bytes);
+            commit(slice);
+            Profiler::instance().counters.uploadBytes += bytes;
+        }
+        return slice;
+    }
+
+    // Streams value and binds it to a uniform block binding point; false if it didn't fit
+    template <typename T>
+    bool bindUniforms(unsigned int binding, const T& value)
+    {
+        StreamSlice slice = write(&value, sizeof(T), uniformAlignment);
+        if (!slice)
+            return false;
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, id, slice.offset, slice.size);
+        return true;
+    }
+
+    // Fences the current region; call after the frame's last draw reading it
+    void endFrame()
+    {
+        if (id == 0)
+            return;
+        if (fences[region] != nullptr)
+            glDeleteSync(fences[region]);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    ~StreamBuffer() { destroy(); }
+
+private:
+    unsigned int id;
+    void* mapped;                // Persistent mapping of the whole buffer
+    std::vector<char> staging;   // GL 3.3: slices are written here, then committed
+    size_t regionBytes;
+    size_t wantedBytes;          // Largest frame asked for, to grow to
+    int region;                  // Region of the current frame
+    size_t head;                 // Bytes allocated in it
+    bool persistentMap;
+    size_t uniformAlignment;
+    GLsync fences[FRAMES];
+
+    bool create(size_t bytes)
+    {
+        regionBytes = bytes;
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+        if (persistentMap) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, regionBytes * FRAMES, nullptr, flags);
+            mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, regionBytes * FRAMES, flags);
+            if (mapped == nullptr) {
+                std::cerr << "Failed to map the stream buffer persistently" << std::endl;
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                glDeleteBuffers(1, &id);
+                id = 0;
+                return false;
+            }
+        } else {
+            glBufferData(GL_COPY_WRITE_BUFFER, regionBytes * FRAMES, nullptr, GL_STREAM_DRAW);
+            staging.assign(regionBytes * FRAMES, 0);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return true;
+    }
+
+    void destroy()
+    {
+        for (GLsync& fence : fences) {
+            if (fence != nullptr)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        if (id != 0) {
+            if (mapped != nullptr) {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &id);
+        }
+        id = 0;
+        mapped = nullptr;
+    }
+
+    // Blocks until the GPU has finished the frame that last used region r
+    void waitFence(int r)
+    {
+        GLsync fence = fences[r];
+        if (fence == nullptr)
+            return;
+        fences[r] = nullptr;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            PROFILE_SCOPE("Fence wait");
+            auto start = std::chrono::steady_clock::now();
+            do {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            } while (status == GL_TIMEOUT_EXPIRED);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            fenceWaitMs += ms;
+            blockedFrames++;
+            Profiler::instance().counters.fenceWaitMicroseconds += static_cast<uint64_t>(ms * 1000.0);
+        }
+        glDeleteSync(fence);
+    }
+};
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef TRANSFORMSTORE_H
+#define TRANSFORMSTORE_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "JobSystem.h"
+
+using Vec3 = glm::vec3;
+
+// Data-oriented store of object transforms. Position, rotation (Euler degrees, applied
+// x then y then z like Object::getModelMatrix) and scale live in SoA arrays; update()
+// rebuilds the model matrices of dirty transforms only, four at a time with SSE, on
+// the calling thread or spread over a JobSystem
+class TransformStore
+{
+public:
+    // SoA transform components
+    std::vector<float> px, py, pz;
+    std::vector<float> rx, ry, rz;
+    std::vector<float> sx, sy, sz;
+
+    // Set when a transform changed since the last update()
+    std::vector<uint8_t> dirty;
+
+    // Model matrices, valid after update()
+    std::vector<glm::mat4> matrices;
+
+    // Matrices rebuilt by the last update()
+    size_t lastUpdated = 0;
+
+    // Adds a transform and returns its index
+    size_t add(Vec3 position = Vec3(0.0f), Vec3 rotation = Vec3(0.0f), Vec3 scale = Vec3(1.0f))
+    {
+        px.push_back(position.x); py.push_back(position.y); pz.push_back(position.z);
+        rx.push_back(rotation.x); ry.push_back(rotation.y); rz.push_back(rotation.z);
+        sx.push_back(scale.x); sy.push_back(scale.y); sz.push_back(scale.z);
+        dirty.push_back(1);
+        matrices.push_back(glm::mat4(1.0f));
+        return px.size() - 1;
+    }
+
+    void reserve(size_t n)
+    {
+        for (auto* v : { &px, &py, &pz, &rx, &ry, &rz, &sx, &sy, &sz })
+            v->reserve(n);
+        dirty.reserve(n);
+        matrices.reserve(n);
+    }
+
+    size_t size() const { return px.size(); }
+
+    Vec3 position(size_t i) const { return Vec3(px[i], py[i], pz[i]); }
+    Vec3 rotation(size_t i) const { return Vec3(rx[i], ry[i], rz[i]); }
+    Vec3 scale(size_t i) const { return Vec3(sx[i], sy[i], sz[i]); }
+
+    void setPosition(size_t i, Vec3 v) { px[i] = v.x; py[i] = v.y; pz[i] = v.z; dirty[i] = 1; }
+    void setRotation(size_t i, Vec3 v) { rx[i] = v.x; ry[i] = v.y; rz[i] = v.z; dirty[i] = 1; }
+    void setScale(size_t i, Vec3 v) { sx[i] = v.x; sy[i] = v.y; sz[i] = v.z; dirty[i] = 1; }
+    void rotate(size_t i, Vec3 v) { rx[i] += v.x; ry[i] += v.y; rz[i] += v.z; dirty[i] = 1; }
+
+    // Copies the components of a store of the same size (e.g. to keep the previous
+    // simulation state). Matrices and dirty flags are left alone
+    void copyComponents(const TransformStore& other)
+    {
+        px = other.px; py = other.py; pz = other.pz;
+        rx = other.rx; ry = other.ry; rz = other.rz;
+        sx = other.sx; sy = other.sy; sz = other.sz;
+    }
+
+    // Sets every component to mix(a, b, t), for rendering between two simulation states.
+    // Euler angles are blended linearly, so both states must come from continuous rotation
+    void interpolate(const TransformStore& a, const TransformStore& b, float t)
+    {
+        const size_t n = size();
+        const std::vector<float>* from[9] = { &a.px, &a.py, &a.pz, &a.rx, &a.ry, &a.rz, &a.sx, &a.sy, &a.sz };
+        const std::vector<float>* to[9] = { &b.px, &b.py, &b.pz, &b.rx, &b.ry, &b.rz, &b.sx, &b.sy, &b.sz };
+        std::vector<float>* out[9] = { &px, &py, &pz, &rx, &ry, &rz, &sx, &sy, &sz };
+        for (int c = 0; c < 9; c++) {
+            const float* x = from[c]->data();
+            const float* y = to[c]->data();
+            float* o = out[c]->data();
+            for (size_t i = 0; i < n; i++)
+                o[i] = x[i] + (y[i] - x[i]) * t;
+        }
+        std::fill(dirty.begin(), dirty.end(), 1);
+    }
+
+    // Rebuilds the matrices of every dirty transform and clears the flags
+    void update()
+    {
+        lastUpdated = updateRange(0, size());
+    }
+
+    // Same, split over the job system in chunks of grain transforms
+    void update(JobSystem& jobs, size_t grain = 4096)
+    {
+        std::atomic<size_t> updated(0);
+        grain = (std::max<size_t>(grain, 4) + 3) & ~size_t(3); // Keep chunks on SSE groups
+        jobs.parallelFor(0, size(), grain, [&](size_t begin, size_t end) {
+            updated.fetch_add(updateRange(begin, end), std::memory_order_relaxed);
+        });
+        lastUpdated = updated.load(std::memory_order_relaxed);
+    }
+
+    // Rebuilds the dirty matrices in [begin, end) and returns how many there were.
+    // Disjoint ranges may run on different threads
+    size_t updateRange(size_t begin, size_t end)
+    {
+        size_t i = begin;
+        size_t updated = 0;
+
+#if defined(__SSE2__)
+        for (; i + 4 <= end; i += 4) {
+            uint32_t flags;
+            memcpy(&flags, &dirty[i], sizeof(flags));
+            if (flags == 0)
+                continue;
+            if (flags == 0x01010101u) {
+                compose4(i);
+                updated += 4;
+            } else {
+                for (size_t j = i; j < i + 4; j++) {
+                    if (dirty[j]) {
+                        compose(j);
+                        updated++;
+                    }
+                }
+            }
+            memset(&dirty[i], 0, 4);
+        }
+#endif
+        for (; i < end; i++) {
+            if (dirty[i]) {
+                compose(i);
+                dirty[i] = 0;
+                updated++;
+            }
+        }
+        return updated;
+    }
+
+    // Scalar path: T * Rx * Ry * Rz * S written out directly
+    void compose(size_t i)
+    {
+        const float toRadians = 0.01745329251994329577f;
+        float sa = std::sin(rx[i] * toRadians), ca = std::cos(rx[i] * toRadians);
+        float sb = std::sin(ry[i] * toRadians), cb = std::cos(ry[i] * toRadians);
+        float sc = std::sin(rz[i] * toRadians), cc = std::cos(rz[i] * toRadians);
+
+        glm::mat4& m = matrices[i];
+        m[0] = glm::vec4(cb * cc, sa * sb * cc + ca * sc, -ca * sb * cc + sa * sc, 0.0f) * sx[i];
+        m[1] = glm::vec4(-cb * sc, -sa * sb * sc + ca * cc, ca * sb * sc + sa * cc, 0.0f) * sy[i];
+        m[2] = glm::vec4(sb, -sa * cb, ca * cb, 0.0f) * sz[i];
+        m[3] = glm::vec4(px[i], py[i], pz[i], 1.0f);
+    }
+
+private:
+#if defined(__SSE2__)
+    // sin and cos of four angles (radians). Cody-Waite reduction to [-pi/4, pi/4] and
+    // minimax polynomials (the single-precision Cephes coefficients)
+    static void sincos4(__m128 x, __m128& s, __m128& c)
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 sinSign = _mm_and_ps(x, signMask);
+        x = _mm_andnot_ps(signMask, x);
+
+        // Octant j = (int)(x * 4/pi), rounded up to even
+        __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+        j = _mm_add_epi32(j, _mm_set1_epi32(1));
+        j = _mm_and_si128(j, _mm_set1_epi32(~1));
+        __m128 y = _mm_cvtepi32_ps(j);
+
+        // Quadrant swaps and signs
+        __m128i sinFlip = _mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29);
+        __m128i cosFlip = _mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29);
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+        sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(sinFlip));
+
+        // x - y * pi/4 in three steps
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+        __m128 z = _mm_mul_ps(x, x);
+
+        __m128 pc = _mm_set1_ps(2.443315711809948e-5f);
+        pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(-1.388731625493765e-3f));
+        pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(4.166664568298827e-2f));
+        pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+        pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+        __m128 ps = _mm_set1_ps(-1.9515295891e-4f);
+        ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(8.3321608736e-3f));
+        ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(-1.6666654611e-1f));
+        ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), x), x);
+
+        __m128 sinValue = _mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps));
+        __m128 cosValue = _mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc));
+        s = _mm_xor_ps(sinValue, sinSign);
+        c = _mm_xor_ps(cosValue, _mm_castsi128_ps(cosFlip));
+    }
+
+    // Four transforms at once: sin/cos and the rotation terms are computed lane-wise, then
+    // each matrix column is transposed from SoA lanes into the four output matrices
+    void compose4(size_t i)
+    {
+        const __m128 toRadians = _mm_set1_ps(0.01745329251994329577f);
+        __m128 sa, ca, sb, cb, sc, cc;
+        sincos4(_mm_mul_ps(_mm_loadu_ps(&rx[i]), toRadians), sa, ca);
+        sincos4(_mm_mul_ps(_mm_loadu_ps(&ry[i]), toRadians), sb, cb);
+        sincos4(_mm_mul_ps(_mm_loadu_ps(&rz[i]), toRadians), sc, cc);
+
+        const __m128 scaleX = _mm_loadu_ps(&sx[i]);
+        const __m128 scaleY = _mm_loadu_ps(&sy[i]);
+        const __m128 scaleZ = _mm_loadu_ps(&sz[i]);
+        const __m128 sasb = _mm_mul_ps(sa, sb);
+        const __m128 casb = _mm_mul_ps(ca, sb);
+
+        __m128 cols[4][4];
+        cols[0][0] = _mm_mul_ps(_mm_mul_ps(cb, cc), scaleX);
+        cols[0][1] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sasb, cc), _mm_mul_ps(ca, sc)), scaleX);
+        cols[0][2] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sa, sc), _mm_mul_ps(casb, cc)), scaleX);
+        cols[1][0] = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(cb, sc)), scaleY);
+        cols[1][1] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ca, cc), _mm_mul_ps(sasb, sc)), scaleY);
+        cols[1][2] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(casb, sc), _mm_mul_ps(sa, cc)), scaleY);
+        cols[2][0] = _mm_mul_ps(sb, scaleZ);
+        cols[2][1] = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(sa, cb)), scaleZ);
+        cols[2][2] = _mm_mul_ps(_mm_mul_ps(ca, cb), scaleZ);
+        cols[3][0] = _mm_loadu_ps(&px[i]);
+        cols[3][1] = _mm_loadu_ps(&py[i]);
+        cols[3][2] = _mm_loadu_ps(&pz[i]);
+        for (int c = 0; c < 3; c++)
+            cols[c][3] = _mm_setzero_ps();
+        cols[3][3] = _mm_set1_ps(1.0f);
+
+        float* out = &matrices[i][0][0];
+        for (int c = 0; c < 4; c++) {
+            __m128 r0 = cols[c][0], r1 = cols[c][1], r2 = cols[c][2], r3 = cols[c][3];
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(out + 0 * 16 + c * 4, r0);
+            _mm_storeu_ps(out + 1 * 16 + c * 4, r1);
+            _mm_storeu_ps(out + 2 * 16 + c * 4, r2);
+            _mm_storeu_ps(out + 3 * 16 + c * 4, r3);
+        }
+    }
+#endif
+};
+
+#endif
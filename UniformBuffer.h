@@ -0,0 +1,75 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstring>
+#include "Profiler.h"
+#include "StreamBuffer.h"
+
+// Per-frame data shared by every program through the "Frame" uniform block (binding 0).
+// Laid out to match std140: mat4s are 16-byte aligned columns, so no padding is needed
+struct FrameUniforms
+{
+    static const unsigned int BINDING = 0;
+
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+};
+
+// A uniform buffer holding one T, bound to a fixed binding point. update() maps the
+// buffer with GL_MAP_INVALIDATE_BUFFER_BIT, which orphans the previous storage so the
+// write never waits for draws still reading last frame's data. update(value, stream)
+// writes into a StreamBuffer instead and binds that range
+template <typename T>
+class UniformBuffer
+{
+public:
+    unsigned int id;
+    unsigned int binding;
+
+    UniformBuffer() : id(0), binding(0) {}
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void init(unsigned int bindingPoint)
+    {
+        binding = bindingPoint;
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_STREAM_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void update(const T& value)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        void* ptr = glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(T), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (ptr != nullptr) {
+            memcpy(ptr, &value, sizeof(T));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        } else {
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        Profiler::instance().counters.uploadBytes += sizeof(T);
+    }
+
+    // Streams value when it fits in stream's region, else rebinds this buffer and updates it
+    void update(const T& value, StreamBuffer& stream)
+    {
+        if (stream.bindUniforms(binding, value))
+            return;
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+        update(value);
+    }
+
+    ~UniformBuffer()
+    {
+        if (id != 0) glDeleteBuffers(1, &id);
+    }
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "Bounds.h"
+
+// Attribute locations shared by the vertex shaders
+enum VertexAttribute
+{
+    ATTRIBUTE_POSITION = 0,
+    ATTRIBUTE_NORMAL = 1,
+    ATTRIBUTE_UV = 2,
+    ATTRIBUTE_INSTANCE_MODEL = 3 // Per-instance mat4, one vec4 column in each of 3-6
+};
+
+// Points the instance model matrix attributes at the mat4s in the bound GL_ARRAY_BUFFER,
+// starting byteOffset bytes in, advancing once per instance (for the bound VAO)
+inline void setInstanceAttributes(size_t byteOffset)
+{
+    for (unsigned int i = 0; i < 4; i++) {
+        glVertexAttribPointer(ATTRIBUTE_INSTANCE_MODEL + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void*)(uintptr_t)(byteOffset + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(ATTRIBUTE_INSTANCE_MODEL + i);
+        glVertexAttribDivisor(ATTRIBUTE_INSTANCE_MODEL + i, 1);
+    }
+}
+
+// IEEE half precision, rounded to nearest even; overflow becomes infinity
+inline uint16_t packHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+    if (magnitude >= 0x7F800000u) // Inf or NaN
+        return static_cast<uint16_t>(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+    if (magnitude >= 0x477FF000u) // Rounds past the largest half
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    if (magnitude < 0x38800000u) { // Subnormal half (or zero)
+        if (magnitude < 0x33000000u)
+            return static_cast<uint16_t>(sign);
+        uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+        int shift = 126 - static_cast<int>(magnitude >> 23); // 14..24
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1), midpoint = 1u << (shift - 1);
+        half += rest > midpoint || (rest == midpoint && (half & 1u));
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = (magnitude - 0x38000000u) >> 13;
+    uint32_t rest = magnitude & 0x1FFFu;
+    half += rest > 0x1000u || (rest == 0x1000u && (half & 1u));
+    return static_cast<uint16_t>(sign | half);
+}
+
+inline float unpackHalf(uint16_t half)
+{
+    uint32_t sign = uint32_t(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu, mantissa = half & 0x3FFu;
+    uint32_t bits;
+    if (exponent == 0x1Fu) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else {
+        float value = std::ldexp(float(mantissa), -24);
+        return sign ? -value : value;
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline glm::vec3 octDecode(int16_t x, int16_t y)
+{
+    glm::vec3 n(x / 32767.0f, y / 32767.0f, 0.0f);
+    n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+    if (n.z < 0.0f) {
+        float nx = n.x;
+        n.x = (1.0f - std::fabs(n.y)) * (nx >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::fabs(nx)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    float length = glm::length(n);
+    return length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+// Unit vector to two snorm16 octahedral coordinates (Cigolle et al., "A Survey of Efficient
+// Representations for Independent Unit Vectors"). Of the four roundings of the projected
+// point the one decoding closest to n is kept
+inline void octEncode(glm::vec3 n, int16_t out[2])
+{
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (sum == 0.0f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = n.x / sum, y = n.y / sum;
+    if (n.z < 0.0f) {
+        float ox = x;
+        x = (1.0f - std::fabs(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::fabs(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+    float fx = std::floor(x * 32767.0f), fy = std::floor(y * 32767.0f);
+    float best = -2.0f;
+    for (int i = 0; i < 4; i++) {
+        int16_t cx = static_cast<int16_t>(std::max(-32767.0f, std::min(32767.0f, fx + (i & 1))));
+        int16_t cy = static_cast<int16_t>(std::max(-32767.0f, std::min(32767.0f, fy + (i >> 1))));
+        float similarity = glm::dot(octDecode(cx, cy), n);
+        if (similarity > best) {
+            best = similarity;
+            out[0] = cx;
+            out[1] = cy;
+        }
+    }
+}
+
+// Interleaved vertex layout: which attributes a mesh's VBO holds and how each is encoded.
+// Attributes follow each other in the order position, normal, uv, each 4-byte aligned.
+// Quantized positions are unorm16 within the mesh bounds; positionTransform() maps them
+// back and is folded into the model matrix (see Object::getDrawMatrix), so shaders read
+// either encoding as a vec3. Octahedral normals reach the shader as two unnormalized
+// shorts (exact on every GL version) and are decoded there
+struct VertexFormat
+{
+    enum PositionEncoding : uint8_t { POSITION_FLOAT3, POSITION_UNORM16 };       // 12 / 8 bytes
+    enum NormalEncoding : uint8_t { NORMAL_NONE, NORMAL_FLOAT3, NORMAL_OCT16 };  //  0 / 12 / 4 bytes
+    enum UVEncoding : uint8_t { UV_NONE, UV_FLOAT2, UV_HALF2 };                  //  0 / 8 / 4 bytes
+
+    uint8_t position;
+    uint8_t normal;
+    uint8_t uv;
+    uint8_t reserved;
+
+    // Plain float positions (procedural meshes)
+    static VertexFormat positionsOnly() { return VertexFormat{ POSITION_FLOAT3, NORMAL_NONE, UV_NONE, 0 }; }
+    // Every attribute as floats: 32 bytes
+    static VertexFormat full() { return VertexFormat{ POSITION_FLOAT3, NORMAL_FLOAT3, UV_FLOAT2, 0 }; }
+    // Every attribute quantized: 16 bytes
+    static VertexFormat compact() { return VertexFormat{ POSITION_UNORM16, NORMAL_OCT16, UV_HALF2, 0 }; }
+
+    bool operator==(const VertexFormat& other) const
+    {
+        return position == other.position && normal == other.normal && uv == other.uv;
+    }
+    bool operator!=(const VertexFormat& other) const { return !(*this == other); }
+
+    bool valid() const { return position <= POSITION_UNORM16 && normal <= NORMAL_OCT16 && uv <= UV_HALF2; }
+
+    // Defines selecting the normal decode of shaders/object.vert, which reads octahedral
+    // normals without them. A program draws meshes of one normal encoding
+    const char* shaderDefines() const { return normal == NORMAL_FLOAT3 ? "#define NORMAL_FLOAT3\n" : ""; }
+
+    uint32_t positionBytes() const { return position == POSITION_FLOAT3 ? 12 : 8; }
+    uint32_t normalBytes() const { return normal == NORMAL_NONE ? 0 : normal == NORMAL_FLOAT3 ? 12 : 4; }
+    uint32_t uvBytes() const { return uv == UV_NONE ? 0 : uv == UV_FLOAT2 ? 8 : 4; }
+    uint32_t normalOffset() const { return positionBytes(); }
+    uint32_t uvOffset() const { return positionBytes() + normalBytes(); }
+    uint32_t stride() const { return positionBytes() + normalBytes() + uvBytes(); }
+
+    // Maps stored positions to model space: the unit cube onto bounds when quantized
+    glm::mat4 positionTransform(const AABB& bounds) const
+    {
+        if (position == POSITION_FLOAT3)
+            return glm::mat4(1.0f);
+        return glm::scale(glm::translate(glm::mat4(1.0f), bounds.min), bounds.max - bounds.min);
+    }
+
+    // Writes count vertices to out (stride() bytes each). normals and uvs may be null when
+    // the format has none; bounds must contain every position
+    void encode(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* uvs, size_t count,
+                const AABB& bounds, void* out) const
+    {
+        char* vertex = static_cast<char*>(out);
+        glm::vec3 size = bounds.max - bounds.min;
+        for (size_t i = 0; i < count; i++, vertex += stride()) {
+            if (position == POSITION_FLOAT3) {
+                memcpy(vertex, &positions[i].x, 12);
+            } else {
+                uint16_t q[4] = { 0, 0, 0, 0 };
+                for (int c = 0; c < 3; c++) {
+                    float t = size[c] > 0.0f ? (positions[i][c] - bounds.min[c]) / size[c] : 0.0f;
+                    q[c] = static_cast<uint16_t>(std::lround(std::max(0.0f, std::min(1.0f, t)) * 65535.0f));
+                }
+                memcpy(vertex, q, 8);
+            }
+
+            glm::vec3 n = normals ? normals[i] : glm::vec3(0.0f);
+            if (normal == NORMAL_FLOAT3) {
+                memcpy(vertex + normalOffset(), &n.x, 12);
+            } else if (normal == NORMAL_OCT16) {
+                int16_t oct[2];
+                octEncode(n, oct);
+                memcpy(vertex + normalOffset(), oct, 4);
+            }
+
+            glm::vec2 t = uvs ? uvs[i] : glm::vec2(0.0f);
+            if (uv == UV_FLOAT2) {
+                memcpy(vertex + uvOffset(), &t.x, 8);
+            } else if (uv == UV_HALF2) {
+                uint16_t half[2] = { packHalf(t.x), packHalf(t.y) };
+                memcpy(vertex + uvOffset(), half, 4);
+            }
+        }
+    }
+
+    // Reads back one stored vertex, as the shader would see it after positionTransform()
+    glm::vec3 decodePosition(const void* vertex, const AABB& bounds) const
+    {
+        if (position == POSITION_FLOAT3) {
+            glm::vec3 p;
+            memcpy(&p.x, vertex, 12);
+            return p;
+        }
+        uint16_t q[3];
+        memcpy(q, vertex, 6);
+        glm::vec3 size = bounds.max - bounds.min;
+        return bounds.min + glm::vec3(q[0] / 65535.0f * size.x, q[1] / 65535.0f * size.y, q[2] / 65535.0f * size.z);
+    }
+
+    glm::vec3 decodeNormal(const void* vertex) const
+    {
+        const char* p = static_cast<const char*>(vertex) + normalOffset();
+        if (normal == NORMAL_FLOAT3) {
+            glm::vec3 n;
+            memcpy(&n.x, p, 12);
+            return n;
+        }
+        if (normal == NORMAL_OCT16) {
+            int16_t oct[2];
+            memcpy(oct, p, 4);
+            return octDecode(oct[0], oct[1]);
+        }
+        return glm::vec3(0.0f);
+    }
+
+    glm::vec2 decodeUV(const void* vertex) const
+    {
+        const char* p = static_cast<const char*>(vertex) + uvOffset();
+        if (uv == UV_FLOAT2) {
+            glm::vec2 t;
+            memcpy(&t.x, p, 8);
+            return t;
+        }
+        if (uv == UV_HALF2) {
+            uint16_t half[2];
+            memcpy(half, p, 4);
+            return glm::vec2(unpackHalf(half[0]), unpackHalf(half[1]));
+        }
+        return glm::vec2(0.0f);
+    }
+
+    // Points the attributes at the VBO bound to GL_ARRAY_BUFFER, for the bound VAO
+    void setAttributes() const
+    {
+        GLsizei size = static_cast<GLsizei>(stride());
+        if (position == POSITION_FLOAT3)
+            glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE, size, (void*)0);
+        else
+            glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_UNSIGNED_SHORT, GL_TRUE, size, (void*)0);
+        glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+
+        if (normal == NORMAL_FLOAT3)
+            glVertexAttribPointer(ATTRIBUTE_NORMAL, 3, GL_FLOAT, GL_FALSE, size, (void*)(uintptr_t)normalOffset());
+        else if (normal == NORMAL_OCT16)
+            glVertexAttribPointer(ATTRIBUTE_NORMAL, 2, GL_SHORT, GL_FALSE, size, (void*)(uintptr_t)normalOffset());
+        if (normal != NORMAL_NONE)
+            glEnableVertexAttribArray(ATTRIBUTE_NORMAL);
+
+        if (uv == UV_FLOAT2)
+            glVertexAttribPointer(ATTRIBUTE_UV, 2, GL_FLOAT, GL_FALSE, size, (void*)(uintptr_t)uvOffset());
+        else if (uv == UV_HALF2)
+            glVertexAttribPointer(ATTRIBUTE_UV, 2, GL_HALF_FLOAT, GL_FALSE, size, (void*)(uintptr_t)uvOffset());
+        if (uv != UV_NONE)
+            glEnableVertexAttribArray(ATTRIBUTE_UV);
+    }
+};
+
+#endif
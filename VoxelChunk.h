@@ -0,0 +1,189 @@
+#ifndef VOXELCHUNK_H
+#define VOXELCHUNK_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Block type; 0 is air and every other type is solid
+using BlockId = uint16_t;
+const BlockId AIR = 0;
+
+// A SIZE^3 cube of blocks stored as indices into a palette of the block types it holds,
+// bit-packed at the fewest bits (0, 1, 2, 4, 8 or 16) that can index the palette; powers
+// of two never straddle a 64-bit word. A chunk of a single type (all air, all stone) is
+// just its palette. Cell (x, y, z) is (y * SIZE + z) * SIZE + x: rows along x, then layers
+template <int N>
+class PaletteChunk
+{
+public:
+    static const int SIZE = N;
+    static const int VOLUME = N * N * N;
+
+    explicit PaletteChunk(BlockId fill = AIR) : palette(1, fill), counts(1, VOLUME), bits(0) {}
+
+    static int cell(int x, int y, int z) { return (y * SIZE + z) * SIZE + x; }
+
+    BlockId get(int x, int y, int z) const { return palette[paletteIndex(cell(x, y, z))]; }
+
+    void set(int x, int y, int z, BlockId block)
+    {
+        int c = cell(x, y, z);
+        uint32_t old = paletteIndex(c);
+        if (palette[old] == block)
+            return;
+        uint32_t entry = findOrAdd(block);
+        counts[old]--;
+        counts[entry]++;
+        storeIndex(c, entry);
+    }
+
+    // Replaces every block from a dense array of VOLUME ids in cell order
+    void assign(const BlockId* blocks)
+    {
+        palette.clear();
+        counts.clear();
+        for (int c = 0; c < VOLUME; c++) {
+            if (palette.empty() || palette.back() != blocks[c]) {
+                if (std::find(palette.begin(), palette.end(), blocks[c]) == palette.end()) {
+                    palette.push_back(blocks[c]);
+                    counts.push_back(0);
+                }
+            }
+        }
+        bits = bitsFor(palette.size());
+        words.assign(wordCount(bits), 0);
+        uint32_t last = 0;
+        for (int c = 0; c < VOLUME; c++) {
+            if (palette[last] != blocks[c])
+                last = static_cast<uint32_t>(std::find(palette.begin(), palette.end(), blocks[c]) - palette.begin());
+            counts[last]++;
+            if (bits != 0)
+                storeIndex(c, last);
+        }
+    }
+
+    // Unpacks every block into a dense array of VOLUME ids in cell order
+    void decode(BlockId* blocks) const
+    {
+        if (bits == 0) {
+            std::fill_n(blocks, VOLUME, palette[0]);
+            return;
+        }
+        const int perWord = 64 / bits;
+        const uint64_t mask = (uint64_t(1) << bits) - 1;
+        int c = 0;
+        for (uint64_t word : words)
+            for (int i = 0; i < perWord; i++, word >>= bits)
+                blocks[c++] = palette[word & mask];
+    }
+
+    // Drops palette entries no block uses, repacks at the fewest bits and releases the
+    // memory that frees
+    void compact()
+    {
+        size_t used = std::count_if(counts.begin(), counts.end(), [](uint32_t count) { return count > 0; });
+        if (used == palette.size())
+            return;
+        std::vector<BlockId> blocks(VOLUME);
+        decode(blocks.data());
+        assign(blocks.data());
+        palette.shrink_to_fit();
+        counts.shrink_to_fit();
+        words.shrink_to_fit();
+    }
+
+    // True when every block is the same type (then blocks() is that type)
+    bool uniform() const { return bits == 0 || std::count(counts.begin(), counts.end(), uint32_t(VOLUME)) == 1; }
+    BlockId uniformBlock() const { return palette[std::find(counts.begin(), counts.end(), uint32_t(VOLUME)) - counts.begin()]; }
+
+    // Blocks that aren't air
+    uint32_t solidCount() const
+    {
+        uint32_t solid = 0;
+        for (size_t i = 0; i < palette.size(); i++)
+            solid += palette[i] != AIR ? counts[i] : 0;
+        return solid;
+    }
+
+    int bitsPerBlock() const { return bits; }
+    size_t paletteSize() const { return palette.size(); }
+
+    // Heap and object bytes
+    size_t memoryBytes() const
+    {
+        return sizeof(*this) + palette.capacity() * sizeof(BlockId) + counts.capacity() * sizeof(uint32_t)
+             + words.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    std::vector<BlockId> palette;
+    std::vector<uint32_t> counts; // Blocks using each palette entry; entries at 0 are reused
+    std::vector<uint64_t> words;
+    int bits;
+
+    static int bitsFor(size_t entries)
+    {
+        int b = 0;
+        while ((size_t(1) << b) < entries)
+            b = b == 0 ? 1 : b * 2;
+        return b;
+    }
+
+    static size_t wordCount(int b) { return b == 0 ? 0 : (size_t(VOLUME) * b + 63) / 64; }
+
+    uint32_t paletteIndex(int c) const
+    {
+        if (bits == 0)
+            return 0;
+        size_t bit = size_t(c) * bits;
+        return static_cast<uint32_t>((words[bit >> 6] >> (bit & 63)) & ((uint64_t(1) << bits) - 1));
+    }
+
+    void storeIndex(int c, uint32_t value)
+    {
+        size_t bit = size_t(c) * bits;
+        uint64_t mask = ((uint64_t(1) << bits) - 1) << (bit & 63);
+        uint64_t& word = words[bit >> 6];
+        word = (word & ~mask) | (uint64_t(value) << (bit & 63));
+    }
+
+    uint32_t findOrAdd(BlockId block)
+    {
+        for (size_t i = 0; i < palette.size(); i++)
+            if (palette[i] == block && counts[i] > 0)
+                return static_cast<uint32_t>(i);
+        for (size_t i = 0; i < palette.size(); i++) {
+            if (counts[i] == 0) {
+                palette[i] = block;
+                return static_cast<uint32_t>(i);
+            }
+        }
+        palette.push_back(block);
+        counts.push_back(0);
+        if (bitsFor(palette.size()) != bits)
+            repack(bitsFor(palette.size()));
+        return static_cast<uint32_t>(palette.size() - 1);
+    }
+
+    void repack(int newBits)
+    {
+        std::vector<uint64_t> old(wordCount(newBits), 0);
+        old.swap(words);
+        int oldBits = bits;
+        bits = newBits;
+        for (int c = 0; c < VOLUME; c++) {
+            uint32_t value = 0;
+            if (oldBits != 0) {
+                size_t bit = size_t(c) * oldBits;
+                value = static_cast<uint32_t>((old[bit >> 6] >> (bit & 63)) & ((uint64_t(1) << oldBits) - 1));
+            }
+            storeIndex(c, value);
+        }
+    }
+};
+
+using VoxelChunk = PaletteChunk<32>;
+
+#endif
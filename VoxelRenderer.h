@@ -0,0 +1,155 @@
+#ifndef VOXELRENDERER_H
+#define VOXELRENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Frustum.h"
+#include "Profiler.h"
+#include "ShaderProgram.h"
+#include "UniformBuffer.h"
+#include "VoxelWorld.h"
+
+// Draws a VoxelWorld's chunk meshes: one vertex buffer and draw call per chunk that has
+// quads and is in view. Vertices are the 8-byte VoxelVertex, read as integers by
+// shaders/voxel.vert, and every chunk shares one index buffer of two triangles per quad
+class VoxelRenderer
+{
+public:
+    VoxelRenderer() : quadIndexBuffer(0), quadCapacity(0), originLocation(-1), gpuBytes(0) {}
+
+    VoxelRenderer(const VoxelRenderer&) = delete;
+    VoxelRenderer& operator=(const VoxelRenderer&) = delete;
+
+    bool init()
+    {
+        if (!program.load("shaders/voxel.vert", "shaders/voxel.frag"))
+            return false;
+        program.bindBlock("Frame", FrameUniforms::BINDING);
+        originLocation = program.uniform("chunkOrigin");
+        glGenBuffers(1, &quadIndexBuffer);
+        return true;
+    }
+
+    // Uploads the meshes world finished and frees the chunks it evicted
+    void update(VoxelWorld& world)
+    {
+        world.drainMeshes([this](ChunkCoord coord, const VoxelMesh& mesh) { upload(coord, mesh); });
+        world.drainEvicted([this](ChunkCoord coord) {
+            auto it = chunks.find(coord);
+            if (it != chunks.end()) {
+                release(it->second);
+                chunks.erase(it);
+            }
+        });
+    }
+
+    // Draws the chunks inside the frustum of viewProjection (FrameUniforms already bound)
+    void draw(const glm::mat4& viewProjection)
+    {
+        FrameCounters& counters = Profiler::instance().counters;
+        Frustum frustum = Frustum::fromMatrix(viewProjection);
+        program.use();
+        for (const auto& entry : chunks) {
+            const GpuChunk& chunk = entry.second;
+            glm::vec3 origin = glm::vec3(float(entry.first.x), float(entry.first.y), float(entry.first.z)) * float(VoxelWorld::SIZE);
+            if (!frustum.intersects(AABB(origin, origin + glm::vec3(float(VoxelWorld::SIZE)))))
+                continue;
+            glUniform3f(originLocation, origin.x, origin.y, origin.z);
+            glBindVertexArray(chunk.vao);
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(chunk.quads * 6), GL_UNSIGNED_INT, (void*)0);
+            counters.stateChanges++;
+            counters.drawCalls++;
+            counters.triangles += chunk.quads * 2;
+            counters.trianglesFullDetail += chunk.quads * 2;
+        }
+        glBindVertexArray(0);
+    }
+
+    size_t chunkCount() const { return chunks.size(); }
+    size_t bufferBytes() const { return gpuBytes; }
+
+    ~VoxelRenderer()
+    {
+        for (auto& entry : chunks)
+            release(entry.second);
+        if (quadIndexBuffer != 0) glDeleteBuffers(1, &quadIndexBuffer);
+    }
+
+private:
+    struct GpuChunk
+    {
+        GLuint vao = 0, vbo = 0;
+        uint64_t quads = 0;
+    };
+
+    ShaderProgram program;
+    std::unordered_map<ChunkCoord, GpuChunk, ChunkCoordHash> chunks;
+    GLuint quadIndexBuffer;
+    size_t quadCapacity;
+    GLint originLocation;
+    size_t gpuBytes;
+
+    void upload(ChunkCoord coord, const VoxelMesh& mesh)
+    {
+        if (mesh.quadCount() == 0) {
+            auto it = chunks.find(coord);
+            if (it != chunks.end()) {
+                release(it->second);
+                chunks.erase(it);
+            }
+            return;
+        }
+        growIndices(mesh.quadCount());
+
+        GpuChunk& chunk = chunks[coord];
+        if (chunk.vao == 0) {
+            glGenVertexArrays(1, &chunk.vao);
+            glGenBuffers(1, &chunk.vbo);
+            glBindVertexArray(chunk.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+            glVertexAttribIPointer(0, 4, GL_UNSIGNED_BYTE, sizeof(VoxelVertex), (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribIPointer(1, 1, GL_UNSIGNED_SHORT, sizeof(VoxelVertex), (void*)offsetof(VoxelVertex, block));
+            glEnableVertexAttribArray(1);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+            glBindVertexArray(0);
+        }
+        size_t bytes = mesh.vertices.size() * sizeof(VoxelVertex);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+        glBufferData(GL_ARRAY_BUFFER, bytes, mesh.vertices.data(), GL_STATIC_DRAW);
+        gpuBytes += bytes - chunk.quads * 4 * sizeof(VoxelVertex);
+        chunk.quads = mesh.quadCount();
+        Profiler::instance().counters.uploadBytes += bytes;
+    }
+
+    void release(GpuChunk& chunk)
+    {
+        glDeleteVertexArrays(1, &chunk.vao);
+        glDeleteBuffers(1, &chunk.vbo);
+        gpuBytes -= chunk.quads * 4 * sizeof(VoxelVertex);
+    }
+
+    // Quad q is vertices 4q..4q+3 as triangles (0, 1, 2) and (0, 2, 3). The buffer keeps
+    // its name when it grows, so the chunks' vertex arrays stay bound to it
+    void growIndices(size_t quads)
+    {
+        if (quads <= quadCapacity)
+            return;
+        quadCapacity = std::max(quads, quadCapacity * 2);
+        std::vector<uint32_t> indices;
+        indices.reserve(quadCapacity * 6);
+        for (uint32_t q = 0; q < quadCapacity; q++) {
+            uint32_t v = q * 4;
+            indices.insert(indices.end(), { v, v + 1, v + 2, v, v + 2, v + 3 });
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        Profiler::instance().counters.uploadBytes += indices.size() * sizeof(uint32_t);
+    }
+};
+
+#endif
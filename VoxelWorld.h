@@ -0,0 +1,546 @@
+#ifndef VOXELWORLD_H
+#define VOXELWORLD_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Collision.h"
+#include "GreedyMesher.h"
+#include "JobSystem.h"
+#include "VoxelChunk.h"
+
+// Block types of the generated terrain (shaders/voxel.frag colors them)
+enum TerrainBlock : BlockId
+{
+    GRASS = 1,
+    DIRT,
+    STONE,
+    SAND,
+    SNOW
+};
+
+struct ChunkCoord
+{
+    int x, y, z;
+
+    bool operator==(const ChunkCoord& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct ChunkCoordHash
+{
+    size_t operator()(const ChunkCoord& c) const
+    {
+        return size_t(uint32_t(c.x) * 73856093u ^ uint32_t(c.y) * 19349663u ^ uint32_t(c.z) * 83492791u);
+    }
+};
+
+// Height-map terrain from a few octaves of value noise: grass on top, sand in the valleys,
+// snow on the peaks, three blocks of dirt, then stone. Deterministic for a seed
+class TerrainGenerator
+{
+public:
+    int baseHeight = -12;  // Surface height of flat ground
+    float amplitude = 10.0f; // Hills and valleys reach about this far from it
+    float scale = 96.0f;   // Blocks across the largest features
+
+    explicit TerrainGenerator(uint32_t seed = 1) : seed(seed) {}
+
+    // Y of the topmost solid block of column (x, z)
+    int height(int x, int z) const
+    {
+        float sum = 0.0f, weight = 1.0f, total = 0.0f, frequency = 1.0f / scale;
+        for (int octave = 0; octave < 4; octave++) {
+            sum += weight * valueNoise(x * frequency, z * frequency, octave);
+            total += weight;
+            weight *= 0.5f;
+            frequency *= 2.0f;
+        }
+        return baseHeight + int(std::floor((sum / total * 2.0f - 1.0f) * amplitude));
+    }
+
+    BlockId block(int y, int surface) const
+    {
+        if (y > surface)
+            return AIR;
+        if (y <= surface - 4)
+            return STONE;
+        if (surface <= baseHeight - amplitude * 0.4f)
+            return SAND;
+        if (y < surface)
+            return DIRT;
+        return surface >= baseHeight + amplitude * 0.5f ? SNOW : GRASS;
+    }
+
+    // Fills chunk at coord (in chunks of its size)
+    template <int N>
+    void generate(ChunkCoord coord, PaletteChunk<N>& chunk) const
+    {
+        std::vector<BlockId> blocks(PaletteChunk<N>::VOLUME);
+        for (int z = 0; z < N; z++) {
+            for (int x = 0; x < N; x++) {
+                int surface = height(coord.x * N + x, coord.z * N + z);
+                for (int y = 0; y < N; y++)
+                    blocks[PaletteChunk<N>::cell(x, y, z)] = block(coord.y * N + y, surface);
+            }
+        }
+        chunk.assign(blocks.data());
+    }
+
+private:
+    uint32_t seed;
+
+    float lattice(int x, int z, int octave) const
+    {
+        uint32_t h = uint32_t(x) * 374761393u + uint32_t(z) * 668265263u + (seed + uint32_t(octave)) * 2246822519u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return float(h ^ (h >> 16)) / 4294967295.0f;
+    }
+
+    float valueNoise(float x, float z, int octave) const
+    {
+        float fx = std::floor(x), fz = std::floor(z);
+        int ix = int(fx), iz = int(fz);
+        float u = x - fx, v = z - fz;
+        u = u * u * (3.0f - 2.0f * u);
+        v = v * v * (3.0f - 2.0f * v);
+        float a = lattice(ix, iz, octave), b = lattice(ix + 1, iz, octave);
+        float c = lattice(ix, iz + 1, octave), d = lattice(ix + 1, iz + 1, octave);
+        return a + (b - a) * u + (c - a) * v + (a - b - c + d) * u * v;
+    }
+};
+
+struct VoxelWorldSettings
+{
+    int radius = 8;      // Chunks loaded around the center, horizontally
+    int minChunkY = -2;  // Vertical range of chunks [minChunkY, maxChunkY); below is solid
+    int maxChunkY = 1;
+    size_t maxJobs = 16; // Generation and meshing jobs in flight
+};
+
+// A block world of palette-compressed chunks streamed around a point. update() (main
+// thread, once a frame) generates the missing chunks within radius on the job system,
+// nearest first, and evicts those beyond radius + 1 as soon as no job works on them;
+// edited chunks are compacted and kept aside, and come back instead of regenerating.
+// Chunks are greedy meshed on jobs once their side neighbors are loaded, and remeshed
+// only when an edit touches them (an edit on a chunk border also dirties the neighbor).
+// Jobs read immutable snapshots: an edit copies a chunk a job still holds, and a mesh
+// finished after a newer edit is dropped. Finished meshes and evicted chunks are handed
+// to the renderer with drainMeshes() and drainEvicted()
+class VoxelWorld : public CollisionGrid
+{
+public:
+    static const int SIZE = VoxelChunk::SIZE;
+
+    using Settings = VoxelWorldSettings;
+
+    struct Statistics
+    {
+        uint64_t generated = 0; // Chunks generated (not counting reloaded edits)
+        uint64_t meshed = 0;    // Meshes built
+        uint64_t stale = 0;     // ... of which were dropped after a newer edit
+        uint64_t evicted = 0;
+    };
+
+    Statistics statistics;
+
+    explicit VoxelWorld(JobSystem& jobs, Settings settings = Settings(), TerrainGenerator generator = TerrainGenerator())
+        : settings(settings), generator(generator), jobs(jobs), bedrock(std::make_shared<const VoxelChunk>(STONE)),
+          hasCenter(false), cursor(0), dirtyCount(0), farSlots(0), inFlight(0), queued(0)
+    {
+    }
+
+    VoxelWorld(const VoxelWorld&) = delete;
+    VoxelWorld& operator=(const VoxelWorld&) = delete;
+
+    ~VoxelWorld() { jobs.wait(pending); }
+
+    const TerrainGenerator& terrain() const { return generator; }
+
+    static int floorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+    static ChunkCoord chunkOf(int x, int y, int z) { return ChunkCoord{ floorDiv(x, SIZE), floorDiv(y, SIZE), floorDiv(z, SIZE) }; }
+
+    // Air where no chunk is loaded
+    BlockId getBlock(int x, int y, int z) const
+    {
+        ChunkCoord coord = chunkOf(x, y, z);
+        auto it = slots.find(coord);
+        if (it == slots.end() || it->second.chunk == nullptr)
+            return coord.y < settings.minChunkY ? BlockId(STONE) : AIR;
+        return it->second.chunk->get(x - coord.x * SIZE, y - coord.y * SIZE, z - coord.z * SIZE);
+    }
+
+    bool solid(int x, int y, int z) const override { return getBlock(x, y, z) != AIR; }
+
+    // Changes a block of a loaded chunk and queues the remeshing it needs; false if the
+    // chunk isn't loaded
+    bool setBlock(int x, int y, int z, BlockId block)
+    {
+        ChunkCoord coord = chunkOf(x, y, z);
+        auto it = slots.find(coord);
+        if (it == slots.end() || it->second.chunk == nullptr)
+            return false;
+        Slot& slot = it->second;
+        int lx = x - coord.x * SIZE, ly = y - coord.y * SIZE, lz = z - coord.z * SIZE;
+        if (slot.chunk->get(lx, ly, lz) == block)
+            return true;
+        if (slot.chunk.use_count() > 1)
+            slot.chunk = std::make_shared<VoxelChunk>(*slot.chunk); // A job holds the old one
+        slot.chunk->set(lx, ly, lz, block);
+        slot.edited = true;
+        invalidate(slot);
+
+        const int local[3] = { lx, ly, lz };
+        for (int axis = 0; axis < 3; axis++) {
+            int side = local[axis] == 0 ? -1 : local[axis] == SIZE - 1 ? 1 : 0;
+            if (side == 0)
+                continue;
+            int n[3] = { coord.x, coord.y, coord.z };
+            n[axis] += side;
+            auto neighbor = slots.find(ChunkCoord{ n[0], n[1], n[2] });
+            if (neighbor != slots.end() && neighbor->second.chunk != nullptr)
+                invalidate(neighbor->second);
+        }
+        return true;
+    }
+
+    // First solid block along a ray within maxDistance (Amanatides and Woo's grid
+    // traversal); normal is the face the ray entered through
+    bool raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3& block, glm::ivec3& normal) const
+    {
+        glm::ivec3 cell(glm::floor(origin)), step;
+        glm::vec3 next, delta;
+        for (int i = 0; i < 3; i++) {
+            step[i] = direction[i] > 0.0f ? 1 : direction[i] < 0.0f ? -1 : 0;
+            delta[i] = step[i] != 0 ? std::abs(1.0f / direction[i]) : FLT_MAX;
+            float boundary = step[i] > 0 ? cell[i] + 1.0f - origin[i] : origin[i] - cell[i];
+            next[i] = step[i] != 0 ? boundary * delta[i] : FLT_MAX;
+        }
+        normal = glm::ivec3(0, 0, 0);
+        float t = 0.0f;
+        while (t <= maxDistance) {
+            if (solid(cell.x, cell.y, cell.z)) {
+                block = cell;
+                return true;
+            }
+            int axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+            t = next[axis];
+            next[axis] += delta[axis];
+            cell[axis] += step[axis];
+            normal = glm::ivec3(0, 0, 0);
+            normal[axis] = -step[axis];
+        }
+        return false;
+    }
+
+    // Streams around center and queues the jobs the world needs; collects finished ones
+    void update(const glm::vec3& center)
+    {
+        collect();
+        queued = 0;
+
+        ChunkCoord c = chunkOf(int(std::floor(center.x)), 0, int(std::floor(center.z)));
+        if (!hasCenter || c.x != centerChunk.x || c.z != centerChunk.z) {
+            recenter(c);
+            evictFar();
+        }
+
+        // Load missing chunks nearest first. Nothing within radius is evicted, so the
+        // cursor only moves forward until the center changes
+        for (; cursor < wanted.size() && inFlight < settings.maxJobs; cursor++) {
+            if (slots.find(wanted[cursor]) == slots.end())
+                load(wanted[cursor]);
+        }
+
+        // Mesh dirty chunks whose neighbors are loaded, nearest first
+        if (dirtyCount > 0) {
+            for (size_t i = 0; i < wanted.size() && inFlight < settings.maxJobs; i++) {
+                auto it = slots.find(wanted[i]);
+                if (it != slots.end() && it->second.dirty && !it->second.meshing)
+                    mesh(it->first, it->second);
+            }
+        }
+    }
+
+    // Finishes the queued jobs and collects them
+    void wait()
+    {
+        jobs.wait(pending);
+        collect();
+    }
+
+    // Loads and meshes everything around center before returning (e.g. at spawn)
+    void loadAround(const glm::vec3& center)
+    {
+        for (update(center); !idle(); update(center))
+            wait();
+    }
+
+    // Hands each mesh finished since the last call to f(coord, mesh); an empty mesh means
+    // the chunk has nothing to draw
+    template <typename F>
+    void drainMeshes(F&& f)
+    {
+        for (Finished& finished : ready)
+            f(finished.coord, finished.mesh);
+        ready.clear();
+    }
+
+    // Hands each chunk evicted since the last call to f(coord)
+    template <typename F>
+    void drainEvicted(F&& f)
+    {
+        for (const ChunkCoord& coord : evicted)
+            f(coord);
+        evicted.clear();
+    }
+
+    size_t chunkCount() const { return slots.size(); }
+    bool idle() const { return inFlight == 0 && queued == 0; }
+
+    // Solid blocks held by loaded chunks
+    uint64_t solidBlocks() const
+    {
+        uint64_t count = 0;
+        for (const auto& entry : slots)
+            count += entry.second.chunk != nullptr ? entry.second.chunk->solidCount() : 0;
+        return count;
+    }
+
+    // Bytes held by loaded and set-aside chunks
+    size_t memoryBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& entry : slots)
+            bytes += entry.second.chunk != nullptr ? entry.second.chunk->memoryBytes() : 0;
+        for (const auto& entry : saved)
+            bytes += entry.second->memoryBytes();
+        return bytes;
+    }
+
+private:
+    struct Slot
+    {
+        std::shared_ptr<VoxelChunk> chunk; // Null while generating
+        uint32_t version = 0;              // Bumped when the chunk or a neighbor's border changes
+        bool edited = false;               // Set aside instead of dropped when evicted
+        bool dirty = false;                // Needs a mesh
+        bool meshing = false;
+    };
+
+    struct Generated
+    {
+        ChunkCoord coord;
+        std::shared_ptr<VoxelChunk> chunk;
+    };
+
+    struct Finished
+    {
+        ChunkCoord coord;
+        uint32_t version;
+        VoxelMesh mesh;
+    };
+
+    Settings settings;
+    TerrainGenerator generator;
+    JobSystem& jobs;
+    std::shared_ptr<const VoxelChunk> bedrock; // Below the lowest chunks
+
+    std::unordered_map<ChunkCoord, Slot, ChunkCoordHash> slots;
+    std::unordered_map<ChunkCoord, std::shared_ptr<VoxelChunk>, ChunkCoordHash> saved; // Evicted edited chunks
+
+    bool hasCenter;
+    ChunkCoord centerChunk;
+    std::vector<ChunkCoord> wanted; // Chunks within radius, nearest first
+    size_t cursor;                  // wanted before this are loaded or loading
+    size_t dirtyCount;              // Slots needing a mesh
+    size_t farSlots;                // Slots beyond reach kept by evictFar() for their jobs
+
+    // Job results, appended by workers under the lock
+    JobCounter pending;
+    size_t inFlight; // Jobs queued and not collected
+    size_t queued;   // Jobs queued by the last update()
+    std::mutex resultMutex;
+    std::vector<Generated> generatedResults, generatedSwap;
+    std::vector<Finished> meshResults, meshSwap;
+
+    std::vector<Finished> ready;
+    std::vector<ChunkCoord> evicted;
+
+    void invalidate(Slot& slot)
+    {
+        slot.version++;
+        if (!slot.dirty) {
+            slot.dirty = true;
+            dirtyCount++;
+        }
+    }
+
+    void recenter(ChunkCoord c)
+    {
+        hasCenter = true;
+        centerChunk = c;
+        wanted.clear();
+        int r = settings.radius;
+        for (int dz = -r; dz <= r; dz++)
+            for (int dx = -r; dx <= r; dx++)
+                if (dx * dx + dz * dz <= r * r)
+                    for (int y = settings.minChunkY; y < settings.maxChunkY; y++)
+                        wanted.push_back(ChunkCoord{ c.x + dx, y, c.z + dz });
+        std::sort(wanted.begin(), wanted.end(), [&](const ChunkCoord& a, const ChunkCoord& b) {
+            int da = (a.x - c.x) * (a.x - c.x) + (a.z - c.z) * (a.z - c.z);
+            int db = (b.x - c.x) * (b.x - c.x) + (b.z - c.z) * (b.z - c.z);
+            return da != db ? da < db : a.y > b.y; // Surface layers first
+        });
+        cursor = 0;
+    }
+
+    bool beyondReach(ChunkCoord coord) const
+    {
+        int dx = coord.x - centerChunk.x, dz = coord.z - centerChunk.z;
+        return dx * dx + dz * dz > (settings.radius + 1) * (settings.radius + 1);
+    }
+
+    // Drops chunks beyond radius + 1 that no job is working on; edited ones are compacted
+    // and set aside. The others are counted in farSlots, for collect() to retry
+    void evictFar()
+    {
+        farSlots = 0;
+        for (auto it = slots.begin(); it != slots.end();) {
+            Slot& slot = it->second;
+            if (!beyondReach(it->first)) {
+                ++it;
+                continue;
+            }
+            if (slot.chunk == nullptr || slot.meshing) {
+                farSlots++;
+                ++it;
+                continue;
+            }
+            if (slot.edited) {
+                if (slot.chunk.use_count() > 1)
+                    slot.chunk = std::make_shared<VoxelChunk>(*slot.chunk); // A neighbor's job holds it
+                slot.chunk->compact();
+                saved[it->first] = slot.chunk;
+            }
+            dirtyCount -= slot.dirty;
+            evicted.push_back(it->first);
+            statistics.evicted++;
+            it = slots.erase(it);
+        }
+    }
+
+    void load(ChunkCoord coord)
+    {
+        Slot& slot = slots[coord];
+        auto it = saved.find(coord);
+        if (it != saved.end()) {
+            slot.chunk = it->second;
+            slot.edited = true;
+            saved.erase(it);
+            invalidate(slot);
+            return;
+        }
+        submit([this, coord] {
+            auto chunk = std::make_shared<VoxelChunk>();
+            generator.generate(coord, *chunk);
+            std::lock_guard<std::mutex> lock(resultMutex);
+            generatedResults.push_back(Generated{ coord, std::move(chunk) });
+        });
+    }
+
+    // Queues a mesh of slot if its side neighbors are loaded
+    void mesh(ChunkCoord coord, Slot& slot)
+    {
+        static const int offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+        std::array<std::shared_ptr<const VoxelChunk>, 7> snapshot;
+        snapshot[0] = slot.chunk;
+        for (int face = 0; face < 6; face++) {
+            ChunkCoord n{ coord.x + offsets[face][0], coord.y + offsets[face][1], coord.z + offsets[face][2] };
+            if (n.y < settings.minChunkY) {
+                snapshot[face + 1] = bedrock;
+                continue;
+            }
+            if (n.y >= settings.maxChunkY)
+                continue; // Open sky
+            auto it = slots.find(n);
+            if (it == slots.end() || it->second.chunk == nullptr)
+                return;
+            snapshot[face + 1] = it->second.chunk;
+        }
+
+        slot.dirty = false;
+        slot.meshing = true;
+        dirtyCount--;
+        uint32_t version = slot.version;
+        if (slot.chunk->uniform() && slot.chunk->uniformBlock() == AIR) {
+            // Nothing to draw; skip the job
+            std::lock_guard<std::mutex> lock(resultMutex);
+            meshResults.push_back(Finished{ coord, version, VoxelMesh() });
+            inFlight++;
+            return;
+        }
+        submit([this, coord, version, snapshot] {
+            static thread_local GreedyMesher<SIZE> mesher;
+            const VoxelChunk* neighbors[6];
+            for (int face = 0; face < 6; face++)
+                neighbors[face] = snapshot[face + 1].get();
+            Finished finished{ coord, version, VoxelMesh() };
+            mesher.load(*snapshot[0], neighbors);
+            mesher.build(finished.mesh);
+            std::lock_guard<std::mutex> lock(resultMutex);
+            meshResults.push_back(std::move(finished));
+        });
+    }
+
+    template <typename F>
+    void submit(F&& function)
+    {
+        inFlight++;
+        queued++;
+        jobs.run(std::forward<F>(function), &pending);
+    }
+
+    // Installs generated chunks and publishes the meshes that are still current, then
+    // evicts the chunks left beyond reach once their jobs are done
+    void collect()
+    {
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            generatedSwap.swap(generatedResults);
+            meshSwap.swap(meshResults);
+        }
+        inFlight -= generatedSwap.size() + meshSwap.size();
+        for (Generated& generated : generatedSwap) {
+            Slot& slot = slots[generated.coord];
+            slot.chunk = std::move(generated.chunk);
+            invalidate(slot);
+            statistics.generated++;
+        }
+        generatedSwap.clear();
+        for (Finished& finished : meshSwap) {
+            statistics.meshed++;
+            auto it = slots.find(finished.coord);
+            if (it == slots.end())
+                continue;
+            it->second.meshing = false;
+            if (finished.version != it->second.version) {
+                statistics.stale++; // Edited since; it is dirty again
+                continue;
+            }
+            if (!beyondReach(finished.coord))
+                ready.push_back(std::move(finished));
+        }
+        meshSwap.clear();
+        if (farSlots > 0)
+            evictFar();
+    }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+// Helpers shared by the benchmarks: pass/fail checks and generated test geometry
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// Checks print one line each; checkResult() prints the verdict and returns main's exit code
+inline int failures = 0;
+
+inline void check(bool ok, const char* what)
+{
+    std::printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+inline int checkResult()
+{
+    std::printf("\n%s\n", failures == 0 ? "All checks passed" : "CHECKS FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+// Unit sphere positions and indices, appended to the given arrays
+inline void appendSphere(int segments, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+    unsigned int base = static_cast<unsigned int>(vertices.size() / 3);
+    int rings = segments / 2;
+    for (int r = 0; r <= rings; r++) {
+        float phi = 3.14159265f * r / rings;
+        for (int a = 0; a <= segments; a++) {
+            float theta = 6.2831853f * a / segments;
+            vertices.insert(vertices.end(), { 0.5f * std::sin(phi) * std::cos(theta), 0.5f * std::cos(phi),
+                                              0.5f * std::sin(phi) * std::sin(theta) });
+        }
+    }
+    for (int r = 0; r < rings; r++) {
+        for (int a = 0; a < segments; a++) {
+            unsigned int i = base + r * (segments + 1) + a, j = i + segments + 1;
+            indices.insert(indices.end(), { i, j, i + 1, i + 1, j, j + 1 });
+        }
+    }
+}
+
+// A wavy n x n grid as an OBJ file. With attributes every vertex also gets a uv and a
+// normal, and faces use the v/vt/vn form
+inline void writeGrid(const char* path, int n, bool attributes = false)
+{
+    std::ofstream out(path);
+    for (int z = 0; z < n; z++) {
+        for (int x = 0; x < n; x++) {
+            out << "v " << x * 0.1f << " " << std::sin(x * 0.05f) * std::cos(z * 0.05f) << " " << z * 0.1f << "\n";
+            if (attributes)
+                out << "vt " << x / float(n - 1) << " " << z / float(n - 1) << "\nvn 0 1 0\n";
+        }
+    }
+    auto face = [&](int a, int b, int c) {
+        out << "f";
+        for (int i : { a, b, c }) {
+            out << " " << i;
+            if (attributes)
+                out << "/" << i << "/" << i;
+        }
+        out << "\n";
+    };
+    for (int z = 0; z + 1 < n; z++) {
+        for (int x = 0; x + 1 < n; x++) {
+            int i = z * n + x + 1;
+            face(i, i + 1, i + n + 1);
+            face(i, i + n + 1, i + n);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,303 @@
+// Collision checks and timings, no GL context needed.
+// First a set of deterministic scenarios: landing on a floor, sliding along a wall,
+// walking off a ledge, a fast body against a thin wall, a moved box collider, a mesh
+// collider, the spatial hash against brute force (also after moving items in place) and
+// bit-identical reruns. Exits with 1 if any of them fails. Then 100k static box colliders:
+// broadphase build time, and query and player step costs; and 10k cube meshes moved every
+// step.
+#include "../Cube.h"
+#include "../Player.h"
+#include "Bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+// A floor whose top is at y = 0, so a grounded player's eye rests at eyeHeight
+static void addFloor(CollisionWorld& world)
+{
+    world.addBox(AABB(Vec3(-50.0f, -1.0f, -50.0f), Vec3(50.0f, 0.0f, 50.0f)));
+}
+
+static void run(Player& player, const PlayerInput& input, int steps)
+{
+    for (int i = 0; i < steps; i++)
+        player.step(input, 1.0f / 60.0f);
+}
+
+static void scenarios()
+{
+    std::printf("Scenarios:\n");
+    const float dt = 1.0f / 60.0f;
+    const float skin = CollisionWorld().skin;
+
+    // Falls onto the floor and rests on it
+    {
+        CollisionWorld world;
+        addFloor(world);
+        Camera camera;
+        Player player(Vec3(0.0f, 5.0f, 0.0f), &camera, &world);
+        player.grounded = false;
+        run(player, PlayerInput(), 120);
+        float feet = player.position.y - player.eyeHeight;
+        check(player.grounded, "lands on the floor (grounded)");
+        check(feet >= 0.0f && feet <= skin, "rests within the skin of the floor");
+        check(player.velocity.y == 0.0f, "vertical velocity cleared on landing");
+
+        PlayerInput jump;
+        jump.jump = true;
+        player.step(jump, dt);
+        check(!player.grounded && player.velocity.y > 0.0f, "jumps from the floor");
+        run(player, PlayerInput(), 120);
+        check(player.grounded, "lands again after the jump");
+    }
+
+    // Walks diagonally into a wall at x = 2 and slides along it
+    {
+        CollisionWorld world;
+        addFloor(world);
+        world.addBox(AABB(Vec3(2.0f, 0.0f, -50.0f), Vec3(3.0f, 3.0f, 50.0f)));
+        Camera camera; // Looking down -z
+        Player player(Vec3(0.0f, 1.6f, 0.0f), &camera, &world);
+        PlayerInput input;
+        input.direction = Vec2(1.0f, 1.0f); // Right (+x) and forward (-z)
+        run(player, input, 180);
+        check(player.position.x + player.radius <= 2.0f, "does not pass through the wall");
+        check(player.position.x + player.radius >= 2.0f - 2.0f * skin, "stays against the wall");
+        check(player.position.z < -5.0f, "slides along the wall");
+        check(player.grounded, "stays grounded while sliding");
+    }
+
+    // Walks off the edge of a raised platform and lands on the floor below
+    {
+        CollisionWorld world;
+        addFloor(world);
+        world.addBox(AABB(Vec3(-2.0f, 0.0f, -2.0f), Vec3(2.0f, 1.0f, 2.0f)));
+        Camera camera;
+        Player player(Vec3(0.0f, 2.6f + 0.5f * skin, 0.0f), &camera, &world);
+        run(player, PlayerInput(), 10);
+        check(player.grounded && player.position.y > 2.5f, "stands on the platform");
+
+        PlayerInput input;
+        input.direction = Vec2(0.0f, 1.0f);
+        bool leftGround = false;
+        for (int i = 0; i < 120; i++) {
+            player.step(input, dt);
+            leftGround = leftGround || !player.grounded;
+        }
+        check(leftGround, "ungrounded after walking off the edge");
+        check(player.grounded && player.position.y < 1.7f, "lands on the floor below");
+    }
+
+    // A fast capsule against a thin wall: 120 units/s is 2 units per step
+    {
+        CollisionWorld world;
+        world.addBox(AABB(Vec3(-5.0f, -5.0f, -0.05f), Vec3(5.0f, 5.0f, 0.05f)));
+        Capsule capsule{ Vec3(0.0f, 0.0f, 3.0f), Vec3(0.0f, 1.0f, 3.0f), 0.3f };
+        Vec3 moved(0.0f);
+        for (int i = 0; i < 10; i++)
+            moved += world.slide(capsule.translated(moved), Vec3(0.0f, 0.0f, -2.0f));
+        check(capsule.a.z + moved.z >= 0.05f + 0.3f, "no tunnelling through a thin wall");
+    }
+
+    // A box collider moved by setTransform blocks at its new place, not the old one
+    {
+        CollisionWorld world;
+        int wall = world.addBox(AABB(Vec3(-5.0f, -5.0f, -0.05f), Vec3(5.0f, 5.0f, 0.05f)));
+        world.setTransform(wall, glm::translate(glm::mat4(1.0f), Vec3(0.0f, 0.0f, -2.0f)));
+        Capsule capsule{ Vec3(0.0f, 0.0f, 3.0f), Vec3(0.0f, 1.0f, 3.0f), 0.3f };
+        CollisionHit hit;
+        bool blocked = world.sweep(capsule, Vec3(0.0f, 0.0f, -6.0f), hit);
+        float stop = capsule.a.z - 6.0f * hit.t; // The wall's front face is now at z = -1.95
+        check(blocked && hit.collider == wall && std::fabs(stop - (-1.95f + 0.3f)) < 2.0f * skin,
+              "a moved box collider blocks at its new place");
+    }
+
+    // A rotated cube mesh as a collider: a capsule dropped on it lands on its top corner
+    {
+        CollisionWorld world;
+        glm::mat4 transform = glm::rotate(glm::mat4(1.0f), glm::radians(45.0f), Vec3(0.0f, 0.0f, 1.0f));
+        world.addMesh(CollisionMesh::fromArrays(Cube::meshVertices(), Cube::meshIndices()), transform);
+        Capsule capsule{ Vec3(0.0f, 3.0f, 0.0f), Vec3(0.0f, 4.0f, 0.0f), 0.25f };
+        CollisionHit hit;
+        bool found = world.sweep(capsule, Vec3(0.0f, -5.0f, 0.0f), hit);
+        float bottom = capsule.a.y - 5.0f * hit.t - capsule.radius;
+        check(found && std::fabs(bottom - std::sqrt(0.5f)) < 2.0f * skin, "stops on the corner of a rotated cube mesh");
+    }
+
+    // Broadphase against brute force
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.1f, 6.0f);
+        std::vector<AABB> boxes;
+        for (int i = 0; i < 5000; i++) {
+            Vec3 p(position(rng), position(rng) * 0.1f, position(rng));
+            boxes.emplace_back(p, p + Vec3(size(rng), size(rng), size(rng)));
+        }
+        boxes.emplace_back(Vec3(-200.0f, -20.0f, -200.0f), Vec3(200.0f, -19.0f, 200.0f)); // Large item
+        SpatialHash hash(4.0f);
+        hash.build(boxes);
+
+        bool same = true;
+        std::vector<int> found;
+        for (int q = 0; q < 500 && same; q++) {
+            Vec3 p(position(rng), position(rng) * 0.2f, position(rng));
+            AABB box(p, p + Vec3(size(rng), size(rng), size(rng)) * 3.0f);
+            found.clear();
+            hash.query(box, found);
+            std::vector<int> expected;
+            for (size_t i = 0; i < boxes.size(); i++)
+                if (boxes[i].overlaps(box))
+                    expected.push_back(static_cast<int>(i));
+            std::sort(found.begin(), found.end());
+            same = found == expected;
+        }
+        check(same, "spatial hash matches brute force");
+
+        // Items nudged within their cells, moved far away, emptied and refilled
+        std::uniform_real_distribution<float> nudge(-0.5f, 0.5f);
+        for (int round = 0; round < 20 && same; round++) {
+            for (int i = 0; i < 300; i++) {
+                int item = static_cast<int>(rng() % (boxes.size() - 1));
+                Vec3 offset = i % 3 == 0 ? Vec3(position(rng), 0.0f, position(rng)) : Vec3(nudge(rng), nudge(rng), nudge(rng));
+                boxes[item] = i % 50 == 0 ? AABB() : AABB(boxes[item].min + offset, boxes[item].max + offset);
+                hash.update(item, boxes[item]);
+            }
+            for (int q = 0; q < 50 && same; q++) {
+                Vec3 p(position(rng), position(rng) * 0.2f, position(rng));
+                AABB box(p, p + Vec3(size(rng), size(rng), size(rng)) * 3.0f);
+                found.clear();
+                hash.query(box, found);
+                std::vector<int> expected;
+                for (size_t i = 0; i < boxes.size(); i++)
+                    if (boxes[i].overlaps(box))
+                        expected.push_back(static_cast<int>(i));
+                std::sort(found.begin(), found.end());
+                same = found == expected;
+            }
+        }
+        check(same, "updated spatial hash matches brute force");
+    }
+
+    // Identical inputs give bit-identical results
+    {
+        auto trajectory = [] {
+            CollisionWorld world;
+            addFloor(world);
+            for (int i = 0; i < 20; i++)
+                world.addBox(AABB(Vec3(i * 1.5f - 15.0f, 0.0f, -4.0f - i % 3), Vec3(i * 1.5f - 14.2f, 0.5f + i % 4, -3.0f - i % 3)));
+            Camera camera;
+            Player player(Vec3(0.0f, 1.6f, 0.0f), &camera, &world);
+            std::vector<Vec3> positions;
+            PlayerInput input;
+            for (int i = 0; i < 600; i++) {
+                input.direction = Vec2(std::sin(i * 0.05f), 1.0f);
+                input.jump = i % 90 == 0;
+                player.step(input, 1.0f / 60.0f);
+                positions.push_back(player.position);
+            }
+            return positions;
+        };
+        std::vector<Vec3> a = trajectory(), b = trajectory();
+        check(memcmp(a.data(), b.data(), a.size() * sizeof(Vec3)) == 0, "reruns are bit-identical");
+    }
+}
+
+static void timings()
+{
+    const int COLLIDERS = 100000;
+    std::printf("\n%d static box colliders over 1000 x 1000 units:\n", COLLIDERS);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f), size(0.5f, 4.0f);
+    CollisionWorld world;
+    world.addBox(AABB(Vec3(-520.0f, -1.0f, -520.0f), Vec3(520.0f, 0.0f, 520.0f)));
+    for (int i = 0; i < COLLIDERS;) {
+        Vec3 p(position(rng), 0.0f, position(rng));
+        AABB box(p, p + Vec3(size(rng), size(rng), size(rng)));
+        if (!box.overlaps(AABB(Vec3(-5.0f), Vec3(5.0f)))) { // Keep the player's start clear
+            world.addBox(box);
+            i++;
+        }
+    }
+
+    std::vector<int> found;
+    auto start = Clock::now();
+    world.query(AABB(Vec3(0.0f), Vec3(0.0f)), found); // Triggers the broadphase build
+    double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::printf("  broadphase build        %9.3f ms\n", buildMs);
+
+    // Player-sized box queries
+    const int QUERIES = 100000;
+    std::vector<Vec3> points;
+    for (int i = 0; i < QUERIES; i++)
+        points.emplace_back(position(rng), 1.0f, position(rng));
+    size_t hits = 0;
+    start = Clock::now();
+    for (const Vec3& p : points) {
+        found.clear();
+        world.query(AABB(p - Vec3(0.5f, 1.0f, 0.5f), p + Vec3(0.5f, 1.0f, 0.5f)), found);
+        hits += found.size();
+    }
+    double queryUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / QUERIES;
+    std::printf("  box query               %9.3f us  (%.1f hits)\n", queryUs, double(hits) / QUERIES);
+
+    // Brute force for reference
+    start = Clock::now();
+    size_t bruteHits = 0;
+    for (int q = 0; q < 100; q++) {
+        AABB box(points[q] - Vec3(0.5f, 1.0f, 0.5f), points[q] + Vec3(0.5f, 1.0f, 0.5f));
+        for (size_t i = 0; i < world.size(); i++)
+            bruteHits += world.bounds(static_cast<int>(i)).overlaps(box);
+    }
+    double bruteUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / 100;
+    volatile size_t sink = bruteHits;
+    (void)sink;
+    std::printf("  brute force query       %9.3f us\n", bruteUs);
+
+    // Capsule sweeps and full player steps through the field
+    Camera camera;
+    Player player(Vec3(0.0f, 1.6f, 0.0f), &camera, &world);
+    PlayerInput input;
+    const int STEPS = 20000;
+    start = Clock::now();
+    for (int i = 0; i < STEPS; i++) {
+        input.direction = Vec2(std::sin(i * 0.01f), 1.0f);
+        input.jump = i % 45 == 0;
+        player.step(input, 1.0f / 60.0f);
+    }
+    double stepUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / STEPS;
+    std::printf("  player step (2 sweeps)  %9.3f us  (ended at %.1f, %.1f, %.1f)\n", stepUs,
+                player.position.x, player.position.y, player.position.z);
+
+    // Spinning cube meshes moved every step, as in the demo, with a player walking among them
+    const int SPINNING = 10000;
+    CollisionWorld spinning;
+    spinning.addBox(AABB(Vec3(-520.0f, -1.0f, -520.0f), Vec3(520.0f, 0.0f, 520.0f)));
+    auto cube = CollisionMesh::fromArrays(Cube::meshVertices(), Cube::meshIndices());
+    std::vector<Vec3> centers;
+    for (int i = 0; i < SPINNING; i++) {
+        centers.emplace_back(position(rng) * 0.2f, 3.0f + (i % 5) * 3.0f, position(rng) * 0.2f);
+        spinning.addMesh(cube, glm::translate(glm::mat4(1.0f), centers.back()));
+    }
+    Player walker(Vec3(0.0f, 1.6f, 0.0f), &camera, &spinning);
+    const int SPIN_STEPS = 200;
+    start = Clock::now();
+    for (int s = 0; s < SPIN_STEPS; s++) {
+        for (int i = 0; i < SPINNING; i++)
+            spinning.setTransform(i + 1, glm::rotate(glm::translate(glm::mat4(1.0f), centers[i]), s * 0.05f, Vec3(1.0f)));
+        input.direction = Vec2(std::sin(s * 0.01f), 1.0f);
+        walker.step(input, 1.0f / 60.0f);
+    }
+    double spinMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / SPIN_STEPS;
+    std::printf("  %d moving colliders  %9.3f ms per step (moves and player step)\n", SPINNING, spinMs);
+}
+
+int main()
+{
+    scenarios();
+    timings();
+    return checkResult();
+}
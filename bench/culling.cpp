@@ -0,0 +1,145 @@
+// Frustum culling checks and cost. The checks cover a hand-built scene (boxes inside,
+// outside, straddling a plane and behind the camera) before and after a refit; then, for
+// 100k-object scenes, BVH build, incremental refit with a fraction of moving objects, and
+// query time and rejection rate against brute force, whose visible set the BVH must match
+// object for object. Exits with 1 on any failure.
+#include "../BVH.h"
+#include "Bench.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Sorted ids of the objects the BVH keeps
+static std::vector<int> visibleSet(const BVH& bvh, const Frustum& frustum)
+{
+    std::vector<int> visible;
+    bvh.query(frustum, visible);
+    std::sort(visible.begin(), visible.end());
+    return visible;
+}
+
+static AABB cube(glm::vec3 center, float halfSize)
+{
+    return AABB(center - glm::vec3(halfSize), center + glm::vec3(halfSize));
+}
+
+static void checks()
+{
+    std::printf("Checks:\n");
+    // Camera at the origin looking down -z: at z = -10 the view spans x and y in [-10, 10]
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+
+    std::vector<AABB> scene = {
+        cube(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f),    // 0: inside
+        cube(glm::vec3(50.0f, 0.0f, -10.0f), 1.0f),   // 1: right of the view
+        cube(glm::vec3(-10.0f, 0.0f, -10.0f), 1.0f),  // 2: straddling the left plane
+        cube(glm::vec3(0.0f, 0.0f, 10.0f), 1.0f),     // 3: behind the camera
+        cube(glm::vec3(0.0f, 0.0f, -100.0f), 2.0f),   // 4: straddling the far plane
+        cube(glm::vec3(0.0f, 0.0f, -150.0f), 1.0f),   // 5: beyond the far plane
+        cube(glm::vec3(0.0f), 0.5f),                  // 6: around the camera, through the near plane
+        cube(glm::vec3(0.0f, 30.0f, -10.0f), 1.0f),   // 7: above the view
+        cube(glm::vec3(3.0f, -4.0f, -20.0f), 0.25f),  // 8: inside
+        cube(glm::vec3(-3.0f, 0.0f, 25.0f), 20.0f),   // 9: behind the camera, wider than the view
+    };
+    BVH bvh;
+    bvh.build(scene);
+    check(visibleSet(bvh, frustum) == std::vector<int>({ 0, 2, 4, 6, 8 }), "hand-built scene: expected visible set");
+
+    // Swap the inside and the right-hand box, then move one behind the camera into view
+    std::swap(scene[0], scene[1]);
+    scene[3] = cube(glm::vec3(0.0f, 0.0f, -30.0f), 1.0f);
+    for (int i : { 0, 1, 3 })
+        bvh.setBounds(i, scene[i]);
+    bvh.refit();
+    check(visibleSet(bvh, frustum) == std::vector<int>({ 1, 2, 3, 4, 6, 8 }), "hand-built scene: expected set after a refit");
+
+    // Nothing in view, and an empty tree
+    glm::mat4 away = glm::lookAt(glm::vec3(0.0f, 0.0f, -500.0f), glm::vec3(0.0f, 0.0f, -501.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    check(visibleSet(bvh, Frustum::fromMatrix(projection * away)).empty(), "hand-built scene: all culled looking away");
+    BVH empty;
+    empty.build({});
+    check(visibleSet(empty, frustum).empty(), "an empty tree returns nothing");
+}
+
+int main()
+{
+    checks();
+
+    const int count = 100000;
+    const int frames = 50;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f), size(0.5f, 3.0f), jitter(-0.5f, 0.5f);
+
+    std::vector<AABB> bounds(count);
+    for (AABB& box : bounds) {
+        glm::vec3 c(pos(rng), pos(rng) * 0.1f, pos(rng)), e(size(rng));
+        box = AABB(c - e, c + e);
+    }
+
+    auto start = Clock::now();
+    BVH bvh;
+    bvh.build(bounds);
+    std::printf("\n%d objects: build %.2f ms, %zu nodes\n", count, msSince(start), bvh.nodes.size());
+
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    std::vector<int> visible, brute;
+    visible.reserve(count);
+    brute.reserve(count);
+
+    for (float moving : {0.0f, 0.1f, 1.0f}) {
+        double refitMs = 0.0, queryMs = 0.0, bruteMs = 0.0;
+        size_t visibleTotal = 0;
+        bool same = true;
+        for (int f = 0; f < frames; f++) {
+            // Move a fraction of the objects
+            start = Clock::now();
+            for (int i = 0; i < int(count * moving); i++) {
+                glm::vec3 d(jitter(rng), 0.0f, jitter(rng));
+                bounds[i] = AABB(bounds[i].min + d, bounds[i].max + d);
+                bvh.setBounds(i, bounds[i]);
+            }
+            bvh.refit();
+            refitMs += msSince(start);
+
+            // Camera spinning at the origin
+            float yaw = f * (6.2831853f / frames);
+            glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(std::cos(yaw), 0.0f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+            Frustum frustum = Frustum::fromMatrix(projection * view);
+
+            start = Clock::now();
+            visible.clear();
+            bvh.query(frustum, visible);
+            queryMs += msSince(start);
+            visibleTotal += visible.size();
+
+            start = Clock::now();
+            brute.clear();
+            for (int i = 0; i < count; i++)
+                if (frustum.intersects(bounds[i]))
+                    brute.push_back(i);
+            bruteMs += msSince(start);
+
+            // Same objects, not just the same number
+            std::sort(visible.begin(), visible.end());
+            same = same && visible == brute;
+        }
+        double rejection = 100.0 * (1.0 - double(visibleTotal) / (double(count) * frames));
+        std::printf("moving %3.0f%%: refit %.3f ms, query %.3f ms (brute force %.3f ms), rejected %.2f%%\n",
+                    moving * 100.0f, refitMs / frames, queryMs / frames, bruteMs / frames, rejection);
+        char what[64];
+        std::snprintf(what, sizeof(what), "moving %.0f%%: BVH keeps the brute-force set", moving * 100.0f);
+        check(same, what);
+    }
+    return checkResult();
+}
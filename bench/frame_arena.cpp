@@ -0,0 +1,174 @@
+// Transient per-frame lists from the heap vs from FrameAllocator's arenas, counting heap
+// allocations once the frames repeat. Fails if an arena frame allocates after the first
+// round of frames, if a spill is misaligned, if a spill, a rewind or a scratch scope loses
+// data, or if parallelFor over many chunks still allocates once its jobs are recycled.
+#include "../AllocationCounter.h"
+#include "../FrameArena.h"
+#include "../JobSystem.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// A frame's worth of short-lived lists: visible ids and their sort keys
+template <typename IntList, typename KeyList>
+static uint64_t buildFrame(IntList& visible, KeyList& keys, int count, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> coin(0, 3);
+    for (int i = 0; i < count; i++)
+        if (coin(rng) != 0)
+            visible.push_back(i);
+    for (int id : visible)
+        keys.push_back(static_cast<uint64_t>(id) * 2654435761u);
+    uint64_t sum = 0;
+    for (uint64_t key : keys)
+        sum += key;
+    return sum;
+}
+
+int main()
+{
+    const int count = 20000;
+    const int frames = 300;
+    const int warmup = FrameAllocator::FRAMES * 2;
+    bool ok = true;
+
+    // Heap: fresh vectors every frame, as a per-frame local would
+    std::mt19937 rng(3);
+    uint64_t heapSum = 0;
+    uint64_t before = AllocationCounter::count();
+    auto start = Clock::now();
+    for (int f = 0; f < frames; f++) {
+        std::vector<int> visible;
+        std::vector<uint64_t> keys;
+        heapSum += buildFrame(visible, keys, count, rng);
+    }
+    double heapMs = msSince(start);
+    uint64_t heapAllocations = AllocationCounter::count() - before;
+
+    // Arena: the same lists on the frame's arena; the first frames grow the blocks
+    rng.seed(3);
+    uint64_t arenaSum = 0;
+    FrameAllocator& frameAllocator = FrameAllocator::instance();
+    uint64_t steadyAllocations = 0;
+    start = Clock::now();
+    for (int f = 0; f < frames; f++) {
+        before = AllocationCounter::count();
+        frameAllocator.beginFrame();
+        std::pmr::vector<int> visible(frameAllocator.resource());
+        std::pmr::vector<uint64_t> keys(frameAllocator.resource());
+        arenaSum += buildFrame(visible, keys, count, rng);
+        if (f >= warmup)
+            steadyAllocations += AllocationCounter::count() - before;
+    }
+    double arenaMs = msSince(start);
+
+    std::printf("%d frames of %d-object lists\n", frames, count);
+    std::printf("heap vectors:   %8.2f ms  %8llu allocations\n", heapMs, (unsigned long long)heapAllocations);
+    std::printf("frame arena:    %8.2f ms  %8llu allocations after %d frames, block %zu KB\n", arenaMs,
+                (unsigned long long)steadyAllocations, warmup, frameAllocator.arena().blockCapacity() / 1024);
+    if (arenaSum != heapSum) {
+        std::printf("FAIL: arena frames computed a different result\n");
+        ok = false;
+    }
+    if (steadyAllocations != 0) {
+        std::printf("FAIL: steady-state arena frames allocated\n");
+        ok = false;
+    }
+
+    // A spill keeps the data intact, and the next reset grows the block to fit
+    LinearArena arena(256);
+    {
+        std::pmr::vector<int> list(&arena);
+        for (int i = 0; i < 1000; i++)
+            list.push_back(i);
+        for (int i = 0; i < 1000; i++)
+            if (list[i] != i)
+                ok = false;
+    }
+    arena.reset();
+    if (arena.blockCapacity() < arena.peak() || arena.used() != 0) {
+        std::printf("FAIL: reset did not grow the block to the peak (%zu < %zu)\n", arena.blockCapacity(), arena.peak());
+        ok = false;
+    }
+
+    // Spilled allocations keep their alignment, including the default pmr one
+    {
+        LinearArena small(64);
+        bool aligned = true;
+        for (size_t alignment : { size_t(1), size_t(8), size_t(16), alignof(std::max_align_t), size_t(32), size_t(128) }) {
+            for (int i = 0; i < 4; i++) {
+                void* p = small.allocate(100 + i, alignment);
+                aligned = aligned && reinterpret_cast<uintptr_t>(p) % alignment == 0;
+            }
+        }
+        small.reset();
+        if (!aligned || small.used() != 0) {
+            std::printf("FAIL: a spilled allocation is misaligned or its bytes were not released\n");
+            ok = false;
+        }
+    }
+
+    // Rewinding to a mark keeps what came before it
+    int* kept = static_cast<int*>(arena.allocate(sizeof(int), alignof(int)));
+    *kept = 42;
+    LinearArena::Mark mark = arena.mark();
+    (void)arena.allocate(arena.blockCapacity(), 16); // Spills
+    arena.rewind(mark);
+    if (*kept != 42 || arena.used() != sizeof(int)) {
+        std::printf("FAIL: rewind lost data or left %zu bytes\n", arena.used());
+        ok = false;
+    }
+
+    // Nested scratch scopes free their own allocations only
+    size_t scratchBefore = scratchArena().used();
+    {
+        ScratchScope outer;
+        std::pmr::vector<float> a(100, 1.0f, outer.resource());
+        size_t afterOuter = scratchArena().used();
+        {
+            ScratchScope inner;
+            std::pmr::vector<float> b(100000, 2.0f, inner.resource());
+        }
+        if (scratchArena().used() != afterOuter || a[99] != 1.0f) {
+            std::printf("FAIL: inner scratch scope did not rewind\n");
+            ok = false;
+        }
+    }
+    if (scratchArena().used() != scratchBefore) {
+        std::printf("FAIL: scratch scope did not rewind\n");
+        ok = false;
+    }
+
+    // Split parallel updates recycle their jobs: no allocations once the free lists fill
+    {
+        JobSystem jobs(4);
+        std::vector<float> values(100000, 1.0f);
+        uint64_t jobAllocations = 0;
+        for (int f = 0; f < 200; f++) {
+            before = AllocationCounter::count();
+            jobs.parallelFor(0, values.size(), 1024, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    values[i] = values[i] * 0.5f + 1.0f;
+            });
+            if (f >= 100)
+                jobAllocations += AllocationCounter::count() - before;
+        }
+        std::printf("parallelFor:    %8llu allocations after 100 frames of %zu jobs\n",
+                    (unsigned long long)jobAllocations, values.size() / 1024);
+        if (jobAllocations != 0) {
+            std::printf("FAIL: steady-state parallelFor allocated\n");
+            ok = false;
+        }
+    }
+
+    std::printf(ok ? "arena checks passed\n" : "arena checks FAILED\n");
+    return ok ? 0 : 1;
+}
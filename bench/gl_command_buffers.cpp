@@ -0,0 +1,366 @@
+// Recording a frame's draws on the job threads (ParallelRecorder) and replaying them on
+// the GL thread (CommandReplayer into GLRenderBackend), against doing the same work and
+// issuing GL calls inline on one thread. Every object spins, is frustum culled, picks a
+// level of detail by distance and sets its program, mesh, color and model matrix, so the
+// per-object CPU work is what a real frame does before its GL calls. Reports recording,
+// replay and total submit time per frame for 1 to 8 workers. Checks the replayer's
+// filtering and state change counts, that the commands don't depend on the worker count
+// and that replay renders the same image as the inline path, also when the replayer was
+// not reset after unbind(); exits with 1 if not. Uses a headless EGL context
+// (see Headless.h).
+// Usage: bench/gl_command_buffers [objects] [frames] (default 50000, 20)
+#include <GL/glew.h>
+#include "../CommandBuffer.h"
+#include "../Cube.h"
+#include "../Frustum.h"
+#include "../GLRenderBackend.h"
+#include "../Headless.h"
+#include "../UniformBuffer.h"
+#include "Bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string vertexSource =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (std140) uniform Frame { mat4 view; mat4 projection; mat4 viewProjection; };\n"
+    "uniform mat4 model;\n"
+    "void main() { gl_Position = viewProjection * model * vec4(aPos, 1.0f); }\n";
+// Two programs that differ only in how they shade
+static const char* fragmentSources[2] = {
+    "#version 330 core\nuniform vec4 color;\nout vec4 FragColor;\nvoid main() { FragColor = color; }\n",
+    "#version 330 core\nuniform vec4 color;\nout vec4 FragColor;\nvoid main() { FragColor = vec4(color.bgr, 1.0f); }\n"
+};
+
+// Counts what reaches the backend, for the filtering checks
+struct CountingBackend : RenderBackend
+{
+    int programs = 0, meshes = 0, uniforms = 0, draws = 0;
+
+    void bindProgram(uint32_t) override { programs++; }
+    void bindMesh(uint32_t) override { meshes++; }
+    void setVec4(int, const float*) override { uniforms++; }
+    void setMat4(int, const float*) override { uniforms++; }
+    void draw(int) override { draws++; }
+};
+
+// Sphere with two levels of detail (32 and 8 segments) in one index buffer
+static void uploadSphere(Mesh& mesh)
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    uint32_t fine = 0;
+    for (int segments : { 32, 8 }) {
+        unsigned int base = static_cast<unsigned int>(vertices.size() / 3);
+        int rings = segments / 2;
+        for (int r = 0; r <= rings; r++) {
+            float phi = 3.14159265f * r / rings;
+            for (int a = 0; a <= segments; a++) {
+                float theta = 6.2831853f * a / segments;
+                vertices.insert(vertices.end(), { 0.5f * std::sin(phi) * std::cos(theta), 0.5f * std::cos(phi),
+                                                  0.5f * std::sin(phi) * std::sin(theta) });
+            }
+        }
+        for (int r = 0; r < rings; r++) {
+            for (int a = 0; a < segments; a++) {
+                unsigned int i = base + r * (segments + 1) + a, j = i + segments + 1;
+                indices.insert(indices.end(), { i, j, i + 1, i + 1, j, j + 1 });
+            }
+        }
+        if (fine == 0)
+            fine = static_cast<uint32_t>(indices.size());
+    }
+    mesh.upload(vertices, indices);
+    mesh.setLODs({ MeshLOD{ 0, fine, 0.0f }, MeshLOD{ fine, static_cast<uint32_t>(indices.size()) - fine, 0.05f } });
+}
+
+struct SceneObject
+{
+    uint32_t program, mesh, material;
+    glm::vec3 position, axis;
+    float scale;
+};
+
+int main(int argc, char** argv)
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 50000;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::printf("Checks:\n");
+    {
+        CommandBuffer commands;
+        glm::vec4 red(1.0f, 0.0f, 0.0f, 1.0f);
+        commands.bindProgram(0);
+        commands.bindProgram(0);
+        commands.bindMesh(1);
+        commands.setVec4(2, red);
+        commands.setVec4(2, red);
+        commands.draw();
+        commands.bindMesh(1);
+        commands.setVec4(2, glm::vec4(0.0f));
+        commands.draw();
+        commands.bindProgram(1);
+        commands.setVec4(2, glm::vec4(0.0f)); // Same value, but the new program hasn't seen it
+        commands.draw();
+        CountingBackend counted;
+        CommandReplayer replayer;
+        replayer.replay(commands, counted);
+        check(counted.programs == 2 && counted.meshes == 1 && counted.uniforms == 3 && counted.draws == 3
+              && replayer.filtered == 3 && replayer.replayed == commands.size(),
+              "replay drops repeated binds and unchanged uniforms");
+        replayer.reset();
+        replayer.replay(commands, counted);
+        check(counted.programs == 4 && counted.meshes == 2, "reset() forgets the bound state");
+    }
+
+    HeadlessContext context;
+    if (!context.init())
+        return 1;
+    if (!initGlew())
+        return 1;
+
+    Framebuffer target;
+    if (!target.init(256, 256))
+        return 1;
+    target.bind();
+    glEnable(GL_DEPTH_TEST);
+
+    Shader vertex, fragments[2];
+    vertex.compile(GL_VERTEX_SHADER, vertexSource.c_str(), "object vertex");
+    ShaderProgram programs[2];
+    for (int i = 0; i < 2; i++) {
+        fragments[i].compile(GL_FRAGMENT_SHADER, fragmentSources[i], "color fragment");
+        programs[i].link({ &vertex, &fragments[i] });
+        programs[i].bindBlock("Frame", FrameUniforms::BINDING);
+    }
+    // Both programs link the same vertex stage, so the locations match
+    int modelLocation = programs[0].uniform("model"), colorLocation = programs[0].uniform("color");
+
+    UniformBuffer<FrameUniforms> frameUniforms;
+    frameUniforms.init(FrameUniforms::BINDING);
+    FrameUniforms frame;
+    frame.view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    frame.projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 200.0f);
+    frame.viewProjection = frame.projection * frame.view;
+    frameUniforms.update(frame);
+    Frustum frustum = Frustum::fromMatrix(frame.viewProjection);
+
+    MeshHandle cube = Cube::sharedMesh();
+    Mesh sphere;
+    uploadSphere(sphere);
+    GLRenderBackend backend;
+    const ShaderProgram* programList[2] = { &programs[0], &programs[1] };
+    const Mesh* meshList[2] = { cube.get(), &sphere };
+    for (const ShaderProgram* program : programList)
+        backend.addProgram(*program);
+    for (const Mesh* mesh : meshList)
+        backend.addMesh(*mesh);
+
+    std::vector<glm::vec4> materials;
+    for (int i = 0; i < 8; i++)
+        materials.push_back(glm::vec4((i & 1) ? 1.0f : 0.3f, (i & 2) ? 0.9f : 0.2f, (i & 4) ? 0.8f : 0.1f, 1.0f));
+
+    // Grouped by program, mesh and material, as a scene sorted once at load would be, so
+    // runs of objects share state for the replay to filter
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<SceneObject> objects;
+    for (int i = 0; i < count; i++) {
+        SceneObject object;
+        object.program = random() % 2;
+        object.mesh = random() % 2;
+        object.material = random() % materials.size();
+        object.position = glm::vec3((unit(random) - 0.5f) * 160.0f, (unit(random) - 0.5f) * 160.0f, -5.0f - unit(random) * 150.0f);
+        object.axis = glm::normalize(glm::vec3(unit(random), unit(random), 0.5f));
+        object.scale = 0.5f + unit(random) * 1.5f;
+        objects.push_back(object);
+    }
+    std::sort(objects.begin(), objects.end(), [](const SceneObject& a, const SceneObject& b) {
+        return std::tie(a.program, a.mesh, a.material) < std::tie(b.program, b.mesh, b.material);
+    });
+
+    // The per-object work of a frame: animate, cull, pick the level, then emit the state
+    // and draw through out (a CommandBuffer or, inline, straight to GL)
+    AABB unitBox(glm::vec3(-0.5f), glm::vec3(0.5f));
+    auto visit = [&](const SceneObject& object, int f, auto& out) {
+        glm::mat4 model = glm::rotate(glm::translate(glm::mat4(1.0f), object.position), f * 0.05f + object.scale, object.axis);
+        model = glm::scale(model, glm::vec3(object.scale));
+        if (!frustum.intersects(unitBox.transformed(model)))
+            return;
+        int lod = object.mesh == 1 && -object.position.z > 60.0f ? 1 : 0;
+        out.bindProgram(object.program);
+        out.bindMesh(object.mesh);
+        out.setVec4(colorLocation, materials[object.material]);
+        out.setMat4(modelLocation, model);
+        out.draw(lod);
+    };
+
+    // Inline: the same calls, made on this thread as objects are visited. Programs and
+    // meshes are only rebound when they change, as the replayer would
+    struct Inline
+    {
+        const ShaderProgram* const* programs;
+        const Mesh* const* meshes;
+        uint32_t program = ~0u, mesh = ~0u;
+        const Mesh* bound = nullptr;
+
+        void bindProgram(uint32_t p)
+        {
+            if (p != program)
+                programs[program = p]->use();
+        }
+        void bindMesh(uint32_t m)
+        {
+            if (m != mesh) {
+                bound = meshes[mesh = m];
+                glBindVertexArray(bound->VAO);
+            }
+        }
+        void setVec4(int location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+        void setMat4(int location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+        void draw(int lod)
+        {
+            const MeshLOD& level = bound->lods[std::min<size_t>(lod, bound->lods.size() - 1)];
+            size_t indexSize = (bound->indexType == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int);
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(level.count), bound->indexType, (void*)(level.first * indexSize));
+        }
+    };
+    auto drawInline = [&](int f) {
+        Inline out{ programList, meshList };
+        for (const SceneObject& object : objects)
+            visit(object, f, out);
+        glBindVertexArray(0);
+    };
+
+    const size_t GRAIN = 1024;
+    ParallelRecorder recorder;
+    CommandReplayer replayer;
+    auto record = [&](JobSystem& jobs, int f) {
+        recorder.record(jobs, objects.size(), GRAIN, [&](CommandBuffer& commands, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                visit(objects[i], f, commands);
+        });
+    };
+    auto replay = [&]() {
+        replayer.reset();
+        recorder.replay(replayer, backend);
+        backend.unbind(replayer);
+    };
+    // Every command and value the recorder holds, in replay order
+    auto recorded = [&]() {
+        std::vector<unsigned char> bytes;
+        for (size_t b = 0; b < recorder.bufferCount(); b++) {
+            const CommandBuffer& buffer = recorder.buffer(b);
+            for (const RenderCommand& command : buffer) {
+                const unsigned char* raw = reinterpret_cast<const unsigned char*>(&command);
+                bytes.insert(bytes.end(), raw, raw + sizeof(command));
+                if (command.type == CommandType::SetVec4 || command.type == CommandType::SetMat4) {
+                    const unsigned char* value = reinterpret_cast<const unsigned char*>(buffer.value(command));
+                    bytes.insert(bytes.end(), value, value + (command.type == CommandType::SetVec4 ? 16 : 64));
+                }
+            }
+        }
+        return bytes;
+    };
+
+    std::vector<unsigned char> inlineImage, replayImage;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawInline(0);
+    target.readPixels(inlineImage);
+
+    std::vector<unsigned char> serialCommands;
+    {
+        JobSystem serial(1), parallel(4);
+        record(serial, 0);
+        serialCommands = recorded();
+        record(parallel, 0);
+        check(recorded() == serialCommands, "4 workers record the same commands as 1");
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        replay();
+        target.readPixels(replayImage);
+    }
+    check(!inlineImage.empty() && replayImage == inlineImage, "replay renders the same image as inline calls");
+    // Five commands per drawn object, two of them binds: more than half of those dropped
+    check(replayer.filtered * 5 > replayer.replayed, "replay drops most binds (objects are grouped by state)");
+    size_t commandCount = recorder.commandCount();
+    uint64_t filtered = replayer.filtered;
+
+    // Every bind that reaches GL counts, program binds included; and a replay straight
+    // after unbind(), without reset(), binds its mesh again
+    {
+        uint64_t binds = 0;
+        uint32_t program = ~0u, mesh = ~0u;
+        for (size_t b = 0; b < recorder.bufferCount(); b++) {
+            for (const RenderCommand& command : recorder.buffer(b)) {
+                uint32_t* bound = command.type == CommandType::BindProgram ? &program
+                                : command.type == CommandType::BindMesh    ? &mesh
+                                                                            : nullptr;
+                if (bound != nullptr && *bound != command.object) {
+                    *bound = command.object;
+                    binds++;
+                }
+            }
+        }
+        uint64_t before = Profiler::instance().counters.stateChanges;
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        recorder.replay(replayer, backend);
+        backend.unbind(replayer);
+        uint64_t changes = Profiler::instance().counters.stateChanges - before;
+        check(changes > 0 && changes == binds, "program and mesh binds count as state changes");
+        target.readPixels(replayImage);
+        check(replayImage == inlineImage, "a replay after unbind() without reset() rebinds");
+    }
+    check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+    // Timed into a 1x1 viewport so a software rasterizer's fill doesn't hide the CPU cost
+    glViewport(0, 0, 1, 1);
+    auto timeFrames = [&](auto&& frameAt, double& firstMs, double& secondMs) {
+        firstMs = secondMs = 0.0;
+        for (int f = 1; f <= frames; f++) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            frameAt(f, firstMs, secondMs);
+            glFinish();
+        }
+        firstMs /= frames;
+        secondMs /= frames;
+    };
+    auto since = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+    double inlineMs, unused;
+    timeFrames([&](int f, double& first, double&) {
+        auto start = Clock::now();
+        drawInline(f);
+        first += since(start);
+    }, inlineMs, unused);
+
+    std::printf("\n%d objects, %d frames, %zu commands per frame (%llu dropped on replay), %u hardware threads\n",
+                count, frames, commandCount, (unsigned long long)filtered, std::thread::hardware_concurrency());
+    std::printf("%-20s %14s %14s %14s %10s\n", "", "record", "replay", "submit", "speedup");
+    std::printf("%-20s %14s %14s %11.3f ms %10s\n", "inline, 1 thread", "", "", inlineMs, "");
+    double oneWorkerMs = 0.0;
+    for (unsigned workers : { 1u, 2u, 4u, 8u }) {
+        JobSystem jobs(workers);
+        double recordMs, replayMs;
+        timeFrames([&](int f, double& first, double& second) {
+            auto start = Clock::now();
+            record(jobs, f);
+            first += since(start);
+            start = Clock::now();
+            replay();
+            second += since(start);
+        }, recordMs, replayMs);
+        if (workers == 1)
+            oneWorkerMs = recordMs + replayMs;
+        char name[32];
+        std::snprintf(name, sizeof(name), "%u worker%s", workers, workers == 1 ? "" : "s");
+        std::printf("%-20s %11.3f ms %11.3f ms %11.3f ms %9.2fx\n", name, recordMs, replayMs, recordMs + replayMs,
+                    oneWorkerMs / (recordMs + replayMs));
+    }
+
+    return checkResult();
+}
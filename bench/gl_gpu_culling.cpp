@@ -0,0 +1,252 @@
+// GPU-driven drawing (GpuScene: compute-shader frustum culling and level of detail, one
+// glMultiDrawElementsIndirectCount per mesh) against the CPU path (BVH query, selectLOD and
+// RenderQueue) on scenes of random cubes and spheres. Checks that both draw the same
+// objects at the same levels and render the same image, then reports the CPU time per
+// frame of each path as the object count grows: the GPU path's should stay flat. Exits with
+// 1 on a failed check, and with 0 (skipping) when the context can't run compute shaders.
+// Uses a headless EGL context (see Headless.h); run from the repository root so the
+// shaders are found.
+// Usage: bench/gl_gpu_culling [max objects] [frames] (default 100000, 20)
+#include <GL/glew.h>
+#include "../BVH.h"
+#include "../Cube.h"
+#include "../GpuScene.h"
+#include "../Headless.h"
+#include "../RenderQueue.h"
+#include "../UniformBuffer.h"
+#include "Bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+static const char* vertexSource =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 3) in mat4 instanceModel;\n"
+    "layout (std140) uniform Frame { mat4 view; mat4 projection; mat4 viewProjection; };\n"
+    "void main() { gl_Position = viewProjection * instanceModel * vec4(aPos, 1.0f); }\n";
+static const char* fragmentSource =
+    "#version 330 core\nout vec4 FragColor;\nvoid main() { FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f); }\n";
+
+struct SceneObject
+{
+    const Mesh* mesh;
+    int gpuMesh;
+    glm::mat4 model;
+    AABB bounds;
+    int lod;
+};
+
+static void resetCounters() { Profiler::instance().counters = FrameCounters(); }
+
+int main(int argc, char** argv)
+{
+    int maxCount = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    HeadlessContext context;
+    if (!context.init())
+        return 1;
+    if (!initGlew())
+        return 1;
+    std::printf("%s, %s\n", (const char*)glGetString(GL_VERSION), (const char*)glGetString(GL_RENDERER));
+    if (!GpuScene::supported()) {
+        std::printf("No compute shaders or GL_ARB_indirect_parameters; nothing to compare\n");
+        return 0;
+    }
+
+    const int size = 256;
+    const float fov = 60.0f;
+    Framebuffer target;
+    if (!target.init(size, size))
+        return 1;
+    target.bind();
+    glEnable(GL_DEPTH_TEST);
+
+    Shader vertex, fragment;
+    vertex.compile(GL_VERTEX_SHADER, vertexSource, "instanced vertex");
+    fragment.compile(GL_FRAGMENT_SHADER, fragmentSource, "color fragment");
+    ShaderProgram program;
+    program.link({ &vertex, &fragment });
+    program.bindBlock("Frame", FrameUniforms::BINDING);
+
+    UniformBuffer<FrameUniforms> frameUniforms;
+    frameUniforms.init(FrameUniforms::BINDING);
+    FrameUniforms frame;
+    const glm::vec3 eye(0.0f);
+    frame.view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    frame.projection = glm::perspective(glm::radians(fov), 1.0f, 0.1f, 200.0f);
+    frame.viewProjection = frame.projection * frame.view;
+    frameUniforms.update(frame);
+    const Frustum frustum = Frustum::fromMatrix(frame.viewProjection);
+
+    // A cube and a sphere with two levels of detail
+    MeshHandle cube = Cube::sharedMesh();
+    Mesh sphere;
+    {
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        appendSphere(32, vertices, indices);
+        uint32_t fine = static_cast<uint32_t>(indices.size());
+        appendSphere(8, vertices, indices);
+        sphere.upload(vertices, indices);
+        sphere.setLODs({ MeshLOD{ 0, fine, 0.0f }, MeshLOD{ fine, static_cast<uint32_t>(indices.size()) - fine, 0.2f } });
+    }
+
+    // Objects spread around the camera, about a sixth of them in view
+    auto makeScene = [&](int count) {
+        std::mt19937 random(5);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<SceneObject> objects;
+        for (int i = 0; i < count; i++) {
+            SceneObject object;
+            bool isCube = random() % 2 == 0;
+            object.mesh = isCube ? cube.get() : &sphere;
+            object.gpuMesh = isCube ? 0 : 1;
+            glm::vec3 position((unit(random) - 0.5f) * 300.0f, (unit(random) - 0.5f) * 300.0f, (unit(random) - 0.5f) * 300.0f);
+            object.model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), position), unit(random) * 6.0f,
+                                                  glm::normalize(glm::vec3(unit(random), unit(random), 0.5f))),
+                                      glm::vec3(0.5f + unit(random) * 1.5f));
+            object.bounds = object.mesh->bounds.transformed(object.model);
+            object.lod = 0;
+            objects.push_back(object);
+        }
+        return objects;
+    };
+
+    // CPU path: BVH query, selectLOD and the render queue
+    struct CpuPath
+    {
+        BVH bvh;
+        std::vector<int> visible;
+        RenderQueue queue;
+    };
+    auto cpuDraw = [&](std::vector<SceneObject>& objects, CpuPath& cpu) {
+        cpu.visible.clear();
+        cpu.bvh.query(frustum, cpu.visible);
+        for (int i : cpu.visible) {
+            SceneObject& object = objects[i];
+            glm::mat3 m(object.model);
+            float scale = std::max(glm::length(m[0]), std::max(glm::length(m[1]), glm::length(m[2])));
+            float distance = glm::length(object.bounds.center() - eye);
+            object.lod = selectLOD(object.mesh->lods, object.lod, distance, scale, fov, float(size));
+            cpu.queue.submit(program, *object.mesh, 0, object.lod, object.model * object.mesh->positionTransform, distance);
+        }
+        cpu.queue.flush();
+    };
+
+    std::printf("\nChecks (%d objects):\n", std::min(maxCount, 20000));
+    {
+        std::vector<SceneObject> objects = makeScene(std::min(maxCount, 20000));
+        CpuPath cpu;
+        cpu.queue.init();
+        std::vector<AABB> bounds;
+        for (const SceneObject& object : objects)
+            bounds.push_back(object.bounds);
+        cpu.bvh.build(bounds);
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        resetCounters();
+        cpuDraw(objects, cpu);
+        FrameCounters cpuCounters = Profiler::instance().counters;
+        std::vector<unsigned char> cpuImage;
+        target.readPixels(cpuImage);
+
+        GpuScene scene;
+        if (!scene.init())
+            return 1;
+        scene.addMesh(*cube);
+        scene.addMesh(sphere);
+        for (const SceneObject& object : objects)
+            scene.add(object.gpuMesh, object.model);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        resetCounters();
+        scene.draw(program, frame.viewProjection, eye, fov, float(size));
+        FrameCounters gpuCounters = Profiler::instance().counters;
+        GpuScene::Statistics statistics = scene.readStatistics();
+        std::vector<unsigned char> gpuImage;
+        target.readPixels(gpuImage);
+        check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+        // The shader's float math may disagree on a box exactly touching a plane or a level boundary
+        auto close = [](uint64_t a, uint64_t b) { return (a > b ? a - b : b - a) * 1000 <= std::max(a, b); };
+        std::printf("  visible: CPU %zu, GPU %llu; triangles: CPU %llu, GPU %llu\n", cpu.visible.size(),
+                    (unsigned long long)statistics.instances, (unsigned long long)cpuCounters.triangles,
+                    (unsigned long long)statistics.triangles);
+        check(statistics.instances > 0 && close(statistics.instances, cpu.visible.size()), "GPU culling keeps the objects the BVH does");
+        check(statistics.triangles < statistics.trianglesFullDetail && close(statistics.triangles, cpuCounters.triangles),
+              "GPU levels of detail match selectLOD");
+        bool used[2][2] = {};
+        for (int i : cpu.visible)
+            used[objects[i].gpuMesh][objects[i].lod] = true;
+        check(statistics.commands == uint64_t(used[0][0] + used[0][1] + used[1][0] + used[1][1]) && used[1][0] && used[1][1],
+              "compaction keeps one command per level in use");
+        check(gpuCounters.drawCalls == 2, "one draw call per mesh");
+
+        size_t covered = 0, differ = 0;
+        for (size_t i = 0; i + 2 < cpuImage.size(); i += 3) {
+            covered += cpuImage[i] || cpuImage[i + 1] || cpuImage[i + 2];
+            differ += cpuImage[i] != gpuImage[i] || cpuImage[i + 1] != gpuImage[i + 1] || cpuImage[i + 2] != gpuImage[i + 2];
+        }
+        check(covered > 0 && differ * 1000 <= covered, "GPU path renders the same image");
+
+        // Culling again after moving everything out of view leaves nothing to draw
+        for (size_t i = 0; i < objects.size(); i++)
+            scene.setTransform(static_cast<int>(i), glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 1000.0f)));
+        scene.draw(program, frame.viewProjection, eye, fov, float(size));
+        GpuScene::Statistics empty = scene.readStatistics();
+        check(empty.instances == 0 && empty.commands == 0, "moved objects are uploaded and culled");
+    }
+
+    // CPU time per frame as the scene grows, into a 1x1 viewport so a software rasterizer's
+    // fill doesn't hide it. The scene is static, as most of a large scene is
+    std::printf("\n%10s %16s %16s %16s %16s\n", "objects", "CPU path cpu", "CPU path frame", "GPU path cpu", "GPU path frame");
+    glViewport(0, 0, 1, 1);
+    for (int count = 1000; count <= maxCount; count *= 10) {
+        std::vector<SceneObject> objects = makeScene(count);
+        CpuPath cpu;
+        cpu.queue.init();
+        std::vector<AABB> bounds;
+        for (const SceneObject& object : objects)
+            bounds.push_back(object.bounds);
+        cpu.bvh.build(bounds);
+        GpuScene scene;
+        scene.init();
+        scene.addMesh(*cube);
+        scene.addMesh(sphere);
+        for (const SceneObject& object : objects)
+            scene.add(object.gpuMesh, object.model);
+
+        auto measure = [&](auto&& draw, double& cpuMs, double& frameMs) {
+            draw(); // Warm up: buffer layout and growth
+            glFinish();
+            cpuMs = 0.0;
+            auto start = Clock::now();
+            for (int f = 0; f < frames; f++) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                auto s = Clock::now();
+                draw();
+                cpuMs += std::chrono::duration<double, std::milli>(Clock::now() - s).count();
+                glFinish();
+            }
+            frameMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+            cpuMs /= frames;
+        };
+        double cpuPathCpu, cpuPathFrame, gpuPathCpu, gpuPathFrame;
+        measure([&] { cpuDraw(objects, cpu); }, cpuPathCpu, cpuPathFrame);
+        measure([&] { scene.draw(program, frame.viewProjection, eye, fov, float(size)); }, gpuPathCpu, gpuPathFrame);
+        std::printf("%10d %13.3f ms %13.3f ms %13.3f ms %13.3f ms\n", count, cpuPathCpu, cpuPathFrame, gpuPathCpu, gpuPathFrame);
+    }
+    target.bind();
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    if (std::strstr(renderer, "llvmpipe") != nullptr || std::strstr(renderer, "softpipe") != nullptr)
+        std::printf("(%s runs compute shaders on the CPU inside the GL calls, so the GPU path's CPU time\n"
+                    " includes its culling; its own work is the same 2 draws and a few binds at every size)\n",
+                    renderer);
+
+    return checkResult();
+}
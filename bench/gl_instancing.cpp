@@ -0,0 +1,132 @@
+// Compares CPU frame-submission cost of the per-object Cube path (one uniform upload and
+// draw per cube) against one InstancedMesh draw. Uses a headless EGL context (see
+// Headless.h), so no display is needed.
+// Usage: bench/gl_instancing [frames]
+#include <GL/glew.h>
+#include <glm/gtc/type_ptr.hpp>
+#include "../Cube.h"
+#include "../Headless.h"
+#include "../InstancedMesh.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+using Clock = std::chrono::steady_clock;
+
+static const char* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "uniform mat4 model;\n"
+    "uniform mat4 viewProjection;\n"
+    "void main() { gl_Position = viewProjection * model * vec4(aPos, 1.0f); }\n";
+static const char* instancedVertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 3) in mat4 instanceModel;\n"
+    "uniform mat4 viewProjection;\n"
+    "void main() { gl_Position = viewProjection * instanceModel * vec4(aPos, 1.0f); }\n";
+static const char* fragmentSource = "#version 330 core\n"
+    "out vec4 FragColor;\n"
+    "void main() { FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f); }\n";
+
+static unsigned int linkProgram(const char* vs, const char* fs)
+{
+    unsigned int v = glCreateShader(GL_VERTEX_SHADER), f = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(v, 1, &vs, NULL);
+    glShaderSource(f, 1, &fs, NULL);
+    glCompileShader(v);
+    glCompileShader(f);
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, v);
+    glAttachShader(program, f);
+    glLinkProgram(program);
+    glDeleteShader(v);
+    glDeleteShader(f);
+    return program;
+}
+
+struct Timing {
+    double submitMs; // CPU time to issue the frame
+    double frameMs;  // including glFinish
+};
+
+template <typename F>
+static Timing timeFrames(int frames, F&& frame)
+{
+    frame(0.0f);
+    glFinish();
+
+    double submit = 0.0;
+    auto start = Clock::now();
+    for (int i = 0; i < frames; i++) {
+        auto s = Clock::now();
+        frame(i * 0.016f);
+        submit += std::chrono::duration<double, std::milli>(Clock::now() - s).count();
+        glFinish();
+    }
+    double total = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return { submit / frames, total / frames };
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 20;
+
+    HeadlessContext context;
+    if (!context.init() || !initGlew())
+        return 1;
+    Framebuffer target;
+    if (!target.init(64, 64))
+        return 1;
+    target.bind();
+
+    unsigned int program = linkProgram(vertexSource, fragmentSource);
+    unsigned int instancedProgram = linkProgram(instancedVertexSource, fragmentSource);
+    glm::mat4 viewProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 1000.0f)
+        * glm::lookAt(glm::vec3(0.0f, 0.0f, 50.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::printf("%8s  %22s  %22s  %8s\n", "objects", "per-object submit/frame", "instanced submit/frame", "speedup");
+    for (int count : {1000, 10000, 100000}) {
+        std::vector<std::unique_ptr<Cube>> cubes;
+        for (int i = 0; i < count; i++) {
+            glm::vec3 p((i % 100) - 50.0f, ((i / 100) % 100) - 50.0f, -(i / 10000) * 2.0f);
+            cubes.push_back(std::make_unique<Cube>(p, glm::vec3(0.0f), glm::vec3(0.5f)));
+        }
+
+        // The per-object loop main.cpp used to run
+        Timing perObject = timeFrames(frames, [&](float t) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glUseProgram(program);
+            glUniformMatrix4fv(glGetUniformLocation(program, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+            for (const auto& cube : cubes) {
+                cube->rotation = glm::vec3(t * 50.0f);
+                glm::mat4 model = cube->getModelMatrix();
+                glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+                cube->draw();
+            }
+        });
+
+        InstancedMesh mesh;
+        mesh.init(Cube::sharedMesh());
+        Timing instanced = timeFrames(frames, [&](float t) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glUseProgram(instancedProgram);
+            glUniformMatrix4fv(glGetUniformLocation(instancedProgram, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+            mesh.transforms.resize(cubes.size());
+            for (size_t i = 0; i < cubes.size(); i++) {
+                cubes[i]->rotation = glm::vec3(t * 50.0f);
+                mesh.transforms[i] = cubes[i]->getModelMatrix();
+            }
+            mesh.update();
+            mesh.draw();
+        });
+
+        std::printf("%8d  %15.3f ms (%6.2f)  %15.3f ms (%6.2f)  %7.1fx\n", count,
+                    perObject.submitMs, perObject.frameMs, instanced.submitMs, instanced.frameMs,
+                    perObject.submitMs / instanced.submitMs);
+    }
+    std::printf("(frame time including glFinish in parentheses)\n");
+
+    glDeleteProgram(program);
+    glDeleteProgram(instancedProgram);
+    return 0;
+}
@@ -0,0 +1,234 @@
+// Per-frame uploads through buffers orphaned every frame (glBufferData + glBufferSubData)
+// against StreamBuffer, mapped persistently (GL 4.4 / ARB_buffer_storage) and with its
+// GL 3.3 fallback, on a RenderQueue of animated cubes whose matrices and commands change
+// every frame. Frames are not finished one by one, so the GPU can fall behind and the
+// stream's fences have something to wait for. Reports CPU submit time, frame time and
+// fence wait per frame. Checks that slices read back what was written in every region,
+// that a full region grows, that uniform and vertex slices stay aligned in regions of any
+// size and that every path renders the same image; exits with 1 if not. Uses a headless
+// EGL context (see Headless.h).
+// Usage: bench/gl_stream_buffer [objects] [frames] (default 50000, 30)
+#include <GL/glew.h>
+#include "../Cube.h"
+#include "../Headless.h"
+#include "../RenderQueue.h"
+#include "../StreamBuffer.h"
+#include "../UniformBuffer.h"
+#include "Bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string vertexSource =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 3) in mat4 instanceModel;\n"
+    "layout (std140) uniform Frame { mat4 view; mat4 projection; mat4 viewProjection; };\n"
+    "void main() { gl_Position = viewProjection * instanceModel * vec4(aPos, 1.0f); }\n";
+static const char* fragmentSource =
+    "#version 330 core\nuniform vec4 color;\nout vec4 FragColor;\nvoid main() { FragColor = color; }\n";
+
+// Writes frames of bytes through stream and reads each slice back from the buffer
+static bool roundTrips(StreamBuffer& stream, int frames, size_t bytes)
+{
+    bool same = true;
+    std::vector<unsigned char> written(bytes), read(bytes);
+    for (int f = 0; f < frames; f++) {
+        stream.beginFrame();
+        for (size_t i = 0; i < bytes; i++)
+            written[i] = static_cast<unsigned char>(i * 7 + f * 13);
+        StreamSlice slice = stream.write(written.data(), bytes, 4);
+        stream.endFrame();
+        if (!slice)
+            return false;
+        glBindBuffer(GL_COPY_READ_BUFFER, stream.buffer());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, slice.offset, bytes, read.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        same = same && read == written;
+    }
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 50000;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 30;
+
+    HeadlessContext context;
+    if (!context.init())
+        return 1;
+    if (!initGlew())
+        return 1;
+    bool hasStorage = StreamBuffer::persistentSupported();
+
+    std::printf("Checks:\n");
+    for (int persistent = 0; persistent < 2; persistent++) {
+        if (persistent && !hasStorage)
+            continue;
+        const char* path = persistent ? "persistent" : "GL 3.3";
+        StreamBuffer stream;
+        check(stream.init(4096, persistent) && stream.persistent() == bool(persistent),
+              (std::string(path) + ": buffer created").c_str());
+
+        // Offsets of consecutive frames cycle through the regions
+        size_t offsets[StreamBuffer::FRAMES + 1];
+        for (int f = 0; f <= StreamBuffer::FRAMES; f++) {
+            stream.beginFrame();
+            offsets[f] = stream.allocate(16).offset;
+            stream.endFrame();
+        }
+        bool cycles = offsets[0] == offsets[StreamBuffer::FRAMES];
+        for (int a = 0; a < StreamBuffer::FRAMES; a++)
+            for (int b = a + 1; b < StreamBuffer::FRAMES; b++)
+                cycles = cycles && offsets[a] / stream.capacity() != offsets[b] / stream.capacity();
+        check(cycles, (std::string(path) + ": frames use the regions in turn").c_str());
+        check(roundTrips(stream, 2 * StreamBuffer::FRAMES, 3000), (std::string(path) + ": slices read back in every region").c_str());
+
+        stream.beginFrame();
+        bool full = !stream.allocate(3000) || !stream.allocate(3000);
+        stream.endFrame();
+        check(full && roundTrips(stream, StreamBuffer::FRAMES, 6000) && stream.capacity() >= 6000,
+              (std::string(path) + ": a full region grows at the next frame").c_str());
+
+        // Grow to an odd region size, so regions after the first start off any alignment
+        stream.beginFrame();
+        stream.allocate(3 * stream.capacity() + 1, 1);
+        stream.endFrame();
+        stream.beginFrame();
+        bool odd = stream.capacity() % 2 == 1;
+        stream.endFrame();
+
+        GLint alignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        bool aligned = odd, vertices = true;
+        for (int f = 0; f < 2 * StreamBuffer::FRAMES; f++) {
+            GLint start = -1;
+            stream.beginFrame();
+            stream.allocate(4);
+            aligned = aligned && stream.bindUniforms(FrameUniforms::BINDING, FrameUniforms());
+            glGetIntegeri_v(GL_UNIFORM_BUFFER_START, FrameUniforms::BINDING, &start);
+            aligned = aligned && start >= 0 && start % alignment == 0 && glGetError() == GL_NO_ERROR;
+            StreamSlice mesh = stream.allocate(10 * 12, 12); // Vertices of 12 bytes
+            vertices = vertices && mesh && mesh.offset % 12 == 0;
+            stream.endFrame();
+        }
+        check(aligned, (std::string(path) + ": uniform ranges are aligned in every region").c_str());
+        check(vertices, (std::string(path) + ": vertex slices start on a whole vertex").c_str());
+    }
+
+    Framebuffer target;
+    if (!target.init(256, 256))
+        return 1;
+    target.bind();
+    glEnable(GL_DEPTH_TEST);
+
+    Shader vertex, fragment;
+    vertex.compile(GL_VERTEX_SHADER, vertexSource.c_str(), "instanced vertex");
+    fragment.compile(GL_FRAGMENT_SHADER, fragmentSource, "color fragment");
+    ShaderProgram program;
+    program.link({ &vertex, &fragment });
+    program.bindBlock("Frame", FrameUniforms::BINDING);
+
+    UniformBuffer<FrameUniforms> frameUniforms;
+    frameUniforms.init(FrameUniforms::BINDING);
+    FrameUniforms frame;
+    frame.view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    frame.projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 200.0f);
+    frame.viewProjection = frame.projection * frame.view;
+
+    MeshHandle cube = Cube::sharedMesh();
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<glm::vec3> positions, axes;
+    for (int i = 0; i < count; i++) {
+        positions.push_back(glm::vec3((unit(random) - 0.5f) * 120.0f, (unit(random) - 0.5f) * 120.0f, -5.0f - unit(random) * 150.0f));
+        axes.push_back(glm::normalize(glm::vec3(unit(random), unit(random), 0.5f)));
+    }
+
+    RenderQueue queue;
+    queue.init();
+    queue.materials = { glm::vec4(1.0f, 0.5f, 0.2f, 1.0f) };
+    // Every cube spins, so all the matrices change every frame
+    auto draw = [&](StreamBuffer* stream, int f) {
+        if (stream != nullptr)
+            frameUniforms.update(frame, *stream);
+        else
+            frameUniforms.update(frame);
+        for (int i = 0; i < count; i++) {
+            glm::mat4 model = glm::rotate(glm::translate(glm::mat4(1.0f), positions[i]), f * 0.05f + i, axes[i]);
+            queue.submit(program, *cube, 0, 0, model, -positions[i].z);
+        }
+        queue.flush();
+    };
+
+    struct Result
+    {
+        const char* name;
+        bool persistent;
+        double submitMs, frameMs, fenceWaitMs;
+        uint64_t uploadBytes;
+        std::vector<unsigned char> image;
+    };
+    auto run = [&](const char* name, int mode) {
+        Result result{ name, mode == 1, 0.0, 0.0, 0.0, 0, {} };
+        StreamBuffer stream;
+        if (mode > 0)
+            stream.init(size_t(count) * (sizeof(glm::mat4) + 32) + 4096, mode == 1);
+        StreamBuffer* used = mode > 0 ? &stream : nullptr;
+        queue.setStream(used);
+
+        auto frameAt = [&](int f) {
+            if (used != nullptr)
+                stream.beginFrame();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draw(used, f);
+            if (used != nullptr)
+                stream.endFrame();
+        };
+        Profiler::instance().counters = FrameCounters();
+        frameAt(0);
+        result.uploadBytes = Profiler::instance().counters.uploadBytes;
+        target.readPixels(result.image);
+
+        // Timed into a 1x1 viewport so a software rasterizer's fill doesn't hide the CPU cost
+        glViewport(0, 0, 1, 1);
+        double submit = 0.0;
+        auto start = Clock::now();
+        for (int f = 1; f <= frames; f++) {
+            auto s = Clock::now();
+            frameAt(f);
+            submit += std::chrono::duration<double, std::milli>(Clock::now() - s).count();
+            glFlush();
+        }
+        glFinish();
+        result.frameMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+        result.submitMs = submit / frames;
+        result.fenceWaitMs = stream.fenceWaitMs / frames;
+        target.bind();
+        queue.setStream(nullptr);
+        return result;
+    };
+
+    std::vector<Result> results;
+    results.push_back(run("orphaned buffers", 0));
+    if (hasStorage)
+        results.push_back(run("stream, persistent", 1));
+    results.push_back(run("stream, GL 3.3 copies", 2));
+    check(glGetError() == GL_NO_ERROR, "no GL errors");
+    for (size_t r = 1; r < results.size(); r++)
+        check(!results[r].image.empty() && results[r].image == results[0].image,
+              (std::string(results[r].name) + " renders the same image").c_str());
+
+    std::printf("\n%d animated cubes, %d frames, %s, %s\n", count, frames,
+                hasStorage ? "GL_ARB_buffer_storage available" : "no GL_ARB_buffer_storage",
+                queue.multiDrawIndirect ? "multi-draw indirect" : "instanced draws");
+    std::printf("%-24s %12s %14s %14s %14s\n", "", "upload", "submit/frame", "frame", "fence wait");
+    for (const Result& result : results)
+        std::printf("%-24s %9.1f KB %11.3f ms %11.3f ms %11.3f ms\n", result.name, result.uploadBytes / 1024.0,
+                    result.submitMs, result.frameMs, result.fenceWaitMs);
+
+    return checkResult();
+}
@@ -0,0 +1,151 @@
+// Streams a large generated mesh through AssetStreamer and compares frame times with the
+// synchronous load (one glBufferData of the whole mesh in a single frame). Also checks
+// that the streamed buffers hold exactly the file's bytes, including with a small ring
+// that forces wrap-around and chunks ending mid-vertex, that streamed meshes are shared
+// through MeshCache and that MeshCache finds a resident mesh by path without touching its
+// cache file; exits with 1 if not.
+// Uses a headless EGL context (see Headless.h), so no display is needed.
+// Usage: bench/gl_streaming [grid size] (default 700: ~490k vertices, ~27 MB)
+#include <GL/glew.h>
+#include "../AssetStreamer.h"
+#include "../Headless.h"
+#include "Bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+
+struct FrameTimes
+{
+    std::vector<double> ms;
+    size_t uploading = 0; // Frames that began with the mesh uploading
+
+    double max() const { return ms.empty() ? 0.0 : *std::max_element(ms.begin(), ms.end()); }
+    double mean() const
+    {
+        double sum = 0.0;
+        for (double t : ms)
+            sum += t;
+        return ms.empty() ? 0.0 : sum / ms.size();
+    }
+};
+
+// One frame: the work under test, a clear and a glFinish so GPU copies are included
+template <typename F>
+static double frame(F&& work)
+{
+    auto start = Clock::now();
+    work();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glFinish();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Compares a buffer's contents with the expected bytes
+static bool bufferMatches(GLenum target, unsigned int buffer, const void* expected, size_t size)
+{
+    std::vector<char> contents(size);
+    glBindBuffer(target, buffer);
+    glGetBufferSubData(target, 0, size, contents.data());
+    return memcmp(contents.data(), expected, size) == 0;
+}
+
+// Streams path to residency and returns the frame times
+static FrameTimes stream(const char* path, size_t budget, size_t ring, const MeshFile& reference, const char* label)
+{
+    AssetStreamer streamer;
+    streamer.bytesPerFrame = budget;
+    streamer.ringBytes = ring;
+
+    FrameTimes times;
+    StreamHandle mesh = streamer.load(path);
+    bool placeholderSeen = false;
+    size_t largestFrame = 0;
+    while (!mesh->resident() && mesh->state != StreamedMesh::Failed && times.ms.size() < 100000) {
+        times.uploading += mesh->state == StreamedMesh::Uploading;
+        times.ms.push_back(frame([&] { streamer.update(); }));
+        placeholderSeen = placeholderSeen || (mesh->state == StreamedMesh::Uploading && mesh->drawMesh() != nullptr);
+        largestFrame = std::max(largestFrame, streamer.uploadedThisFrame);
+    }
+
+    char what[128];
+    snprintf(what, sizeof(what), "%s: placeholder drawn while uploading", label);
+    check(placeholderSeen || times.ms.size() <= 2, what);
+    snprintf(what, sizeof(what), "%s: buffers match the file", label);
+    check(mesh->resident()
+          && bufferMatches(GL_ARRAY_BUFFER, mesh->mesh->VBO, reference.vertexData(), reference.vertexBytes())
+          && bufferMatches(GL_ELEMENT_ARRAY_BUFFER, mesh->mesh->EBO, reference.indexData(), reference.indexBytes()), what);
+    snprintf(what, sizeof(what), "%s: every frame within the budget", label);
+    check(largestFrame <= budget && streamer.uploadedTotal == reference.vertexBytes() + reference.indexBytes(), what);
+    return times;
+}
+
+int main(int argc, char** argv)
+{
+    int grid = argc > 1 ? std::atoi(argv[1]) : 700;
+
+    HeadlessContext context;
+    if (!context.init())
+        return 1;
+    if (!initGlew())
+        return 1;
+    Framebuffer target;
+    target.init(64, 64);
+    target.bind();
+
+    // Source mesh, with its binary cache built up front so only uploads are timed
+    const char* path = "/tmp/gl_streaming_grid.obj";
+    writeGrid(path, grid);
+    MeshFile reference;
+    if (!reference.loadCached(path))
+        return 1;
+    size_t total = reference.vertexBytes() + reference.indexBytes();
+    std::printf("Mesh: %u vertices, %u indices, %.1f MB\n\n", reference.header().vertexCount,
+                reference.header().indexCount, total / 1048576.0);
+
+    std::printf("Checks:\n");
+    // Odd sizes so chunks end inside vertices and the ring wraps at odd offsets
+    stream(path, 1000003, 2500007, reference, "1 MB budget, 2.5 MB ring");
+    FrameTimes streamed = stream(path, 4 << 20, 16 << 20, reference, "4 MB budget, 16 MB ring");
+
+    // Streamed meshes go into MeshCache, so loading the path again either way shares them
+    {
+        AssetStreamer streamer, other;
+        StreamHandle streamed = streamer.load(path);
+        while (!streamed->resident() && streamed->state != StreamedMesh::Failed)
+            streamer.update();
+        StreamHandle again = other.load(path);
+        check(streamed->resident() && again->resident() && again->mesh == streamed->mesh && other.uploadedTotal == 0,
+              "a second streamer shares the resident mesh");
+        check(MeshCache::instance().loadOBJ(path) == streamed->mesh, "loadOBJ shares the streamed mesh");
+    }
+
+    // A resident mesh is found by path before its cache file is opened (or rebuilt)
+    {
+        MeshHandle first = MeshCache::instance().loadOBJ(path);
+        std::remove(MeshFile::cachePath(path).c_str());
+        MeshHandle second = MeshCache::instance().loadOBJ(path);
+        MappedFile rebuilt(MeshFile::cachePath(path).c_str());
+        check(first && second == first && !rebuilt.isOpen(), "loadOBJ of a resident mesh skips its cache file");
+    }
+
+    // The synchronous path: the whole mesh in one frame
+    FrameTimes sync;
+    for (int i = 0; i < 5; i++) {
+        sync.ms.push_back(frame([&] {
+            Mesh mesh;
+            const MeshFileHeader& header = reference.header();
+            mesh.upload(reference.vertexData(), reference.vertexBytes(), header.format, reference.bounds(),
+                        reference.indexData(), header.indexCount, header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+        }));
+    }
+
+    // Streamed frames include those spent waiting for the background load
+    std::printf("\n%-28s %8s %10s %12s %12s\n", "", "frames", "uploading", "mean", "worst");
+    std::printf("%-28s %8d %10d %9.3f ms %9.3f ms\n", "synchronous upload", 1, 1, sync.mean(), sync.max());
+    std::printf("%-28s %8zu %10zu %9.3f ms %9.3f ms\n", "streamed, 4 MB per frame", streamed.ms.size(), streamed.uploading,
+                streamed.mean(), streamed.max());
+
+    return checkResult();
+}
@@ -0,0 +1,269 @@
+// Compact vertex format (VertexFormat::compact(): unorm16 positions, octahedral normals,
+// half uvs) against all floats. Reports bytes per vertex and the quantization error of
+// each attribute for cow.obj and a generated sphere, then renders both encodings of the
+// sphere through shaders/object.vert, with normals and with uvs as colors, compares the
+// images pixel by pixel and times a vertex-bound draw loop. Exits with 1 if an error
+// exceeds its encoding's bound or the images differ. Uses a headless EGL context (see Headless.h), so no display is needed.
+// Usage: bench/gl_vertex_format [file.obj] (default cow.obj)
+#include <GL/glew.h>
+#include "../Headless.h"
+#include "../Mesh.h"
+#include "../OBJImporter.h"
+#include "../ShaderProgram.h"
+#include "../UniformBuffer.h"
+#include "Bench.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+struct TestMesh
+{
+    std::string name;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<uint32_t> indices;
+};
+
+// Latitude-longitude sphere with exact normals and uvs, off the origin so the bounds
+// don't start at zero
+static TestMesh sphere(int segments)
+{
+    TestMesh mesh;
+    mesh.name = "sphere " + std::to_string(segments);
+    int rings = segments / 2;
+    for (int r = 0; r <= rings; r++) {
+        float phi = 3.14159265f * r / rings;
+        for (int a = 0; a <= segments; a++) {
+            float theta = 6.2831853f * a / segments;
+            glm::vec3 n(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+            mesh.positions.push_back(glm::vec3(3.0f, -1.0f, 2.0f) + 1.5f * n);
+            mesh.normals.push_back(n);
+            mesh.uvs.push_back(glm::vec2(float(a) / segments, float(r) / rings));
+        }
+    }
+    for (int r = 0; r < rings; r++) {
+        for (int a = 0; a < segments; a++) {
+            uint32_t i = r * (segments + 1) + a, j = i + segments + 1;
+            mesh.indices.insert(mesh.indices.end(), { i, j, i + 1, i + 1, j, j + 1 }); // Outward, counter-clockwise
+        }
+    }
+    return mesh;
+}
+
+static AABB boundsOf(const TestMesh& mesh)
+{
+    AABB box;
+    for (const glm::vec3& p : mesh.positions)
+        box.expand(p);
+    return box;
+}
+
+static std::vector<char> encode(const TestMesh& mesh, const VertexFormat& format, const AABB& bounds)
+{
+    std::vector<char> vertices(mesh.positions.size() * format.stride());
+    format.encode(mesh.positions.data(), mesh.normals.empty() ? nullptr : mesh.normals.data(),
+                  mesh.uvs.empty() ? nullptr : mesh.uvs.data(), mesh.positions.size(), bounds, vertices.data());
+    return vertices;
+}
+
+// Decodes every vertex of the compact encoding and compares it with the source floats
+static void measureError(const TestMesh& mesh)
+{
+    VertexFormat full = VertexFormat::full(), compact = VertexFormat::compact();
+    AABB bounds = boundsOf(mesh);
+    glm::vec3 size = bounds.max - bounds.min;
+    std::vector<char> vertices = encode(mesh, compact, bounds);
+
+    glm::vec3 positionError(0.0f);
+    float normalDegrees = 0.0f, uvError = 0.0f, uvBound = 0.0f;
+    for (size_t i = 0; i < mesh.positions.size(); i++) {
+        const char* vertex = vertices.data() + i * compact.stride();
+        positionError = glm::max(positionError, glm::abs(compact.decodePosition(vertex, bounds) - mesh.positions[i]));
+        if (!mesh.normals.empty() && glm::length(mesh.normals[i]) > 0.0f) {
+            // atan2 of sine and cosine stays accurate for tiny angles where acos doesn't
+            glm::vec3 decoded = compact.decodeNormal(vertex), n = glm::normalize(mesh.normals[i]);
+            float angle = std::atan2(glm::length(glm::cross(decoded, n)), glm::dot(decoded, n));
+            normalDegrees = std::max(normalDegrees, glm::degrees(angle));
+        }
+        if (!mesh.uvs.empty()) {
+            glm::vec2 uv = mesh.uvs[i], error = glm::abs(compact.decodeUV(vertex) - uv);
+            uvError = std::max(uvError, std::max(error.x, error.y));
+            // Half of a half-precision step at this magnitude (11 significant bits)
+            float magnitude = std::max(std::fabs(uv.x), std::fabs(uv.y));
+            uvBound = std::max(uvBound, std::max(std::ldexp(1.0f, -25), magnitude * std::ldexp(1.0f, -11)));
+        }
+    }
+
+    std::printf("%s: %zu vertices, %u -> %u bytes each (%.1fx), %.1f -> %.1f KB\n", mesh.name.c_str(),
+                mesh.positions.size(), full.stride(), compact.stride(), double(full.stride()) / compact.stride(),
+                mesh.positions.size() * full.stride() / 1024.0, mesh.positions.size() * compact.stride() / 1024.0);
+    std::printf("  position error %.2e of the bounds diagonal, normal error %.4f deg, uv error %.2e\n",
+                glm::length(positionError) / glm::length(size), normalDegrees, uvError);
+
+    // Rounding to the nearest of 65535 steps, plus float rounding of the decode at the
+    // positions' magnitude
+    glm::vec3 step = size / 65535.0f;
+    glm::vec3 slack = (glm::abs(bounds.min) + glm::abs(bounds.max)) * 4e-7f;
+    check(positionError.x <= step.x * 0.5f + slack.x && positionError.y <= step.y * 0.5f + slack.y
+          && positionError.z <= step.z * 0.5f + slack.z, "positions within half a unorm16 step of the bounds");
+    // 16-bit octahedral coordinates with the best rounding are good to well under 0.01 degrees
+    check(normalDegrees < 0.01f, "normals within 0.01 degrees");
+    check(uvError <= uvBound, "uvs within half a half-precision step");
+}
+
+// Normals (mode 0) or uvs (mode 1) as colors
+static const char* attributeFragmentSource = "#version 330 core\n"
+    "in vec3 vNormal;\n"
+    "in vec2 vUV;\n"
+    "uniform int mode;\n"
+    "out vec4 FragColor;\n"
+    "void main() { FragColor = vec4(mode == 0 ? normalize(vNormal) * 0.5f + 0.5f : vec3(vUV, 0.0f), 1.0f); }\n";
+
+struct Renderer
+{
+    Framebuffer target;
+    UniformBuffer<FrameUniforms> frame;
+    Shader fullVertex, compactVertex, fragment;
+    ShaderProgram fullProgram, compactProgram;
+
+    bool init(int size)
+    {
+        if (!target.init(size, size))
+            return false;
+        frame.init(FrameUniforms::BINDING);
+        // The scene's vertex shader, built for each normal encoding
+        if (!fullVertex.load(GL_VERTEX_SHADER, "shaders/object.vert", VertexFormat::full().shaderDefines())
+            || !compactVertex.load(GL_VERTEX_SHADER, "shaders/object.vert", VertexFormat::compact().shaderDefines())
+            || !fragment.compile(GL_FRAGMENT_SHADER, attributeFragmentSource, "attribute fragment"))
+            return false;
+        return fullProgram.link({ &fullVertex, &fragment }) && compactProgram.link({ &compactVertex, &fragment })
+            && fullProgram.bindBlock("Frame", FrameUniforms::BINDING)
+            && compactProgram.bindBlock("Frame", FrameUniforms::BINDING);
+    }
+
+    // Draws mesh centred in view, as the scene does: model * positionTransform
+    void render(const Mesh& mesh, int mode, std::vector<unsigned char>& rgb)
+    {
+        const ShaderProgram& program = mesh.format.normal == VertexFormat::NORMAL_OCT16 ? compactProgram : fullProgram;
+        glm::vec3 centre = mesh.bounds.center();
+        FrameUniforms uniforms;
+        uniforms.view = glm::lookAt(centre + glm::vec3(0.4f, 0.8f, 3.5f), centre, glm::vec3(0.0f, 1.0f, 0.0f));
+        uniforms.projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+        uniforms.viewProjection = uniforms.projection * uniforms.view;
+        frame.update(uniforms);
+
+        target.bind();
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        program.use();
+        glUniformMatrix4fv(program.uniform("model"), 1, GL_FALSE, glm::value_ptr(mesh.positionTransform));
+        glUniform1i(program.uniform("mode"), mode);
+        mesh.draw();
+        target.readPixels(rgb);
+    }
+};
+
+// Pixels covered in only one image, and covered pixels whose colors differ by more than
+// tolerance in a channel
+static void compareImages(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int tolerance,
+                          size_t& covered, size_t& coverage, size_t& color)
+{
+    covered = coverage = color = 0;
+    for (size_t i = 0; i + 2 < a.size(); i += 3) {
+        bool inA = a[i] || a[i + 1] || a[i + 2], inB = b[i] || b[i + 1] || b[i + 2];
+        covered += inA;
+        if (inA != inB) {
+            coverage++;
+        } else if (inA) {
+            int difference = 0;
+            for (int c = 0; c < 3; c++)
+                difference = std::max(difference, std::abs(int(a[i + c]) - int(b[i + c])));
+            color += difference > tolerance;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : "cow.obj";
+
+    std::printf("Quantization error:\n");
+    OBJMesh loaded;
+    if (!OBJImporter::loadIndexedOBJ(path, loaded)) {
+        std::fprintf(stderr, "Failed to load %s\n", path);
+        return 1;
+    }
+    TestMesh cow;
+    cow.name = path;
+    cow.positions = loaded.positions;
+    cow.normals = loaded.normals;
+    cow.uvs = loaded.uvs;
+    cow.indices.assign(loaded.indices.begin(), loaded.indices.end());
+    measureError(cow);
+    TestMesh ball = sphere(256);
+    measureError(ball);
+
+    HeadlessContext context;
+    if (!context.init())
+        return 1;
+    if (!initGlew())
+        return 1;
+
+    Renderer renderer;
+    if (!renderer.init(256)) {
+        std::printf("CHECKS FAILED\n");
+        return 1;
+    }
+
+    // The same sphere uploaded in both encodings
+    AABB bounds = boundsOf(ball);
+    Mesh meshes[2];
+    VertexFormat formats[2] = { VertexFormat::full(), VertexFormat::compact() };
+    for (int i = 0; i < 2; i++) {
+        std::vector<char> vertices = encode(ball, formats[i], bounds);
+        meshes[i].upload(vertices.data(), vertices.size(), formats[i], bounds, ball.indices.data(), ball.indices.size(),
+                         GL_UNSIGNED_INT);
+    }
+    std::printf("\nRendered %s, %dx%d: vertex buffer %.1f KB full, %.1f KB compact\n", ball.name.c_str(),
+                renderer.target.width, renderer.target.height,
+                ball.positions.size() * formats[0].stride() / 1024.0, ball.positions.size() * formats[1].stride() / 1024.0);
+    const char* modes[2] = { "normals", "uvs" };
+    for (int mode = 0; mode < 2; mode++) {
+        std::vector<unsigned char> reference, compact;
+        renderer.render(meshes[0], mode, reference);
+        renderer.render(meshes[1], mode, compact);
+        size_t covered, coverage, color;
+        compareImages(reference, compact, 2, covered, coverage, color);
+        std::printf("  %-8s %zu pixels covered, %zu differ in coverage, %zu in color by more than 2/255\n", modes[mode],
+                    covered, coverage, color);
+        // Positions move by at most half a unorm16 step, which can only flip a few edge pixels
+        check(covered > 0 && coverage * 1000 <= covered && color * 1000 <= covered,
+              (std::string(modes[mode]) + " render matches the float mesh").c_str());
+    }
+    check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+    // Vertex-bound: many draws into a tiny viewport so fetch and shading, not raster, dominate
+    std::printf("\nVertex-bound draw loop (%zu vertices x 50 draws, 4x4 viewport):\n", ball.positions.size());
+    glViewport(0, 0, 4, 4);
+    double ms[2];
+    for (int i = 0; i < 2; i++) {
+        (i == 0 ? renderer.fullProgram : renderer.compactProgram).use();
+        for (int pass = 0; pass < 2; pass++) { // The first pass warms up
+            auto start = Clock::now();
+            for (int draw = 0; draw < 50; draw++)
+                meshes[i].draw();
+            glFinish();
+            ms[i] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+        std::printf("  %-8s %3u bytes/vertex %9.2f ms\n", i == 0 ? "full" : "compact", formats[i].stride(), ms[i]);
+    }
+    std::printf("(software rasterizers convert attributes on the CPU; the saving is GPU memory traffic)\n");
+
+    return checkResult();
+}
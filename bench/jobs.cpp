@@ -0,0 +1,246 @@
+// Job system checks and scaling, no GL context needed.
+// The checks cover parallelFor coverage, counters, dependency chains, nested parallelFor,
+// submissions from outside threads and a stealing stress run; they exit with 1 on any
+// failure and are meant to be run under ThreadSanitizer as well (make TSAN=1 bench).
+// Then three workloads are timed on 1..N workers: TransformStore matrix rebuilds, a
+// CPU-bound loop and a recursive fork-join tree
+#include "../JobSystem.h"
+#include "../TransformStore.h"
+#include "Bench.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::steady_clock;
+
+static void checks(unsigned workers)
+{
+    std::printf("Checks with %u workers:\n", workers);
+    JobSystem jobs(workers);
+
+    // Every index visited exactly once, including ranges that don't divide by the grain
+    {
+        bool ok = true;
+        for (size_t n : { size_t(0), size_t(1), size_t(999), size_t(100000) }) {
+            std::vector<std::atomic<int>> visits(n);
+            for (auto& v : visits)
+                v.store(0);
+            jobs.parallelFor(0, n, 64, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    visits[i].fetch_add(1, std::memory_order_relaxed);
+            });
+            for (auto& v : visits)
+                ok = ok && v.load() == 1;
+        }
+        check(ok, "parallelFor visits each index once");
+    }
+
+    // A counter reaches zero only after every job in its group ran
+    {
+        JobCounter counter;
+        std::atomic<int> ran(0);
+        for (int i = 0; i < 10000; i++)
+            jobs.run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        jobs.wait(counter);
+        check(counter.done() && ran.load() == 10000, "wait returns after the whole group");
+    }
+
+    // Stages chained with runAfter run strictly in order, each after all of the previous.
+    // Every job is queued up front; each reads the whole previous stage, so a job that
+    // ran early sees a -1
+    {
+        const int STAGES = 8, WIDTH = 64;
+        std::vector<int> results(STAGES * WIDTH, -1);
+        std::vector<std::unique_ptr<JobCounter>> counters;
+        for (int s = 0; s < STAGES; s++)
+            counters.emplace_back(new JobCounter());
+
+        for (int s = 0; s < STAGES; s++) {
+            for (int j = 0; j < WIDTH; j++) {
+                auto job = [&results, s, j] {
+                    int sum = 0;
+                    for (int k = 0; k < WIDTH && s > 0; k++)
+                        sum += results[(s - 1) * WIDTH + k] < 0 ? -100000 : 1;
+                    results[s * WIDTH + j] = s == 0 ? WIDTH : sum;
+                };
+                if (s == 0)
+                    jobs.run(job, counters[s].get());
+                else
+                    jobs.runAfter(*counters[s - 1], job, counters[s].get());
+            }
+        }
+        jobs.wait(*counters[STAGES - 1]);
+        bool ok = true;
+        for (int i = 0; i < STAGES * WIDTH; i++)
+            ok = ok && results[i] == WIDTH;
+        check(ok, "runAfter orders dependent stages");
+    }
+
+    // parallelFor inside parallelFor jobs
+    {
+        std::atomic<long long> sum(0);
+        jobs.parallelFor(0, 64, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                jobs.parallelFor(0, 1000, 10, [&](size_t b, size_t e) {
+                    long long local = 0;
+                    for (size_t j = b; j < e; j++)
+                        local += static_cast<long long>(i * 1000 + j);
+                    sum.fetch_add(local, std::memory_order_relaxed);
+                });
+            }
+        });
+        long long n = 64 * 1000;
+        check(sum.load() == n * (n - 1) / 2, "nested parallelFor");
+    }
+
+    // Jobs submitted from threads outside the system (asset loaders, callbacks)
+    {
+        JobCounter counter;
+        std::atomic<int> ran(0);
+        std::vector<std::thread> outside;
+        for (int t = 0; t < 4; t++) {
+            outside.emplace_back([&] {
+                for (int i = 0; i < 1000; i++)
+                    jobs.run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+            });
+        }
+        for (std::thread& thread : outside)
+            thread.join();
+        jobs.wait(counter);
+        check(ran.load() == 4000, "jobs from outside threads run");
+    }
+
+    // Many tiny jobs that spawn jobs, so workers constantly steal from each other
+    {
+        JobCounter counter;
+        std::atomic<int> leaves(0);
+        std::function<void(int)> spawn = [&](int depth) {
+            if (depth == 0) {
+                leaves.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            for (int i = 0; i < 4; i++)
+                jobs.run([&spawn, depth] { spawn(depth - 1); }, &counter);
+        };
+        jobs.run([&spawn] { spawn(7); }, &counter);
+        jobs.wait(counter);
+        check(leaves.load() == 1 << 14, "recursive spawning under stealing");
+    }
+
+    // Matrices built across workers match the single-threaded build exactly
+    {
+        TransformStore a, b;
+        for (int i = 0; i < 50001; i++) {
+            Vec3 p(float(i % 97), float(i % 13), float(i % 31)), r(float(i % 360), float(i * 7 % 360), float(i * 13 % 360));
+            a.add(p, r, Vec3(1.0f + (i % 5) * 0.25f));
+            b.add(p, r, Vec3(1.0f + (i % 5) * 0.25f));
+        }
+        b.dirty[7] = 0; // A partly clean group
+        a.dirty[7] = 0;
+        a.update();
+        b.update(jobs, 1000);
+        bool same = a.lastUpdated == b.lastUpdated && memcmp(a.matrices.data(), b.matrices.data(), a.size() * sizeof(glm::mat4)) == 0;
+        check(same, "parallel TransformStore update is bit-identical");
+    }
+}
+
+// Busy work that doesn't touch memory
+static float spin(size_t i)
+{
+    float x = float(i) * 1e-3f;
+    for (int k = 0; k < 64; k++)
+        x = std::sin(x) * 0.5f + std::cos(x * 0.3f);
+    return x;
+}
+
+static long long fib(int n)
+{
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+// Naive Fibonacci forking a job per call down to n = 20
+static long long fib(JobSystem& jobs, int n)
+{
+    if (n < 20)
+        return fib(n);
+    long long x = 0, y = 0;
+    JobCounter counter;
+    jobs.run([&] { x = fib(jobs, n - 1); }, &counter);
+    y = fib(jobs, n - 2);
+    jobs.wait(counter);
+    return x + y;
+}
+
+// Best of several runs, in milliseconds
+template <typename F>
+static double timeMs(int runs, const F& f)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = Clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+static void scaling(unsigned maxWorkers)
+{
+    std::printf("\nScaling (best of 5, speedup against 1 worker):\n");
+    std::printf("%8s  %22s  %22s  %22s\n", "workers", "1M transforms", "CPU loop (50k)", "fork-join fib(34)");
+
+    TransformStore store;
+    store.reserve(1000000);
+    for (int i = 0; i < 1000000; i++)
+        store.add(Vec3(float(i)), Vec3(float(i % 360), 0.0f, 45.0f));
+    std::vector<float> out(50000);
+
+    // 1, 2, 4, ... and the hardware thread count
+    std::vector<unsigned> counts;
+    for (unsigned workers = 1; workers < maxWorkers; workers *= 2)
+        counts.push_back(workers);
+    counts.push_back(maxWorkers);
+
+    double base[3] = { 0.0, 0.0, 0.0 };
+    for (unsigned workers : counts) {
+        JobSystem jobs(workers);
+        double t[3];
+        t[0] = timeMs(5, [&] {
+            std::fill(store.dirty.begin(), store.dirty.end(), 1);
+            store.update(jobs);
+        });
+        t[1] = timeMs(5, [&] {
+            jobs.parallelFor(0, out.size(), 2048, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    out[i] = spin(i);
+            });
+        });
+        long long result = 0;
+        t[2] = timeMs(5, [&] { result = fib(jobs, 34); });
+        if (result != 5702887)
+            check(false, "fork-join result");
+
+        std::printf("%8u", workers);
+        for (int w = 0; w < 3; w++) {
+            if (workers == 1)
+                base[w] = t[w];
+            std::printf("  %10.2f ms (%5.2fx)", t[w], base[w] / t[w]);
+        }
+        std::printf("\n");
+    }
+    volatile float sink = out[123] + store.matrices[7][3][0];
+    (void)sink;
+}
+
+// Usage: jobs [max workers] (default: one per hardware thread)
+int main(int argc, char** argv)
+{
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    unsigned maxWorkers = argc > 1 ? std::max(1, std::atoi(argv[1])) : hardware;
+    checks(1);
+    checks(std::max(4u, hardware));
+    scaling(maxWorkers);
+    return checkResult();
+}
@@ -0,0 +1,178 @@
+// Level-of-detail generation and selection, no GL context needed.
+// Builds the LOD chain of an OBJ file (and of a generated grid), reports each level's
+// triangles and error, and checks the shared index buffer: valid indices, no degenerate
+// triangles, shrinking levels and growing errors, the MeshFile round trip, and that a
+// touched but unchanged source keeps its cache and has its new mtime stored. Then flies
+// a camera over a field of copies and reports triangles submitted per frame at full
+// detail against with selectLOD, and how often levels switch with and without hysteresis.
+// Exits with 1 on any failed check.
+// Usage: bench/lod [file.obj] (default cow.obj)
+#include "../MeshFile.h"
+#include "Bench.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <utime.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Builds and checks the LOD chain of path; returns the levels
+static std::vector<MeshLOD> buildLODs(const char* path)
+{
+    OBJMesh mesh;
+    if (!OBJImporter::loadIndexedOBJ(path, mesh)) {
+        check(false, "load OBJ");
+        return {};
+    }
+
+    auto start = Clock::now();
+    std::vector<uint32_t> indices;
+    std::vector<MeshLOD> lods = MeshSimplifier::build(mesh.positions.data(), mesh.normals.data(), mesh.uvs.data(),
+                                                      mesh.positions.size(), mesh.indices, indices,
+                                                      MeshFileHeader::MAX_LODS);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    glm::vec3 lo = mesh.positions[0], hi = mesh.positions[0];
+    for (const glm::vec3& p : mesh.positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    float diagonal = glm::length(hi - lo);
+
+    std::printf("%s: %zu vertices, built in %.1f ms\n", path, mesh.positions.size(), ms);
+    std::printf("%8s %12s %10s %14s\n", "level", "triangles", "ratio", "error/diagonal");
+    for (size_t i = 0; i < lods.size(); i++)
+        std::printf("%8zu %12u %9.1f%% %13.4f%%\n", i, lods[i].count / 3, 100.0 * lods[i].count / lods[0].count,
+                    100.0 * lods[i].error / diagonal);
+
+    bool valid = lods.size() >= 2 && lods[0].first == 0 && lods[0].count == mesh.indices.size();
+    bool ordered = true;
+    for (size_t i = 0; i < lods.size(); i++) {
+        const MeshLOD& lod = lods[i];
+        valid = valid && lod.count % 3 == 0 && lod.first + lod.count <= indices.size();
+        if (i > 0)
+            ordered = ordered && lod.count < lods[i - 1].count && lod.error >= lods[i - 1].error;
+        for (uint32_t t = lod.first; valid && t < lod.first + lod.count; t += 3) {
+            uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+            valid = a < mesh.positions.size() && b < mesh.positions.size() && c < mesh.positions.size()
+                 && mesh.positions[a] != mesh.positions[b] && mesh.positions[b] != mesh.positions[c]
+                 && mesh.positions[c] != mesh.positions[a];
+        }
+    }
+    check(valid, "levels index valid, non-degenerate triangles");
+    check(ordered, "each level has fewer triangles and more error");
+
+    MeshFile file;
+    bool roundTrip = file.build(path);
+    if (roundTrip) {
+        std::vector<MeshLOD> stored = file.lods();
+        roundTrip = stored.size() == lods.size() && file.header().indexCount == indices.size();
+        for (size_t i = 0; roundTrip && i < lods.size(); i++)
+            roundTrip = stored[i].first == lods[i].first && stored[i].count == lods[i].count;
+    }
+    check(roundTrip, "MeshFile stores the same levels");
+    std::printf("\n");
+    return lods;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : "cow.obj";
+
+    std::printf("Checks:\n");
+    std::vector<MeshLOD> lods = buildLODs(path);
+    const char* gridPath = "/tmp/lod_grid.obj";
+    writeGrid(gridPath, 200);
+    buildLODs(gridPath);
+
+    // Touch the grid: the cache is still current, and the new mtime is written into it
+    {
+        std::string cachePath = MeshFile::cachePath(gridPath);
+        std::remove(cachePath.c_str());
+        MeshFile cache;
+        bool built = cache.loadCached(gridPath);
+        int64_t builtMtime = built ? cache.header().sourceMtime : 0;
+        cache.close();
+        utimbuf times{ time_t(builtMtime + 100), time_t(builtMtime + 100) };
+        bool touched = built && utime(gridPath, &times) == 0;
+        MeshFile reopened;
+        bool current = touched && reopened.open(cachePath.c_str()) && reopened.isCurrent(gridPath);
+        reopened.close();
+        MeshFile stamped;
+        check(current && stamped.open(cachePath.c_str()) && stamped.header().sourceMtime == builtMtime + 100,
+              "touched source keeps its cache and stores the new mtime");
+    }
+    std::printf("\n");
+    if (lods.size() < 2) {
+        std::printf("CHECKS FAILED\n");
+        return 1;
+    }
+
+    const float fov = 45.0f, height = 600.0f;
+
+    // Further away never picks a finer level
+    {
+        bool monotonic = true;
+        int previous = 0;
+        for (float distance = 1.0f; distance < 1e6f; distance *= 1.1f) {
+            int level = selectLOD(lods, 0, distance, 1.0f, fov, height, 1.0f, 0.0f);
+            monotonic = monotonic && level >= previous;
+            previous = level;
+        }
+        check(monotonic && previous == static_cast<int>(lods.size()) - 1, "selection coarsens with distance");
+    }
+
+    // Distance at which level 1's error covers one pixel
+    float boundary = lods[1].error * height / (2.0f * std::tan(glm::radians(fov) * 0.5f));
+
+    // An object wobbling around that distance
+    {
+        int switches[2] = { 0, 0 };
+        for (int h = 0; h < 2; h++) {
+            int level = 0;
+            for (int frame = 0; frame < 1000; frame++) {
+                float distance = boundary * (1.0f + 0.05f * std::sin(frame * 0.3f));
+                int next = selectLOD(lods, level, distance, 1.0f, fov, height, 1.0f, h ? 0.25f : 0.0f);
+                switches[h] += next != level;
+                level = next;
+            }
+        }
+        std::printf("  switches at a level boundary over 1000 frames: %d without hysteresis, %d with\n",
+                    switches[0], switches[1]);
+        check(switches[1] < switches[0] && switches[1] <= 1, "hysteresis stops popping at a boundary");
+    }
+
+    // Fly over a 16 x 16 field of copies, about five level 1 boundaries across
+    float spacing = boundary * 0.3f;
+    std::vector<glm::vec3> copies;
+    for (int z = 0; z < 16; z++)
+        for (int x = 0; x < 16; x++)
+            copies.push_back(glm::vec3(x * spacing, 0.0f, z * spacing));
+
+    std::printf("\nFly-through, %zu copies, %dpx viewport, 1px error threshold:\n", copies.size(), int(height));
+    std::printf("%12s %16s %16s %10s %10s\n", "hysteresis", "full detail", "with LOD", "saved", "switches");
+    for (float hysteresis : { 0.0f, 0.25f }) {
+        std::vector<int> level(copies.size(), 0);
+        uint64_t full = 0, submitted = 0;
+        int switches = 0;
+        const int FRAMES = 600;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            // Low pass over the field and back, with some sway
+            float t = frame / float(FRAMES - 1);
+            float along = (t < 0.5f ? t * 2.0f : 2.0f - t * 2.0f) * 15.0f * spacing;
+            glm::vec3 camera(7.5f * spacing + std::sin(frame * 0.05f) * spacing, spacing * 0.5f, along);
+            for (size_t i = 0; i < copies.size(); i++) {
+                int next = selectLOD(lods, level[i], glm::length(copies[i] - camera), 1.0f, fov, height, 1.0f, hysteresis);
+                switches += next != level[i];
+                level[i] = next;
+                full += lods[0].count / 3;
+                submitted += lods[next].count / 3;
+            }
+        }
+        std::printf("%12.2f %16llu %16llu %9.1f%% %10d\n", hysteresis, (unsigned long long)(full / FRAMES),
+                    (unsigned long long)(submitted / FRAMES), 100.0 * (1.0 - double(submitted) / full), switches);
+    }
+    std::printf("(triangles per frame)\n");
+
+    return checkResult();
+}
@@ -0,0 +1,220 @@
+// Compares the mmap/multithreaded OBJImporter against the old fscanf parser. First checks
+// the parser on small inputs: every face corner form, n-gon fans, negative indices across
+// parse chunks and malformed input (which must fail, not read as zeros); exits with 1 if
+// any check fails.
+// Usage: bench/obj_parse [file.obj]  (without a file a synthetic v/vt/vn grid is generated)
+#include "../OBJImporter.h"
+#include "Bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+
+// The fscanf loop OBJImporter::loadOBJ used to run, kept as the baseline (v/vt/vn faces only)
+static bool loadOBJScanf(const char* path, std::vector<glm::vec3>& outVertices,
+                         std::vector<glm::vec2>& outUVs, std::vector<glm::vec3>& outNormals)
+{
+    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+    std::vector<glm::vec3> tempVertices;
+    std::vector<glm::vec2> tempUVs;
+    std::vector<glm::vec3> tempNormals;
+
+    FILE* file = fopen(path, "r");
+    if (file == nullptr)
+        return false;
+
+    while (true) {
+        char lineHeader[128];
+        if (fscanf(file, "%127s", lineHeader) == EOF)
+            break;
+
+        if (strcmp(lineHeader, "v") == 0) {
+            glm::vec3 vertex;
+            if (fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z) != 3)
+                break;
+            tempVertices.push_back(vertex);
+        } else if (strcmp(lineHeader, "vt") == 0) {
+            glm::vec2 uv;
+            if (fscanf(file, "%f %f\n", &uv.x, &uv.y) != 2)
+                break;
+            tempUVs.push_back(uv);
+        } else if (strcmp(lineHeader, "vn") == 0) {
+            glm::vec3 normal;
+            if (fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z) != 3)
+                break;
+            tempNormals.push_back(normal);
+        } else if (strcmp(lineHeader, "f") == 0) {
+            unsigned int v[3], vt[3], vn[3];
+            int matches = fscanf(file, "%u/%u/%u %u/%u/%u %u/%u/%u\n",
+                &v[0], &vt[0], &vn[0], &v[1], &vt[1], &vn[1], &v[2], &vt[2], &vn[2]);
+            if (matches != 9) {
+                fclose(file);
+                return false;
+            }
+            for (int i = 0; i < 3; i++) {
+                vertexIndices.push_back(v[i]);
+                uvIndices.push_back(vt[i]);
+                normalIndices.push_back(vn[i]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < vertexIndices.size(); i++) {
+        outVertices.push_back(tempVertices[vertexIndices[i] - 1]);
+        outUVs.push_back(tempUVs[uvIndices[i] - 1]);
+        outNormals.push_back(tempNormals[normalIndices[i] - 1]);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool parse(const std::string& text, OBJData& data, unsigned int threads = 1)
+{
+    return OBJImporter::parseOBJ(text.data(), text.size(), data, threads);
+}
+
+static bool sameCorners(const OBJData& data, const std::vector<OBJIndex>& expected)
+{
+    if (data.corners.size() != expected.size())
+        return false;
+    for (size_t i = 0; i < expected.size(); i++) {
+        const OBJIndex& a = data.corners[i];
+        if (a.v != expected[i].v || a.vt != expected[i].vt || a.vn != expected[i].vn)
+            return false;
+    }
+    return true;
+}
+
+static void checks()
+{
+    std::printf("Checks:\n");
+    const std::string pools = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0.5 1.5 0\n"
+                              "vt 0 0\nvt 1 0\nvt 1 1\nvn 0 0 1\nvn 0 1 0\nvn 1 0 0\n";
+    OBJData data;
+
+    bool forms = parse(pools + "f 1 2 3\nf 1/1 2/2 3/3\nf 1//1 2//2 3//3\nf 1/1/1 2/2/2 3/3/3\n", data);
+    check(forms && sameCorners(data, { { 0, -1, -1 }, { 1, -1, -1 }, { 2, -1, -1 },
+                                       { 0, 0, -1 }, { 1, 1, -1 }, { 2, 2, -1 },
+                                       { 0, -1, 0 }, { 1, -1, 1 }, { 2, -1, 2 },
+                                       { 0, 0, 0 }, { 1, 1, 1 }, { 2, 2, 2 } }),
+          "v, v/vt, v//vn and v/vt/vn corners");
+    check(parse(pools + "f -5/-3/-3 -4/-2/-2 -3/-1/-1\n", data)
+              && sameCorners(data, { { 0, 0, 0 }, { 1, 1, 1 }, { 2, 2, 2 } }),
+          "negative indices count back from the last element");
+    check(parse(pools + "f 1 2 3 4\nf 1 2 3 5 4\n", data)
+              && sameCorners(data, { { 0, -1, -1 }, { 1, -1, -1 }, { 2, -1, -1 }, { 0, -1, -1 }, { 2, -1, -1 }, { 3, -1, -1 },
+                                     { 0, -1, -1 }, { 1, -1, -1 }, { 2, -1, -1 }, { 0, -1, -1 }, { 2, -1, -1 }, { 4, -1, -1 },
+                                     { 0, -1, -1 }, { 4, -1, -1 }, { 3, -1, -1 } }),
+          "quads and pentagons are fanned around their first corner");
+    check(parse("# comment\ng part\nv 1e-3 +2 -.5 1.0\nv 1. 2 3 # w\nv 3E2 0 0\nvt 0.5 0.5 0\nf 1/1 2/1 3/1\n", data)
+              && data.positions.size() == 3 && data.positions[0] == glm::vec3(0.001f, 2.0f, -0.5f)
+              && data.positions[2].x == 300.0f && data.corners.size() == 3,
+          "comments, w components and exponents are accepted");
+
+    // Several megabytes so the text is split into chunks. Faces refer back to the vertices
+    // just before them and to one 4000 vertices (~80 KB) back, so the faces after every
+    // chunk boundary use vertices from the chunk before
+    std::string relative, absolute;
+    auto face = [](int a, int b, int c) { return "f " + std::to_string(a) + " " + std::to_string(b) + " " + std::to_string(c) + "\n"; };
+    for (int i = 0; relative.size() < (3u << 20); i++) {
+        std::string vertices;
+        for (int k = 0; k < 3; k++)
+            vertices += "v " + std::to_string(i) + "." + std::to_string(k) + " " + std::to_string(k) + " 0.125\n";
+        int count = 3 * i + 3;
+        relative += vertices + face(-3, -2, -1);
+        absolute += vertices + face(count - 2, count - 1, count);
+        if (count > 4000) {
+            relative += face(-1, -4000, -2);
+            absolute += face(count, count - 3999, count - 1);
+        }
+    }
+    OBJData split, whole;
+    bool parsed = parse(relative, split, 4) && parse(absolute, whole, 1);
+    std::vector<OBJIndex> expected(whole.corners.begin(), whole.corners.end());
+    check(parsed && !expected.empty() && sameCorners(split, expected) && split.positions == whole.positions,
+          "negative indices resolve across parse chunks");
+
+    const char* malformed[] = {
+        "v 1.0 abc 2.0\n",        "v 1.0 2.0\n",          "v 1.0x 2 3\n",    "v 1e 2 3\n",
+        "vt . 0\n",               "vn 0 1\n",             "v 0 0 0\nf 1 1\n", "v 0 0 0\nf 1 1 2\n",
+        "v 0 0 0\nf 0 1 1\n",     "v 0 0 0\nf -2 1 1\n",  "v 0 0 0\nf 1a 1 1\n", "v 0 0 0\nf 1/2 1 1\n",
+    };
+    bool rejected = true;
+    for (const char* text : malformed) {
+        if (parse(text, data)) {
+            std::printf("    accepted: %s", text);
+            rejected = false;
+        }
+    }
+    check(rejected, "malformed numbers, short faces and bad indices fail");
+    std::printf("\n");
+}
+
+template <typename F>
+static double bestOf(int runs, F&& f)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = Clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    checks();
+
+    std::string path = argc > 1 ? argv[1] : "/tmp/obj_parse_bench.obj";
+    if (argc <= 1)
+        writeGrid(path.c_str(), 700, true);
+
+    MappedFile file(path.c_str());
+    if (!file.isOpen()) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return 1;
+    }
+    const double mb = file.size / (1024.0 * 1024.0);
+    std::printf("%s: %.1f MB\n", path.c_str(), mb);
+
+    size_t corners = 0;
+    bool scanfOk = true;
+    double scanfTime = bestOf(3, [&] {
+        std::vector<glm::vec3> v, n;
+        std::vector<glm::vec2> uv;
+        scanfOk = loadOBJScanf(path.c_str(), v, uv, n);
+    });
+    if (scanfOk)
+        std::printf("fscanf parser:        %8.1f ms  %8.1f MB/s\n", scanfTime * 1e3, mb / scanfTime);
+    else
+        std::printf("fscanf parser:        rejects this file\n");
+
+    const unsigned int hw = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int threads = 1; threads <= hw; threads *= 2) {
+        double t = bestOf(3, [&] {
+            OBJData data;
+            OBJImporter::parseOBJ(path.c_str(), data, threads);
+            corners = data.corners.size();
+        });
+        std::printf("mmap parser %2u thr:   %8.1f ms  %8.1f MB/s\n", threads, t * 1e3, mb / t);
+    }
+    double t = bestOf(3, [&] {
+        std::vector<glm::vec3> v, n;
+        std::vector<glm::vec2> uv;
+        OBJImporter::loadOBJ(path.c_str(), v, uv, n);
+    });
+    std::printf("loadOBJ (expanded):   %8.1f ms  %8.1f MB/s\n", t * 1e3, mb / t);
+    OBJMesh mesh;
+    t = bestOf(3, [&] { OBJImporter::loadIndexedOBJ(path.c_str(), mesh); });
+    std::printf("loadIndexedOBJ:       %8.1f ms  %8.1f MB/s\n", t * 1e3, mb / t);
+    std::printf("%zu triangles, %zu corners welded to %zu vertices (%.2fx), %zu-bit indices\n",
+                corners / 3, mesh.cornerCount, mesh.positions.size(), mesh.dedupRatio(), mesh.indexSize() * 8);
+    for (size_t stride : {size_t(12), size_t(32)}) {
+        std::printf("  stride %2zu: VBO+EBO %zu -> %zu bytes\n", stride,
+                    mesh.unindexedBytes(stride), mesh.indexedBytes(stride));
+    }
+    return checkResult();
+}
@@ -0,0 +1,202 @@
+// OcclusionCuller checks and cost, no GL context needed.
+// The checks cover hidden, in-front and half-hidden boxes, AVX2 against scalar coverage,
+// and conservativeness: no object the culler rejects shows a pixel when the occluders and
+// the object are rasterized with SoftwareRasterizer at the same resolution. They exit
+// with 1 on any failure. Then a camera looks down a dense street of cubes: the frustum
+// (BVH) keeps what is in view, the nearest cubes are rasterized as occluders, and the rest
+// are tested, reporting the share culled and the cost of each step.
+// Usage: bench/occlusion [rows] [frames] [occluders] (default 200, 50, 64)
+#include "../BVH.h"
+#include "../Cube.h"
+#include "../OcclusionCuller.h"
+#include "Bench.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static glm::mat4 box(glm::vec3 center, glm::vec3 size)
+{
+    return glm::scale(glm::translate(glm::mat4(1.0f), center), size);
+}
+
+static glm::mat4 viewProjection(float aspect, glm::vec3 eye, glm::vec3 target)
+{
+    return glm::perspective(glm::radians(60.0f), aspect, 0.1f, 100.0f) * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void checks(const RasterMesh& cube, const AABB& cubeBounds)
+{
+    std::printf("Checks:\n");
+    const int width = 160, height = 96;
+    glm::mat4 camera = viewProjection(float(width) / height, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+    glm::mat4 wall = box(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(4.0f, 4.0f, 0.2f));
+    {
+        OcclusionCuller culler(width, height);
+        culler.beginFrame(camera);
+        culler.addOccluder(cube, wall);
+        bool hidden = !culler.visible(cubeBounds.transformed(box(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(1.0f))));
+        bool front = culler.visible(cubeBounds.transformed(box(glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(1.0f))));
+        bool beside = culler.visible(cubeBounds.transformed(box(glm::vec3(4.0f, 0.0f, -10.0f), glm::vec3(1.0f))));
+        check(hidden, "a box behind a wall is culled");
+        check(front, "a box in front of the wall is kept");
+        check(beside, "a box reaching past the wall's edge is kept");
+        check(culler.statistics.tested == 3 && culler.statistics.culled == 1, "statistics count tests and culls");
+    }
+
+    // A random scene of occluders and objects
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<glm::mat4> occluders, objects;
+    for (int i = 0; i < 40; i++)
+        occluders.push_back(glm::rotate(box(glm::vec3((unit(random) - 0.5f) * 16.0f, (unit(random) - 0.5f) * 8.0f,
+                                                      -4.0f - unit(random) * 10.0f),
+                                            glm::vec3(1.0f + unit(random) * 3.0f, 1.0f + unit(random) * 3.0f, 0.5f)),
+                                        unit(random), glm::vec3(0.2f, 1.0f, 0.1f)));
+    for (int i = 0; i < 300; i++)
+        objects.push_back(box(glm::vec3((unit(random) - 0.5f) * 24.0f, (unit(random) - 0.5f) * 12.0f, -6.0f - unit(random) * 30.0f),
+                              glm::vec3(0.2f + unit(random))));
+
+    auto cullScene = [&](OcclusionCuller& culler, std::vector<bool>& visible) {
+        culler.beginFrame(camera);
+        for (const glm::mat4& model : occluders)
+            culler.addOccluder(cube, model);
+        visible.clear();
+        for (const glm::mat4& model : objects)
+            visible.push_back(culler.visible(cubeBounds.transformed(model)));
+    };
+    OcclusionCuller culler(width, height);
+    std::vector<bool> visible;
+    cullScene(culler, visible);
+    if (culler.useAvx2) {
+        OcclusionCuller scalar(width, height);
+        scalar.useAvx2 = false;
+        std::vector<bool> scalarVisible;
+        cullScene(scalar, scalarVisible);
+        bool same = scalarVisible == visible;
+        for (int ty = 0; ty < height / OcclusionCuller::TILE_HEIGHT; ty++)
+            for (int tx = 0; tx < width / OcclusionCuller::TILE_WIDTH; tx++)
+                same = same && scalar.tileDepth(tx, ty) == culler.tileDepth(tx, ty);
+        check(same, "AVX2 matches scalar coverage");
+    } else {
+        std::printf("  (no AVX2 on this CPU; scalar only)\n");
+    }
+
+    // Every culled object is fully hidden in a full-precision rendering
+    JobSystem jobs(1);
+    SoftwareRasterizer raster(width, height);
+    const glm::vec4 red(1.0f, 0.0f, 0.0f, 1.0f), green(0.0f, 1.0f, 0.0f, 1.0f);
+    int leaks = 0;
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (visible[i])
+            continue;
+        raster.setViewProjection(camera);
+        for (const glm::mat4& model : occluders)
+            raster.draw(cube, model, red, RasterFill::Solid);
+        raster.draw(cube, objects[i], green, RasterFill::Solid);
+        raster.render(jobs);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                leaks += raster.pixel(x, y) == SoftwareRasterizer::packColor(green);
+    }
+    std::printf("  %llu of %zu objects culled by %zu occluders\n", (unsigned long long)culler.statistics.culled,
+                objects.size(), occluders.size());
+    check(culler.statistics.culled > 0 && leaks == 0, "culled objects have no visible pixels");
+}
+
+int main(int argc, char** argv)
+{
+    int rows = argc > 1 ? std::atoi(argv[1]) : 200;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 50;
+    size_t occluderCount = argc > 3 ? std::atoi(argv[3]) : 64;
+
+    RasterMesh cube = RasterMesh::fromArrays(Cube::meshVertices(), Cube::meshIndices());
+    AABB cubeBounds = AABB::fromPositions(cube.positions.data(), cube.positions.size(), sizeof(glm::vec3));
+    checks(cube, cubeBounds);
+
+    // A street: small blocks along the kerbs, an unbroken front of tall buildings, and
+    // buildings of random height behind it
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<glm::mat4> models;
+    std::vector<AABB> bounds;
+    for (int row = 0; row < rows; row++) {
+        for (int column = -6; column <= 6; column++) {
+            bool kerb = std::abs(column) == 1, front = std::abs(column) == 2;
+            if (column == 0 || unit(random) < (kerb ? 0.7f : front ? 0.0f : 0.15f))
+                continue;
+            float height = kerb ? 1.0f + unit(random) * 2.0f : front ? 8.0f + unit(random) * 4.0f : 1.0f + unit(random) * 12.0f;
+            glm::vec3 center(column * 2.5f, height * 0.5f - 1.5f, -4.0f - row * 2.5f);
+            models.push_back(box(center, glm::vec3(2.0f, height, front ? 2.5f : 2.0f)));
+            bounds.push_back(cubeBounds.transformed(models.back()));
+        }
+    }
+    BVH bvh;
+    bvh.build(bounds);
+
+    const int width = 1280, height = 720;
+    OcclusionCuller culler(width / 4, height / 4);
+    std::printf("\n%zu objects, %d frames, %zu occluders, %dx%d depth buffer\n", models.size(), frames, occluderCount,
+                culler.getWidth(), culler.getHeight());
+
+    std::vector<int> inFrustum, drawn;
+    std::vector<std::pair<float, int>> byCoverage;
+    double frustumMs = 0.0, selectMs = 0.0, rasterMs = 0.0, testMs = 0.0;
+    uint64_t frustumTotal = 0, drawnTotal = 0, triangles = 0;
+    for (int f = 0; f < frames; f++) {
+        // Walk down the street, looking a little to the sides
+        float t = float(f) / frames;
+        glm::vec3 eye(std::sin(t * 6.2831853f), 1.0f, -t * rows * 1.0f);
+        glm::mat4 camera = viewProjection(float(width) / height, eye, eye + glm::vec3(std::sin(t * 3.0f) * 0.4f, -0.05f, -1.0f));
+
+        auto start = Clock::now();
+        inFrustum.clear();
+        bvh.query(Frustum::fromMatrix(camera), inFrustum);
+        frustumMs += msSince(start);
+
+        // The objects covering the most of the screen make the best occluders
+        start = Clock::now();
+        byCoverage.clear();
+        for (int i : inFrustum) {
+            glm::vec3 offset = bounds[i].center() - eye, extent = bounds[i].extent();
+            byCoverage.emplace_back(-glm::dot(extent, extent) / glm::dot(offset, offset), i);
+        }
+        size_t occluders = std::min(occluderCount, byCoverage.size());
+        std::partial_sort(byCoverage.begin(), byCoverage.begin() + occluders, byCoverage.end());
+        selectMs += msSince(start);
+
+        start = Clock::now();
+        culler.beginFrame(camera);
+        for (size_t o = 0; o < occluders; o++)
+            culler.addOccluder(cube, models[byCoverage[o].second]);
+        rasterMs += msSince(start);
+
+        start = Clock::now();
+        drawn.clear();
+        for (int i : inFrustum)
+            if (culler.visible(bounds[i]))
+                drawn.push_back(i);
+        testMs += msSince(start);
+
+        frustumTotal += inFrustum.size();
+        drawnTotal += drawn.size();
+        triangles += culler.statistics.occluderTriangles;
+    }
+
+    std::printf("frustum (BVH):     %8.3f ms/frame  %8.1f objects in view\n", frustumMs / frames, double(frustumTotal) / frames);
+    std::printf("occluder select:   %8.3f ms/frame\n", selectMs / frames);
+    std::printf("occluder raster:   %8.3f ms/frame  %8.1f triangles\n", rasterMs / frames, double(triangles) / frames);
+    std::printf("occlusion tests:   %8.3f ms/frame  %8.1f objects left\n", testMs / frames, double(drawnTotal) / frames);
+    std::printf("culled %.1f%% of the objects in view for %.3f ms/frame\n",
+                frustumTotal > 0 ? 100.0 * (frustumTotal - drawnTotal) / frustumTotal : 0.0, (selectMs + rasterMs + testMs) / frames);
+
+    return checkResult();
+}
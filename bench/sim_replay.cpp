@@ -0,0 +1,145 @@
+// Replays a scripted input sequence through the fixed-step simulation at 30, 60 and 240
+// render FPS (plus a run with a one second hitch) and checks that the player and cube
+// trajectories are bit-identical step for step. For contrast it also runs the old
+// per-frame movement (velocity *= 1 - damping * dt) at the same frame rates. Finally it
+// reports simulation throughput. Exits with 1 if any trajectory differs.
+#include "../FixedTimestep.h"
+#include "../Player.h"
+#include "../TransformStore.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const double SIM_HZ = 60.0;
+static const double SECONDS = 20.0;
+
+// Input for a given simulation step: walk a square with some turning and jumps
+static void scriptedInput(uint64_t step, PlayerInput& input, Camera& camera)
+{
+    uint64_t phase = (step / 90) % 4;
+    input.direction = Vec2(phase == 1 ? 1.0f : phase == 3 ? -1.0f : 0.0f, phase == 0 ? 1.0f : phase == 2 ? -0.5f : 0.0f);
+    input.jump = step % 150 == 40;
+    if (step % 7 == 0)
+        camera.processMouseMovement(3.0f, step % 2 ? 1.0f : -1.0f);
+}
+
+struct Trajectory
+{
+    std::vector<Vec3> player;
+    std::vector<float> cubes; // Rotation of one cube per step
+    double droppedTime = 0.0;
+};
+
+// Runs the simulation under a render loop at fps; hitchFrame gets one extra second
+static Trajectory replay(double fps, int hitchFrame = -1)
+{
+    Camera camera(Vec3(0.0f, 0.0f, 3.0f));
+    Player player(Vec3(0.0f, 0.0f, 3.0f), &camera);
+    TransformStore cubes;
+    for (int i = 0; i < 10; i++)
+        cubes.add(Vec3(float(i), 0.0f, 0.0f));
+
+    FixedTimestep simulation(SIM_HZ, 8);
+    PlayerInput input;
+    Trajectory trajectory;
+
+    int frames = static_cast<int>(SECONDS * fps);
+    for (int frame = 0; frame < frames; frame++) {
+        double frameTime = 1.0 / fps + (frame == hitchFrame ? 1.0 : 0.0);
+        int steps = simulation.advance(frameTime);
+        for (int s = 0; s < steps; s++) {
+            scriptedInput(trajectory.player.size(), input, camera);
+            player.step(input, simulation.dt());
+            for (size_t i = 0; i < cubes.size(); i++)
+                cubes.rotate(i, Vec3(1.0f, 1.0f, 1.0f) * 50.0f * simulation.dt());
+
+            trajectory.player.push_back(player.position);
+            trajectory.cubes.push_back(cubes.rx[3]);
+        }
+    }
+    trajectory.droppedTime = simulation.droppedTime;
+    return trajectory;
+}
+
+// Number of leading steps that match bit for bit
+static size_t matchingSteps(const Trajectory& a, const Trajectory& b)
+{
+    size_t n = std::min(a.player.size(), b.player.size());
+    for (size_t i = 0; i < n; i++) {
+        if (memcmp(&a.player[i], &b.player[i], sizeof(Vec3)) != 0 || memcmp(&a.cubes[i], &b.cubes[i], sizeof(float)) != 0)
+            return i;
+    }
+    return n;
+}
+
+// The movement before the fixed step: per-frame acceleration and linear damping
+static Vec3 legacyReplay(double fps)
+{
+    Vec3 position(0.0f), velocity(0.0f);
+    float dt = static_cast<float>(1.0 / fps);
+    int frames = static_cast<int>(2.0 * fps);
+    for (int frame = 0; frame < frames; frame++) {
+        velocity.z -= 2.0f;
+        velocity.z *= 1.0f - 15.0f * dt;
+        position += velocity * dt;
+    }
+    return position;
+}
+
+int main()
+{
+    bool ok = true;
+    Trajectory reference = replay(60.0);
+
+    std::printf("Fixed %g Hz simulation, %g s of scripted input (%zu steps)\n", SIM_HZ, SECONDS, reference.player.size());
+    std::printf("%12s  %7s  %9s  %10s  %s\n", "render", "steps", "matching", "dropped", "final position");
+    struct Run { const char* name; double fps; int hitch; };
+    for (const Run& run : { Run{ "30 FPS", 30.0, -1 }, Run{ "60 FPS", 60.0, -1 }, Run{ "240 FPS", 240.0, -1 }, Run{ "60 + hitch", 60.0, 300 } }) {
+        Trajectory t = replay(run.fps, run.hitch);
+        size_t matching = matchingSteps(reference, t);
+        size_t expected = std::min(reference.player.size(), t.player.size());
+        // Float accumulation may put the last step on either side of the end
+        bool same = matching == expected && expected + 2 >= reference.player.size();
+        ok = ok && same;
+        Vec3 p = t.player.back();
+        std::printf("%12s  %7zu  %9s  %8.3f s  (%.4f, %.4f, %.4f)\n", run.name, t.player.size(), same ? "yes" : "NO",
+                    t.droppedTime, p.x, p.y, p.z);
+    }
+
+    std::printf("\nOld per-frame movement, 2 s holding forward:\n");
+    for (double fps : { 30.0, 60.0, 240.0 })
+        std::printf("%9.0f FPS  z = %.3f\n", fps, legacyReplay(fps).z);
+
+    // Throughput: player steps alone, and with 10k cubes carried along
+    std::printf("\nThroughput:\n");
+    for (size_t cubeCount : { size_t(0), size_t(10000) }) {
+        Camera camera;
+        Player player(Vec3(0.0f), &camera);
+        TransformStore cubes, previousCubes;
+        for (size_t i = 0; i < cubeCount; i++)
+            cubes.add(Vec3(float(i), 0.0f, 0.0f));
+        previousCubes = cubes;
+        PlayerInput input;
+        input.direction = Vec2(0.3f, 1.0f);
+
+        const uint64_t steps = cubeCount == 0 ? 2000000 : 2000;
+        auto start = Clock::now();
+        for (uint64_t s = 0; s < steps; s++) {
+            input.jump = s % 60 == 0;
+            player.step(input, 1.0f / 60.0f);
+            previousCubes.copyComponents(cubes);
+            for (size_t i = 0; i < cubes.size(); i++)
+                cubes.rotate(i, Vec3(50.0f / 60.0f));
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        volatile float sink = player.position.x + (cubeCount ? cubes.rx[0] : 0.0f);
+        (void)sink;
+        std::printf("  player + %5zu cubes: %12.0f steps/s (%.3f us/step)\n", cubeCount, steps / seconds, seconds / steps * 1e6);
+    }
+
+    std::printf("\n%s\n", ok ? "Trajectories identical" : "TRAJECTORIES DIFFER");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+// SoftwareRasterizer checks and throughput, no GL context needed.
+// The checks cover AVX2 against scalar rasterization, images across thread counts, depth
+// order, crack-free shared edges, near-plane clipping and the hierarchical depth test; they
+// exit with 1 on any failure. Then a field of cubes and spheres (wireframe and filled) is
+// rendered on 1..N workers, reporting Mtri/s and the speedup over one worker.
+// Usage: bench/software_raster [objects] [frames] [width] [height] (default 20000, 20, 1280, 720)
+#include "../Cube.h"
+#include "../SoftwareRasterizer.h"
+#include "Bench.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+// Unit sphere as a RasterMesh
+static RasterMesh makeSphere(int segments)
+{
+    RasterMesh mesh;
+    int rings = segments / 2;
+    for (int r = 0; r <= rings; r++) {
+        float phi = 3.14159265f * r / rings;
+        for (int a = 0; a <= segments; a++) {
+            float theta = 6.2831853f * a / segments;
+            mesh.positions.emplace_back(0.5f * std::sin(phi) * std::cos(theta), 0.5f * std::cos(phi),
+                                        0.5f * std::sin(phi) * std::sin(theta));
+        }
+    }
+    for (int r = 0; r < rings; r++) {
+        for (int a = 0; a < segments; a++) {
+            unsigned int i = r * (segments + 1) + a, j = i + segments + 1;
+            mesh.indices.insert(mesh.indices.end(), { i, j, i + 1, i + 1, j, j + 1 });
+        }
+    }
+    return mesh;
+}
+
+// Unit quad in the xy plane
+static RasterMesh makeQuad()
+{
+    RasterMesh mesh;
+    mesh.positions = { glm::vec3(-0.5f, -0.5f, 0.0f), glm::vec3(0.5f, -0.5f, 0.0f), glm::vec3(0.5f, 0.5f, 0.0f),
+                       glm::vec3(-0.5f, 0.5f, 0.0f) };
+    mesh.indices = { 0, 1, 2, 0, 2, 3 };
+    return mesh;
+}
+
+struct SceneObject
+{
+    const RasterMesh* mesh;
+    glm::mat4 model;
+    RasterFill fill;
+};
+
+static std::vector<SceneObject> makeScene(int count, const RasterMesh& cube, const RasterMesh& sphere)
+{
+    std::mt19937 random(9);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<SceneObject> objects;
+    for (int i = 0; i < count; i++) {
+        SceneObject object;
+        object.mesh = random() % 2 ? &cube : &sphere;
+        glm::vec3 position((unit(random) - 0.5f) * 80.0f, (unit(random) - 0.5f) * 45.0f, -3.0f - unit(random) * 60.0f);
+        object.model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), position), unit(random) * 6.0f,
+                                              glm::normalize(glm::vec3(unit(random), unit(random), 0.5f))),
+                                  glm::vec3(0.3f + unit(random)));
+        object.fill = static_cast<RasterFill>(random() % 3);
+        objects.push_back(object);
+    }
+    return objects;
+}
+
+static glm::mat4 viewProjection(int width, int height)
+{
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    return glm::perspective(glm::radians(60.0f), float(width) / height, 0.1f, 100.0f) * view;
+}
+
+static void drawScene(SoftwareRasterizer& raster, const std::vector<SceneObject>& objects, const RasterFill* fill = nullptr)
+{
+    for (const SceneObject& object : objects)
+        raster.draw(*object.mesh, object.model, glm::vec4(1.0f, 0.5f, 0.2f, 1.0f), fill != nullptr ? *fill : object.fill);
+}
+
+static void checks(const RasterMesh& cube, const RasterMesh& sphere)
+{
+    std::printf("Checks:\n");
+    JobSystem jobs(4);
+    const int width = 333, height = 211; // Not multiples of the tile size
+    std::vector<SceneObject> objects = makeScene(3000, cube, sphere);
+
+    std::vector<unsigned char> reference;
+    {
+        SoftwareRasterizer raster(width, height);
+        raster.useAvx2 = false;
+        raster.setViewProjection(viewProjection(width, height));
+        drawScene(raster, objects);
+        raster.render(jobs);
+        raster.readPixels(reference);
+    }
+    if (SoftwareRasterizer().useAvx2) {
+        SoftwareRasterizer raster(width, height);
+        raster.setViewProjection(viewProjection(width, height));
+        drawScene(raster, objects);
+        raster.render(jobs);
+        std::vector<unsigned char> image;
+        raster.readPixels(image);
+        check(image == reference, "AVX2 matches scalar rasterization");
+    } else {
+        std::printf("  (no AVX2 on this CPU; scalar only)\n");
+    }
+    {
+        JobSystem single(1);
+        SoftwareRasterizer raster(width, height);
+        raster.setViewProjection(viewProjection(width, height));
+        drawScene(raster, objects);
+        raster.render(single);
+        std::vector<unsigned char> image;
+        raster.readPixels(image);
+        check(image == reference, "one worker renders the same image as four");
+    }
+
+    RasterMesh quad = makeQuad();
+    glm::mat4 identity(1.0f);
+    const glm::vec4 red(1.0f, 0.0f, 0.0f, 1.0f), green(0.0f, 1.0f, 0.0f, 1.0f);
+    {
+        // A near red quad over a far green one, drawn in both orders
+        SoftwareRasterizer a(64, 64), b(64, 64);
+        glm::mat4 nearQuad = glm::translate(identity, glm::vec3(0.0f, 0.0f, -0.5f));
+        glm::mat4 farQuad = glm::scale(identity, glm::vec3(1.5f, 1.5f, 1.0f));
+        a.draw(quad, nearQuad, red, RasterFill::Solid);
+        a.draw(quad, farQuad, green, RasterFill::Solid);
+        b.draw(quad, farQuad, green, RasterFill::Solid);
+        b.draw(quad, nearQuad, red, RasterFill::Solid);
+        a.render(jobs);
+        b.render(jobs);
+        std::vector<unsigned char> imageA, imageB;
+        a.readPixels(imageA);
+        b.readPixels(imageB);
+        check(imageA == imageB && a.pixel(32, 32) == SoftwareRasterizer::packColor(red), "depth test is independent of draw order");
+    }
+    {
+        // A fan of thin triangles covering the whole target: every pixel exactly once
+        SoftwareRasterizer raster(200, 150);
+        RasterMesh fan;
+        const int spokes = 97;
+        fan.positions.push_back(glm::vec3(0.013f, -0.021f, 0.0f));
+        for (int i = 0; i < spokes; i++) {
+            float angle = 6.2831853f * i / spokes;
+            fan.positions.push_back(glm::vec3(3.0f * std::cos(angle), 3.0f * std::sin(angle), 0.0f));
+        }
+        for (int i = 0; i < spokes; i++)
+            fan.indices.insert(fan.indices.end(), { 0u, 1u + i, 1u + (i + 1) % spokes });
+        raster.draw(fan, identity, red, RasterFill::Solid);
+        raster.render(jobs);
+        int holes = 0;
+        for (int y = 0; y < 150; y++)
+            for (int x = 0; x < 200; x++)
+                holes += raster.pixel(x, y) != SoftwareRasterizer::packColor(red);
+        check(holes == 0, "shared edges leave no cracks");
+    }
+    {
+        // A floor passing under the camera crosses the near plane
+        SoftwareRasterizer raster(128, 128);
+        raster.setViewProjection(viewProjection(128, 128));
+        glm::mat4 floor = glm::scale(glm::rotate(glm::translate(identity, glm::vec3(0.0f, -1.0f, 0.0f)), glm::radians(-90.0f),
+                                                 glm::vec3(1.0f, 0.0f, 0.0f)),
+                                     glm::vec3(200.0f));
+        raster.draw(quad, floor, green, RasterFill::Solid);
+        raster.render(jobs);
+        bool bottomCovered = raster.pixel(64, 127) == SoftwareRasterizer::packColor(green);
+        bool topClear = raster.pixel(64, 0) == raster.pixel(0, 0) && raster.pixel(64, 0) != SoftwareRasterizer::packColor(green);
+        check(raster.statistics.clipped > 0 && bottomCovered && topClear, "near-plane clipping");
+    }
+    {
+        // Objects behind a full-screen wall drawn first are skipped block by block
+        SoftwareRasterizer raster(width, height);
+        raster.setViewProjection(viewProjection(width, height));
+        raster.draw(quad, glm::scale(glm::translate(identity, glm::vec3(0.0f, 0.0f, -2.5f)), glm::vec3(20.0f)), red,
+                    RasterFill::Solid);
+        drawScene(raster, objects);
+        raster.render(jobs);
+        bool allRed = true;
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                allRed = allRed && raster.pixel(x, y) == SoftwareRasterizer::packColor(red);
+        std::printf("  %llu of %llu blocks skipped by depth\n", (unsigned long long)raster.statistics.blocksHidden,
+                    (unsigned long long)(raster.statistics.blocks + raster.statistics.blocksHidden));
+        check(allRed && raster.statistics.blocksHidden > raster.statistics.blocks, "hierarchical depth rejects hidden blocks");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+    int width = argc > 3 ? std::atoi(argv[3]) : 1280;
+    int height = argc > 4 ? std::atoi(argv[4]) : 720;
+
+    RasterMesh cube = RasterMesh::fromArrays(Cube::meshVertices(), Cube::meshIndices());
+    RasterMesh sphere = makeSphere(16);
+    checks(cube, sphere);
+
+    std::vector<SceneObject> objects = makeScene(count, cube, sphere);
+    size_t triangles = 0;
+    for (const SceneObject& object : objects)
+        triangles += object.mesh->triangleCount();
+    std::printf("\n%d objects, %zu triangles, %dx%d, %d frames\n", count, triangles, width, height, frames);
+    std::printf("%-24s %8s %12s %10s %9s\n", "", "workers", "frame", "Mtri/s", "speedup");
+
+    const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    const RasterFill wire = RasterFill::Wireframe, shaded = RasterFill::Shaded;
+    struct Config
+    {
+        const char* name;
+        const RasterFill* fill;
+        bool avx2;
+    };
+    bool hasAvx2 = SoftwareRasterizer().useAvx2;
+    std::vector<Config> configs = { { "wireframe", &wire, hasAvx2 }, { "shaded", &shaded, hasAvx2 } };
+    if (hasAvx2)
+        configs.push_back({ "shaded, scalar", &shaded, false });
+
+    for (const Config& config : configs) {
+        double single = 0.0;
+        for (unsigned workers = 1; workers <= hw; workers *= 2) {
+            JobSystem jobs(workers);
+            SoftwareRasterizer raster(width, height);
+            raster.useAvx2 = config.avx2;
+            raster.setViewProjection(viewProjection(width, height));
+            drawScene(raster, objects, config.fill);
+            raster.render(jobs); // Warm up: bins and buffers grow
+
+            auto start = Clock::now();
+            for (int f = 0; f < frames; f++) {
+                drawScene(raster, objects, config.fill);
+                raster.render(jobs);
+            }
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+            if (workers == 1)
+                single = ms;
+            std::printf("%-24s %8u %9.2f ms %10.1f %8.2fx\n", config.name, workers, ms, triangles / (ms * 1e3), single / ms);
+            if (workers * 2 > hw && workers != hw)
+                workers = hw / 2; // Finish on every hardware thread
+        }
+    }
+
+    return checkResult();
+}
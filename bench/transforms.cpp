@@ -0,0 +1,111 @@
+// Compares the per-object Object::getModelMatrix loop against TransformStore::update
+// (SoA + SSE) at 1k, 100k and 1M objects, with every transform dirty and with a static scene.
+// First checks that the store's matrices match getModelMatrix within float rounding, for
+// counts off the SSE width, non-uniform scales, partial updates and the job system split;
+// exits with 1 if any differs.
+#include "../Object.h"
+#include "../TransformStore.h"
+#include "Bench.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+template <typename F>
+static double bestOf(int runs, F&& f)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = Clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+// Whether every matrix of store matches getModelMatrix of an Object with its components
+static bool matchesObjects(const TransformStore& store)
+{
+    for (size_t i = 0; i < store.size(); i++) {
+        glm::mat4 expected = Object(store.position(i), store.rotation(i), store.scale(i)).getModelMatrix();
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                if (std::fabs(store.matrices[i][c][r] - expected[c][r]) > 1e-4f * std::max(1.0f, std::fabs(expected[c][r])))
+                    return false;
+    }
+    return true;
+}
+
+static void checks()
+{
+    std::printf("Checks:\n");
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> angle(-720.0f, 720.0f), position(-500.0f, 500.0f), scale(-3.0f, 3.0f);
+    for (size_t count : { size_t(1), size_t(7), size_t(1003) }) {
+        TransformStore store;
+        for (size_t i = 0; i < count; i++)
+            store.add(Vec3(position(rng), position(rng), position(rng)), Vec3(angle(rng), angle(rng), angle(rng)),
+                      Vec3(scale(rng), scale(rng), scale(rng)));
+        store.update();
+        std::string what = std::to_string(count) + " transforms match getModelMatrix";
+        check(matchesObjects(store) && store.lastUpdated == count, what.c_str());
+
+        // Only the changed transforms are rebuilt, and they still match
+        for (size_t i = 0; i < count; i += 3)
+            store.rotate(i, Vec3(angle(rng), 0.0f, angle(rng)));
+        store.update();
+        what = std::to_string(count) + " transforms match after a partial update";
+        check(matchesObjects(store) && store.lastUpdated == (count + 2) / 3, what.c_str());
+    }
+
+    JobSystem jobs(4);
+    TransformStore store;
+    for (int i = 0; i < 50001; i++)
+        store.add(Vec3(position(rng), position(rng), position(rng)), Vec3(angle(rng), angle(rng), angle(rng)),
+                  Vec3(scale(rng), scale(rng), scale(rng)));
+    store.update(jobs, 1000);
+    check(matchesObjects(store) && store.lastUpdated == store.size(), "job system update matches getModelMatrix");
+    std::printf("\n");
+}
+
+int main()
+{
+    checks();
+    std::printf("%9s  %14s  %14s  %8s  %14s\n", "objects", "getModelMatrix", "store (dirty)", "speedup", "store (static)");
+    for (size_t count : {size_t(1000), size_t(100000), size_t(1000000)}) {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> dist(-360.0f, 360.0f);
+
+        std::vector<Object> objects;
+        TransformStore store;
+        objects.reserve(count);
+        store.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            Vec3 position(dist(rng), dist(rng), dist(rng));
+            Vec3 rotation(dist(rng), dist(rng), dist(rng));
+            objects.emplace_back(position, rotation, Vec3(1.0f));
+            store.add(position, rotation, Vec3(1.0f));
+        }
+
+        const int runs = count >= 1000000 ? 3 : 10;
+        std::vector<glm::mat4> out(count);
+        double perObject = bestOf(runs, [&] {
+            for (size_t i = 0; i < count; i++)
+                out[i] = objects[i].getModelMatrix();
+        });
+        double dirty = bestOf(runs, [&] {
+            std::fill(store.dirty.begin(), store.dirty.end(), 1);
+            store.update();
+        });
+        double clean = bestOf(runs, [&] { store.update(); });
+
+        // Keep the results observable
+        volatile float sink = out[count / 2][3][0] + store.matrices[count / 2][3][0];
+        (void)sink;
+
+        std::printf("%9zu  %11.3f ms  %11.3f ms  %7.1fx  %11.3f ms\n", count, perObject, dirty, perObject / dirty, clean);
+    }
+    return checkResult();
+}
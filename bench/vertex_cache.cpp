@@ -0,0 +1,249 @@
+// Vertex cache, overdraw and vertex fetch optimization of imported meshes (MeshOptimizer),
+// no GL context needed. For each mesh the index order is measured as loaded, after vertex
+// cache ordering, after overdraw ordering and after the fetch remap:
+// ACMR / ATVR from a 16-entry FIFO simulation, overdraw as shaded fragments per covered
+// pixel from six axis views with a small depth-tested rasterizer, and vertex fetch
+// locality as the distance in vertices between consecutive new vertices. Checks that every stage keeps
+// the same triangles; exits with 1 if one doesn't.
+// Usage: bench/vertex_cache [file.obj...] (default cow.obj plus generated meshes)
+#include "../MeshOptimizer.h"
+#include "../OBJImporter.h"
+#include "Bench.h"
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+struct TestMesh
+{
+    std::string name;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// Row-by-row grid, the order most exporters write
+static TestMesh grid(int n)
+{
+    TestMesh mesh;
+    mesh.name = "grid " + std::to_string(n) + "x" + std::to_string(n) + " (row order)";
+    for (int z = 0; z < n; z++)
+        for (int x = 0; x < n; x++)
+            mesh.positions.push_back(glm::vec3(x * 0.1f, std::sin(x * 0.05f) * std::cos(z * 0.05f), z * 0.1f));
+    for (int z = 0; z + 1 < n; z++) {
+        for (int x = 0; x + 1 < n; x++) {
+            uint32_t i = z * n + x;
+            mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + n + 1, i, i + n + 1, i + n });
+        }
+    }
+    return mesh;
+}
+
+// Latitude-longitude sphere with a knot of inner shells, triangles shuffled as a
+// triangle soup exporter might leave them
+static TestMesh shells(int segments, int count)
+{
+    TestMesh mesh;
+    mesh.name = std::to_string(count) + " nested spheres (shuffled)";
+    int rings = segments / 2;
+    for (int s = 0; s < count; s++) {
+        float radius = 1.0f - s * 0.15f;
+        uint32_t base = static_cast<uint32_t>(mesh.positions.size());
+        for (int r = 0; r <= rings; r++) {
+            float phi = 3.14159265f * r / rings;
+            for (int a = 0; a <= segments; a++) {
+                float theta = 6.2831853f * a / segments;
+                mesh.positions.push_back(radius * glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+            }
+        }
+        for (int r = 0; r < rings; r++) {
+            for (int a = 0; a < segments; a++) {
+                uint32_t i = base + r * (segments + 1) + a, j = i + segments + 1;
+                mesh.indices.insert(mesh.indices.end(), { i, i + 1, j, i + 1, j + 1, j });
+            }
+        }
+    }
+    std::mt19937 random(7);
+    size_t triangles = mesh.indices.size() / 3;
+    for (size_t t = triangles - 1; t > 0; t--) {
+        size_t other = random() % (t + 1);
+        for (int i = 0; i < 3; i++)
+            std::swap(mesh.indices[t * 3 + i], mesh.indices[other * 3 + i]);
+    }
+    return mesh;
+}
+
+// Fragments that pass the depth test per covered pixel, averaged over orthographic views
+// from both ends of the three axes. Triangles are drawn in index order with back faces
+// (clockwise on screen) culled, as with GL_CULL_FACE
+static float overdraw(const TestMesh& mesh, int size = 256)
+{
+    glm::vec3 lo = mesh.positions[0], hi = lo;
+    for (const glm::vec3& p : mesh.positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 extent = hi - lo;
+    float scale = (size - 1) / std::max(extent.x, std::max(extent.y, extent.z));
+
+    uint64_t shaded = 0, covered = 0;
+    std::vector<float> depth(size * size);
+    for (int view = 0; view < 6; view++) {
+        // Looking down -axis from the positive side, or down +axis with u mirrored; (u, v,
+        // towards the viewer) stays right-handed either way
+        int axis = view % 3, uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+        float side = view < 3 ? 1.0f : -1.0f;
+        std::fill(depth.begin(), depth.end(), INFINITY);
+
+        auto project = [&](glm::vec3 p) {
+            glm::vec3 q = (p - lo) * scale;
+            float u = side > 0.0f ? q[uAxis] : (size - 1) - q[uAxis];
+            return glm::vec3(u, q[vAxis], -side * q[axis]); // Smaller z is nearer
+        };
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            glm::vec3 a = project(mesh.positions[mesh.indices[t]]);
+            glm::vec3 b = project(mesh.positions[mesh.indices[t + 1]]);
+            glm::vec3 c = project(mesh.positions[mesh.indices[t + 2]]);
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (area <= 0.0f)
+                continue;
+            int x0 = std::max(0, int(std::floor(std::min(a.x, std::min(b.x, c.x)))));
+            int x1 = std::min(size - 1, int(std::ceil(std::max(a.x, std::max(b.x, c.x)))));
+            int y0 = std::max(0, int(std::floor(std::min(a.y, std::min(b.y, c.y)))));
+            int y1 = std::min(size - 1, int(std::ceil(std::max(a.y, std::max(b.y, c.y)))));
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    float px = x + 0.5f, py = y + 0.5f;
+                    float w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / area;
+                    float w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / area;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                        continue;
+                    float z = w0 * a.z + w1 * b.z + w2 * c.z;
+                    float& stored = depth[y * size + x];
+                    if (z < stored) {
+                        covered += stored == INFINITY;
+                        stored = z;
+                        shaded++;
+                    }
+                }
+            }
+        }
+    }
+    return covered == 0 ? 0.0f : float(shaded) / float(covered);
+}
+
+// Average distance in vertices between consecutive first uses (1 = a straight walk)
+static float fetchStride(const TestMesh& mesh)
+{
+    std::vector<uint8_t> seen(mesh.positions.size(), 0);
+    uint64_t distance = 0, count = 0;
+    long long last = -1;
+    for (uint32_t v : mesh.indices) {
+        if (seen[v])
+            continue;
+        seen[v] = 1;
+        if (last >= 0) {
+            distance += static_cast<uint64_t>(std::llabs(static_cast<long long>(v) - last));
+            count++;
+        }
+        last = v;
+    }
+    return count == 0 ? 0.0f : float(distance) / float(count);
+}
+
+// Triangles as position triples, rotated to start at their smallest position (keeping
+// the winding) and sorted
+static std::vector<std::array<float, 9>> triangleSet(const TestMesh& mesh)
+{
+    std::vector<std::array<float, 9>> set;
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        std::array<float, 9> entry;
+        for (int i = 0; i < 3; i++) {
+            glm::vec3 p = mesh.positions[mesh.indices[t + i]];
+            entry[i * 3] = p.x;
+            entry[i * 3 + 1] = p.y;
+            entry[i * 3 + 2] = p.z;
+        }
+        std::array<float, 9> best = entry;
+        for (int r = 1; r < 3; r++) {
+            std::rotate(entry.begin(), entry.begin() + 3, entry.end());
+            best = std::min(best, entry);
+        }
+        set.push_back(best);
+    }
+    std::sort(set.begin(), set.end());
+    return set;
+}
+
+static void report(const char* stage, const TestMesh& mesh, double ms)
+{
+    VertexCacheStats stats = MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.positions.size());
+    std::printf("  %-12s %7.3f %7.3f %10.3f %12.1f", stage, stats.acmr, stats.atvr, overdraw(mesh), fetchStride(mesh));
+    if (ms >= 0.0)
+        std::printf(" %10.1f ms", ms);
+    std::printf("\n");
+}
+
+static void optimize(TestMesh mesh)
+{
+    std::printf("\n%s: %zu vertices, %zu triangles\n", mesh.name.c_str(), mesh.positions.size(), mesh.indices.size() / 3);
+    std::printf("  %-12s %7s %7s %10s %12s %13s\n", "stage", "ACMR", "ATVR", "overdraw", "fetch stride", "time");
+    std::vector<std::array<float, 9>> original = triangleSet(mesh);
+    report("as loaded", mesh, -1.0);
+
+    auto start = Clock::now();
+    MeshOptimizer::optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.positions.size());
+    report("vertex cache", mesh, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    bool same = triangleSet(mesh) == original;
+
+    start = Clock::now();
+    MeshOptimizer::optimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.positions.data(), mesh.positions.size());
+    report("overdraw", mesh, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    same = same && triangleSet(mesh) == original;
+
+    start = Clock::now();
+    std::vector<uint32_t> remap = MeshOptimizer::optimizeVertexFetch(mesh.indices.data(), mesh.indices.size(), mesh.positions.size());
+    MeshOptimizer::remapVertices(mesh.positions, remap);
+    report("fetch", mesh, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    same = same && triangleSet(mesh) == original;
+
+    check(same, "every stage keeps the same triangles");
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<TestMesh> meshes;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+        paths.push_back("cow.obj");
+
+    for (const std::string& path : paths) {
+        OBJMesh loaded;
+        if (!OBJImporter::loadIndexedOBJ(path.c_str(), loaded)) {
+            std::fprintf(stderr, "Failed to load %s\n", path.c_str());
+            return 1;
+        }
+        TestMesh mesh;
+        mesh.name = path;
+        mesh.positions = loaded.positions;
+        mesh.indices.assign(loaded.indices.begin(), loaded.indices.end());
+        meshes.push_back(std::move(mesh));
+    }
+    if (argc == 1) {
+        meshes.push_back(grid(300));
+        meshes.push_back(shells(256, 4));
+    }
+
+    std::printf("ACMR: vertices transformed per triangle, ATVR: per vertex used (FIFO of %u)\n",
+                MeshOptimizer::CACHE_SIZE);
+    for (const TestMesh& mesh : meshes)
+        optimize(mesh);
+
+    return checkResult();
+}
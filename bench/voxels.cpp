@@ -0,0 +1,380 @@
+// Voxel world checks and cost, no GL context needed.
+// The checks cover palette compression, greedy meshes against the exposed faces they
+// replace, remeshing only the chunks an edit touches, edits surviving eviction, eviction
+// of chunks left behind mid-load, compaction of the chunks set aside, and walking on the
+// blocks; they exit with 1 on any failure. Then terrain chunks of 16^3 and 32^3 blocks
+// are meshed on one thread (chunks/s, quads against one per face) and measured (bytes per
+// chunk against two bytes per block), and a world is streamed on the job system while its
+// center moves, reporting the blocks held and the cost of update().
+// Usage: bench/voxels [radius] [frames] (default 8, 300)
+#include "../VoxelWorld.h"
+#include "Bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Every exposed face of the loaded blocks is covered by exactly one quad of its block's
+// type, and quads cover nothing else
+template <int N>
+static bool coversExposedFaces(const GreedyMesher<N>& mesher, const VoxelMesh& mesh)
+{
+    std::map<std::tuple<int, int, int, int>, BlockId> covered; // (face, x, y, z) -> block
+    for (size_t q = 0; q < mesh.quadCount(); q++) {
+        const VoxelVertex* v = &mesh.vertices[q * 4];
+        int face = v[0].face, axis = face / 2;
+        int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+        for (int k = 0; k < 4; k++) {
+            const int p[3] = { v[k].x, v[k].y, v[k].z };
+            for (int a = 0; a < 3; a++) {
+                low[a] = std::min(low[a], p[a]);
+                high[a] = std::max(high[a], p[a]);
+            }
+        }
+        // The plane sits on the far side of the cells of positive faces
+        low[axis] -= face % 2;
+        high[axis] = low[axis] + 1;
+        for (int y = low[1]; y < high[1]; y++)
+            for (int z = low[2]; z < high[2]; z++)
+                for (int x = low[0]; x < high[0]; x++)
+                    if (!covered.emplace(std::make_tuple(face, x, y, z), v[0].block).second)
+                        return false;
+    }
+    static const int offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+    size_t exposed = 0;
+    for (int y = 0; y < N; y++)
+        for (int z = 0; z < N; z++)
+            for (int x = 0; x < N; x++) {
+                BlockId block = mesher.blocks[mesher.padded(x, y, z)];
+                if (block == AIR)
+                    continue;
+                for (int face = 0; face < 6; face++) {
+                    if (mesher.blocks[mesher.padded(x + offsets[face][0], y + offsets[face][1], z + offsets[face][2])] != AIR)
+                        continue;
+                    exposed++;
+                    auto it = covered.find(std::make_tuple(face, x, y, z));
+                    if (it == covered.end() || it->second != block)
+                        return false;
+                }
+            }
+    return exposed == covered.size();
+}
+
+// Chunks meshed by the world since the last call
+static std::set<std::tuple<int, int, int>> drainMeshed(VoxelWorld& world)
+{
+    std::set<std::tuple<int, int, int>> meshed;
+    world.drainMeshes([&](ChunkCoord c, const VoxelMesh&) { meshed.insert(std::make_tuple(c.x, c.y, c.z)); });
+    world.drainEvicted([](ChunkCoord) {});
+    return meshed;
+}
+
+static void checks()
+{
+    std::printf("Checks:\n");
+    std::mt19937 random(3);
+    {
+        VoxelChunk chunk;
+        bool bits = chunk.bitsPerBlock() == 0 && chunk.memoryBytes() == sizeof(VoxelChunk) + sizeof(BlockId) + sizeof(uint32_t);
+        chunk.set(1, 2, 3, STONE);
+        bits = bits && chunk.bitsPerBlock() == 1;
+        chunk.set(4, 5, 6, DIRT);
+        bits = bits && chunk.bitsPerBlock() == 2;
+
+        std::vector<BlockId> expected(VoxelChunk::VOLUME, AIR);
+        expected[VoxelChunk::cell(1, 2, 3)] = STONE;
+        expected[VoxelChunk::cell(4, 5, 6)] = DIRT;
+        for (int i = 0; i < 20000; i++) {
+            int x = random() % 32, y = random() % 32, z = random() % 32;
+            BlockId block = BlockId(random() % 40);
+            chunk.set(x, y, z, block);
+            expected[VoxelChunk::cell(x, y, z)] = block;
+        }
+        bool same = true;
+        for (int y = 0; y < 32; y++)
+            for (int z = 0; z < 32; z++)
+                for (int x = 0; x < 32; x++)
+                    same = same && chunk.get(x, y, z) == expected[VoxelChunk::cell(x, y, z)];
+        std::vector<BlockId> decoded(VoxelChunk::VOLUME);
+        chunk.decode(decoded.data());
+        check(bits && chunk.bitsPerBlock() == 8 && same && decoded == expected, "palette chunks grow and read back every block");
+
+        for (int y = 0; y < 32; y++)
+            for (int z = 0; z < 32; z++)
+                for (int x = 0; x < 32; x++)
+                    chunk.set(x, y, z, y < 10 ? BlockId(STONE) : AIR);
+        chunk.compact();
+        check(chunk.bitsPerBlock() == 1 && chunk.paletteSize() == 2 && chunk.solidCount() == 10 * 32 * 32,
+              "compact() drops unused types");
+    }
+    {
+        // Random blocks (the worst case for merging) and terrain, with neighbors
+        GreedyMesher<32> mesher;
+        VoxelMesh mesh;
+        std::vector<BlockId> blocks(VoxelChunk::VOLUME);
+        VoxelChunk noise, neighbor(STONE);
+        for (BlockId& block : blocks)
+            block = random() % 3 == 0 ? BlockId(1 + random() % 3) : AIR;
+        noise.assign(blocks.data());
+        const VoxelChunk* neighbors[6] = { &neighbor, nullptr, &neighbor, nullptr, nullptr, &neighbor };
+        mesher.load(noise, neighbors);
+        mesher.build(mesh);
+        bool noiseOk = coversExposedFaces(mesher, mesh);
+
+        TerrainGenerator terrain;
+        VoxelChunk ground;
+        terrain.generate(ChunkCoord{ 0, -1, 0 }, ground);
+        const VoxelChunk* none[6] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+        mesher.load(ground, none);
+        mesher.build(mesh);
+        size_t faces = mesher.countFaces();
+        check(noiseOk && coversExposedFaces(mesher, mesh), "greedy quads cover exactly the exposed faces");
+        std::printf("  terrain chunk: %zu quads for %zu faces\n", mesh.quadCount(), faces);
+        check(mesh.quadCount() * 4 < faces, "merging cuts terrain quads by over 4x");
+    }
+
+    JobSystem jobs(4);
+    VoxelWorldSettings settings;
+    settings.radius = 3;
+    VoxelWorld world(jobs, settings);
+    glm::vec3 center(16.0f, 0.0f, 16.0f);
+    world.loadAround(center);
+    drainMeshed(world);
+    {
+        // Surface blocks inside a chunk, on a face, on an edge and on a corner of chunk (0, 0)
+        int inside = world.terrain().height(10, 10), face = world.terrain().height(0, 10);
+        int edge = world.terrain().height(0, 0);
+        bool meshedOne = world.setBlock(10, inside, 10, AIR);
+        world.loadAround(center);
+        std::set<std::tuple<int, int, int>> meshed = drainMeshed(world);
+        ChunkCoord home = VoxelWorld::chunkOf(10, inside, 10);
+        meshedOne = meshedOne && meshed.size() == 1 && meshed.count(std::make_tuple(home.x, home.y, home.z)) == 1;
+
+        world.setBlock(0, face, 10, STONE);
+        world.loadAround(center);
+        size_t faceMeshes = drainMeshed(world).size();
+        world.setBlock(0, edge, 0, STONE);
+        world.loadAround(center);
+        size_t edgeMeshes = drainMeshed(world).size();
+        std::printf("  remeshed %zu, %zu and %zu chunks\n", meshed.size(), faceMeshes, edgeMeshes);
+        check(meshedOne && faceMeshes == 2 && edgeMeshes >= 3, "edits remesh only the chunks they touch");
+    }
+    {
+        // Edits made while a mesh is in flight: the last mesh matches the final blocks
+        int height = world.terrain().height(5, 5);
+        for (int i = 0; i < 8; i++) {
+            world.setBlock(5, height + 1 + i, 5, SNOW);
+            world.update(center);
+        }
+        world.loadAround(center);
+        VoxelMesh last;
+        world.drainMeshes([&](ChunkCoord c, const VoxelMesh& mesh) {
+            if (c == VoxelWorld::chunkOf(5, height, 5))
+                last = mesh;
+        });
+
+        ChunkCoord home = VoxelWorld::chunkOf(5, height, 5);
+        auto copyChunk = [&](ChunkCoord c, VoxelChunk& chunk) {
+            for (int y = 0; y < 32; y++)
+                for (int z = 0; z < 32; z++)
+                    for (int x = 0; x < 32; x++)
+                        chunk.set(x, y, z, world.getBlock(c.x * 32 + x, c.y * 32 + y, c.z * 32 + z));
+        };
+        static const int offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+        VoxelChunk chunks[7];
+        const VoxelChunk* neighbors[6];
+        copyChunk(home, chunks[0]);
+        for (int f = 0; f < 6; f++) {
+            copyChunk(ChunkCoord{ home.x + offsets[f][0], home.y + offsets[f][1], home.z + offsets[f][2] }, chunks[f + 1]);
+            neighbors[f] = &chunks[f + 1];
+        }
+        GreedyMesher<32> mesher;
+        VoxelMesh fresh;
+        mesher.load(chunks[0], neighbors);
+        mesher.build(fresh);
+        bool same = fresh.vertices.size() == last.vertices.size()
+                 && std::equal(fresh.vertices.begin(), fresh.vertices.end(), last.vertices.begin(), [](const VoxelVertex& a, const VoxelVertex& b) {
+                        return a.x == b.x && a.y == b.y && a.z == b.z && a.face == b.face && a.block == b.block;
+                    });
+        std::printf("  %llu of %llu meshes were stale\n", (unsigned long long)world.statistics.stale,
+                    (unsigned long long)world.statistics.meshed);
+        check(same, "meshes finished after newer edits are replaced");
+    }
+    {
+        // Walk away until the edited chunk is evicted, then come back
+        int height = world.terrain().height(10, 10);
+        BlockId before = world.getBlock(10, height, 10);
+        size_t evicted = 0;
+        glm::vec3 away(16.0f + 32.0f * 12, 0.0f, 16.0f);
+        world.loadAround(away);
+        world.drainEvicted([&](ChunkCoord) { evicted++; });
+        bool gone = world.getBlock(10, height - 5, 10) == AIR;
+        world.loadAround(center);
+        drainMeshed(world);
+        check(before == AIR && evicted > 0 && gone && world.getBlock(10, height, 10) == AIR
+                  && world.getBlock(10, height - 5, 10) == STONE,
+              "edits survive eviction");
+    }
+    {
+        // Moving on while chunks are still generating: they go once their jobs finish,
+        // without another chunk crossing
+        VoxelWorldSettings near;
+        near.radius = 2;
+        VoxelWorld moving(jobs, near);
+        glm::vec3 far(16.0f + 32.0f * 12, 0.0f, 16.0f);
+        moving.update(center);
+        moving.update(far);
+        moving.loadAround(far);
+        size_t columns = 0;
+        for (int dz = -near.radius; dz <= near.radius; dz++)
+            for (int dx = -near.radius; dx <= near.radius; dx++)
+                columns += dx * dx + dz * dz <= near.radius * near.radius;
+        check(moving.chunkCount() == columns * size_t(near.maxChunkY - near.minChunkY),
+              "chunks left behind while loading are evicted");
+
+        // An edit undone before eviction leaves unused palette entries; the chunk set
+        // aside is compacted back to the bits its blocks need
+        VoxelWorld edited(jobs, near), untouched(jobs, near);
+        edited.loadAround(center);
+        untouched.loadAround(center);
+        int height = edited.terrain().height(10, 10);
+        std::vector<BlockId> original;
+        for (int i = 0; i < 40; i++) {
+            original.push_back(edited.getBlock(i % 20, height - i / 20, 10));
+            edited.setBlock(i % 20, height - i / 20, 10, BlockId(100 + i));
+        }
+        for (int i = 0; i < 40; i++)
+            edited.setBlock(i % 20, height - i / 20, 10, original[i]);
+        edited.loadAround(far);
+        untouched.loadAround(far);
+        size_t savedBytes = edited.memoryBytes() - untouched.memoryBytes();
+        std::printf("  edited chunk set aside in %zu bytes\n", savedBytes);
+        check(edited.chunkCount() == untouched.chunkCount() && savedBytes > 0 && savedBytes < size_t(VoxelChunk::VOLUME),
+              "chunks set aside are compacted");
+    }
+    {
+        // A capsule dropped onto the ground comes to rest on the top block
+        CollisionWorld collision;
+        collision.setGrid(&world);
+        int height = world.terrain().height(20, 20);
+        Capsule capsule{ glm::vec3(20.5f, height + 3.3f, 20.5f), glm::vec3(20.5f, height + 4.5f, 20.5f), 0.3f };
+        glm::vec3 moved = collision.slide(capsule, glm::vec3(0.0f, -10.0f, 0.0f));
+        float feet = capsule.a.y - capsule.radius + moved.y;
+        check(std::abs(feet - (height + 1.0f)) < 0.05f, "capsules stand on the blocks");
+    }
+}
+
+template <int N>
+static void meshingBenchmark(int columns)
+{
+    TerrainGenerator terrain;
+    std::vector<PaletteChunk<N>> chunks;
+    size_t uniform = 0, chunkBytes = 0, mixedBytes = 0;
+    for (int cz = 0; cz < columns; cz++) {
+        for (int cx = 0; cx < columns; cx++) {
+            for (int cy = -64 / N; cy < 32 / N; cy++) {
+                PaletteChunk<N> chunk;
+                terrain.generate(ChunkCoord{ cx, cy, cz }, chunk);
+                chunkBytes += chunk.memoryBytes();
+                if (chunk.uniform()) {
+                    uniform++;
+                    continue; // Nothing to mesh inside a single type
+                }
+                mixedBytes += chunk.memoryBytes();
+                chunks.push_back(std::move(chunk));
+            }
+        }
+    }
+    size_t total = uniform + chunks.size();
+
+    GreedyMesher<N> mesher;
+    VoxelMesh mesh;
+    const PaletteChunk<N>* none[6] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+    size_t quads = 0, faces = 0;
+    auto start = Clock::now();
+    for (const PaletteChunk<N>& chunk : chunks) {
+        mesher.load(chunk, none);
+        mesher.build(mesh);
+        quads += mesh.quadCount();
+    }
+    double ms = msSince(start);
+    for (const PaletteChunk<N>& chunk : chunks) {
+        mesher.load(chunk, none);
+        faces += mesher.countFaces();
+    }
+    std::printf("%2d^3: %5zu chunks, %4zu single-type; %8.1f bytes/chunk (dense: %d), %6.1f bytes per mixed chunk\n", N,
+                total, uniform, double(chunkBytes) / total, N * N * N * 2,
+                double(mixedBytes) / std::max<size_t>(1, chunks.size()));
+    std::printf("      meshed %zu mixed chunks in %.1f ms: %8.0f chunks/s, %6.1f Mblocks/s, %zu quads for %zu faces (%.1fx)\n",
+                chunks.size(), ms, chunks.size() / (ms / 1e3), chunks.size() * double(N * N * N) / (ms * 1e3), quads,
+                faces, double(faces) / std::max<size_t>(1, quads));
+}
+
+int main(int argc, char** argv)
+{
+    int radius = argc > 1 ? std::atoi(argv[1]) : 8;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 300;
+
+    checks();
+
+    std::printf("\nMeshing on one thread and memory, terrain of 256x256 columns, y -64..32:\n");
+    meshingBenchmark<16>(16);
+    meshingBenchmark<32>(8);
+
+    JobSystem jobs(std::max(2u, std::thread::hardware_concurrency()));
+    VoxelWorldSettings settings;
+    settings.radius = radius;
+    VoxelWorld world(jobs, settings);
+    std::printf("\nWorld of radius %d chunks on %u workers:\n", radius, jobs.threadCount());
+    auto start = Clock::now();
+    world.loadAround(glm::vec3(0.0f));
+    double loadMs = msSince(start);
+    size_t meshes = 0, quads = 0;
+    world.drainMeshes([&](ChunkCoord, const VoxelMesh& mesh) {
+        meshes++;
+        quads += mesh.quadCount();
+    });
+    std::printf("initial load:  %8.1f ms for %zu chunks (%.0f chunks/s), %zu meshes, %zu quads\n", loadMs,
+                world.chunkCount(), world.chunkCount() / (loadMs / 1e3), meshes, quads);
+    std::printf("held:          %llu solid blocks of %zu, %.2f MB (%.1f bytes/chunk)\n", (unsigned long long)world.solidBlocks(),
+                world.chunkCount() * size_t(VoxelChunk::VOLUME), world.memoryBytes() / 1048576.0,
+                double(world.memoryBytes()) / world.chunkCount());
+
+    // Walk a block per frame (60 blocks/s at 60 Hz). update() queues and collects but never
+    // waits for the workers; the sleep stands in for the rest of the frame, when they run
+    double worst = 0.0, total = 0.0;
+    size_t streamed = 0;
+    uint64_t generatedBefore = world.statistics.generated;
+    for (int f = 0; f < frames; f++) {
+        auto frameStart = Clock::now();
+        world.update(glm::vec3(float(f), 0.0f, f * 0.3f));
+        double ms = msSince(frameStart);
+        total += ms;
+        worst = std::max(worst, ms);
+        world.drainMeshes([&](ChunkCoord, const VoxelMesh&) { streamed++; });
+        world.drainEvicted([](ChunkCoord) {});
+        std::this_thread::sleep_for(std::chrono::milliseconds(4));
+    }
+    std::printf("streaming:     update() %.3f ms/frame, worst %.3f ms; %zu meshes, %llu chunks generated, %llu evicted\n",
+                total / frames, worst, streamed, (unsigned long long)(world.statistics.generated - generatedBefore),
+                (unsigned long long)world.statistics.evicted);
+
+    world.loadAround(glm::vec3(float(frames), 0.0f, frames * 0.3f));
+    start = Clock::now();
+    for (int f = 0; f < frames; f++)
+        world.update(glm::vec3(float(frames), 0.0f, frames * 0.3f));
+    std::printf("standing:      update() %.4f ms/frame once loaded\n", msSince(start) / frames);
+
+    return checkResult();
+}
@@ -6,6 +6,25 @@
 #include "Player.h"
 #include "Camera.h"
 #include "Cube.h"
+#include "RenderQueue.h"
+#include "GLRenderBackend.h"
+#include "GpuScene.h"
+#include "SoftwareRasterizer.h"
+#include "OcclusionCuller.h"
+#include "VoxelRenderer.h"
+#include "TransformStore.h"
+#include "BVH.h"
+#include "ShaderProgram.h"
+#include "UniformBuffer.h"
+#include "Headless.h"
+#include "FixedTimestep.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "ProfilerOverlay.h"
+#include "FrameArena.h"
+#include "AllocationCounter.h"
+#include <imgui_impl_glfw.h>
+#include <imgui_impl_opengl3.h>
 #include <bits/stdc++.h>
 
 using namespace std;
@@ -18,104 +37,139 @@ void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
+// Command-line options
+struct Options
+{
+    bool headless = false;          // Render offscreen through EGL instead of a window
+    int frames = 300;               // Frames to render in headless mode
+    float timestep = 1.0f / 60.0f;  // Fixed deltaTime in headless mode
+    double simHz = 60.0;            // Simulation steps per second
+    const char* dumpPrefix = NULL;  // Write each headless frame to <prefix>NNNN.ppm
+    const char* tracePath = NULL;   // Capture every frame and write a Chrome trace at exit
+    bool checkAllocations = false;  // Fail a headless run if a frame after warm-up allocates
+    bool gpuCulling = false;        // Cull and draw the cubes on the GPU (GpuScene) when the context can
+    bool software = false;          // Rasterize the cubes on the CPU (SoftwareRasterizer) and blit the image
+    bool occlusion = false;         // Skip cubes hidden behind the largest cubes on screen (OcclusionCuller); draws filled
+    bool voxels = false;            // Walk on a block world streamed around the player (VoxelWorld) instead of the floor
+    bool recordCommands = false;    // Record the cubes' draws on the job threads (CommandBuffer) instead of queueing them
+};
+bool parseOptions(int argc, char** argv, Options& options);
+
 // Settings
 const int WIDTH = 800, HEIGHT = 600;
-const char *vertexShaderSource = "#version 330 core\n"
-    "layout (location = 0) in vec3 aPos;\n"
-    "uniform mat4 model;\n"
-    "uniform mat4 view;\n"
-    "uniform mat4 projection;\n"
-    "void main()\n"
-    "{\n"
-    "   gl_Position = projection * view * model * vec4(aPos, 1.0f);\n"
-    "}\0";
-const char *fragmentShaderSource = "#version 330 core\n"
-    "out vec4 FragColor;\n"
-    "void main()\n"
-    "{\n"
-    "   FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
-    "}\n\0";
 
 float deltaTime = 0.0f;	// Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 
+// Simulation runs in fixed steps; input is sampled once per frame
+const int MAX_SIM_STEPS = 8; // Catch-up cap per frame
+PlayerInput playerInput;
+bool breakBlock = false, placeBlock = false; // Mouse clicks this frame, for --voxels
+
+// Profiler overlay (F3 toggles it, F4 starts/saves a trace capture)
+bool showProfiler = true;
+const char* TRACE_FILE = "trace.json";
+
 // Camera
 Camera camera(Vec3(0.0f, 0.0f, 3.0f));
-Player player(Vec3(0.0f, 0.0f, 3.0f), &camera);
 
-int main() {
-    // Initialize GLFW
-    if (!glfwInit()) {
-        std::cout << "Failed to initialize GLFW" << std::endl;
+// Collision geometry the player moves through
+CollisionWorld world;
+Player player(Vec3(0.0f, 0.0f, 3.0f), &camera, &world);
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
         return -1;
     }
 
-    // Set GLFW options
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    // Create a window
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "opengl", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+    // Headless runs render into an offscreen framebuffer of the window's size
+    GLFWwindow* window = NULL;
+    HeadlessContext headlessContext;
+    if (options.headless) {
+        if (!headlessContext.init()) {
+            return -1;
+        }
+    } else {
+        // Initialize GLFW
+        if (!glfwInit()) {
+            std::cout << "Failed to initialize GLFW" << std::endl;
+            return -1;
+        }
+
+        // Set GLFW options
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        // Create a window
+        window = glfwCreateWindow(WIDTH, HEIGHT, "opengl", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
     }
-    glfwMakeContextCurrent(window);
 
     // Initialize GLEW
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cout << "Failed to initialize GLEW" << std::endl;
+    if (!initGlew()) {
         return -1;
     }
 
     // Set the viewport
-    glViewport(0, 0, WIDTH, HEIGHT);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-	// Capture mouse events
-	glfwSetCursorPosCallback(window, mouse_callback);
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // Vertex shaders
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "ERROR: Vertex shader compilation failed\n" << infoLog << std::endl;
+    Framebuffer offscreen;
+    if (options.headless) {
+        if (!offscreen.init(WIDTH, HEIGHT)) {
+            return -1;
+        }
+        offscreen.bind();
+    } else {
+        glViewport(0, 0, WIDTH, HEIGHT);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+        // Capture mouse events
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // Dear ImGui for the profiler overlay (chains to the callbacks above)
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGui::GetIO().IniFilename = NULL;
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330");
     }
 
-    // Fragment shaders
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "ERROR: Fragment shader compilation failed\n" << infoLog << std::endl;
+    // Profiling: CPU scopes, GPU timer queries and frame counters
+    Profiler& profiler = Profiler::instance();
+    profiler.enableGpuTimers(true);
+    if (options.tracePath != NULL) {
+        profiler.startCapture();
     }
 
-    // Link shaders into a shader program
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cout << "ERROR: Shader program linking failed\n" << infoLog << std::endl;
-    }
+    // Worker threads for per-object updates and background asset loads (this thread is worker 0)
+    JobSystem& jobs = JobSystem::instance();
+
+    // Shader programs (per-object and instanced) sharing one compiled fragment stage
+    Shader objectVertex, instancedVertex, colorFragment;
+    objectVertex.load(GL_VERTEX_SHADER, "shaders/object.vert");
+    instancedVertex.load(GL_VERTEX_SHADER, "shaders/instanced.vert");
+    colorFragment.load(GL_FRAGMENT_SHADER, "shaders/color.frag");
 
-    // Delete the shader objects, since they're now linked into the program
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    ShaderProgram objectProgram, instancedProgram;
+    objectProgram.link({ &objectVertex, &colorFragment });
+    instancedProgram.link({ &instancedVertex, &colorFragment });
+    objectProgram.bindBlock("Frame", FrameUniforms::BINDING);
+    instancedProgram.bindBlock("Frame", FrameUniforms::BINDING);
 
+    // Per-frame uniforms (view, projection) live in one buffer shared by every program
+    UniformBuffer<FrameUniforms> frameUniforms;
+    frameUniforms.init(FrameUniforms::BINDING);
+
+    // The uniforms and the render queue's matrices and commands are written into a ring of
+    // frame regions, mapped persistently when the context allows (see StreamBuffer)
+    StreamBuffer frameStream;
+    frameStream.init(256 * 1024);
 
 	// Add positions for multiple cubes
 	Vec3 cubePositions[] = {
@@ -131,74 +185,489 @@ int main() {
 		Vec3(-1.3f,  1.0f, -1.5f)  
 	};
 
-	vector<std::unique_ptr<Cube>> cubes;
+	// The cubes share one geometry buffer and are transformed by a transform store.
+	// The simulation keeps the current and previous states; renderCubes blends the two
+	TransformStore cubes;
 	for (int i = 0; i < 10; i++) {
-		cubes.push_back(std::make_unique<Cube>(cubePositions[i], Vec3(0.0f, 0.0f, 0.0f), Vec3(1.0f, 1.0f, 1.0f)));
+		cubes.add(cubePositions[i], Vec3(0.0f, 0.0f, 0.0f), Vec3(1.0f, 1.0f, 1.0f));
+	}
+	TransformStore previousCubes = cubes, renderCubes = cubes;
+	MeshHandle cubeMesh = Cube::sharedMesh();
+
+	// Draws are queued each frame, then sorted by state and batched (see RenderQueue)
+	RenderQueue renderQueue;
+	renderQueue.init();
+	renderQueue.setStream(&frameStream);
+
+	// With --record-commands the jobs record each visible cube's binds, model matrix and draw,
+	// and the commands are replayed here without the redundant binds (see CommandBuffer)
+	GLRenderBackend commandBackend;
+	uint32_t objectProgramId = commandBackend.addProgram(objectProgram);
+	uint32_t cubeMeshId = commandBackend.addMesh(*cubeMesh);
+	int modelLocation = objectProgram.uniform("model");
+	ParallelRecorder recorder;
+	CommandReplayer replayer;
+
+	// Collision: a floor under the cubes (unless --voxels replaces it), and every cube as a
+	// triangle mesh collider
+	if (!options.voxels) {
+		world.addBox(AABB(Vec3(-100.0f, -4.0f, -100.0f), Vec3(100.0f, -3.0f, 100.0f)));
+	}
+	auto cubeCollision = CollisionMesh::fromArrays(Cube::meshVertices(), Cube::meshIndices());
+	cubes.update();
+	vector<int> cubeColliders;
+	for (size_t i = 0; i < cubes.size(); i++) {
+		cubeColliders.push_back(world.addMesh(cubeCollision, cubes.matrices[i]));
 	}
 
-	// Create an Object instance
-    // Object obj;
-    // if (!obj.loadFromOBJ("cow.obj")) {
-    //     std::cerr << "Failed to load OBJ file." << std::endl;
-    //     return -1;
-    // }
+	// Bounding volume hierarchy over the cubes' world bounds for frustum culling
+	const AABB cubeBounds = cubeMesh->bounds;
+	renderCubes.update();
+	vector<AABB> cubeWorldBounds;
+	for (size_t i = 0; i < renderCubes.size(); i++) {
+		cubeWorldBounds.push_back(cubeBounds.transformed(renderCubes.matrices[i]));
+	}
+	BVH cubeBVH;
+	cubeBVH.build(cubeWorldBounds);
+
+	// With --gpu-culling the cubes also live in GPU buffers, and a compute shader culls them
+	// instead of the BVH
+	GpuScene gpuCubes;
+	bool gpuCulling = options.gpuCulling && !options.software && gpuCubes.init();
+	if (gpuCulling) {
+		int mesh = gpuCubes.addMesh(*cubeMesh);
+		for (size_t i = 0; i < renderCubes.size(); i++) {
+			gpuCubes.add(mesh, renderCubes.matrices[i]);
+		}
+	}
+
+	// With --software the cubes are rasterized on the CPU, a tile per worker at a time, and
+	// the image is uploaded to a texture and blitted over the frame
+	SoftwareRasterizer raster(WIDTH, HEIGHT);
+	RasterMesh cubeRaster;
+	GLuint rasterTexture = 0, rasterFramebuffer = 0;
+	GLint presentFramebuffer = 0;
+	if (options.software || options.occlusion) {
+		cubeRaster = RasterMesh::fromArrays(Cube::meshVertices(), Cube::meshIndices());
+	}
+	if (options.software) {
+		glGenTextures(1, &rasterTexture);
+		glBindTexture(GL_TEXTURE_2D, rasterTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glGenFramebuffers(1, &rasterFramebuffer);
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &presentFramebuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, rasterFramebuffer);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rasterTexture, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, presentFramebuffer);
+	}
+
+	// With --occlusion the cubes covering the most of the screen are rasterized into a
+	// quarter-resolution depth buffer on the CPU, and the other visible cubes are tested
+	// against it. A cube is its own simplified geometry
+	const size_t MAX_OCCLUDERS = 8;
+	OcclusionCuller occlusion(WIDTH / 4, HEIGHT / 4);
+	uint64_t occlusionTested = 0, occlusionCulled = 0;
+	double occlusionMs = 0.0;
+
+	// With --voxels the player walks on a block world whose chunks are generated and meshed
+	// on the workers as they come within reach; the mouse buttons break and place blocks.
+	// Four chunks of radius cover the far plane
+	VoxelWorldSettings voxelSettings;
+	voxelSettings.radius = 4;
+	VoxelWorld voxels(jobs, voxelSettings);
+	VoxelRenderer voxelRenderer;
+	if (options.voxels) {
+		if (!voxelRenderer.init()) {
+			return -1;
+		}
+		world.setGrid(&voxels);
+
+		// Stand on the ground under the spawn point, with the chunks around it ready
+		int ground = voxels.terrain().height(static_cast<int>(floor(player.position.x)), static_cast<int>(floor(player.position.z)));
+		player.position.y = ground + 1.0f + player.eyeHeight + world.skin;
+		player.previousPosition = player.position;
+		voxels.loadAround(player.position);
+	}
+
+	// Stream a model in the background for a row of cows; they draw as its bounding box
+	// until it is uploaded, then each at the level of detail its distance calls for.
+	// Headless runs wait for it, so their frames don't depend on how fast it loads
+	// The cow's simplified levels are coarse, so a few pixels of error are allowed before
+	// the distant ones switch
+	const int COWS = 4;
+	const float COW_LOD_PIXELS = 8.0f;
+	Object cows[COWS];
+	for (int i = 0; i < COWS; i++) {
+		cows[i] = Object(Vec3(4.0f + 2.0f * i, -2.0f, -8.0f - 9.0f * i * i), Vec3(0.0f, -30.0f, 0.0f), Vec3(0.004f));
+		cows[i].loadFromOBJAsync("cow.obj");
+	}
+	AssetStreamer& streamer = AssetStreamer::instance();
+	while (window == NULL && (streamer.pendingLoads() > 0 || streamer.pendingBytes() > 0)) {
+		streamer.update();
+		this_thread::yield();
+	}
 
     // Experimental
     glEnable(GL_DEPTH_TEST);
-	glPolygonMode( GL_FRONT_AND_BACK, GL_LINE);
+	// Wireframe, except with --occlusion: culled cubes would show through wireframe occluders
+	glPolygonMode( GL_FRONT_AND_BACK, options.occlusion ? GL_FILL : GL_LINE);
+	const RasterFill rasterFill = options.occlusion ? RasterFill::Solid : RasterFill::Wireframe;
 
-    // Main loop
-    while (!glfwWindowShouldClose(window)) {
-		// Update deltaTime
-		float currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;  
+    FixedTimestep simulation(options.simHz, MAX_SIM_STEPS);
+
+    // Per-frame wall time of headless runs (includes the GPU through glFinish)
+    vector<double> frameTimes;
+    frameTimes.reserve(options.frames);
+    int frameIndex = 0;
 
-        // Process input
-        processInput(window);
+    // Heap allocations per frame, ignoring the first frames while buffers grow (until the
+    // profiler's history is full, each frame still allocates its event list)
+    const int WARMUP_FRAMES = static_cast<int>(Profiler::HISTORY) + 10;
+    uint64_t maxFrameAllocations = 0;
+    int allocatingFrames = 0;
+    FrameAllocator& frameAllocator = FrameAllocator::instance();
 
-        // Clear the screen & depth buffer
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Main loop
+    while (window != NULL ? !glfwWindowShouldClose(window) : frameIndex < options.frames) {
+        auto frameStart = chrono::steady_clock::now();
+        uint64_t allocationsBefore = AllocationCounter::count();
+        profiler.beginFrame();
+        frameAllocator.beginFrame();
+        frameStream.beginFrame();
+
+        if (window != NULL) {
+            PROFILE_SCOPE("Input");
+
+            // Update deltaTime
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            // Process input
+            processInput(window);
+        } else {
+            // Fixed step so headless runs are reproducible frame for frame
+            deltaTime = options.timestep;
+        }
+
+        // Stream meshes whose background loads finished, within the frame budget
+        streamer.update();
+
+        // Advance the simulation in fixed steps, then place the camera between the last two states
+        {
+            PROFILE_SCOPE("Simulation");
+            int steps = simulation.advance(deltaTime);
+            for (int s = 0; s < steps; s++) {
+                player.step(playerInput, simulation.dt());
+
+                previousCubes.copyComponents(cubes);
+                jobs.parallelFor(0, cubes.size(), 4096, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) {
+                        cubes.rotate(i, Vec3(1.0f, 1.0f, 1.0f) * 50.0f * simulation.dt());
+                    }
+                });
+                cubes.update(jobs);
+                for (size_t i = 0; i < cubes.size(); i++) {
+                    world.setTransform(cubeColliders[i], cubes.matrices[i]);
+                }
+            }
+            player.updateCamera(simulation.alpha());
+        }
+
+        // Apply this frame's block edits, stream chunks around the player, and upload the
+        // meshes finished since the last frame
+        if (options.voxels) {
+            PROFILE_SCOPE("Voxels");
+            glm::ivec3 block, normal;
+            if ((breakBlock || placeBlock) && voxels.raycast(camera.position, camera.front, 8.0f, block, normal)) {
+                if (breakBlock) {
+                    voxels.setBlock(block.x, block.y, block.z, AIR);
+                } else {
+                    glm::ivec3 cell = block + normal;
+                    Vec3 corner(static_cast<float>(cell.x), static_cast<float>(cell.y), static_cast<float>(cell.z));
+                    if (!player.capsule().bounds().overlaps(AABB(corner, corner + Vec3(1.0f)))) {
+                        voxels.setBlock(cell.x, cell.y, cell.z, DIRT);
+                    }
+                }
+            }
+            breakBlock = placeBlock = false;
+            voxels.update(player.position);
+            voxelRenderer.update(voxels);
+        }
 
         // Create the view & projection matrices
 		Mat4 view = camera.getViewMatrix();
         Mat4 projection = glm::perspective(glm::radians(camera.fov), (float)WIDTH / HEIGHT, 0.1f, 100.0f);
 
-        // Use shader program and set common uniforms
-        glUseProgram(shaderProgram);
-        int viewLoc = glGetUniformLocation(shaderProgram, "view");
-        int projLoc = glGetUniformLocation(shaderProgram, "projection");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+        // Per-frame uniforms shared by every program
+        FrameUniforms frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.viewProjection = projection * view;
+
+		// Blend the cubes between simulation states and rebuild their model matrices in one pass
+		{
+			PROFILE_SCOPE("Transforms");
+			renderCubes.interpolate(previousCubes, cubes, simulation.alpha());
+			renderCubes.update(jobs);
+		}
 
-		// Render cubes
-		for (const auto& cube : cubes) {
-			// Update rotation
-			cube->rotation += Vec3(1.0f, 1.0f, 1.0f) * 50.0f * deltaTime;
+		// Refit the BVH to the moved cubes and keep only those inside the view frustum.
+		// The list lives in this frame's arena
+		pmr::vector<int> visibleCubes(frameAllocator.resource());
+		if (!gpuCulling) {
+			PROFILE_SCOPE("Culling");
+			for (size_t i = 0; i < renderCubes.size(); i++) {
+				cubeBVH.setBounds(static_cast<int>(i), cubeBounds.transformed(renderCubes.matrices[i]));
+			}
+			cubeBVH.refit();
+			visibleCubes.reserve(renderCubes.size());
+			cubeBVH.query(Frustum::fromMatrix(frame.viewProjection), visibleCubes);
+		}
+		if (options.occlusion && !gpuCulling) {
+			PROFILE_SCOPE("Occlusion");
+			auto occlusionStart = chrono::steady_clock::now();
+
+			// Occluders: the largest cubes on screen, by bounds size over distance squared
+			pmr::vector<pair<float, int>> byCoverage(frameAllocator.resource());
+			byCoverage.reserve(visibleCubes.size());
+			for (int i : visibleCubes) {
+				AABB bounds = cubeBounds.transformed(renderCubes.matrices[i]);
+				Vec3 offset = bounds.center() - camera.position, extent = bounds.extent();
+				byCoverage.emplace_back(-glm::dot(extent, extent) / glm::dot(offset, offset), i);
+			}
+			size_t occluders = min(MAX_OCCLUDERS, byCoverage.size());
+			partial_sort(byCoverage.begin(), byCoverage.begin() + occluders, byCoverage.end());
+			occlusion.beginFrame(frame.viewProjection);
+			for (size_t o = 0; o < occluders; o++) {
+				occlusion.addOccluder(cubeRaster, renderCubes.matrices[byCoverage[o].second]);
+			}
+
+			// Keep the cubes with a pixel in front of the occluders
+			size_t kept = 0;
+			for (int i : visibleCubes) {
+				if (occlusion.visible(cubeBounds.transformed(renderCubes.matrices[i]))) {
+					visibleCubes[kept++] = i;
+				}
+			}
+			visibleCubes.resize(kept);
+
+			occlusionTested += occlusion.statistics.tested;
+			occlusionCulled += occlusion.statistics.culled;
+			profiler.counters.occlusionTested += occlusion.statistics.tested;
+			profiler.counters.occlusionCulled += occlusion.statistics.culled;
+			occlusionMs += chrono::duration<double, milli>(chrono::steady_clock::now() - occlusionStart).count();
+		}
 
-			// Get the model matrix
-			Mat4 model = cube->getModelMatrix();
+		// Stream the uniforms, then draw the cubes: rasterized on the CPU, culled on the GPU, or
+		// queued from the visible list and drawn in sorted batches
+		{
+			PROFILE_SCOPE("Scene");
+			PROFILE_GPU("Scene");
+
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			frameUniforms.update(frame, frameStream);
+
+			if (options.software) {
+				raster.setViewProjection(frame.viewProjection);
+				for (int i : visibleCubes) {
+					raster.draw(cubeRaster, renderCubes.matrices[i], glm::vec4(1.0f, 0.5f, 0.2f, 1.0f), rasterFill);
+				}
+				raster.render(jobs);
+				visibleCubes.clear(); // Drawn: nothing left for the queue
+
+				// The rasterizer's rows run top down, so the blit flips them
+				glBindTexture(GL_TEXTURE_2D, rasterTexture);
+				glPixelStorei(GL_UNPACK_ROW_LENGTH, raster.rowStride());
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, raster.pixels());
+				glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, rasterFramebuffer);
+				glBlitFramebuffer(0, 0, WIDTH, HEIGHT, 0, HEIGHT, WIDTH, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, presentFramebuffer);
+			}
+
+			// Blocks are always filled: in wireframe the chunks' quads would show through the
+			// ground. They go after the software blit, which replaces the whole image
+			if (options.voxels) {
+				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+				voxelRenderer.draw(frame.viewProjection);
+				glPolygonMode(GL_FRONT_AND_BACK, options.occlusion ? GL_FILL : GL_LINE);
+			}
+			if (gpuCulling) {
+				for (size_t i = 0; i < renderCubes.size(); i++) {
+					gpuCubes.setTransform(static_cast<int>(i), renderCubes.matrices[i]);
+				}
+				gpuCubes.draw(instancedProgram, frame.viewProjection, camera.position, camera.fov, HEIGHT);
+			}
+			if (options.recordCommands) {
+				recorder.record(jobs, visibleCubes.size(), 256, [&](CommandBuffer& commands, size_t begin, size_t end) {
+					for (size_t v = begin; v < end; v++) {
+						commands.bindProgram(objectProgramId);
+						commands.bindMesh(cubeMeshId);
+						commands.setMat4(modelLocation, renderCubes.matrices[visibleCubes[v]]);
+						commands.draw();
+					}
+				});
+				replayer.reset();
+				recorder.replay(replayer, commandBackend);
+				commandBackend.unbind(replayer);
+				visibleCubes.clear(); // Drawn
+			}
+			for (int i : visibleCubes) {
+				const Mat4& model = renderCubes.matrices[i];
+				renderQueue.submit(instancedProgram, *cubeMesh, 0, 0, model, glm::length(Vec3(model[3]) - camera.position));
+			}
+			for (Object& cow : cows) {
+				cow.updateStream();
+				cow.selectLOD(camera, HEIGHT, COW_LOD_PIXELS);
+				cow.submit(renderQueue, instancedProgram, 0, camera.position);
+			}
+			renderQueue.flush();
+		}
+		frameStream.endFrame();
+
+		// Profiler overlay
+		if (window != NULL && showProfiler) {
+			PROFILE_SCOPE("Overlay");
+			PROFILE_GPU("Overlay");
+
+			ImGui_ImplOpenGL3_NewFrame();
+			ImGui_ImplGlfw_NewFrame();
+			ImGui::NewFrame();
+			drawProfilerOverlay(profiler);
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
 
-			// Set the model matrix uniform
-			int modelLoc = glGetUniformLocation(shaderProgram, "model");
-			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+        if (window != NULL) {
+            PROFILE_SCOPE("Present");
+
+            // Swap buffers and poll events
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        } else {
+            glFinish();
+            frameTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count());
+
+            if (options.dumpPrefix != NULL) {
+                char path[1024];
+                snprintf(path, sizeof(path), "%s%04d.ppm", options.dumpPrefix, frameIndex);
+                offscreen.writePPM(path);
+            }
+        }
+        if (frameIndex >= WARMUP_FRAMES) {
+            uint64_t allocations = AllocationCounter::count() - allocationsBefore;
+            maxFrameAllocations = max(maxFrameAllocations, allocations);
+            allocatingFrames += allocations > 0;
+        }
+        frameIndex++;
+    }
 
-			// Draw the cube
-			cube->draw();
-		}
+    // Frame time summary for headless runs (dumping is excluded from the timings)
+    if (!frameTimes.empty()) {
+        vector<double> sorted = frameTimes;
+        sort(sorted.begin(), sorted.end());
+        double total = accumulate(sorted.begin(), sorted.end(), 0.0);
+        printf("Rendered %d frames at %dx%d (%s)\n", frameIndex, WIDTH, HEIGHT, (const char*)glGetString(GL_RENDERER));
+        printf("Frame time (ms): mean %.3f  median %.3f  p95 %.3f  max %.3f\n",
+               total / sorted.size(), sorted[sorted.size() / 2],
+               sorted[min(sorted.size() - 1, sorted.size() * 95 / 100)], sorted.back());
+        if (occlusionTested > 0) {
+            printf("Occlusion culling: %.1f%% of %llu tested cubes culled, %.3f ms per frame\n",
+                   100.0 * occlusionCulled / occlusionTested, (unsigned long long)occlusionTested, occlusionMs / frameIndex);
+        }
+        printf("Stream buffer: %s, %.0f KB per frame, %llu frames waited on fences for %.3f ms\n",
+               frameStream.persistent() ? "persistent" : "GL 3.3 copies", frameStream.capacity() / 1024.0,
+               (unsigned long long)frameStream.blockedFrames, frameStream.fenceWaitMs);
+        printf("Triangles: last frame drew %llu of %llu at full detail, cows at LOD",
+               (unsigned long long)profiler.counters.triangles, (unsigned long long)profiler.counters.trianglesFullDetail);
+        for (const Object& cow : cows) {
+            printf(" %d", cow.lod);
+        }
+        printf("\n");
+        if (options.recordCommands) {
+            printf("Command buffers: last frame replayed %llu commands from %zu buffers, %llu redundant ones dropped\n",
+                   (unsigned long long)replayer.replayed, recorder.bufferCount(), (unsigned long long)replayer.filtered);
+        }
+        if (options.voxels) {
+            printf("Voxels: %zu chunks holding %llu blocks in %.1f MB, %zu meshes drawn from %.1f MB of vertices\n",
+                   voxels.chunkCount(), (unsigned long long)voxels.solidBlocks(), voxels.memoryBytes() / 1048576.0,
+                   voxelRenderer.chunkCount(), voxelRenderer.bufferBytes() / 1048576.0);
+        }
+        if (frameIndex > WARMUP_FRAMES) {
+            printf("Heap allocations after %d warm-up frames: %d of %d frames allocated, at most %llu\n", WARMUP_FRAMES,
+                   allocatingFrames, frameIndex - WARMUP_FRAMES, (unsigned long long)maxFrameAllocations);
+        }
+    }
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // Chrome trace of the whole run
+    profiler.endFrame();
+    if (options.tracePath != NULL) {
+        if (profiler.writeChromeTrace(options.tracePath)) {
+            printf("Wrote trace to %s\n", options.tracePath);
+        } else {
+            std::cout << "Failed to write " << options.tracePath << std::endl;
+        }
     }
 
     // Clean up
-    glDeleteProgram(shaderProgram);
-    glfwTerminate();
+    if (window != NULL) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+        glfwTerminate();
+    }
+
+    if (options.checkAllocations && allocatingFrames > 0) {
+        std::cout << "Error: " << allocatingFrames << " steady-state frames allocated from the heap." << std::endl;
+        return 1;
+    }
     return 0;
 }
 
+// Parses --headless, --frames N, --timestep SECONDS, --sim-hz HZ, --dump PREFIX, --trace PATH,
+// --check-allocations, --gpu-culling, --software, --occlusion, --voxels and --record-commands
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--frames" && hasValue) {
+            options.frames = atoi(argv[++i]);
+        } else if (arg == "--timestep" && hasValue) {
+            options.timestep = static_cast<float>(atof(argv[++i]));
+        } else if (arg == "--dump" && hasValue) {
+            options.dumpPrefix = argv[++i];
+        } else if (arg == "--sim-hz" && hasValue) {
+            options.simHz = atof(argv[++i]);
+        } else if (arg == "--trace" && hasValue) {
+            options.tracePath = argv[++i];
+        } else if (arg == "--check-allocations") {
+            options.checkAllocations = true;
+        } else if (arg == "--gpu-culling") {
+            options.gpuCulling = true;
+        } else if (arg == "--software") {
+            options.software = true;
+        } else if (arg == "--occlusion") {
+            options.occlusion = true;
+        } else if (arg == "--voxels") {
+            options.voxels = true;
+        } else if (arg == "--record-commands") {
+            options.recordCommands = true;
+        } else {
+            std::cout << "Usage: " << argv[0] << " [--headless] [--frames N] [--timestep SECONDS] [--sim-hz HZ] [--dump PREFIX] [--trace PATH] [--check-allocations] [--gpu-culling] [--software] [--occlusion] [--voxels] [--record-commands]" << std::endl;
+            return false;
+        }
+    }
+    if (options.frames <= 0 || options.timestep <= 0.0f || options.simHz <= 0.0) {
+        std::cout << "--frames, --timestep and --sim-hz must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
 // Process inputs
 void processInput(GLFWwindow *window) {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
@@ -215,12 +684,38 @@ void processInput(GLFWwindow *window) {
 		xDir -= 1.0f;
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		xDir += 1.0f;
-	player.move(Vec2(xDir, yDir), deltaTime);
-
-	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-		player.jump();
+	playerInput.direction = Vec2(xDir, yDir);
+	playerInput.jump = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+
+	// Block edits (edge-triggered): the left button breaks, the right one places
+	static bool leftDown = false, rightDown = false;
+	bool left = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+	bool right = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+	breakBlock = left && !leftDown;
+	placeBlock = right && !rightDown;
+	leftDown = left;
+	rightDown = right;
+
+	// Profiler keys (edge-triggered)
+	static bool f3Down = false, f4Down = false;
+	bool f3 = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+	bool f4 = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+	if (f3 && !f3Down) {
+		showProfiler = !showProfiler;
+	}
+	if (f4 && !f4Down) {
+		Profiler& profiler = Profiler::instance();
+		if (!profiler.capturing()) {
+			profiler.startCapture();
+		} else {
+			profiler.stopCapture();
+			if (profiler.writeChromeTrace(TRACE_FILE)) {
+				std::cout << "Wrote " << TRACE_FILE << std::endl;
+			}
+		}
 	}
-	player.updateVertical(deltaTime);
+	f3Down = f3;
+	f4Down = f4;
 }
 
 // Mouse movement callback
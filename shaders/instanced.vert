@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 instanceModel;
+
+layout (std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+};
+
+void main()
+{
+    gl_Position = viewProjection * instanceModel * vec4(aPos, 1.0f);
+}
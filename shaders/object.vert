@@ -0,0 +1,40 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+#ifdef NORMAL_FLOAT3
+layout (location = 1) in vec3 aNormal;
+#else
+layout (location = 1) in vec2 aNormal; // Octahedral, snorm16 as raw shorts (VertexFormat::NORMAL_OCT16)
+#endif
+layout (location = 2) in vec2 aUV;
+
+layout (std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+};
+
+// Includes the mesh's position dequantization (see Object::getDrawMatrix)
+uniform mat4 model;
+
+out vec3 vNormal; // Model space
+out vec2 vUV;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+    return normalize(n);
+}
+
+void main()
+{
+#ifdef NORMAL_FLOAT3
+    vNormal = aNormal;
+#else
+    vNormal = octDecode(aNormal / 32767.0f);
+#endif
+    vUV = aUV;
+    gl_Position = viewProjection * model * vec4(aPos, 1.0f);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+flat in uint vFace;
+flat in uint vBlock;
+
+out vec4 FragColor;
+
+// Indexed by TerrainBlock (VoxelWorld.h); 0 is air
+const vec3 blockColors[6] = vec3[6](
+    vec3(1.0f, 0.0f, 1.0f),
+    vec3(0.36f, 0.62f, 0.25f), // Grass
+    vec3(0.52f, 0.37f, 0.24f), // Dirt
+    vec3(0.5f, 0.5f, 0.52f),   // Stone
+    vec3(0.86f, 0.8f, 0.55f),  // Sand
+    vec3(0.94f, 0.96f, 1.0f)   // Snow
+);
+
+// Fixed light per face (-x, +x, -y, +y, -z, +z) so block edges read without normals
+const float faceShade[6] = float[6](0.7f, 0.8f, 0.5f, 1.0f, 0.75f, 0.85f);
+
+void main()
+{
+    vec3 color = vBlock < 6u ? blockColors[vBlock] : blockColors[0];
+    FragColor = vec4(color * faceShade[vFace], 1.0f);
+}
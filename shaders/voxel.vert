@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in uvec4 aPosFace; // Chunk-local corner (xyz) and face (w), see VoxelVertex
+layout (location = 1) in uint aBlock;
+
+layout (std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+};
+
+// World position of the chunk's corner
+uniform vec3 chunkOrigin;
+
+flat out uint vFace;
+flat out uint vBlock;
+
+void main()
+{
+    vFace = aPosFace.w;
+    vBlock = aBlock;
+    gl_Position = viewProjection * vec4(chunkOrigin + vec3(aPosFace.xyz), 1.0f);
+}
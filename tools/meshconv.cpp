@@ -0,0 +1,60 @@
+// Bakes OBJ files into binary mesh caches offline.
+// Usage: meshconv [-f] file.obj...        writes file.obj.mesh next to each source
+//        meshconv file.obj -o out.mesh    writes a single mesh to out.mesh
+// Up-to-date caches are skipped unless -f is given.
+#include "../MeshFile.h"
+#include <cstring>
+
+int main(int argc, char** argv)
+{
+    std::vector<const char*> inputs;
+    const char* output = nullptr;
+    bool force = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0) {
+            force = true;
+        } else if (argv[i][0] == '-') {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 2;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty() || (output != nullptr && inputs.size() != 1)) {
+        std::cerr << "Usage: " << argv[0] << " [-f] file.obj... | file.obj -o out.mesh" << std::endl;
+        return 2;
+    }
+
+    int failures = 0;
+    for (const char* input : inputs) {
+        std::string path = output ? output : MeshFile::cachePath(input);
+
+        MeshFile existing;
+        if (!force && existing.open(path.c_str()) && existing.isCurrent(input)) {
+            std::cout << path << " is up to date" << std::endl;
+            continue;
+        }
+
+        MeshBuildStats stats;
+        if (!MeshFile::bake(input, path.c_str(), &stats)) {
+            std::cerr << "Failed to convert " << input << std::endl;
+            failures++;
+            continue;
+        }
+        std::cout << input << ": " << stats.corners << " corners -> " << stats.vertices << " vertices ("
+                  << double(stats.corners) / stats.vertices << "x), " << stats.indexBits << "-bit indices, saved "
+                  << stats.savedBytes << " bytes" << std::endl;
+        std::cout << input << ": LOD triangles";
+        for (uint32_t i = 0; i < stats.lodCount; i++)
+            std::cout << " " << stats.lodTriangles[i];
+        std::cout << ", max error " << stats.maxError << std::endl;
+        std::cout << input << ": ACMR " << stats.before.acmr << " -> " << stats.after.acmr << ", ATVR "
+                  << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+        std::cout << "Wrote " << path << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}